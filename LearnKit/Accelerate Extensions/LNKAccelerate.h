@@ -5,10 +5,14 @@
 //  Copyright (c) 2014 Matt Rajca. All rights reserved.
 //
 
-#import <Accelerate/Accelerate.h>
+#import "LNKAccelerateBLAS.h"
 
 #define UNIT_STRIDE 1
 
+#if USE_ACCELERATE
+
+#import <Accelerate/Accelerate.h>
+
 #if USE_DOUBLE_PRECISION
 
 #define LNK_vfill		vDSP_vfillD
@@ -35,7 +39,6 @@
 #define LNK_vlog		vvlog
 #define LNK_vexp		vvexp
 #define LNK_vtanh		vvtanh
-#define LNK_vpows		vvpows
 
 #define LNK_sqrt		sqrt
 #define LNK_pow			pow
@@ -74,7 +77,6 @@
 #define LNK_vlog		vvlogf
 #define LNK_vexp		vvexpf
 #define LNK_vtanh		vvtanhf
-#define LNK_vpows		vvpowsf
 
 #define LNK_sqrt		sqrtf
 #define LNK_pow			powf
@@ -89,12 +91,66 @@
 
 #endif
 
+#else
+
+#define LNK_vfill		LNKPortable_vfill
+#define LNK_vclr		LNKPortable_vclr
+#define LNK_vmean		LNKPortable_vmean
+#define LNK_vsadd		LNKPortable_vsadd
+#define LNK_dotpr		LNKPortable_dotpr
+#define LNK_vadd		LNKPortable_vadd
+#define LNK_vdiv		LNKPortable_vdiv
+#define LNK_vsub		LNKPortable_vsub
+#define LNK_vsdiv		LNKPortable_vsdiv
+#define LNK_mmul		LNKPortable_mmul
+#define LNK_mmov		LNKPortable_mmov
+#define LNK_vmul		LNKPortable_vmul
+#define LNK_vsmul		LNKPortable_vsmul
+#define LNK_vsmsa		LNKPortable_vsmsa
+#define LNK_vneg		LNKPortable_vneg
+#define LNK_vsma		LNKPortable_vsma
+#define LNK_svdiv		LNKPortable_svdiv
+#define LNK_vsum		LNKPortable_vsum
+#define LNK_vsq			LNKPortable_vsq
+#define LNK_minv		LNKPortable_minv
+#define LNK_maxv		LNKPortable_maxv
+#define LNK_vlog		LNKPortable_vlog
+#define LNK_vexp		LNKPortable_vexp
+#define LNK_vtanh		LNKPortable_vtanh
+
+#if USE_DOUBLE_PRECISION
+
+#define LNK_sqrt		sqrt
+#define LNK_pow			pow
+#define LNK_exp			exp
+#define LNK_fabs		fabs
+#define LNKLog			log
+#define LNKLog2			log2
+#define LNK_strtoflt(str)	strtod((str), NULL)
+
+#else
+
+#define LNK_sqrt		sqrtf
+#define LNK_pow			powf
+#define LNK_exp			expf
+#define LNK_fabs		fabsf
+#define LNKLog			logf
+#define LNKLog2			log2f
+#define LNK_strtoflt(str,len)	strtof((str), NULL)
+
+#endif
+
+/// Computes the euclidean distance between the two vectors.
+#define LNKVectorDistance(vector1, vector2, outDistance, n) LNKPortable_distancesq((vector1), UNIT_STRIDE, (vector2), UNIT_STRIDE, (outDistance), (n))
+
+#endif
+
 /* In-place operations */
 
-void LNK_mtrans(const LNKFloat *source, LNKFloat *dest, vDSP_Length N, vDSP_Length M);
+void LNK_mtrans(const LNKFloat *source, LNKFloat *dest, LNKSize N, LNKSize M);
 
-/// Inverts a matrix of dimensions n * n.
-void LNK_minvert(LNKFloat *matrix, LNKSize n);
+/// Inverts a matrix of dimensions n * n. Returns `NO` if the matrix is singular.
+BOOL LNK_minvert(LNKFloat *matrix, LNKSize n);
 
 /// Applies the sigmoid function to every element of the vector.
 void LNK_vsigmoid(LNKFloat *vector, LNKSize n);
@@ -104,10 +160,20 @@ void LNK_vsigmoid(LNKFloat *vector, LNKSize n);
 /// Applies the gradient of the sigmoid function to every element of the sigmoid vector.
 void LNK_vsigmoidgrad(const LNKFloat *vector, LNKFloat *outVector, LNKSize n);
 
+/// Raises every element of `x` to the same `exponent`.
+void LNK_vpows(LNKFloat *z, LNKFloat exponent, const LNKFloat *x, LNKSize n);
+
+/// Computes the m * n matrix `c = a' * b` where `a` is p * m and `b` is p * n, without transposing `a` in memory.
+void LNK_mmultrans(const LNKFloat *a, const LNKFloat *b, LNKFloat *c, LNKSize m, LNKSize n, LNKSize p);
+
 /// Computes the standard deviation of the elements in the vector.
 LNKFloat LNK_vsd(LNKVector vector, LNKSize stride, LNKFloat *workgroup, LNKFloat mean, BOOL inSample);
 
 /// Computes the determinant of the n * n matrix.
 LNKFloat LNK_mdet(const LNKFloat *matrix, LNKSize n);
 
+/// Computes the singular values and right singular vectors of the n * n matrix.
+/// Returns `NO` if the decomposition could not be performed.
+BOOL LNK_msvd(const LNKFloat *matrix, LNKSize n, LNKFloat *outSingularValues, LNKFloat *outVT);
+
 LNKFloat LNK_vlogsumexp(const LNKFloat *vector, LNKSize n);
@@ -7,9 +7,17 @@
 
 #import "LNKAccelerate.h"
 
-void LNK_mtrans(const LNKFloat *source, LNKFloat *dest, vDSP_Length N, vDSP_Length M) {
+#import "LNKMemoryBufferManager.h"
+
+#if !USE_ACCELERATE
+#include <cblas.h>
+#endif
+
+void LNK_mtrans(const LNKFloat *source, LNKFloat *dest, LNKSize N, LNKSize M) {
 	if (source == dest) {
-#if USE_DOUBLE_PRECISION
+#if !USE_ACCELERATE
+		LNKPortable_mtrans(source, UNIT_STRIDE, dest, UNIT_STRIDE, N, M);
+#elif USE_DOUBLE_PRECISION
 		vDSP_mtransD(source, UNIT_STRIDE, dest, UNIT_STRIDE, N, M);
 #else
 		vDSP_mtrans(source, UNIT_STRIDE, dest, UNIT_STRIDE, N, M);
@@ -19,13 +27,13 @@ void LNK_mtrans(const LNKFloat *source, LNKFloat *dest, vDSP_Length N, vDSP_Leng
 
 #define BLOCK_SIZE 16
 	
-	for (vDSP_Length i = 0; i < N; i += BLOCK_SIZE) {
-		for (vDSP_Length j = 0; j < M; j += BLOCK_SIZE) {
-			const vDSP_Length imax = MIN(i + BLOCK_SIZE, N);
-			const vDSP_Length jmax = MIN(j + BLOCK_SIZE, M);
+	for (LNKSize i = 0; i < N; i += BLOCK_SIZE) {
+		for (LNKSize j = 0; j < M; j += BLOCK_SIZE) {
+			const LNKSize imax = MIN(i + BLOCK_SIZE, N);
+			const LNKSize jmax = MIN(j + BLOCK_SIZE, M);
 			
-			for (vDSP_Length k = i; k < imax; ++k) {
-				for (vDSP_Length l = j; l < jmax; ++l) {
+			for (LNKSize k = i; k < imax; ++k) {
+				for (LNKSize l = j; l < jmax; ++l) {
 					dest[l + k*M] = source[k + l*N];
 				}
 			}
@@ -33,25 +41,20 @@ void LNK_mtrans(const LNKFloat *source, LNKFloat *dest, vDSP_Length N, vDSP_Leng
 	}
 }
 
-void LNK_minvert(LNKFloat *matrix, LNKSize n) {
+BOOL LNK_minvert(LNKFloat *matrix, LNKSize n) {
 	NSCAssert(matrix, @"The matrix must not be NULL");
 	NSCAssert(n, @"The length must be greater than 0");
 	
-	__CLPK_integer *pivot = malloc(n * n * sizeof(__CLPK_integer));
-	__CLPK_integer error = 0;
-	__CLPK_integer np = (__CLPK_integer)n;
-	LNKFloat *workspace = LNKFloatAlloc(n);
+	int *pivot = malloc(n * sizeof(int));
+	int error = LNKPortable_getrf(matrix, n, pivot);
 	
-#if USE_DOUBLE_PRECISION
-	dgetrf_(&np, &np, matrix, &np, pivot, &error);
-	dgetri_(&np, matrix, &np, pivot, workspace, &np, &error);
-#else
-	sgetrf_(&np, &np, matrix, &np, pivot, &error);
-	sgetri_(&np, matrix, &np, pivot, workspace, &np, &error);
-#endif
+	if (error == 0) {
+		error = LNKPortable_getri(matrix, n, pivot);
+	}
 	
-	free(workspace);
 	free(pivot);
+	
+	return error == 0;
 }
 
 void LNK_vsigmoid(LNKFloat *vector, LNKSize n) {
@@ -74,11 +77,43 @@ void LNK_vsigmoidgrad(const LNKFloat *vector, LNKFloat *outVector, LNKSize n) {
 	NSCAssert(n, @"The length must be greater than 0");
 	
 	// vector (1 - vector) = vector - vector^2
-	LNKFloat *vectorSquared = LNKFloatAlloc(n);
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	LNKFloat *vectorSquared = LNKMemoryBufferManagerAllocBlock(memoryManager, n);
 	LNK_vsq(vector, UNIT_STRIDE, vectorSquared, UNIT_STRIDE, n);
 	
 	LNK_vsub(vectorSquared, UNIT_STRIDE, vector, UNIT_STRIDE, outVector, UNIT_STRIDE, n);
-	free(vectorSquared);
+	LNKMemoryBufferManagerFreeBlock(memoryManager, vectorSquared, n);
+}
+
+void LNK_vpows(LNKFloat *z, LNKFloat exponent, const LNKFloat *x, LNKSize n) {
+	NSCAssert(z, @"The out vector must not be NULL");
+	NSCAssert(x, @"The vector must not be NULL");
+	NSCAssert(n, @"The length must be greater than 0");
+	
+#if USE_ACCELERATE
+	// vvpows takes the exponent by pointer and applies it to every element.
+	NSCAssert(n <= INT_MAX, @"The length must fit in an int");
+	const int np = (int)n;
+#if USE_DOUBLE_PRECISION
+	vvpows(z, &exponent, x, &np);
+#else
+	vvpowsf(z, &exponent, x, &np);
+#endif
+#else
+	LNKPortable_vpows(z, exponent, x, n);
+#endif
+}
+
+void LNK_mmultrans(const LNKFloat *a, const LNKFloat *b, LNKFloat *c, LNKSize m, LNKSize n, LNKSize p) {
+	NSCAssert(a && b && c, @"The matrices must not be NULL");
+	NSCAssert(m <= INT_MAX && n <= INT_MAX && p <= INT_MAX, @"The dimensions must fit in an int");
+	
+	// vDSP has no transposed product, but both backends ship CBLAS.
+#if USE_DOUBLE_PRECISION
+	cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans, (int)m, (int)n, (int)p, 1, a, (int)m, b, (int)n, 0, c, (int)n);
+#else
+	cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, (int)m, (int)n, (int)p, 1, a, (int)m, b, (int)n, 0, c, (int)n);
+#endif
 }
 
 LNKFloat LNK_vsd(LNKVector vector, LNKSize stride, LNKFloat *workgroup, LNKFloat mean, BOOL inSample) {
@@ -109,17 +144,10 @@ LNKFloat LNK_mdet(const LNKFloat *matrix, LNKSize n) {
 	NSCAssert(matrix, @"The matrix must not be NULL");
 	NSCAssert(n, @"The length must be greater than 0");
 	
-	__CLPK_integer np = (__CLPK_integer)n;
-	__CLPK_integer error = 0;
-	__CLPK_integer *pivot = malloc(n * sizeof(__CLPK_integer));
+	int *pivot = malloc(n * sizeof(int));
 	
 	LNKFloat *matrixCopy = LNKFloatAllocAndCopy(matrix, n * n);
-	
-#if USE_DOUBLE_PRECISION
-	dgetrf_(&np, &np, matrixCopy, &np, pivot, &error);
-#else
-	sgetrf_(&np, &np, matrixCopy, &np, pivot, &error);
-#endif
+	const int error = LNKPortable_getrf(matrixCopy, n, pivot);
 	
 	if (error > 0) {
 		fprintf(stderr, "LNK_mdet: we have a singular matrix\n");
@@ -131,7 +159,7 @@ LNKFloat LNK_mdet(const LNKFloat *matrix, LNKSize n) {
 	LNKFloat determinant = 1;
 	
 	// Multiply the diagonal elements.
-	for (__CLPK_integer index = 0; index < np; index++) {
+	for (int index = 0; index < (int)n; index++) {
 		determinant *= matrixCopy[index * n + index];
 		
 		if (pivot[index] != (index+1))
@@ -144,6 +172,18 @@ LNKFloat LNK_mdet(const LNKFloat *matrix, LNKSize n) {
 	return determinant;
 }
 
+BOOL LNK_msvd(const LNKFloat *matrix, LNKSize n, LNKFloat *outSingularValues, LNKFloat *outVT) {
+	NSCAssert(matrix, @"The matrix must not be NULL");
+	NSCAssert(n, @"The length must be greater than 0");
+	
+	// LAPACK destroys its input.
+	LNKFloat *matrixCopy = LNKFloatAllocAndCopy(matrix, n * n);
+	const int error = LNKPortable_gesvd(matrixCopy, n, outSingularValues, outVT);
+	free(matrixCopy);
+	
+	return error == 0;
+}
+
 LNKFloat LNK_vlogsumexp(const LNKFloat *vector, LNKSize n) {
 	if (vector == NULL || n == 0) {
 		return 0;
@@ -0,0 +1,82 @@
+//
+//  LNKAccelerateBLAS.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+// Portable implementations of the kernels LearnKit otherwise takes from Accelerate.
+// Matrix products and factorizations go through CBLAS/LAPACKE; vDSP-only element-wise
+// operations are hand-vectorized. Every function takes the same arguments, in the same
+// order, as the vDSP/vForce routine it replaces so `LNKAccelerate.h` can alias them.
+// These are always compiled so the two backends can be benchmarked against each other.
+
+/* vDSP equivalents */
+
+void LNKPortable_vfill(const LNKFloat *a, LNKFloat *c, long ic, LNKSize n);
+void LNKPortable_vclr(LNKFloat *c, long ic, LNKSize n);
+void LNKPortable_vmean(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n);
+void LNKPortable_vsadd(const LNKFloat *a, long ia, const LNKFloat *b, LNKFloat *c, long ic, LNKSize n);
+void LNKPortable_dotpr(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, LNKSize n);
+void LNKPortable_vadd(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize n);
+
+/// Computes `c = a / b`. As with vDSP, the divisor comes first.
+void LNKPortable_vdiv(const LNKFloat *b, long ib, const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n);
+
+/// Computes `c = a - b`. As with vDSP, the subtrahend comes first.
+void LNKPortable_vsub(const LNKFloat *b, long ib, const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n);
+
+void LNKPortable_vsdiv(const LNKFloat *a, long ia, const LNKFloat *b, LNKFloat *c, long ic, LNKSize n);
+
+/// Computes the m * n matrix `c = a * b` where `a` is m * p and `b` is p * n.
+void LNKPortable_mmul(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize m, LNKSize n, LNKSize p);
+
+/// Copies an n-row, m-column submatrix from `a` (row length `ta`) to `c` (row length `tc`).
+void LNKPortable_mmov(const LNKFloat *a, LNKFloat *c, LNKSize m, LNKSize n, LNKSize ta, LNKSize tc);
+
+void LNKPortable_vmul(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize n);
+void LNKPortable_vsmul(const LNKFloat *a, long ia, const LNKFloat *b, LNKFloat *c, long ic, LNKSize n);
+
+/// Computes `d = a * b + c` for scalars `b` and `c`.
+void LNKPortable_vsmsa(const LNKFloat *a, long ia, const LNKFloat *b, const LNKFloat *c, LNKFloat *d, long iD, LNKSize n);
+
+void LNKPortable_vneg(const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n);
+
+/// Computes `d = a * b + c` for a scalar `b`.
+void LNKPortable_vsma(const LNKFloat *a, long ia, const LNKFloat *b, const LNKFloat *c, long ic, LNKFloat *d, long iD, LNKSize n);
+
+/// Computes `c = a / b` for a scalar `a`.
+void LNKPortable_svdiv(const LNKFloat *a, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize n);
+
+void LNKPortable_vsum(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n);
+void LNKPortable_vsq(const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n);
+void LNKPortable_minv(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n);
+void LNKPortable_maxv(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n);
+
+/// Computes the squared euclidean distance between the two vectors.
+void LNKPortable_distancesq(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, LNKSize n);
+
+/// Transposes the n * m matrix `a` into the m * n matrix `c`, which may alias `a`.
+void LNKPortable_mtrans(const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize m, LNKSize n);
+
+/* vForce equivalents */
+
+void LNKPortable_vlog(LNKFloat *y, const LNKFloat *x, const int *n);
+void LNKPortable_vexp(LNKFloat *y, const LNKFloat *x, const int *n);
+void LNKPortable_vtanh(LNKFloat *y, const LNKFloat *x, const int *n);
+
+/// Raises every element of `x` to the same `exponent`. Unlike vForce's `vvpows`, which reads one exponent per element,
+/// the exponent is passed by value.
+void LNKPortable_vpows(LNKFloat *z, LNKFloat exponent, const LNKFloat *x, LNKSize n);
+
+/* LAPACK equivalents */
+
+/// Computes the LU factorization of the n * n matrix in place. Returns the LAPACK status code.
+int LNKPortable_getrf(LNKFloat *matrix, LNKSize n, int *pivot);
+
+/// Inverts the n * n matrix previously factorized by `LNKPortable_getrf`. Returns the LAPACK status code.
+int LNKPortable_getri(LNKFloat *matrix, LNKSize n, const int *pivot);
+
+/// Computes the singular values and right singular vectors of the n * n matrix, which is overwritten.
+/// Returns the LAPACK status code.
+int LNKPortable_gesvd(LNKFloat *matrix, LNKSize n, LNKFloat *outSingularValues, LNKFloat *outVT);
@@ -0,0 +1,460 @@
+//
+//  LNKAccelerateBLAS.m
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKAccelerateBLAS.h"
+
+#if USE_ACCELERATE
+#import <Accelerate/Accelerate.h>
+#else
+#include <cblas.h>
+#include <lapacke.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#if USE_DOUBLE_PRECISION
+#define LNK_cblas_dot	cblas_ddot
+#define LNK_cblas_gemm	cblas_dgemm
+#define LNK_cblas_axpy	cblas_daxpy
+#define LNK_cblas_scal	cblas_dscal
+#define LNK_scalar_log	log
+#define LNK_scalar_exp	exp
+#define LNK_scalar_tanh	tanh
+#define LNK_scalar_pow	pow
+#else
+#define LNK_cblas_dot	cblas_sdot
+#define LNK_cblas_gemm	cblas_sgemm
+#define LNK_cblas_axpy	cblas_saxpy
+#define LNK_cblas_scal	cblas_sscal
+#define LNK_scalar_log	logf
+#define LNK_scalar_exp	expf
+#define LNK_scalar_tanh	tanhf
+#define LNK_scalar_pow	powf
+#endif
+
+// Element-wise kernels are written against 256-bit packs. Scalars are splatted
+// implicitly, so the same expression can be used for the pack and tail loops.
+#define PACK_BYTES 32
+typedef LNKFloat LNKFloatPack __attribute__((vector_size(PACK_BYTES), aligned(sizeof(LNKFloat))));
+#define PACK_WIDTH (PACK_BYTES / sizeof(LNKFloat))
+#define PACK_LOAD(pointer) (*(const LNKFloatPack *)(pointer))
+#define PACK_STORE(pointer, value) (*(LNKFloatPack *)(pointer) = (value))
+
+#define STRIDED(pointer, index, stride) (pointer)[(long)(index) * (stride)]
+
+// c[i] = EXPR(x = a[i])
+#define MAP1(a, ia, c, ic, n, EXPR) do { \
+	LNKSize i = 0; \
+	if ((ia) == 1 && (ic) == 1) { \
+		for (; i + PACK_WIDTH <= (n); i += PACK_WIDTH) { \
+			const LNKFloatPack x = PACK_LOAD((a) + i); \
+			PACK_STORE((c) + i, (EXPR)); \
+		} \
+	} \
+	for (; i < (n); i++) { \
+		const LNKFloat x = STRIDED(a, i, ia); \
+		STRIDED(c, i, ic) = (EXPR); \
+	} \
+} while (0)
+
+// c[i] = EXPR(x = a[i], y = b[i])
+#define MAP2(a, ia, b, ib, c, ic, n, EXPR) do { \
+	LNKSize i = 0; \
+	if ((ia) == 1 && (ib) == 1 && (ic) == 1) { \
+		for (; i + PACK_WIDTH <= (n); i += PACK_WIDTH) { \
+			const LNKFloatPack x = PACK_LOAD((a) + i); \
+			const LNKFloatPack y = PACK_LOAD((b) + i); \
+			PACK_STORE((c) + i, (EXPR)); \
+		} \
+	} \
+	for (; i < (n); i++) { \
+		const LNKFloat x = STRIDED(a, i, ia); \
+		const LNKFloat y = STRIDED(b, i, ib); \
+		STRIDED(c, i, ic) = (EXPR); \
+	} \
+} while (0)
+
+// Returns the sum of EXPR(x = a[i]).
+#define REDUCE1(a, ia, n, EXPR) ({ \
+	LNKSize i = 0; \
+	LNKFloat sum = 0; \
+	if ((ia) == 1) { \
+		LNKFloatPack sum0 = { 0 }, sum1 = { 0 }; \
+		for (; i + 2 * PACK_WIDTH <= (n); i += 2 * PACK_WIDTH) { \
+			{ const LNKFloatPack x = PACK_LOAD((a) + i); sum0 += (EXPR); } \
+			{ const LNKFloatPack x = PACK_LOAD((a) + i + PACK_WIDTH); sum1 += (EXPR); } \
+		} \
+		sum0 += sum1; \
+		for (LNKSize lane = 0; lane < PACK_WIDTH; lane++) \
+			sum += sum0[lane]; \
+	} \
+	for (; i < (n); i++) { \
+		const LNKFloat x = STRIDED(a, i, ia); \
+		sum += (EXPR); \
+	} \
+	sum; \
+})
+
+// Returns the sum of EXPR(x = a[i], y = b[i]).
+#define REDUCE2(a, ia, b, ib, n, EXPR) ({ \
+	LNKSize i = 0; \
+	LNKFloat sum = 0; \
+	if ((ia) == 1 && (ib) == 1) { \
+		LNKFloatPack sum0 = { 0 }, sum1 = { 0 }; \
+		for (; i + 2 * PACK_WIDTH <= (n); i += 2 * PACK_WIDTH) { \
+			{ const LNKFloatPack x = PACK_LOAD((a) + i), y = PACK_LOAD((b) + i); sum0 += (EXPR); } \
+			{ const LNKFloatPack x = PACK_LOAD((a) + i + PACK_WIDTH), y = PACK_LOAD((b) + i + PACK_WIDTH); sum1 += (EXPR); } \
+		} \
+		sum0 += sum1; \
+		for (LNKSize lane = 0; lane < PACK_WIDTH; lane++) \
+			sum += sum0[lane]; \
+	} \
+	for (; i < (n); i++) { \
+		const LNKFloat x = STRIDED(a, i, ia); \
+		const LNKFloat y = STRIDED(b, i, ib); \
+		sum += (EXPR); \
+	} \
+	sum; \
+})
+
+void LNKPortable_vfill(const LNKFloat *a, LNKFloat *c, long ic, LNKSize n) {
+	const LNKFloat value = *a;
+	LNKSize i = 0;
+
+	if (ic == 1) {
+		LNKFloatPack pack;
+		for (LNKSize lane = 0; lane < PACK_WIDTH; lane++)
+			pack[lane] = value;
+
+		for (; i + PACK_WIDTH <= n; i += PACK_WIDTH)
+			PACK_STORE(c + i, pack);
+	}
+
+	for (; i < n; i++)
+		STRIDED(c, i, ic) = value;
+}
+
+void LNKPortable_vclr(LNKFloat *c, long ic, LNKSize n) {
+	if (ic == 1) {
+		memset(c, 0, n * sizeof(LNKFloat));
+		return;
+	}
+
+	for (LNKSize i = 0; i < n; i++)
+		STRIDED(c, i, ic) = 0;
+}
+
+void LNKPortable_vmean(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n) {
+	LNKFloat sum = 0;
+	LNKPortable_vsum(a, ia, &sum, n);
+	*c = n ? sum / n : 0;
+}
+
+void LNKPortable_vsadd(const LNKFloat *a, long ia, const LNKFloat *b, LNKFloat *c, long ic, LNKSize n) {
+	const LNKFloat scalar = *b;
+	MAP1(a, ia, c, ic, n, x + scalar);
+}
+
+void LNKPortable_dotpr(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, LNKSize n) {
+	if (ia > 0 && ib > 0 && n <= INT_MAX && ia <= INT_MAX && ib <= INT_MAX) {
+		*c = LNK_cblas_dot((int)n, a, (int)ia, b, (int)ib);
+		return;
+	}
+
+	*c = REDUCE2(a, ia, b, ib, n, x * y);
+}
+
+void LNKPortable_vadd(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize n) {
+	MAP2(a, ia, b, ib, c, ic, n, x + y);
+}
+
+void LNKPortable_vdiv(const LNKFloat *b, long ib, const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n) {
+	MAP2(a, ia, b, ib, c, ic, n, x / y);
+}
+
+void LNKPortable_vsub(const LNKFloat *b, long ib, const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n) {
+	MAP2(a, ia, b, ib, c, ic, n, x - y);
+}
+
+void LNKPortable_vsdiv(const LNKFloat *a, long ia, const LNKFloat *b, LNKFloat *c, long ic, LNKSize n) {
+	const LNKFloat scalar = *b;
+	MAP1(a, ia, c, ic, n, x / scalar);
+}
+
+void LNKPortable_mmul(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize m, LNKSize n, LNKSize p) {
+	if (ia == 1 && ib == 1 && ic == 1 && m <= INT_MAX && n <= INT_MAX && p <= INT_MAX) {
+		LNK_cblas_gemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, (int)m, (int)n, (int)p,
+					   1, a, (int)p, b, (int)n, 0, c, (int)n);
+		return;
+	}
+
+	for (LNKSize row = 0; row < m; row++) {
+		for (LNKSize column = 0; column < n; column++) {
+			LNKFloat sum = 0;
+
+			for (LNKSize k = 0; k < p; k++)
+				sum += STRIDED(a, row * p + k, ia) * STRIDED(b, k * n + column, ib);
+
+			STRIDED(c, row * n + column, ic) = sum;
+		}
+	}
+}
+
+void LNKPortable_mmov(const LNKFloat *a, LNKFloat *c, LNKSize m, LNKSize n, LNKSize ta, LNKSize tc) {
+	for (LNKSize row = 0; row < n; row++)
+		memmove(c + row * tc, a + row * ta, m * sizeof(LNKFloat));
+}
+
+void LNKPortable_vmul(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize n) {
+	MAP2(a, ia, b, ib, c, ic, n, x * y);
+}
+
+void LNKPortable_vsmul(const LNKFloat *a, long ia, const LNKFloat *b, LNKFloat *c, long ic, LNKSize n) {
+	const LNKFloat scalar = *b;
+
+	if (a == c && ia == ic && ia > 0 && n <= INT_MAX && ia <= INT_MAX) {
+		LNK_cblas_scal((int)n, scalar, c, (int)ic);
+		return;
+	}
+
+	MAP1(a, ia, c, ic, n, x * scalar);
+}
+
+void LNKPortable_vsmsa(const LNKFloat *a, long ia, const LNKFloat *b, const LNKFloat *c, LNKFloat *d, long iD, LNKSize n) {
+	const LNKFloat scale = *b;
+	const LNKFloat offset = *c;
+	MAP1(a, ia, d, iD, n, x * scale + offset);
+}
+
+void LNKPortable_vneg(const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n) {
+	MAP1(a, ia, c, ic, n, -x);
+}
+
+void LNKPortable_vsma(const LNKFloat *a, long ia, const LNKFloat *b, const LNKFloat *c, long ic, LNKFloat *d, long iD, LNKSize n) {
+	const LNKFloat scalar = *b;
+
+	if (c == d && ic == iD && ia > 0 && ic > 0 && n <= INT_MAX && ia <= INT_MAX && ic <= INT_MAX) {
+		LNK_cblas_axpy((int)n, scalar, a, (int)ia, d, (int)iD);
+		return;
+	}
+
+	MAP2(a, ia, c, ic, d, iD, n, x * scalar + y);
+}
+
+void LNKPortable_svdiv(const LNKFloat *a, const LNKFloat *b, long ib, LNKFloat *c, long ic, LNKSize n) {
+	const LNKFloat scalar = *a;
+	MAP1(b, ib, c, ic, n, scalar / x);
+}
+
+void LNKPortable_vsum(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n) {
+	*c = REDUCE1(a, ia, n, x);
+}
+
+void LNKPortable_vsq(const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize n) {
+	MAP1(a, ia, c, ic, n, x * x);
+}
+
+void LNKPortable_minv(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n) {
+	LNKFloat minimum = LNKFloatMax;
+
+	for (LNKSize i = 0; i < n; i++) {
+		const LNKFloat value = STRIDED(a, i, ia);
+
+		if (value < minimum)
+			minimum = value;
+	}
+
+	*c = minimum;
+}
+
+void LNKPortable_maxv(const LNKFloat *a, long ia, LNKFloat *c, LNKSize n) {
+	LNKFloat maximum = LNKFloatMin;
+
+	for (LNKSize i = 0; i < n; i++) {
+		const LNKFloat value = STRIDED(a, i, ia);
+
+		if (value > maximum)
+			maximum = value;
+	}
+
+	*c = maximum;
+}
+
+void LNKPortable_distancesq(const LNKFloat *a, long ia, const LNKFloat *b, long ib, LNKFloat *c, LNKSize n) {
+	*c = REDUCE2(a, ia, b, ib, n, (x - y) * (x - y));
+}
+
+void LNKPortable_mtrans(const LNKFloat *a, long ia, LNKFloat *c, long ic, LNKSize m, LNKSize n) {
+	const LNKFloat *source = a;
+	LNKFloat *copy = NULL;
+
+	if (a == c) {
+		copy = LNKFloatAlloc(m * n);
+
+		for (LNKSize i = 0; i < m * n; i++)
+			copy[i] = STRIDED(a, i, ia);
+
+		source = copy;
+		ia = 1;
+	}
+
+#define BLOCK_SIZE 16
+
+	for (LNKSize i = 0; i < m; i += BLOCK_SIZE) {
+		for (LNKSize j = 0; j < n; j += BLOCK_SIZE) {
+			const LNKSize imax = MIN(i + BLOCK_SIZE, m);
+			const LNKSize jmax = MIN(j + BLOCK_SIZE, n);
+
+			for (LNKSize k = i; k < imax; k++) {
+				for (LNKSize l = j; l < jmax; l++) {
+					STRIDED(c, k * n + l, ic) = STRIDED(source, l * m + k, ia);
+				}
+			}
+		}
+	}
+
+#undef BLOCK_SIZE
+
+	free(copy);
+}
+
+void LNKPortable_vlog(LNKFloat *y, const LNKFloat *x, const int *n) {
+	for (int i = 0; i < *n; i++)
+		y[i] = LNK_scalar_log(x[i]);
+}
+
+void LNKPortable_vexp(LNKFloat *y, const LNKFloat *x, const int *n) {
+	for (int i = 0; i < *n; i++)
+		y[i] = LNK_scalar_exp(x[i]);
+}
+
+void LNKPortable_vtanh(LNKFloat *y, const LNKFloat *x, const int *n) {
+	for (int i = 0; i < *n; i++)
+		y[i] = LNK_scalar_tanh(x[i]);
+}
+
+void LNKPortable_vpows(LNKFloat *z, LNKFloat exponent, const LNKFloat *x, LNKSize n) {
+	for (LNKSize i = 0; i < n; i++)
+		z[i] = LNK_scalar_pow(x[i], exponent);
+}
+
+#if USE_ACCELERATE
+
+// Accelerate only ships the Fortran-style CLAPACK interface. The matrices are
+// row-major, so LAPACK sees their transposes; this is harmless for inversion.
+
+// Pivots are kept in LAPACK's own integer type and only converted at the boundary, since it need not be as wide as `int`.
+
+int LNKPortable_getrf(LNKFloat *matrix, LNKSize n, int *pivot) {
+	__CLPK_integer np = (__CLPK_integer)n;
+	__CLPK_integer error = 0;
+	__CLPK_integer *const lapackPivot = malloc(n * sizeof(__CLPK_integer));
+#if USE_DOUBLE_PRECISION
+	dgetrf_(&np, &np, matrix, &np, lapackPivot, &error);
+#else
+	sgetrf_(&np, &np, matrix, &np, lapackPivot, &error);
+#endif
+	for (LNKSize i = 0; i < n; i++)
+		pivot[i] = (int)lapackPivot[i];
+
+	free(lapackPivot);
+	return (int)error;
+}
+
+int LNKPortable_getri(LNKFloat *matrix, LNKSize n, const int *pivot) {
+	__CLPK_integer np = (__CLPK_integer)n;
+	__CLPK_integer error = 0;
+	__CLPK_integer *const lapackPivot = malloc(n * sizeof(__CLPK_integer));
+	LNKFloat *workspace = LNKFloatAlloc(n);
+
+	for (LNKSize i = 0; i < n; i++)
+		lapackPivot[i] = pivot[i];
+#if USE_DOUBLE_PRECISION
+	dgetri_(&np, matrix, &np, lapackPivot, workspace, &np, &error);
+#else
+	sgetri_(&np, matrix, &np, lapackPivot, workspace, &np, &error);
+#endif
+	free(workspace);
+	free(lapackPivot);
+	return (int)error;
+}
+
+int LNKPortable_gesvd(LNKFloat *matrix, LNKSize n, LNKFloat *outSingularValues, LNKFloat *outVT) {
+	__CLPK_integer np = (__CLPK_integer)n;
+	__CLPK_integer error = 0;
+
+	// The first pass computes work sizes.
+	__CLPK_integer workSize = -1;
+	LNKFloat workOptimal = 0;
+#if USE_DOUBLE_PRECISION
+	dgesvd_("N", "A", &np, &np, matrix, &np, outSingularValues, NULL, &np, outVT, &np, &workOptimal, &workSize, &error);
+#else
+	sgesvd_("N", "A", &np, &np, matrix, &np, outSingularValues, NULL, &np, outVT, &np, &workOptimal, &workSize, &error);
+#endif
+
+	workSize = (__CLPK_integer)workOptimal;
+	LNKFloat *const work = LNKFloatAlloc(workSize);
+#if USE_DOUBLE_PRECISION
+	dgesvd_("N", "A", &np, &np, matrix, &np, outSingularValues, NULL, &np, outVT, &np, work, &workSize, &error);
+#else
+	sgesvd_("N", "A", &np, &np, matrix, &np, outSingularValues, NULL, &np, outVT, &np, work, &workSize, &error);
+#endif
+	free(work);
+
+	return (int)error;
+}
+
+#else
+
+// LAPACKE is told the matrices are row-major so pivots and factors match the
+// layout callers see. The SVD keeps the column-major convention used with Accelerate.
+// Pivots are kept in `lapack_int`, which is 64 bits wide with ILP64 builds, and only converted at the boundary.
+
+int LNKPortable_getrf(LNKFloat *matrix, LNKSize n, int *pivot) {
+	const lapack_int np = (lapack_int)n;
+	lapack_int *const lapackPivot = malloc(n * sizeof(lapack_int));
+#if USE_DOUBLE_PRECISION
+	const lapack_int error = LAPACKE_dgetrf(LAPACK_ROW_MAJOR, np, np, matrix, np, lapackPivot);
+#else
+	const lapack_int error = LAPACKE_sgetrf(LAPACK_ROW_MAJOR, np, np, matrix, np, lapackPivot);
+#endif
+	for (LNKSize i = 0; i < n; i++)
+		pivot[i] = (int)lapackPivot[i];
+
+	free(lapackPivot);
+	return (int)error;
+}
+
+int LNKPortable_getri(LNKFloat *matrix, LNKSize n, const int *pivot) {
+	const lapack_int np = (lapack_int)n;
+	lapack_int *const lapackPivot = malloc(n * sizeof(lapack_int));
+
+	for (LNKSize i = 0; i < n; i++)
+		lapackPivot[i] = pivot[i];
+#if USE_DOUBLE_PRECISION
+	const lapack_int error = LAPACKE_dgetri(LAPACK_ROW_MAJOR, np, matrix, np, lapackPivot);
+#else
+	const lapack_int error = LAPACKE_sgetri(LAPACK_ROW_MAJOR, np, matrix, np, lapackPivot);
+#endif
+	free(lapackPivot);
+	return (int)error;
+}
+
+int LNKPortable_gesvd(LNKFloat *matrix, LNKSize n, LNKFloat *outSingularValues, LNKFloat *outVT) {
+	const lapack_int np = (lapack_int)n;
+	LNKFloat *const superb = LNKFloatAlloc(n > 1 ? n - 1 : 1);
+#if USE_DOUBLE_PRECISION
+	const lapack_int error = LAPACKE_dgesvd(LAPACK_COL_MAJOR, 'N', 'A', np, np, matrix, np, outSingularValues, NULL, np, outVT, np, superb);
+#else
+	const lapack_int error = LAPACKE_sgesvd(LAPACK_COL_MAJOR, 'N', 'A', np, np, matrix, np, outSingularValues, NULL, np, outVT, np, superb);
+#endif
+	free(superb);
+	return (int)error;
+}
+
+#endif
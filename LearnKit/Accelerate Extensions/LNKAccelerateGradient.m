@@ -11,6 +11,7 @@
 #import "LNKAccelerate.h"
 #import "LNKFastFloatQueue.h"
 #import "LNKMatrixPrivate.h"
+#import "LNKSparseMatrix.h"
 
 @interface LBFGSContext : NSObject
 
@@ -21,7 +22,6 @@
 @property (nonatomic) LNKFloat *workgroupCC;
 @property (nonatomic) LNKFloat *workgroupCC2;
 @property (nonatomic) LNKFloat *workgroupEC;
-@property (nonatomic) const LNKFloat *transposeMatrix;
 @property (nonatomic) BOOL regularizationEnabled;
 @property (nonatomic) LNKFloat lambda;
 
@@ -40,16 +40,19 @@
 
 
 // The final result is in workgroupCC.
-void _LNKComputeBatchGradient(const LNKFloat *matrixBuffer, const LNKFloat *transposeMatrix, const LNKFloat *thetaVector, const LNKFloat *outputVector, LNKFloat *workgroupEC, LNKFloat *workgroupCC, LNKFloat *workgroupCC2, LNKSize rowCount, LNKSize columnCount, BOOL enableRegularization, LNKFloat lambda, LNKHFunction hFunction) {
+void _LNKComputeBatchGradient(LNKMatrix *matrix, const LNKFloat *thetaVector, LNKFloat *workgroupEC, LNKFloat *workgroupCC, LNKFloat *workgroupCC2, BOOL enableRegularization, LNKFloat lambda, LNKHFunction hFunction) {
+	const LNKSize rowCount = matrix.rowCount;
+	const LNKSize columnCount = matrix.columnCount;
+	
 	// h = x . thetaVector
 	// 1 / m * sum((h - y) * x)
-	LNK_mmul(matrixBuffer, UNIT_STRIDE, thetaVector, UNIT_STRIDE, workgroupEC, UNIT_STRIDE, rowCount, 1, columnCount);
+	[matrix multiplyByBuffer:thetaVector columnCount:1 outputBuffer:workgroupEC];
 	
 	if (hFunction)
 		hFunction(workgroupEC, rowCount);
 	
-	LNK_vsub(outputVector, UNIT_STRIDE, workgroupEC, UNIT_STRIDE, workgroupEC, UNIT_STRIDE, rowCount);
-	LNK_mmul(transposeMatrix, UNIT_STRIDE, workgroupEC, UNIT_STRIDE, workgroupCC, UNIT_STRIDE, columnCount, 1, rowCount);
+	LNK_vsub(matrix.outputVector, UNIT_STRIDE, workgroupEC, UNIT_STRIDE, workgroupEC, UNIT_STRIDE, rowCount);
+	[matrix multiplyTransposeByBuffer:workgroupEC columnCount:1 outputBuffer:workgroupCC];
 	
 	if (enableRegularization) {
 		// cost += lambda * theta
@@ -75,39 +78,55 @@ void LNK_learntheta_gd(LNKMatrix *matrix, LNKFloat *thetaVector, LNKOptimization
 	const LNKSize rowCount = matrix.rowCount;
 	const LNKSize columnCount = matrix.columnCount;
 	
-	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
-	const LNKFloat *outputVector = matrix.outputVector;
-	
 	LNKFloat *workgroupEC = LNKFloatAlloc(rowCount);
 	LNKFloat *workgroupCC = LNKFloatAlloc(columnCount);
 	LNKFloat *workgroupCC2 = LNKFloatAlloc(columnCount);
 	
-	LNKFloat *transposeMatrix = LNKFloatAlloc(rowCount * columnCount);
-	LNK_mtrans(matrixBuffer, transposeMatrix, columnCount, rowCount);
-	
 	const BOOL stochastic = [algorithm isKindOfClass:[LNKOptimizationAlgorithmStochasticGradientDescent class]];
 	
 	void (^gradientIteration)(LNKFloat alpha) = ^(LNKFloat alpha) {
 		if (stochastic) {
+			// Dense rows are read through the shuffled view, so they are never gathered into a buffer of their own.
 			LNKMatrix *randomMatrix = [matrix copyShuffledMatrix];
-			const LNKFloat *randomMatrixBuffer = randomMatrix.matrixBuffer;
 			const LNKSize stepCount = ((LNKOptimizationAlgorithmStochasticGradientDescent *)algorithm).stepCount;
+			const LNKFloat *outputVector = randomMatrix.outputVector;
 			
-			// Stochastic gradient descent:
-			for (LNKSize step = 0; step < stepCount; step++) {
-				const LNKFloat *row = randomMatrixBuffer + step * columnCount;
+			if (randomMatrix.sparse) {
+				// Only the parameters of the row's non-zero values have a non-zero gradient.
+				LNKSparseMatrix *sparseMatrix = (LNKSparseMatrix *)randomMatrix;
+				const LNKSize *rowPointers = sparseMatrix.rowPointers;
+				const LNKSize *columnIndices = sparseMatrix.columnIndices;
+				const LNKFloat *values = sparseMatrix.values;
 				
-				// singleGradient = (h - y) * x
-				LNKFloat h;
-				LNK_dotpr(row, UNIT_STRIDE, thetaVector, UNIT_STRIDE, &h, columnCount);
-				
-				// workgroupCC holds the gradient.
-				const LNKFloat delta = h - outputVector[step];
-				LNK_vsmul(row, UNIT_STRIDE, &delta, workgroupCC, UNIT_STRIDE, columnCount);
-				
-				// thetaVector = thetaVector - alpha * gradient
-				const LNKFloat negAlpha = -alpha;
-				LNK_vsma(workgroupCC, UNIT_STRIDE, &negAlpha, thetaVector, UNIT_STRIDE, thetaVector, UNIT_STRIDE, columnCount);
+				for (LNKSize step = 0; step < stepCount; step++) {
+					LNKFloat h = 0;
+					
+					for (LNKSize index = rowPointers[step]; index < rowPointers[step + 1]; index++)
+						h += values[index] * thetaVector[columnIndices[index]];
+					
+					const LNKFloat negAlphaDelta = -alpha * (h - outputVector[step]);
+					
+					for (LNKSize index = rowPointers[step]; index < rowPointers[step + 1]; index++)
+						thetaVector[columnIndices[index]] += negAlphaDelta * values[index];
+				}
+			}
+			else {
+				// Stochastic gradient descent:
+				for (LNKSize step = 0; step < stepCount; step++) {
+					const LNKFloat *row = [randomMatrix rowAtIndex:step];
+					
+					// singleGradient = (h - y) * x
+					LNKFloat h;
+					LNK_dotpr(row, UNIT_STRIDE, thetaVector, UNIT_STRIDE, &h, columnCount);
+					
+					// workgroupCC holds the gradient.
+					const LNKFloat delta = h - outputVector[step];
+					LNK_vsmul(row, UNIT_STRIDE, &delta, workgroupCC, UNIT_STRIDE, columnCount);
+					
+					// thetaVector = thetaVector - alpha * gradient
+					const LNKFloat negAlpha = -alpha;
+					LNK_vsma(workgroupCC, UNIT_STRIDE, &negAlpha, thetaVector, UNIT_STRIDE, thetaVector, UNIT_STRIDE, columnCount);
+				}
 			}
 
 			[randomMatrix release];
@@ -115,7 +134,7 @@ void LNK_learntheta_gd(LNKMatrix *matrix, LNKFloat *thetaVector, LNKOptimization
 		else {
 			// Batch gradient descent:
 			// workgroupCC holds the gradient.
-			_LNKComputeBatchGradient(matrixBuffer, transposeMatrix, thetaVector, outputVector, workgroupEC, workgroupCC, workgroupCC2, rowCount, columnCount, regularizationEnabled, lambda, NULL);
+			_LNKComputeBatchGradient(matrix, thetaVector, workgroupEC, workgroupCC, workgroupCC2, regularizationEnabled, lambda, NULL);
 			
 			// thetaVector = thetaVector - alpha * gradient
 			const LNKFloat negAlpha = -alpha;
@@ -163,7 +182,6 @@ void LNK_learntheta_gd(LNKMatrix *matrix, LNKFloat *thetaVector, LNKOptimization
 	free(workgroupEC);
 	free(workgroupCC);
 	free(workgroupCC2);
-	free(transposeMatrix);
 }
 
 static lbfgsfloatval_t _LNK_lbfgs_evaluate(void *instance, const lbfgsfloatval_t *x, lbfgsfloatval_t *g, const int n, const lbfgsfloatval_t step) {
@@ -179,7 +197,7 @@ static lbfgsfloatval_t _LNK_lbfgs_evaluate(void *instance, const lbfgsfloatval_t
 	const LNKSize columnCount = matrix.columnCount;
 	NSCAssert(columnCount == (LNKSize)n, @"Size mismatch");
 	
-	_LNKComputeBatchGradient(matrix.matrixBuffer, context.transposeMatrix, x, matrix.outputVector, context.workgroupEC, workgroupCC, workgroupCC2, matrix.rowCount, columnCount, context.regularizationEnabled, context.lambda, context.hFunction);
+	_LNKComputeBatchGradient(matrix, x, context.workgroupEC, workgroupCC, workgroupCC2, context.regularizationEnabled, context.lambda, context.hFunction);
 	
 	// Give liblbfgs our gradient and return the cost.
 	LNKFloatCopy(g, workgroupCC, columnCount);
@@ -210,9 +228,6 @@ void LNK_learntheta_lbfgs(LNKMatrix *matrix, LNKFloat *thetaVector, BOOL regular
 	LNKFloat *workgroupCC = LNKFloatAlloc(columnCount);
 	LNKFloat *workgroupCC2 = LNKFloatAlloc(columnCount);
 	
-	LNKFloat *transposeMatrix = LNKFloatAlloc(rowCount * columnCount);
-	LNK_mtrans(matrix.matrixBuffer, transposeMatrix, columnCount, rowCount);
-	
 	LBFGSContext *context = [[LBFGSContext alloc] init];
 	context.matrix = matrix;
 	context.thetaVector = thetaVector;
@@ -221,7 +236,6 @@ void LNK_learntheta_lbfgs(LNKMatrix *matrix, LNKFloat *thetaVector, BOOL regular
 	context.workgroupEC = workgroupEC;
 	context.workgroupCC = workgroupCC;
 	context.workgroupCC2 = workgroupCC2;
-	context.transposeMatrix = transposeMatrix;
 	context.regularizationEnabled = regularizationEnabled;
 	context.lambda = lambda;
 
@@ -237,7 +251,6 @@ void LNK_learntheta_lbfgs(LNKMatrix *matrix, LNKFloat *thetaVector, BOOL regular
 	free(workgroupEC);
 	free(workgroupCC);
 	free(workgroupCC2);
-	free(transposeMatrix);
 	
 	free(theta);
 }
@@ -8,6 +8,7 @@
 #import "_LNKAnomalyDetectorAC.h"
 
 #import "LNKAccelerate.h"
+#import "LNKClassifierPrivate.h"
 #import "LNKMatrix.h"
 
 @implementation _LNKAnomalyDetectorAC {
@@ -104,15 +105,15 @@
 	return c * LNK_exp(-0.5 * sum);
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
 	const LNKFloat p = [self _probabilityWithFeatureVector:featureVector.data length:featureVector.length];
 	
-	if (p < self.threshold) {
-		// It's an anomaly.
-		return [LNKClass classWithUnsignedInteger:1];
-	}
+	// Class 1 stands for anomalies.
+	const BOOL isAnomaly = p < self.threshold;
+	outProbabilities[0] = isAnomaly ? 0 : 1;
+	outProbabilities[1] = isAnomaly ? 1 : 0;
 	
-	return [LNKClass classWithUnsignedInteger:0];
+	return YES;
 }
 
 - (void)dealloc {
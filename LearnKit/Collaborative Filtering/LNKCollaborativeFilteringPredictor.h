@@ -20,6 +20,8 @@ NS_ASSUME_NONNULL_BEGIN
 /// The `featureCount` must be greater than 0.
 /// The matrix passed in must be the output matrix, with dimensions `rowCount` * `userCount`.
 /// The indicator matrix must also be provided, with dimensions `rowCount` * `userCount`.
+/// Its non-zero entries mark the ratings that were made. Training takes time proportional to the number of ratings,
+/// and sparse output and indicator matrices (see `LNKSparseMatrix`) are never stored densely.
 - (instancetype)initWithMatrix:(LNKMatrix *)outputMatrix indicatorMatrix:(LNKMatrix *)indicatorMatrix implementationType:(LNKImplementationType)implementationType optimizationAlgorithm:(id<LNKOptimizationAlgorithm>)algorithm featureCount:(NSUInteger)featureCount;
 
 @property (nonatomic, retain, nullable) LNKRegularizationConfiguration *regularizationConfiguration;
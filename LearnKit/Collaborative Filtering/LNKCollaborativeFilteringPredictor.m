@@ -13,6 +13,7 @@
 #import "LNKOptimizationAlgorithm.h"
 #import "LNKPredictorPrivate.h"
 #import "LNKRegularizationConfiguration.h"
+#import "LNKSparseMatrix.h"
 
 @interface LNKCollaborativeFilteringPredictor () < LNKOptimizationAlgorithmDelegate >
 
@@ -22,6 +23,12 @@
 	LNKMatrix *_indicatorMatrix;
 	LNKSize _featureCount;
 	LNKFloat *_unrolledGradient;
+	
+	// The users who rated every row and their ratings, in compressed sparse row form, so the cost and gradient take
+	// time proportional to the number of ratings rather than to rows times users.
+	LNKSize *_ratingRowPointers;
+	LNKSize *_ratingUsers;
+	LNKFloat *_ratings;
 }
 
 + (NSArray<Class> *)supportedAlgorithms {
@@ -51,10 +58,64 @@
 		const LNKSize unrolledRowCount = rowCount + userCount;
 		
 		_unrolledGradient = LNKFloatAlloc(unrolledRowCount * _featureCount);
+		
+		[self _gatherRatingsFromOutputMatrix:outputMatrix];
 	}
 	return self;
 }
 
+- (void)_gatherRatingsFromOutputMatrix:(LNKMatrix *)outputMatrix {
+	const LNKSize userCount = outputMatrix.columnCount;
+	const LNKSize rowCount = outputMatrix.rowCount;
+	LNKMatrix *const indicatorMatrix = _indicatorMatrix;
+	
+	_ratingRowPointers = malloc((rowCount + 1) * sizeof(LNKSize));
+	_ratingRowPointers[0] = 0;
+	
+	if (indicatorMatrix.sparse) {
+		// Sparse indicator matrices already hold the rated entries and nothing else.
+		LNKSparseMatrix *const sparseIndicatorMatrix = (LNKSparseMatrix *)indicatorMatrix;
+		const LNKSize ratingCount = sparseIndicatorMatrix.rowPointers[rowCount];
+		
+		memcpy(_ratingRowPointers, sparseIndicatorMatrix.rowPointers, (rowCount + 1) * sizeof(LNKSize));
+		_ratingUsers = malloc(MAX(ratingCount, 1) * sizeof(LNKSize));
+		memcpy(_ratingUsers, sparseIndicatorMatrix.columnIndices, ratingCount * sizeof(LNKSize));
+	}
+	else {
+		LNKSize ratingCount = 0;
+		
+		for (LNKSize row = 0; row < rowCount; row++) {
+			const LNKFloat *const indicator = [indicatorMatrix rowAtIndex:row];
+			
+			for (LNKSize userIndex = 0; userIndex < userCount; userIndex++)
+				ratingCount += indicator[userIndex] != 0;
+			
+			_ratingRowPointers[row + 1] = ratingCount;
+		}
+		
+		_ratingUsers = malloc(MAX(ratingCount, 1) * sizeof(LNKSize));
+		
+		for (LNKSize row = 0; row < rowCount; row++) {
+			const LNKFloat *const indicator = [indicatorMatrix rowAtIndex:row];
+			LNKSize index = _ratingRowPointers[row];
+			
+			for (LNKSize userIndex = 0; userIndex < userCount; userIndex++) {
+				if (indicator[userIndex])
+					_ratingUsers[index++] = userIndex;
+			}
+		}
+	}
+	
+	// Sparse output matrices look ratings up without being densified.
+	const LNKSize ratingCount = _ratingRowPointers[rowCount];
+	_ratings = LNKFloatAlloc(MAX(ratingCount, 1));
+	
+	for (LNKSize row = 0; row < rowCount; row++) {
+		for (LNKSize index = _ratingRowPointers[row]; index < _ratingRowPointers[row + 1]; index++)
+			_ratings[index] = [outputMatrix valueAtRow:row column:_ratingUsers[index]];
+	}
+}
+
 - (LNKFloat)_evaluateCostFunction {
 	LNKMatrix *outputMatrix = self.matrix;
 	const LNKSize userCount = outputMatrix.columnCount;
@@ -62,44 +123,34 @@
 	const LNKFloat *dataMatrix = _unrolledGradient;
 	const LNKFloat *thetaMatrix = _unrolledGradient + rowCount * _featureCount;
 	
-	LNKFloat *thetaTranspose = LNKFloatAlloc(userCount * _featureCount);
-	LNK_mtrans(thetaMatrix, thetaTranspose, _featureCount, userCount);
-	
-	// 1/2 * sum((((X * Theta') - Y) ^ 2) * R)
-	const LNKSize resultSize = rowCount * userCount;
-	LNKFloat *result = LNKFloatAlloc(resultSize);
-	LNK_mmul(dataMatrix, UNIT_STRIDE, thetaTranspose, UNIT_STRIDE, result, UNIT_STRIDE, rowCount, userCount, _featureCount);
+	// 1/2 * sum((((X * Theta') - Y) ^ 2) * R), summed over the rated entries only
+	LNKFloat sum = 0;
 	
-	LNK_vsub(outputMatrix.matrixBuffer, UNIT_STRIDE, result, UNIT_STRIDE, result, UNIT_STRIDE, resultSize);
-	LNK_vmul(result, UNIT_STRIDE, result, UNIT_STRIDE, result, UNIT_STRIDE, resultSize);
-	LNK_vmul(result, UNIT_STRIDE, _indicatorMatrix.matrixBuffer, UNIT_STRIDE, result, UNIT_STRIDE, resultSize);
-	
-	LNKFloat sum;
-	LNK_vsum(result, UNIT_STRIDE, &sum, resultSize);
-	free(result);
+	for (LNKSize exampleIndex = 0; exampleIndex < rowCount; exampleIndex++) {
+		const LNKFloat *example = dataMatrix + _featureCount * exampleIndex;
+		
+		for (LNKSize index = _ratingRowPointers[exampleIndex]; index < _ratingRowPointers[exampleIndex + 1]; index++) {
+			LNKFloat result;
+			LNK_dotpr(example, UNIT_STRIDE, thetaMatrix + _ratingUsers[index] * _featureCount, UNIT_STRIDE, &result, _featureCount);
+			
+			const LNKFloat error = result - _ratings[index];
+			sum += error * error;
+		}
+	}
 	
 	LNKFloat regularizationTerm = 0;
 	
 	NSAssert([self.algorithm isKindOfClass:[LNKOptimizationAlgorithmCG class]], @"Unexpected algorithm");
 	
 	if (_regularizationConfiguration != nil) {
-		// Re-use the theta transpose matrix to compute the theta square.
-		LNK_vmul(thetaTranspose, UNIT_STRIDE, thetaTranspose, UNIT_STRIDE, thetaTranspose, UNIT_STRIDE, userCount * _featureCount);
-		
-		LNKFloat *dataSquare = LNKFloatAlloc(rowCount * _featureCount);
-		LNK_vmul(dataMatrix, UNIT_STRIDE, dataMatrix, UNIT_STRIDE, dataSquare, UNIT_STRIDE, rowCount * _featureCount);
-		
 		LNKFloat thetaSum, dataSum;
-		LNK_vsum(thetaTranspose, UNIT_STRIDE, &thetaSum, userCount * _featureCount);
-		LNK_vsum(dataSquare, UNIT_STRIDE, &dataSum, rowCount * _featureCount);
-		free(dataSquare);
+		LNK_dotpr(thetaMatrix, UNIT_STRIDE, thetaMatrix, UNIT_STRIDE, &thetaSum, userCount * _featureCount);
+		LNK_dotpr(dataMatrix, UNIT_STRIDE, dataMatrix, UNIT_STRIDE, &dataSum, rowCount * _featureCount);
 		
 		// ... + lambda / 2 * (sum(Theta^2) + sum(X^2))
 		regularizationTerm = _regularizationConfiguration.lambda / 2 * (thetaSum + dataSum);
 	}
 	
-	free(thetaTranspose);
-	
 	return 0.5 * sum + regularizationTerm;
 }
 
@@ -121,28 +172,26 @@
 	
 	for (LNKSize exampleIndex = 0; exampleIndex < rowCount; exampleIndex++) {
 		const LNKFloat *example = dataMatrix + _featureCount * exampleIndex;
-		const LNKFloat *output = [outputMatrix rowAtIndex:exampleIndex];
-		const LNKFloat *indicator = [_indicatorMatrix rowAtIndex:exampleIndex];
 		
 		LNKFloat *dataGradientLocation = dataGradient + exampleIndex * _featureCount;
 		
-		for (LNKSize userIndex = 0; userIndex < userCount; userIndex++) {
-			if (indicator[userIndex]) {
-				// inner = (X(example,:) . Theta(user,:)) - Y(example,user)
-				const LNKFloat *user = thetaMatrix + userIndex * _featureCount;
-				
-				LNKFloat result;
-				LNK_dotpr(example, UNIT_STRIDE, user, UNIT_STRIDE, &result, _featureCount);
-				
-				const LNKFloat inner = result - output[userIndex];
-				
-				// X_gradient += inner * Theta(user,:)
-				LNK_vsma(user, UNIT_STRIDE, &inner, dataGradientLocation, UNIT_STRIDE, dataGradientLocation, UNIT_STRIDE, _featureCount);
-				
-				// Theta_gradient += inner * X(example,:)
-				LNKFloat *const thetaGradientLocation = thetaGradient + userIndex * _featureCount;
-				LNK_vsma(example, UNIT_STRIDE, &inner, thetaGradientLocation, UNIT_STRIDE, thetaGradientLocation, UNIT_STRIDE, _featureCount);
-			}
+		for (LNKSize index = _ratingRowPointers[exampleIndex]; index < _ratingRowPointers[exampleIndex + 1]; index++) {
+			const LNKSize userIndex = _ratingUsers[index];
+			
+			// inner = (X(example,:) . Theta(user,:)) - Y(example,user)
+			const LNKFloat *user = thetaMatrix + userIndex * _featureCount;
+			
+			LNKFloat result;
+			LNK_dotpr(example, UNIT_STRIDE, user, UNIT_STRIDE, &result, _featureCount);
+			
+			const LNKFloat inner = result - _ratings[index];
+			
+			// X_gradient += inner * Theta(user,:)
+			LNK_vsma(user, UNIT_STRIDE, &inner, dataGradientLocation, UNIT_STRIDE, dataGradientLocation, UNIT_STRIDE, _featureCount);
+			
+			// Theta_gradient += inner * X(example,:)
+			LNKFloat *const thetaGradientLocation = thetaGradient + userIndex * _featureCount;
+			LNK_vsma(example, UNIT_STRIDE, &inner, thetaGradientLocation, UNIT_STRIDE, thetaGradientLocation, UNIT_STRIDE, _featureCount);
 		}
 		
 		if (regularizationEnabled) {
@@ -258,6 +307,9 @@
 
 - (void)dealloc {
 	free(_unrolledGradient);
+	free(_ratingRowPointers);
+	free(_ratingUsers);
+	free(_ratings);
 	
 	[_indicatorMatrix release];
 	[_regularizationConfiguration release];
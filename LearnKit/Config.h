@@ -6,4 +6,16 @@
 //  Copyright © 2016 Matt Rajca. All rights reserved.
 //
 
+// Set to 0 to build LearnKit with single-precision `LNKFloat`s throughout, for training and predictions alike.
+#ifndef USE_DOUBLE_PRECISION
 #define USE_DOUBLE_PRECISION 1
+#endif
+
+// Set to 0 to route the `LNK_*` kernels through a portable CBLAS/LAPACKE backend instead of Accelerate.
+#ifndef USE_ACCELERATE
+#if defined(__APPLE__)
+#define USE_ACCELERATE 1
+#else
+#define USE_ACCELERATE 0
+#endif
+#endif
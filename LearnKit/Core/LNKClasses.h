@@ -20,6 +20,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 typedef NSUInteger(^LNKClassMapper)(LNKClass *aClass);
 
+/// Classes are enumerated in the order of their indices.
 @interface LNKClasses : NSObject <NSFastEnumeration>
 
 /// All integers in the given range are mapped to indices 0..length
@@ -31,6 +32,11 @@ typedef NSUInteger(^LNKClassMapper)(LNKClass *aClass);
 
 - (NSUInteger)indexForClass:(LNKClass *)aClass;
 
+/// Unlike `-indexForClass:`, these don't allocate objects, so they can be called for every prediction.
+/// Returns `NSNotFound` if no class has the given value.
+- (NSUInteger)indexForClassWithUnsignedInteger:(NSUInteger)value;
+- (LNKClass *)classAtIndex:(NSUInteger)index;
+
 @property (nonatomic, readonly) NSUInteger count;
 
 @end
@@ -40,6 +40,7 @@
 
 @implementation LNKClasses {
 	NSArray<LNKClass *> *_classes;
+	NSUInteger *_values;
 	LNKClassMapper _mapper;
 }
 
@@ -68,7 +69,7 @@ static NSArray<LNKClass *> *_LNKIntegersInRange(NSRange range) {
 }
 
 + (instancetype)withClasses:(NSArray<LNKClass *> *)classes mapper:(LNKClassMapper)mapper {
-	return [[self alloc] initWithClasses:classes mapper:mapper];
+	return [[[self alloc] initWithClasses:classes mapper:mapper] autorelease];
 }
 
 - (instancetype)initWithClasses:(NSArray<LNKClass *> *)classes mapper:(LNKClassMapper)mapper {
@@ -78,8 +79,22 @@ static NSArray<LNKClass *> *_LNKIntegersInRange(NSRange range) {
 	if (!(self = [super init]))
 		return nil;
 	
-	_classes = [classes retain];
+	const NSUInteger count = classes.count;
+	id *indexedClasses = calloc(count, sizeof(id));
+	_values = malloc(count * sizeof(NSUInteger));
+	
+	// Classes are kept in the order of their indices, so they can be looked up and enumerated by index.
+	for (LNKClass *aClass in classes) {
+		const NSUInteger index = mapper(aClass);
+		NSAssert(index < count && !indexedClasses[index], @"Classes must be mapped to distinct indices in [0, count)");
+		
+		indexedClasses[index] = aClass;
+		_values[index] = aClass.unsignedIntegerValue;
+	}
+	
+	_classes = [[NSArray alloc] initWithObjects:indexedClasses count:count];
 	_mapper = [mapper copy];
+	free(indexedClasses);
 	
 	return self;
 }
@@ -89,6 +104,21 @@ static NSArray<LNKClass *> *_LNKIntegersInRange(NSRange range) {
 	return _mapper(aClass);
 }
 
+- (NSUInteger)indexForClassWithUnsignedInteger:(NSUInteger)value {
+	const NSUInteger count = _classes.count;
+	
+	for (NSUInteger index = 0; index < count; index++) {
+		if (_values[index] == value)
+			return index;
+	}
+	
+	return NSNotFound;
+}
+
+- (LNKClass *)classAtIndex:(NSUInteger)index {
+	return _classes[index];
+}
+
 - (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(__unsafe_unretained id [])buffer count:(NSUInteger)len {
 	return [_classes countByEnumeratingWithState:state objects:buffer count:len];
 }
@@ -99,6 +129,7 @@ static NSArray<LNKClass *> *_LNKIntegersInRange(NSRange range) {
 
 - (void)dealloc {
 	[_classes release];
+	free(_values);
 	[_mapper release];
 	[super dealloc];
 }
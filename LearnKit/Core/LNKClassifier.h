@@ -19,7 +19,21 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, retain, readonly) LNKClasses *classes;
 
+/// Predicts the class of `featureVector` without allocating any objects, so it can be called in tight loops.
+/// Returns the index of the class in `classes`, or `LNKSizeMax` if no class could be predicted or every class has a probability of 0.
+/// If `outProbabilities` isn't NULL, it receives a probability for every class in the order of their indices; classifiers
+/// that only make hard decisions give the predicted class a probability of 1.
+/// `-predictValueForFeatureVector:` is a wrapper around this method.
+- (LNKSize)predictClassIndexForFeatureVector:(LNKVector)featureVector probabilities:(nullable LNKFloat *)outProbabilities;
+
+/// Predicts the probabilities of every class for each row of `matrix` like `-predictClassIndexForFeatureVector:probabilities:`.
+/// `outputBuffer` must have room for `matrix.rowCount * classes.count` values, stored row by row. Rows no class could be
+/// predicted for get probabilities of 0. Rows are predicted in parallel unless a classifier overrides this method.
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
 /// The classifier should be trained prior to calling these methods.
+/// Both are computed from `-predictProbabilitiesForMatrix:outputBuffer:` on blocks of rows, taking the most probable class of each row,
+/// so evaluating large matrices doesn't hold the probabilities of every row at once.
 - (LNKFloat)computeClassificationAccuracyOnMatrix:(LNKMatrix *)matrix;
 
 - (LNKConfusionMatrix *)computeConfusionMatrixOnMatrix:(LNKMatrix *)matrix;
@@ -7,15 +7,32 @@
 
 #import "LNKClassifier.h"
 
+#import "LNKAccelerate.h"
 #import "LNKClassifierPrivate.h"
 #import "LNKConfusionMatrixPrivate.h"
+#import "LNKExecutor.h"
 #import "LNKMatrix.h"
-#import "LNKMatrixPrivate.h"
+#import "LNKMemoryBufferManager.h"
+#import "LNKPredictorPrivate.h"
 
-@implementation LNKClassifier {
-	NSMapTable *_classesToProbabilities;
+/// Rows are evaluated a block at a time, so no more than a block's probabilities are held per thread.
+#define EVALUATION_BLOCK_SIZE 1024
+
+/// Returns the index of the most probable class, or `LNKSizeMax` if every probability is 0.
+/// Ties go to the class with the lowest index, as they do for single feature vectors.
+static LNKSize _LNKMostProbableClassIndex(const LNKFloat *probabilities, LNKSize classCount) {
+	LNKSize bestClassIndex = 0;
+	
+	for (LNKSize classIndex = 1; classIndex < classCount; classIndex++) {
+		if (probabilities[classIndex] > probabilities[bestClassIndex])
+			bestClassIndex = classIndex;
+	}
+	
+	return probabilities[bestClassIndex] > 0 ? bestClassIndex : LNKSizeMax;
 }
 
+@implementation LNKClassifier
+
 - (instancetype)initWithMatrix:(LNKMatrix *)matrix implementationType:(LNKImplementationType)implementation optimizationAlgorithm:(id<LNKOptimizationAlgorithm>)algorithm classes:(LNKClasses *)classes {
 	NSParameterAssert(classes);
 	
@@ -27,59 +44,134 @@
 	return self;
 }
 
-- (void)_didPredictProbability:(LNKFloat)probability forClass:(LNKClass *)class {
-	NSParameterAssert(class);
+- (instancetype)initWithMatrix:(LNKMatrix *)matrix optimizationAlgorithm:(id<LNKOptimizationAlgorithm>)algorithm classes:(LNKClasses *)classes {
+	NSParameterAssert(classes);
 	
-	if (!_classesToProbabilities)
-		_classesToProbabilities = [[NSMapTable strongToStrongObjectsMapTable] retain];
+	if (!(self = [super initWithMatrix:matrix optimizationAlgorithm:algorithm]))
+		return nil;
+	
+	_classes = [classes retain];
 	
-	[_classesToProbabilities setObject:[NSNumber numberWithLNKFloat:probability] forKey:class];
+	return self;
 }
 
-- (void)_predictValueForFeatureVector:(LNKVector)featureVector {
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+#pragma unused(outProbabilities)
 #pragma unused(featureVector)
 	
 	NSAssertNotReachable(@"%s should be implemented by subclasses", __PRETTY_FUNCTION__);
+	return NO;
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
-	NSParameterAssert(featureVector.data);
-	NSParameterAssert(featureVector.length);
+- (LNKSize)predictClassIndexForFeatureVector:(LNKVector)featureVector probabilities:(LNKFloat *)outProbabilities {
+	const LNKSize classCount = _classes.count;
+	
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+	LNKFloat *probabilities = outProbabilities ? outProbabilities : LNKMemoryBufferManagerAllocScratch(memoryManager, classCount);
+	LNKSize bestClassIndex = LNKSizeMax;
+	
+	// Like rows of matrices, feature vectors no class could be predicted for get probabilities of 0.
+	if ([self _predictProbabilities:probabilities forFeatureVector:featureVector])
+		bestClassIndex = _LNKMostProbableClassIndex(probabilities, classCount);
+	else
+		LNK_vclr(probabilities, UNIT_STRIDE, classCount);
+	
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	
+	return bestClassIndex;
+}
 
-	[self _predictValueForFeatureVector:featureVector];
+- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+	const LNKSize classIndex = [self predictClassIndexForFeatureVector:featureVector probabilities:NULL];
+	
+	if (classIndex == LNKSizeMax)
+		return nil;
+	
+	return [_classes classAtIndex:classIndex];
+}
 
-	LNKFloat bestProbability = -1;
-	LNKClass *bestClass = nil;
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
 	
-	for (LNKClass *class in _classes) {
-		LNKFloat probability = [[_classesToProbabilities objectForKey:class] LNKFloatValue];
-		
-		if (probability > bestProbability) {
-			bestClass = class;
-			bestProbability = probability;
+	const LNKSize classCount = _classes.count;
+	const LNKSize columnCount = matrix.columnCount;
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), 0, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		for (LNKSize row = range.location; row < range.location + range.length; row++) {
+			LNKFloat *rowProbabilities = outputBuffer + row * classCount;
+			
+			if (![self _predictProbabilities:rowProbabilities forFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:row], columnCount)])
+				LNK_vclr(rowProbabilities, UNIT_STRIDE, classCount);
 		}
-	}
+	});
+}
+
+/// Predicts the rows of `matrix` in `range`, which should span at most `EVALUATION_BLOCK_SIZE` rows, into the current thread's
+/// scratch memory and passes `handler` the index of the most probable class of each one.
+- (void)_predictClassIndicesOfRowsInRange:(LNKRange)range ofMatrix:(LNKMatrix *)matrix handler:(void (^)(LNKSize row, LNKSize classIndex))handler {
+	const LNKSize classCount = _classes.count;
+	
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+	LNKFloat *probabilities = LNKMemoryBufferManagerAllocScratch(memoryManager, range.length * classCount);
+	
+	LNKMatrix *block = range.length == matrix.rowCount ? matrix : [matrix submatrixWithRowRange:NSMakeRange(range.location, range.length)];
+	[self predictProbabilitiesForMatrix:block outputBuffer:probabilities];
+	
+	for (LNKSize row = 0; row < range.length; row++)
+		handler(range.location + row, _LNKMostProbableClassIndex(probabilities + row * classCount, classCount));
+	
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+}
+
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	
+	LNKClasses *const classes = _classes;
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), EVALUATION_BLOCK_SIZE, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		[self _predictClassIndicesOfRowsInRange:range ofMatrix:matrix handler:^(LNKSize row, LNKSize classIndex) {
+			outputBuffer[row] = classIndex == LNKSizeMax ? NAN : [classes classAtIndex:classIndex].unsignedIntegerValue;
+		}];
+	});
+}
+
+/// Returns the index of the class whose value is `output`, or `LNKSizeMax` if there isn't one.
+static LNKSize _LNKClassIndexForOutput(LNKClasses *classes, LNKFloat output) {
+	if (!(output >= 0))
+		return LNKSizeMax;
 	
-	return bestClass;
+	const NSUInteger classIndex = [classes indexForClassWithUnsignedInteger:(NSUInteger)output];
+	return classIndex == NSNotFound ? LNKSizeMax : classIndex;
 }
 
 - (LNKFloat)computeClassificationAccuracyOnMatrix:(LNKMatrix *)matrix {
 	if (!matrix)
 		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
 
+	LNKClasses *const classes = _classes;
 	const LNKSize rowCount = matrix.rowCount;
-	const LNKSize columnCount = matrix.columnCount;
-	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
 	const LNKFloat *outputVector = matrix.outputVector;
 	
+	// Predictions are counted a block at a time as they're made.
 	LNKSize hits = 0;
-	
-	for (LNKSize m = 0; m < rowCount; m++) {
-		id predictedValue = [self predictValueForFeatureVector:LNKVectorCreateUnsafe(_ROW_IN_MATRIX_BUFFER(m), columnCount)];
-		
-		if ([predictedValue isEqual:[LNKClass classWithUnsignedInteger:outputVector[m]]])
-			hits++;
-	}
+	LNKExecutorCount(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), EVALUATION_BLOCK_SIZE, &hits, 1, ^(LNKRange range, LNKSize *counters) {
+		[self _predictClassIndicesOfRowsInRange:range ofMatrix:matrix handler:^(LNKSize m, LNKSize classIndex) {
+			if (classIndex != LNKSizeMax && classIndex == _LNKClassIndexForOutput(classes, outputVector[m]))
+				counters[0]++;
+		}];
+	});
 	
 	return (LNKFloat)hits / rowCount;
 }
@@ -89,31 +181,35 @@
 		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
 	}
 
+	LNKClasses *const classes = _classes;
 	const LNKSize rowCount = matrix.rowCount;
-	const LNKSize columnCount = matrix.columnCount;
-	const LNKFloat *const matrixBuffer = matrix.matrixBuffer;
+	const LNKSize classCount = classes.count;
+	const LNKSize countCount = classCount * (classCount + 1);
 	const LNKFloat *const outputVector = matrix.outputVector;
 
-	LNKConfusionMatrix *const confusionMatrix = [[LNKConfusionMatrix alloc] init];
+	// Every thread predicts a block of rows at a time and counts them into a table of its own; the tables are summed once
+	// all rows are counted. Rows whose outputs aren't one of the classes aren't counted.
+	LNKSize *const counts = malloc(countCount * sizeof(LNKSize));
+	LNKExecutorCount(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), EVALUATION_BLOCK_SIZE, counts, countCount, ^(LNKRange range, LNKSize *counters) {
+		[self _predictClassIndicesOfRowsInRange:range ofMatrix:matrix handler:^(LNKSize m, LNKSize predictedClassIndex) {
+			const LNKSize trueClassIndex = _LNKClassIndexForOutput(classes, outputVector[m]);
 
-	for (LNKSize m = 0; m < rowCount; m++) {
-		id predictedValue = [self predictValueForFeatureVector:LNKVectorCreateUnsafe(_ROW_IN_MATRIX_BUFFER(m), columnCount)];
+			if (trueClassIndex == LNKSizeMax) {
+				return;
+			}
 
-		if (![predictedValue isKindOfClass:[LNKClass class]]) {
-			continue;
-		}
+			counters[trueClassIndex * (classCount + 1) + (predictedClassIndex == LNKSizeMax ? classCount : predictedClassIndex)]++;
+		}];
+	});
 
-		LNKClass *const predictedClass = predictedValue;
-		LNKClass *const trueClass = [LNKClass classWithUnsignedInteger:outputVector[m]];
+	LNKConfusionMatrix *const confusionMatrix = [[LNKConfusionMatrix alloc] _initWithClasses:classes counts:counts];
 
-		[confusionMatrix _incrementFrequencyForTrueClass:trueClass predictedClass:predictedClass];
-	}
+	free(counts);
 
 	return [confusionMatrix autorelease];
 }
 
 - (void)dealloc {
-	[_classesToProbabilities release];
 	[_classes release];
 	[super dealloc];
 }
@@ -9,9 +9,12 @@
 
 @interface LNKClassifier (Private)
 
-/// Instead of overriding -predictValueForFeatureVector:, classifiers should override the following method and provide probabilities for all classes.
-- (void)_predictValueForFeatureVector:(LNKVector)featureVector;
+/// For classifiers with a fixed set of classes, which are set up through LNKPredictor's initializers.
+- (instancetype)initWithMatrix:(LNKMatrix *)matrix optimizationAlgorithm:(id<LNKOptimizationAlgorithm>)algorithm classes:(LNKClasses *)classes;
 
-- (void)_didPredictProbability:(LNKFloat)probability forClass:(LNKClass *)class;
+/// Instead of overriding -predictValueForFeatureVector:, classifiers should override the following method and write
+/// probabilities for all classes into `outProbabilities`, which is never NULL. Returns NO if no class can be predicted.
+/// Implementations must not allocate objects.
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector;
 
 @end
@@ -9,11 +9,37 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-@class LNKClass;
+@class LNKClass, LNKClasses;
 
+/// Counts how often examples of each class are predicted as each class, in a dense table indexed by the classes' indices.
+/// Examples no class could be predicted for count against the recall of their class, but not the precision of any class.
 @interface LNKConfusionMatrix : NSObject
 
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, retain, readonly) LNKClasses *classes;
+
+/// The number of examples counted, including those no class could be predicted for.
+@property (nonatomic, readonly) NSUInteger exampleCount;
+
 - (NSUInteger)frequencyForTrueClass:(LNKClass *)trueClass predictedClass:(LNKClass *)predictedClass;
+- (NSUInteger)frequencyForTrueClassAtIndex:(NSUInteger)trueClassIndex predictedClassAtIndex:(NSUInteger)predictedClassIndex;
+
+/// These are 0 for classes no example was predicted as or belongs to.
+- (LNKFloat)precisionForClassAtIndex:(NSUInteger)classIndex;
+- (LNKFloat)recallForClassAtIndex:(NSUInteger)classIndex;
+- (LNKFloat)f1ScoreForClassAtIndex:(NSUInteger)classIndex;
+
+/// The unweighted means of the metrics of every class.
+@property (nonatomic, readonly) LNKFloat macroPrecision;
+@property (nonatomic, readonly) LNKFloat macroRecall;
+@property (nonatomic, readonly) LNKFloat macroF1Score;
+
+/// The metrics of the counts of all classes pooled together. Micro-averaged recall is the accuracy over all examples,
+/// and precision the accuracy over the examples a class was predicted for.
+@property (nonatomic, readonly) LNKFloat microPrecision;
+@property (nonatomic, readonly) LNKFloat microRecall;
+@property (nonatomic, readonly) LNKFloat microF1Score;
 
 @end
 
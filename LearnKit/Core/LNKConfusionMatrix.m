@@ -11,7 +11,40 @@
 #import "LNKConfusionMatrixPrivate.h"
 
 @implementation LNKConfusionMatrix {
-	NSMutableDictionary<LNKClass *, NSCountedSet<LNKClass *> *> *_frequencyTable;
+	// Rows are true classes and columns predicted classes, followed by a column for examples without a predicted class.
+	LNKSize *_counts;
+	LNKSize _classCount;
+}
+
+- (instancetype)init {
+	NSAssertNotReachable(@"Use the designated initializer", nil);
+	return nil;
+}
+
+- (instancetype)_initWithClasses:(LNKClasses *)classes counts:(const LNKSize *)counts {
+	NSParameterAssert(classes);
+	NSParameterAssert(counts);
+
+	if (!(self = [super init]))
+		return nil;
+
+	_classes = [classes retain];
+	_classCount = classes.count;
+
+	const LNKSize countCount = _classCount * (_classCount + 1);
+	_counts = malloc(countCount * sizeof(LNKSize));
+	memcpy(_counts, counts, countCount * sizeof(LNKSize));
+
+	for (LNKSize index = 0; index < countCount; index++)
+		_exampleCount += counts[index];
+
+	return self;
+}
+
+- (void)dealloc {
+	free(_counts);
+	[_classes release];
+	[super dealloc];
 }
 
 - (NSUInteger)frequencyForTrueClass:(LNKClass *)trueClass predictedClass:(LNKClass *)predictedClass {
@@ -23,41 +56,127 @@
 		[NSException raise:NSInvalidArgumentException format:@"The predicted class must be specified"];
 	}
 
-	NSCountedSet<LNKClass *> *const trueCounts = _frequencyTable[trueClass];
+	const NSUInteger trueClassIndex = [_classes indexForClass:trueClass];
+	const NSUInteger predictedClassIndex = [_classes indexForClass:predictedClass];
 
-	if (!trueCounts) {
+	// Classes that aren't part of `classes` never had an example counted.
+	if (trueClassIndex >= _classCount || predictedClassIndex >= _classCount) {
 		return 0;
 	}
 
-	return [trueCounts countForObject:predictedClass];
+	return [self frequencyForTrueClassAtIndex:trueClassIndex predictedClassAtIndex:predictedClassIndex];
 }
 
-- (void)_incrementFrequencyForTrueClass:(LNKClass *)trueClass predictedClass:(LNKClass *)predictedClass {
-	if (!trueClass) {
-		[NSException raise:NSInvalidArgumentException format:@"The true class must be specified"];
+- (NSUInteger)frequencyForTrueClassAtIndex:(NSUInteger)trueClassIndex predictedClassAtIndex:(NSUInteger)predictedClassIndex {
+	if (trueClassIndex >= _classCount || predictedClassIndex >= _classCount) {
+		[NSException raise:NSInvalidArgumentException format:@"The class index is out-of-bounds"];
 	}
 
-	if (!predictedClass) {
-		[NSException raise:NSInvalidArgumentException format:@"The predicted class must be specified"];
-	}
+	return _counts[trueClassIndex * (_classCount + 1) + predictedClassIndex];
+}
 
-	if (_frequencyTable == nil) {
-		_frequencyTable = [[NSMutableDictionary alloc] init];
+- (LNKSize)_truePositiveCountForClassAtIndex:(NSUInteger)classIndex {
+	if (classIndex >= _classCount) {
+		[NSException raise:NSInvalidArgumentException format:@"The class index is out-of-bounds"];
 	}
 
-	NSCountedSet<LNKClass *> *trueCounts = _frequencyTable[trueClass];
+	return _counts[classIndex * (_classCount + 1) + classIndex];
+}
 
-	if (!trueCounts) {
-		trueCounts = [[[NSCountedSet alloc] init] autorelease];
-		_frequencyTable[trueClass] = trueCounts;
-	}
+/// The number of examples predicted as the class.
+- (LNKSize)_predictedCountForClassAtIndex:(NSUInteger)classIndex {
+	LNKSize count = 0;
 
-	[trueCounts addObject:predictedClass];
+	for (LNKSize trueClassIndex = 0; trueClassIndex < _classCount; trueClassIndex++)
+		count += _counts[trueClassIndex * (_classCount + 1) + classIndex];
+
+	return count;
 }
 
-- (void)dealloc {
-	[_frequencyTable release];
-	[super dealloc];
+/// The number of examples of the class, whether or not a class was predicted for them.
+- (LNKSize)_trueCountForClassAtIndex:(NSUInteger)classIndex {
+	const LNKSize *row = _counts + classIndex * (_classCount + 1);
+	LNKSize count = 0;
+
+	for (LNKSize predictedClassIndex = 0; predictedClassIndex <= _classCount; predictedClassIndex++)
+		count += row[predictedClassIndex];
+
+	return count;
+}
+
+static LNKFloat _LNKRatio(LNKSize numerator, LNKSize denominator) {
+	return denominator ? (LNKFloat)numerator / denominator : 0;
+}
+
+- (LNKFloat)precisionForClassAtIndex:(NSUInteger)classIndex {
+	return _LNKRatio([self _truePositiveCountForClassAtIndex:classIndex], [self _predictedCountForClassAtIndex:classIndex]);
+}
+
+- (LNKFloat)recallForClassAtIndex:(NSUInteger)classIndex {
+	return _LNKRatio([self _truePositiveCountForClassAtIndex:classIndex], [self _trueCountForClassAtIndex:classIndex]);
+}
+
+- (LNKFloat)f1ScoreForClassAtIndex:(NSUInteger)classIndex {
+	// The harmonic mean of precision and recall, 2 TP / (2 TP + FP + FN).
+	const LNKSize truePositiveCount = [self _truePositiveCountForClassAtIndex:classIndex];
+	return _LNKRatio(2 * truePositiveCount, [self _predictedCountForClassAtIndex:classIndex] + [self _trueCountForClassAtIndex:classIndex]);
+}
+
+- (LNKFloat)macroPrecision {
+	LNKFloat sum = 0;
+
+	for (LNKSize classIndex = 0; classIndex < _classCount; classIndex++)
+		sum += [self precisionForClassAtIndex:classIndex];
+
+	return sum / _classCount;
+}
+
+- (LNKFloat)macroRecall {
+	LNKFloat sum = 0;
+
+	for (LNKSize classIndex = 0; classIndex < _classCount; classIndex++)
+		sum += [self recallForClassAtIndex:classIndex];
+
+	return sum / _classCount;
+}
+
+- (LNKFloat)macroF1Score {
+	LNKFloat sum = 0;
+
+	for (LNKSize classIndex = 0; classIndex < _classCount; classIndex++)
+		sum += [self f1ScoreForClassAtIndex:classIndex];
+
+	return sum / _classCount;
+}
+
+- (LNKSize)_truePositiveCount {
+	LNKSize count = 0;
+
+	for (LNKSize classIndex = 0; classIndex < _classCount; classIndex++)
+		count += [self _truePositiveCountForClassAtIndex:classIndex];
+
+	return count;
+}
+
+- (LNKSize)_predictedCount {
+	LNKSize count = 0;
+
+	for (LNKSize classIndex = 0; classIndex < _classCount; classIndex++)
+		count += [self _predictedCountForClassAtIndex:classIndex];
+
+	return count;
+}
+
+- (LNKFloat)microPrecision {
+	return _LNKRatio([self _truePositiveCount], [self _predictedCount]);
+}
+
+- (LNKFloat)microRecall {
+	return _LNKRatio([self _truePositiveCount], _exampleCount);
+}
+
+- (LNKFloat)microF1Score {
+	return _LNKRatio(2 * [self _truePositiveCount], [self _predictedCount] + _exampleCount);
 }
 
 @end
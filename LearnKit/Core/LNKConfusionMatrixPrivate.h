@@ -9,6 +9,8 @@
 
 @interface LNKConfusionMatrix (Private)
 
-- (void)_incrementFrequencyForTrueClass:(LNKClass *)trueClass predictedClass:(LNKClass *)predictedClass;
+/// `counts` holds a row of `classes.count + 1` counts for every true class, the last of which counts the examples no class
+/// was predicted for. The counts are copied.
+- (instancetype)_initWithClasses:(LNKClasses *)classes counts:(const LNKSize *)counts;
 
 @end
@@ -0,0 +1,50 @@
+//
+//  LNKExecutor.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A pool of long-lived threads that process ranges of examples in chunks.
+/// Each thread starts out with an even share of the chunks and steals from the others once it runs out,
+/// so a slow or busy thread doesn't hold up the rest.
+typedef struct _LNKExecutor LNKExecutor;
+typedef LNKExecutor *LNKExecutorRef;
+
+/// `threadIndex` is less than the executor's thread count and is never used by two chunks that run concurrently,
+/// so it can index per-thread reduction buffers.
+typedef void (^LNKExecutorWorker)(LNKRange range, LNKSize threadIndex);
+
+/// `LNKExecutorSum` hands each thread a zeroed accumulator of the length passed to it.
+typedef void (^LNKExecutorAccumulatingWorker)(LNKRange range, LNKFloat *accumulator);
+
+/// `LNKExecutorCount` hands each thread zeroed counters of the length passed to it.
+typedef void (^LNKExecutorCountingWorker)(LNKRange range, LNKSize *counters);
+
+/// A thread count of 0 uses one thread per processor.
+/// The thread calling `LNKExecutorApply` participates in the work and counts toward the thread count.
+LNKExecutorRef LNKExecutorCreate(LNKSize threadCount);
+void LNKExecutorFree(LNKExecutorRef executor);
+
+LNKSize LNKExecutorGetThreadCount(LNKExecutorRef executor);
+
+/// Applies to work submitted after the call. Threads are started on demand and kept until the executor is freed.
+void LNKExecutorSetThreadCount(LNKExecutorRef executor, LNKSize threadCount);
+
+/// The executor used by all of LearnKit's parallel algorithms.
+/// Models trained side by side share its threads, so lowering its thread count bounds the total parallelism of the process.
+LNKExecutorRef LNKExecutorGetShared(void);
+
+/// Splits `range` into chunks of `grainSize` examples and returns once `worker` has processed all of them.
+/// A grain size of 0 picks one that gives every thread several chunks.
+void LNKExecutorApply(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKExecutorWorker worker);
+
+/// Like `LNKExecutorApply`, but gives every thread its own zeroed accumulator of `length` elements and sums them into `outResult`.
+void LNKExecutorSum(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKFloat *outResult, LNKSize length, LNKExecutorAccumulatingWorker worker);
+
+/// Like `LNKExecutorSum`, but with integer counters, which stay exact however many examples are counted.
+void LNKExecutorCount(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKSize *outCounts, LNKSize length, LNKExecutorCountingWorker worker);
+
+NS_ASSUME_NONNULL_END
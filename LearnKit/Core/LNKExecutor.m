@@ -0,0 +1,353 @@
+//
+//  LNKExecutor.m
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKExecutor.h"
+
+#import "LNKAccelerate.h"
+#import "LNKMemoryBufferManager.h"
+#import <pthread.h>
+
+#define CHUNKS_PER_THREAD	4	// Used when no grain size is given.
+
+// The chunks a thread has yet to claim. The owner claims from the front; other threads steal from the back.
+struct _LNKExecutorSlice {
+	pthread_mutex_t lock;
+	LNKSize begin, end;
+};
+
+struct _LNKExecutorJob {
+	LNKRange range;
+	LNKSize grainSize;
+	LNKSize threadCount;
+	LNKExecutorWorker worker;
+
+	struct _LNKExecutorSlice *slices;
+	LNKSize unclaimedChunkCount;	// Accessed atomically.
+	LNKSize activeWorkerCount;		// Guarded by the executor's lock.
+
+	struct _LNKExecutorJob *next;
+};
+
+struct _LNKExecutorThread {
+	LNKExecutorRef executor;
+	LNKSize index;
+};
+
+struct _LNKExecutor {
+	pthread_mutex_t lock;
+	pthread_cond_t jobsAvailable;
+	pthread_cond_t workerFinished;
+
+	struct _LNKExecutorJob *jobs;
+	pthread_t *threads;
+	LNKSize spawnedThreadCount;
+	LNKSize threadCount;
+	BOOL stopping;
+};
+
+static BOOL _LNKExecutorNextChunk(struct _LNKExecutorJob *job, LNKSize threadIndex, LNKSize *outChunk) {
+	struct _LNKExecutorSlice *const slice = &job->slices[threadIndex];
+
+	while (__atomic_load_n(&job->unclaimedChunkCount, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&slice->lock);
+
+		if (slice->begin < slice->end) {
+			*outChunk = slice->begin++;
+			pthread_mutex_unlock(&slice->lock);
+			__atomic_fetch_sub(&job->unclaimedChunkCount, 1, __ATOMIC_RELAXED);
+			return YES;
+		}
+
+		pthread_mutex_unlock(&slice->lock);
+
+		// Steal the back half of the next thread's remaining chunks.
+		for (LNKSize offset = 1; offset < job->threadCount; offset++) {
+			struct _LNKExecutorSlice *const victim = &job->slices[(threadIndex + offset) % job->threadCount];
+			pthread_mutex_lock(&victim->lock);
+
+			const LNKSize remainingChunkCount = victim->end - victim->begin;
+
+			if (remainingChunkCount == 0) {
+				pthread_mutex_unlock(&victim->lock);
+				continue;
+			}
+
+			const LNKSize stolenChunkCount = (remainingChunkCount + 1) / 2;
+			victim->end -= stolenChunkCount;
+			const LNKSize stolenBegin = victim->end;
+			pthread_mutex_unlock(&victim->lock);
+
+			// Our slice is empty so no other thread touches it in the meantime.
+			pthread_mutex_lock(&slice->lock);
+			slice->begin = stolenBegin + 1;
+			slice->end = stolenBegin + stolenChunkCount;
+			pthread_mutex_unlock(&slice->lock);
+
+			*outChunk = stolenBegin;
+			__atomic_fetch_sub(&job->unclaimedChunkCount, 1, __ATOMIC_RELAXED);
+			return YES;
+		}
+
+		// Whatever remains is in flight between two slices.
+	}
+
+	return NO;
+}
+
+static void _LNKExecutorRunJob(struct _LNKExecutorJob *job, LNKSize threadIndex) {
+	const LNKSize end = job->range.location + job->range.length;
+	LNKSize chunk;
+
+	while (_LNKExecutorNextChunk(job, threadIndex, &chunk)) {
+		const LNKSize location = job->range.location + chunk * job->grainSize;
+
+		@autoreleasepool {
+			job->worker(LNKRangeMake(location, MIN(job->grainSize, end - location)), threadIndex);
+		}
+	}
+}
+
+static void *_LNKExecutorThreadMain(void *context) {
+	struct _LNKExecutorThread *const thread = context;
+	LNKExecutorRef executor = thread->executor;
+	const LNKSize threadIndex = thread->index;
+	free(thread);
+
+	pthread_mutex_lock(&executor->lock);
+
+	while (!executor->stopping) {
+		struct _LNKExecutorJob *job = executor->jobs;
+
+		// Threads beyond a job's thread count have no slice in it.
+		while (job && (threadIndex >= job->threadCount || !__atomic_load_n(&job->unclaimedChunkCount, __ATOMIC_RELAXED)))
+			job = job->next;
+
+		if (!job) {
+			pthread_cond_wait(&executor->jobsAvailable, &executor->lock);
+			continue;
+		}
+
+		job->activeWorkerCount++;
+		pthread_mutex_unlock(&executor->lock);
+
+		_LNKExecutorRunJob(job, threadIndex);
+
+		pthread_mutex_lock(&executor->lock);
+
+		if (--job->activeWorkerCount == 0)
+			pthread_cond_broadcast(&executor->workerFinished);
+	}
+
+	pthread_mutex_unlock(&executor->lock);
+
+	return NULL;
+}
+
+static LNKSize _LNKProcessorCount() {
+	return [NSProcessInfo processInfo].activeProcessorCount;
+}
+
+/// The executor's lock must be held.
+static void _LNKExecutorSpawnThreads(LNKExecutorRef executor, LNKSize threadCount) {
+	if (threadCount <= executor->spawnedThreadCount + 1)
+		return;
+
+	// The thread calling into the executor acts as thread 0, so we only need threadCount - 1 of our own.
+	executor->threads = realloc(executor->threads, (threadCount - 1) * sizeof(pthread_t));
+
+	for (LNKSize index = executor->spawnedThreadCount + 1; index < threadCount; index++) {
+		struct _LNKExecutorThread *thread = malloc(sizeof(struct _LNKExecutorThread));
+		thread->executor = executor;
+		thread->index = index;
+
+		if (pthread_create(&executor->threads[index - 1], NULL, &_LNKExecutorThreadMain, thread) != 0)
+			[NSException raise:NSGenericException format:@"Could not start an executor thread"];
+	}
+
+	executor->spawnedThreadCount = threadCount - 1;
+}
+
+LNKExecutorRef LNKExecutorCreate(LNKSize threadCount) {
+	LNKExecutorRef executor = calloc(1, sizeof(LNKExecutor));
+	pthread_mutex_init(&executor->lock, NULL);
+	pthread_cond_init(&executor->jobsAvailable, NULL);
+	pthread_cond_init(&executor->workerFinished, NULL);
+	executor->threadCount = threadCount ? threadCount : _LNKProcessorCount();
+
+	return executor;
+}
+
+void LNKExecutorFree(LNKExecutorRef executor) {
+	NSCAssert(executor, @"The executor must not be NULL");
+
+	pthread_mutex_lock(&executor->lock);
+	NSCAssert(executor->jobs == NULL, @"The executor must not be freed while it has work");
+	executor->stopping = YES;
+	pthread_cond_broadcast(&executor->jobsAvailable);
+	pthread_mutex_unlock(&executor->lock);
+
+	for (LNKSize index = 0; index < executor->spawnedThreadCount; index++)
+		pthread_join(executor->threads[index], NULL);
+
+	pthread_cond_destroy(&executor->workerFinished);
+	pthread_cond_destroy(&executor->jobsAvailable);
+	pthread_mutex_destroy(&executor->lock);
+	free(executor->threads);
+	free(executor);
+}
+
+LNKSize LNKExecutorGetThreadCount(LNKExecutorRef executor) {
+	NSCAssert(executor, @"The executor must not be NULL");
+
+	pthread_mutex_lock(&executor->lock);
+	const LNKSize threadCount = executor->threadCount;
+	pthread_mutex_unlock(&executor->lock);
+
+	return threadCount;
+}
+
+void LNKExecutorSetThreadCount(LNKExecutorRef executor, LNKSize threadCount) {
+	NSCAssert(executor, @"The executor must not be NULL");
+
+	pthread_mutex_lock(&executor->lock);
+	executor->threadCount = threadCount ? threadCount : _LNKProcessorCount();
+	pthread_mutex_unlock(&executor->lock);
+}
+
+LNKExecutorRef LNKExecutorGetShared() {
+	static LNKExecutorRef sharedExecutor = NULL;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		sharedExecutor = LNKExecutorCreate(0);
+	});
+
+	return sharedExecutor;
+}
+
+static void _LNKExecutorApplyWithThreadCount(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKSize threadCount, LNKExecutorWorker worker) {
+	if (!grainSize)
+		grainSize = MAX(1, range.length / (threadCount * CHUNKS_PER_THREAD));
+
+	const LNKSize chunkCount = (range.length + grainSize - 1) / grainSize;
+
+	// Not worth waking anyone up.
+	if (threadCount == 1 || chunkCount == 1) {
+		for (LNKSize location = range.location; location < range.location + range.length; location += grainSize)
+			worker(LNKRangeMake(location, MIN(grainSize, range.location + range.length - location)), 0);
+
+		return;
+	}
+
+	struct _LNKExecutorSlice slices[threadCount];
+
+	for (LNKSize index = 0; index < threadCount; index++) {
+		pthread_mutex_init(&slices[index].lock, NULL);
+		slices[index].begin = index * chunkCount / threadCount;
+		slices[index].end = (index + 1) * chunkCount / threadCount;
+	}
+
+	struct _LNKExecutorJob job;
+	job.range = range;
+	job.grainSize = grainSize;
+	job.threadCount = threadCount;
+	job.worker = worker;
+	job.slices = slices;
+	job.unclaimedChunkCount = chunkCount;
+	job.activeWorkerCount = 0;
+	job.next = NULL;
+
+	pthread_mutex_lock(&executor->lock);
+	_LNKExecutorSpawnThreads(executor, threadCount);
+
+	struct _LNKExecutorJob **tail = &executor->jobs;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = &job;
+
+	pthread_cond_broadcast(&executor->jobsAvailable);
+	pthread_mutex_unlock(&executor->lock);
+
+	_LNKExecutorRunJob(&job, 0);
+
+	// Every chunk has been claimed; wait for the threads still running theirs.
+	pthread_mutex_lock(&executor->lock);
+
+	for (tail = &executor->jobs; *tail != &job; tail = &(*tail)->next);
+	*tail = job.next;
+
+	while (job.activeWorkerCount)
+		pthread_cond_wait(&executor->workerFinished, &executor->lock);
+
+	pthread_mutex_unlock(&executor->lock);
+
+	for (LNKSize index = 0; index < threadCount; index++)
+		pthread_mutex_destroy(&slices[index].lock);
+}
+
+void LNKExecutorApply(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKExecutorWorker worker) {
+	NSCAssert(executor, @"The executor must not be NULL");
+	NSCAssert(worker, @"The worker must not be NULL");
+
+	if (!range.length)
+		return;
+
+	_LNKExecutorApplyWithThreadCount(executor, range, grainSize, LNKExecutorGetThreadCount(executor), worker);
+}
+
+void LNKExecutorSum(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKFloat *outResult, LNKSize length, LNKExecutorAccumulatingWorker worker) {
+	NSCAssert(executor, @"The executor must not be NULL");
+	NSCAssert(outResult, @"The result must not be NULL");
+	NSCAssert(length, @"The length must be greater than 0");
+	NSCAssert(worker, @"The worker must not be NULL");
+
+	// The thread count is read once so it can't change between allocating the accumulators and handing them out.
+	const LNKSize threadCount = LNKExecutorGetThreadCount(executor);
+
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	LNKFloat *accumulators = LNKMemoryBufferManagerAllocBlock(memoryManager, threadCount * length);
+	LNK_vclr(accumulators, UNIT_STRIDE, threadCount * length);
+
+	if (range.length) {
+		_LNKExecutorApplyWithThreadCount(executor, range, grainSize, threadCount, ^(LNKRange innerRange, LNKSize threadIndex) {
+			worker(innerRange, accumulators + threadIndex * length);
+		});
+	}
+
+	LNKFloatCopy(outResult, accumulators, length);
+
+	for (LNKSize index = 1; index < threadCount; index++)
+		LNK_vadd(outResult, UNIT_STRIDE, accumulators + index * length, UNIT_STRIDE, outResult, UNIT_STRIDE, length);
+
+	LNKMemoryBufferManagerFreeBlock(memoryManager, accumulators, threadCount * length);
+}
+
+void LNKExecutorCount(LNKExecutorRef executor, LNKRange range, LNKSize grainSize, LNKSize *outCounts, LNKSize length, LNKExecutorCountingWorker worker) {
+	NSCAssert(executor, @"The executor must not be NULL");
+	NSCAssert(outCounts, @"The counts must not be NULL");
+	NSCAssert(length, @"The length must be greater than 0");
+	NSCAssert(worker, @"The worker must not be NULL");
+
+	const LNKSize threadCount = LNKExecutorGetThreadCount(executor);
+	LNKSize *counters = calloc(threadCount * length, sizeof(LNKSize));
+
+	if (range.length) {
+		_LNKExecutorApplyWithThreadCount(executor, range, grainSize, threadCount, ^(LNKRange innerRange, LNKSize threadIndex) {
+			worker(innerRange, counters + threadIndex * length);
+		});
+	}
+
+	memcpy(outCounts, counters, length * sizeof(LNKSize));
+
+	for (LNKSize index = 1; index < threadCount; index++) {
+		const LNKSize *threadCounters = counters + index * length;
+
+		for (LNKSize counter = 0; counter < length; counter++)
+			outCounts[counter] += threadCounters[counter];
+	}
+
+	free(counters);
+}
@@ -27,6 +27,12 @@ typedef NS_ENUM(NSUInteger, LNKValueType) {
 								 outputVectorAtURL:(nullable NSURL *)outputVectorURL outputVectorValueType:(LNKValueType)outputVectorValueType
 										  rowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount;
 
+/// Initializes a matrix by mapping a file written with `-writeNativeDataToURL:error:` into memory.
+/// The buffers are used in place rather than copied, so loading takes constant time regardless of the size of the file,
+/// and pages that are not modified are shared with other processes mapping the same file.
+/// Returns `nil` if the file is not a native matrix with the floating-point type of this build.
+- (nullable instancetype)initWithNativeMatrixAtURL:(NSURL *)url;
+
 /// Initializes a matrix by filling the given buffers.
 /// The column count should not include the ones column.
 - (instancetype)initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount
@@ -37,6 +43,10 @@ typedef NS_ENUM(NSUInteger, LNKValueType) {
 
 @property (nonatomic, readonly) BOOL hasBiasColumn;
 
+/// Whether only the non-zero values of the matrix are stored, as with `LNKSparseMatrix`.
+/// Sparse matrices build a dense copy of themselves the first time `matrixBuffer` or `rowAtIndex:` is called.
+@property (nonatomic, readonly, getter=isSparse) BOOL sparse;
+
 - (LNKMatrix *)matrixByAddingBiasColumn;
 
 - (const LNKFloat *)matrixBuffer NS_RETURNS_INNER_POINTER;
@@ -54,9 +64,22 @@ typedef NS_ENUM(NSUInteger, LNKValueType) {
 - (LNKMatrix *)multiplyByMatrix:(LNKMatrix *)matrix;
 - (LNKMatrix *)transposedMatrix;
 
+/// Computes the product of the matrix and the row-major `buffer`, which has `columnCount` columns and as many rows as
+/// the matrix has columns, and writes the `rowCount` by `columnCount` result to `outputBuffer`.
+/// Sparse matrices compute this in time proportional to their number of non-zero values.
+- (void)multiplyByBuffer:(const LNKFloat *)buffer columnCount:(LNKSize)columnCount outputBuffer:(LNKFloat *)outputBuffer;
+
+/// Like `-multiplyByBuffer:columnCount:outputBuffer:`, but with the transpose of the matrix, so `buffer` has as many
+/// rows as the matrix and the result has as many rows as the matrix has columns.
+- (void)multiplyTransposeByBuffer:(const LNKFloat *)buffer columnCount:(LNKSize)columnCount outputBuffer:(LNKFloat *)outputBuffer;
+
 - (LNKMatrix *)covarianceMatrix;
 - (nullable LNKMatrix *)invertedMatrix;
 
+// Copies, shuffled matrices, splits and row ranges are views that share the rows of the current matrix and only copy
+// its output vector. Views of reordered rows gather them into a buffer of their own the first time `matrixBuffer` is
+// called; `rowAtIndex:` never needs to.
+
 /// Returns a copy of the current matrix with its rows reshuffled.
 - (LNKMatrix *)copyShuffledMatrix;
 
@@ -65,6 +88,7 @@ typedef NS_ENUM(NSUInteger, LNKValueType) {
 
 - (void)splitIntoTrainingMatrix:(LNKMatrix *__nullable *__nonnull)trainingMatrix testMatrix:(LNKMatrix *__nullable *__nonnull)testMatrix trainingBias:(LNKFloat)trainingBias;
 
+/// Throws an exception if the range is out of bounds.
 - (LNKMatrix *)submatrixWithRowRange:(NSRange)range;
 - (LNKMatrix *)submatrixWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount;
 
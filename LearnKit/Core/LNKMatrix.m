@@ -7,13 +7,24 @@
 
 #import "LNKMatrix.h"
 
+#import <sys/mman.h>
+#import <sys/stat.h>
+
 #import "LNKAccelerate.h"
+#import "LNKMatrixPrivate.h"
 #import "LNKUtilities.h"
 
 @implementation LNKMatrix {
 	LNKFloat *_matrix, *_outputVector;
 	LNKFloat *_columnToMu, *_columnToSD;
 	BOOL _weakMatrixReference;
+	void *_mappedFile;
+	size_t _mappedFileLength;
+	
+	// Views reference the rows of another matrix, which they keep alive, instead of copying them.
+	LNKMatrix *_parent;
+	const LNKFloat *_rowBase;
+	LNKSize *_rowIndices;
 }
 
 #define NUMBER_BUFFER_SIZE 2048
@@ -137,6 +148,93 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	return self;
 }
 
+static BOOL _LNKNativeMatrixHeaderIsValid(const _LNKNativeMatrixHeader *header, uint64_t fileLength) {
+	if (memcmp(header->magic, _LNK_NATIVE_MATRIX_MAGIC, sizeof(header->magic)) || header->version != _LNK_NATIVE_MATRIX_VERSION) {
+		NSLog(@"Error while loading matrix: the file is not a native matrix");
+		return NO;
+	}
+	
+	if (header->byteOrder != _LNK_NATIVE_MATRIX_BYTE_ORDER || header->valueSize != sizeof(LNKFloat)) {
+		NSLog(@"Error while loading matrix: the file was written with a different byte order or floating-point type");
+		return NO;
+	}
+	
+	uint64_t valueCount;
+	
+	// Rejecting dimensions that could not fit in the file also keeps the layout arithmetic from overflowing.
+	if (!header->rowCount || !header->columnCount || __builtin_mul_overflow(header->rowCount, header->columnCount, &valueCount) ||
+		valueCount > fileLength / sizeof(LNKFloat)) {
+		NSLog(@"Error while loading matrix: invalid matrix dimensions");
+		return NO;
+	}
+	
+	_LNKNativeMatrixHeader expectedHeader = *header;
+	const uint64_t expectedLength = _LNKNativeMatrixLayout(&expectedHeader);
+	
+	if (memcmp(&expectedHeader, header, sizeof(_LNKNativeMatrixHeader)) || fileLength < expectedLength) {
+		NSLog(@"Error while loading matrix: invalid matrix file size");
+		return NO;
+	}
+	
+	return YES;
+}
+
+- (instancetype)initWithNativeMatrixAtURL:(NSURL *)url {
+	NSParameterAssert(url);
+	
+	if (!(self = [super init]))
+		return nil;
+	
+	const int file = open(url.fileSystemRepresentation, O_RDONLY);
+	
+	if (file == -1) {
+		NSLog(@"Error while loading matrix: could not open the matrix file at the given URL: %s", strerror(errno));
+		[self release];
+		return nil;
+	}
+	
+	struct stat fileStatus;
+	
+	if (fstat(file, &fileStatus) || (uint64_t)fileStatus.st_size < sizeof(_LNKNativeMatrixHeader)) {
+		NSLog(@"Error while loading matrix: invalid matrix file size");
+		close(file);
+		[self release];
+		return nil;
+	}
+	
+	// Private mappings let callers modify the buffers (the output vector, for example) without touching the file,
+	// and pages that are never written stay shared through the page cache.
+	_mappedFileLength = (size_t)fileStatus.st_size;
+	_mappedFile = mmap(NULL, _mappedFileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file);
+	
+	if (_mappedFile == MAP_FAILED) {
+		NSLog(@"Error while loading matrix: could not map the matrix file into memory: %s", strerror(errno));
+		_mappedFile = NULL;
+		[self release];
+		return nil;
+	}
+	
+	const _LNKNativeMatrixHeader *header = _mappedFile;
+	
+	if (!_LNKNativeMatrixHeaderIsValid(header, _mappedFileLength)) {
+		[self release];
+		return nil;
+	}
+	
+	char *const bytes = _mappedFile;
+	_rowCount = header->rowCount;
+	_columnCount = header->columnCount;
+	_hasBiasColumn = (header->flags & _LNKNativeMatrixFlagsHasBiasColumn) != 0;
+	_normalized = (header->flags & _LNKNativeMatrixFlagsNormalized) != 0;
+	_matrix = (LNKFloat *)(bytes + header->matrixOffset);
+	_outputVector = (LNKFloat *)(bytes + header->outputVectorOffset);
+	_columnToMu = (LNKFloat *)(bytes + header->meanVectorOffset);
+	_columnToSD = (LNKFloat *)(bytes + header->standardDeviationVectorOffset);
+	
+	return self;
+}
+
 - (instancetype)initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount prepareBuffers:(BOOL (^)(LNKFloat *, LNKFloat *))preparationBlock {
 	return [self initWithRowCount:rowCount columnCount:columnCount addingOnesColumn:NO prepareBuffers:preparationBlock];
 }
@@ -164,26 +262,73 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	return self;
 }
 
-// This initializer does not make a copy of the matrix data. Rather, it establishes a weak reference.
-- (instancetype)_initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount matrix:(LNKFloat *)matrix prepareOutputBuffer:(BOOL (^)(LNKFloat *))preparationBlock {
+- (instancetype)_initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount hasBiasColumn:(BOOL)hasBiasColumn outputVector:(const LNKFloat *)outputVector {
 	NSParameterAssert(rowCount);
 	NSParameterAssert(columnCount);
-	NSParameterAssert(preparationBlock);
 	
 	if (!(self = [super init]))
 		return nil;
 	
 	_rowCount = rowCount;
 	_columnCount = columnCount;
-	_hasBiasColumn = NO;
+	_hasBiasColumn = hasBiasColumn;
 	
 	[self _allocateBuffersIncludingMatrix:NO];
-	_matrix = matrix;
-	_weakMatrixReference = YES;
 	
-	if (!preparationBlock(_outputVector)) {
-		[self _freeBuffers];
+	if (outputVector)
+		LNKFloatCopy(_outputVector, outputVector, rowCount);
+	else
+		LNK_vclr(_outputVector, UNIT_STRIDE, rowCount);
+	
+	return self;
+}
+
+// Views share the rows of `parent` rather than copying them. They hold the contiguous rows starting at `firstRow`
+// when `rowIndices` is `NULL`, or else the rows at the given indices, in which case the view takes ownership of them.
+// Only the output vector, which takes O(rows) memory, is copied so it can be modified independently.
+- (instancetype)_initViewOfMatrix:(LNKMatrix *)parent rowCount:(LNKSize)rowCount firstRow:(LNKSize)firstRow rowIndices:(LNKSize *)rowIndices {
+	NSParameterAssert(parent);
+	NSParameterAssert(rowCount);
+	NSParameterAssert(rowIndices || firstRow + rowCount <= parent->_rowCount);
+	
+	if (!(self = [super init]))
 		return nil;
+	
+	_rowCount = rowCount;
+	_columnCount = parent->_columnCount;
+	_hasBiasColumn = parent->_hasBiasColumn;
+	_normalized = parent->_normalized;
+	
+	[self _allocateBuffersIncludingMatrix:NO];
+	LNKFloatCopy(_columnToMu, parent->_columnToMu, _columnCount);
+	LNKFloatCopy(_columnToSD, parent->_columnToSD, _columnCount);
+	
+	for (LNKSize row = 0; row < rowCount; row++)
+		_outputVector[row] = parent->_outputVector[rowIndices ? rowIndices[row] : firstRow + row];
+	
+	if (parent->_rowIndices) {
+		// Views of views index straight into the rows they share, so there is never more than one level of indirection.
+		const BOOL contiguous = rowIndices == NULL;
+		
+		if (contiguous)
+			rowIndices = malloc(rowCount * sizeof(LNKSize));
+		
+		for (LNKSize row = 0; row < rowCount; row++)
+			rowIndices[row] = parent->_rowIndices[contiguous ? firstRow + row : rowIndices[row]];
+		
+		_rowBase = parent->_rowBase;
+		_rowIndices = rowIndices;
+		_parent = [parent->_parent retain];
+	}
+	else if (rowIndices) {
+		_rowBase = parent->_matrix;
+		_rowIndices = rowIndices;
+		_parent = [parent retain];
+	}
+	else {
+		_matrix = parent->_matrix + firstRow * _columnCount;
+		_weakMatrixReference = YES;
+		_parent = [parent retain];
 	}
 	
 	return self;
@@ -191,24 +336,34 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 
 - (id)copyWithZone:(NSZone *)zone {
 #pragma unused(zone)
+	return [[LNKMatrix alloc] _initViewOfMatrix:self rowCount:_rowCount firstRow:0 rowIndices:NULL];
+}
 
-	LNKMatrix *const matrix = [[LNKMatrix alloc] _initWithRowCount:_rowCount columnCount:_columnCount matrix:_matrix prepareOutputBuffer:^BOOL(LNKFloat *outputVector) {
-		LNKFloatCopy(outputVector, _outputVector, _rowCount);
-		return YES;
-	}];
+/// Gathers the rows of a view into a buffer of its own the first time contiguous data is needed.
+/// Several threads may race to do so, in which case all but one of them discard their copy.
+- (LNKFloat *)_materializeRows {
+	LNKFloat *matrix = __atomic_load_n(&_matrix, __ATOMIC_ACQUIRE);
 	
-	NSAssert(matrix->_rowCount == _rowCount, @"Incorrect example count");
-	NSAssert(matrix->_columnCount == _columnCount, @"Incorrect column count");
+	if (matrix)
+		return matrix;
 	
-	matrix->_normalized = _normalized;
-	matrix->_hasBiasColumn = _hasBiasColumn;
-	LNKFloatCopy(matrix->_columnToMu, _columnToMu, _columnCount);
-	LNKFloatCopy(matrix->_columnToSD, _columnToSD, _columnCount);
+	LNKFloat *const rows = LNKFloatAlloc(_rowCount * _columnCount);
 	
-	return matrix;
+	for (LNKSize row = 0; row < _rowCount; row++)
+		LNKFloatCopy(rows + row * _columnCount, _rowBase + _rowIndices[row] * _columnCount, _columnCount);
+	
+	if (!__atomic_compare_exchange_n(&_matrix, &matrix, rows, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		free(rows);
+		return matrix;
+	}
+	
+	return rows;
 }
 
 - (const LNKFloat *)matrixBuffer {
+	if (_rowIndices)
+		return [self _materializeRows];
+	
 	return _matrix;
 }
 
@@ -218,6 +373,10 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 
 - (const LNKFloat *)rowAtIndex:(LNKSize)index {
 	NSParameterAssert(index < _rowCount);
+	
+	if (_rowIndices)
+		return _rowBase + _rowIndices[index] * _columnCount;
+	
 	return _matrix + (index * _columnCount);
 }
 
@@ -230,7 +389,7 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 		@throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"The column index is out of bounds" userInfo:nil];
 	}
 
-	return _matrix[row * _columnCount + column];
+	return [self rowAtIndex:row][column];
 }
 
 - (void)clipRowCountTo:(LNKSize)rowCount {
@@ -242,7 +401,7 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	LNKFloat *values = LNKFloatAlloc(_rowCount);
 
 	for (LNKSize index = 0; index < _rowCount; index++) {
-		values[index] = _matrix[index * _columnCount + columnIndex];
+		values[index] = [self rowAtIndex:index][columnIndex];
 	}
 
 	return LNKVectorCreateUnsafe(values, _rowCount);
@@ -263,7 +422,7 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	const LNKSize matrixColumnCount = matrix.columnCount;
 
 	LNKFloat *const result = LNKFloatAlloc(rowCount * matrixColumnCount);
-	LNK_mmul(_matrix, UNIT_STRIDE, matrix.matrixBuffer, UNIT_STRIDE, result, UNIT_STRIDE, rowCount, matrixColumnCount, columnCount);
+	LNK_mmul(self.matrixBuffer, UNIT_STRIDE, matrix.matrixBuffer, UNIT_STRIDE, result, UNIT_STRIDE, rowCount, matrixColumnCount, columnCount);
 
 	return [[[LNKMatrix alloc] initWithRowCount:rowCount columnCount:matrixColumnCount prepareBuffers:^BOOL(LNKFloat *localMatrix, LNKFloat *outputVector) {
 #pragma unused(outputVector)
@@ -278,11 +437,31 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 
 	return [[[LNKMatrix alloc] initWithRowCount:columnCount columnCount:rowCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
 #pragma unused(outputVector)
-		LNK_mtrans(_matrix, matrix, columnCount, rowCount);
+		LNK_mtrans(self.matrixBuffer, matrix, columnCount, rowCount);
 		return YES;
 	}] autorelease];
 }
 
+- (BOOL)isSparse {
+	return NO;
+}
+
+- (void)multiplyByBuffer:(const LNKFloat *)buffer columnCount:(LNKSize)columnCount outputBuffer:(LNKFloat *)outputBuffer {
+	NSParameterAssert(buffer);
+	NSParameterAssert(columnCount);
+	NSParameterAssert(outputBuffer);
+	
+	LNK_mmul(self.matrixBuffer, UNIT_STRIDE, buffer, UNIT_STRIDE, outputBuffer, UNIT_STRIDE, _rowCount, columnCount, _columnCount);
+}
+
+- (void)multiplyTransposeByBuffer:(const LNKFloat *)buffer columnCount:(LNKSize)columnCount outputBuffer:(LNKFloat *)outputBuffer {
+	NSParameterAssert(buffer);
+	NSParameterAssert(columnCount);
+	NSParameterAssert(outputBuffer);
+	
+	LNK_mmultrans(self.matrixBuffer, buffer, outputBuffer, _columnCount, columnCount, _rowCount);
+}
+
 - (LNKMatrix *)covarianceMatrix {
 	if (!self.normalized) {
 		@throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"Only covariance of normalized matrices is supported" userInfo:nil];
@@ -292,11 +471,8 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 #pragma unused(outputVector)
 
 		// S = 1/m X' X
-		LNKFloat *const transposeMatrix = LNKFloatAlloc(_columnCount * _rowCount);
-		LNK_mtrans(_matrix, transposeMatrix, _columnCount, _rowCount);
-
-		LNK_mmul(transposeMatrix, UNIT_STRIDE, _matrix, UNIT_STRIDE, matrix, UNIT_STRIDE, _columnCount, _columnCount, _rowCount);
-		free(transposeMatrix);
+		const LNKFloat *const matrixBuffer = self.matrixBuffer;
+		LNK_mmultrans(matrixBuffer, matrixBuffer, matrix, _columnCount, _columnCount, _rowCount);
 
 		const LNKFloat m = (LNKFloat)_rowCount;
 		LNK_vsdiv(matrix, UNIT_STRIDE, &m, matrix, UNIT_STRIDE, _columnCount * _columnCount);
@@ -314,29 +490,8 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	return [[[LNKMatrix alloc] initWithRowCount:_columnCount columnCount:_columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
 #pragma unused(outputVector)
 
-		LNKFloatCopy(matrix, _matrix, _columnCount * _columnCount);
-
-		__CLPK_integer error = 0;
-		__CLPK_integer *const pivot = malloc(_columnCount * sizeof(__CLPK_integer));
-		__CLPK_doublereal *const workspace = malloc(_columnCount * sizeof(__CLPK_doublereal));
-
-		// Factorization
-		__CLPK_integer N = (__CLPK_integer)_columnCount;
-		dgetrf_(&N, &N, matrix, &N, pivot, &error);
-
-		if (error != 0) {
-			free(pivot);
-			free(workspace);
-			return NO;
-		}
-
-		// Inversion
-		dgetri_(&N, matrix, &N, pivot, workspace, &N, &error);
-
-		free(pivot);
-		free(workspace);
-
-		return (error == 0);
+		LNKFloatCopy(matrix, self.matrixBuffer, _columnCount * _columnCount);
+		return LNK_minvert(matrix, _columnCount);
 	}] autorelease];
 }
 
@@ -351,12 +506,13 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 		return NO;
 	}
 
+	const LNKFloat *buffer = self.matrixBuffer;
 	const LNKFloat *otherBuffer = otherMatrix.matrixBuffer;
 	const LNKSize items = _rowCount * _columnCount;
 	const LNKFloat threshold = 0.0001;
 
 	for (LNKSize i = 0; i < items; i++) {
-		if (LNK_fabs(_matrix[i] - otherBuffer[i]) > threshold) {
+		if (LNK_fabs(buffer[i] - otherBuffer[i]) > threshold) {
 			return NO;
 		}
 	}
@@ -413,20 +569,8 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	if (rowCount > _rowCount)
 		[NSException raise:NSInvalidArgumentException format:@"The number of examples in the submatrix cannot be greater than the number of examples in the current matrix"];
 	
-	return [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:_columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
-		LNKSize *const indices = [self _shuffleIndices];
-		
-		for (LNKSize index = 0; index < rowCount; index++) {
-			const LNKSize actualIndex = indices[index];
-			
-			outputVector[index] = _outputVector[actualIndex];
-			LNKFloatCopy(matrix + index * _columnCount, _matrix + actualIndex * _columnCount, _columnCount);
-		}
-		
-		free(indices);
-		
-		return YES;
-	}];
+	// Only the first `rowCount` shuffled indices are used; the view takes ownership of them.
+	return [[LNKMatrix alloc] _initViewOfMatrix:self rowCount:rowCount firstRow:0 rowIndices:[self _shuffleIndices]];
 }
 
 - (void)splitIntoTrainingMatrix:(LNKMatrix **)trainingMatrix testMatrix:(LNKMatrix **)testMatrix trainingBias:(LNKFloat)trainingBias {
@@ -434,28 +578,20 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	const LNKSize trainingSize = rowCount * trainingBias;
 	const LNKSize testSize = rowCount - trainingSize;
 
-	LNKMatrix *const shuffledMatrix = [self copyShuffledMatrix];
-	*trainingMatrix = [shuffledMatrix submatrixWithRowRange:NSMakeRange(0, trainingSize)];
-	*testMatrix = [shuffledMatrix submatrixWithRowRange:NSMakeRange(trainingSize, testSize)];
+	// Both halves are views over the same rows in a shuffled order.
+	LNKSize *const indices = [self _shuffleIndices];
+	LNKSize *const testIndices = malloc(sizeof(LNKSize) * testSize);
+	memcpy(testIndices, indices + trainingSize, sizeof(LNKSize) * testSize);
 
-	[shuffledMatrix release];
+	*trainingMatrix = [[[LNKMatrix alloc] _initViewOfMatrix:self rowCount:trainingSize firstRow:0 rowIndices:indices] autorelease];
+	*testMatrix = [[[LNKMatrix alloc] _initViewOfMatrix:self rowCount:testSize firstRow:0 rowIndices:testIndices] autorelease];
 }
 
 - (LNKMatrix *)submatrixWithRowRange:(NSRange)range {
-	const LNKSize columnCount = self.columnCount;
-
-	LNKMatrix *const submatrix = [[LNKMatrix alloc] initWithRowCount:range.length columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
-		for (LNKSize example = range.location; example < NSMaxRange(range); example++) {
-			const LNKFloat *inputExample = [self rowAtIndex:example];
-			LNKFloatCopy(matrix + (example - range.location) * columnCount, inputExample, columnCount);
-
-			outputVector[example - range.location] = _outputVector[example];
-		}
-
-		return YES;
-	}];
-
-	return [submatrix autorelease];
+	if (NSMaxRange(range) > _rowCount)
+		[NSException raise:NSInvalidArgumentException format:@"The row range is out of bounds"];
+	
+	return [[[LNKMatrix alloc] _initViewOfMatrix:self rowCount:range.length firstRow:range.location rowIndices:NULL] autorelease];
 }
 
 - (LNKMatrix *)submatrixWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount {
@@ -507,12 +643,19 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 }
 
 - (void)_freeBuffers {
+	if (_mappedFile) {
+		munmap(_mappedFile, _mappedFileLength);
+		return;
+	}
+	
 	if (!_weakMatrixReference)
 		free(_matrix);
 	
 	free(_outputVector);
 	free(_columnToMu);
 	free(_columnToSD);
+	free(_rowIndices);
+	[_parent release];
 }
 
 - (void)dealloc {
@@ -534,8 +677,10 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 		columnToMu[0] = 0;
 	}
 	
+	const LNKFloat *const matrixBuffer = self.matrixBuffer;
+	
 	for (LNKSize n = _hasBiasColumn; n < _columnCount; n++) {
-		LNKFloat *const columnPointer = _matrix + n;
+		const LNKFloat *const columnPointer = matrixBuffer + n;
 		
 		LNKFloat mean;
 		LNK_vmean(columnPointer, _columnCount, &mean, _rowCount);
@@ -562,7 +707,7 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 	NSParameterAssert(sdVector);
 
 	LNKMatrix *const normalizedMatrix = [[LNKMatrix alloc] initWithRowCount:_rowCount columnCount:_columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
-		LNKFloatCopy(matrix, _matrix, _columnCount * _rowCount);
+		LNKFloatCopy(matrix, self.matrixBuffer, _columnCount * _rowCount);
 		LNKFloatCopy(outputVector, _outputVector, _rowCount);
 		return YES;
 	}];
@@ -618,7 +763,7 @@ static LNKSize _sizeOfLNKValueType(LNKValueType type) {
 }
 
 - (void)printMatrix {
-	LNKPrintMatrix("Matrix", _matrix, _rowCount, _columnCount);
+	LNKPrintMatrix("Matrix", self.matrixBuffer, _rowCount, _columnCount);
 }
 
 - (void)printOutputVector {
@@ -19,6 +19,7 @@ NS_ASSUME_NONNULL_BEGIN
 - (nullable instancetype)initWithCSVFileAtURL:(NSURL *)url delimiter:(unichar)delimiter;
 
 /// Columns may be deleted or transformed (e.g. mapping strings representing categorical data to numerical entries) by passing a dictionary of preprocessing rules, indexed by the column index.
+/// The file is parsed in parallel, so conversion handlers may be called from several threads at once. The delimiter must be an ASCII character.
 - (nullable instancetype)initWithCSVFileAtURL:(NSURL *)url delimiter:(unichar)delimiter ignoringHeader:(BOOL)ignoreHeader columnPreprocessingRules:(NSDictionary<NSNumber *, LNKCSVColumnRule *> *)preprocessingRules;
 
 @end
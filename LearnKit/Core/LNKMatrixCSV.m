@@ -9,7 +9,151 @@
 
 #import "LNKAccelerate.h"
 #import "LNKCSVColumnRule.h"
-#import "LNKFastObjects.h"
+#import "LNKExecutor.h"
+
+/// Files are split into chunks of about this many bytes, cut at line boundaries, which are then parsed in parallel.
+#define CHUNK_SIZE			(1 << 20)
+
+/// Fields shorter than this are parsed from a copy on the stack.
+#define FIELD_BUFFER_SIZE	128
+
+#define COLUMN_DELETED		LNKSizeMax
+#define COLUMN_OUTPUT		(LNKSizeMax - 1)
+
+/// What to do with every column of the file, resolved once from the preprocessing rules.
+typedef struct {
+	LNKSize fileColumnCount;
+	LNKSize columnCount;
+	/// The matrix column each file column goes to, `COLUMN_OUTPUT` or `COLUMN_DELETED`.
+	LNKSize *targets;
+	/// The conversion handler of each file column, if any. The rules dictionary keeps them alive.
+	LNKCSVColumnRuleTypeConversionHandler *handlers;
+} _LNKCSVColumnPlan;
+
+static BOOL _LNKIsLineTerminator(char character) {
+	return character == '\n' || character == '\r';
+}
+
+/// Returns the end of the line starting at `cursor`.
+static const char *_LNKCSVLineEnd(const char *cursor, const char *end) {
+	while (cursor < end && !_LNKIsLineTerminator(*cursor))
+		cursor++;
+
+	return cursor;
+}
+
+/// Returns the start of the line following the one ending at `lineEnd`.
+static const char *_LNKCSVNextLine(const char *lineEnd, const char *end) {
+	return lineEnd < end ? lineEnd + 1 : end;
+}
+
+/// Splits a line into its non-empty fields and returns how many there are. Only the first `capacity` fields are stored.
+/// Delimiters between double quotes do not end fields, and quotes are kept as part of the field.
+static LNKSize _LNKCSVSplitLine(const char *line, const char *lineEnd, char delimiter, const char **fieldStarts, LNKSize *fieldLengths, LNKSize capacity) {
+	LNKSize fieldCount = 0;
+	const char *fieldStart = line;
+	BOOL inQuotes = NO;
+
+	for (const char *cursor = line; cursor <= lineEnd; cursor++) {
+		if (cursor == lineEnd || (*cursor == delimiter && !inQuotes)) {
+			if (cursor > fieldStart) {
+				if (fieldCount < capacity) {
+					fieldStarts[fieldCount] = fieldStart;
+					fieldLengths[fieldCount] = (LNKSize)(cursor - fieldStart);
+				}
+
+				fieldCount++;
+			}
+
+			fieldStart = cursor + 1;
+		} else if (*cursor == '"' && (cursor == line || cursor[-1] != '\\')) {
+			inQuotes = !inQuotes;
+		}
+	}
+
+	return fieldCount;
+}
+
+/// Mapped files are not null-terminated, so fields are copied before they are parsed.
+static LNKFloat _LNKCSVParseField(const char *field, LNKSize length) {
+	char buffer[FIELD_BUFFER_SIZE];
+	char *string = length < FIELD_BUFFER_SIZE ? buffer : malloc(length + 1);
+	memcpy(string, field, length);
+	string[length] = '\0';
+
+	const LNKFloat value = LNK_strtoflt(string);
+
+	if (string != buffer)
+		free(string);
+
+	return value;
+}
+
+static LNKFloat _LNKCSVConvertField(LNKCSVColumnRuleTypeConversionHandler handler, const char *field, LNKSize length) {
+	NSString *string = [[NSString alloc] initWithBytes:field length:length encoding:NSUTF8StringEncoding];
+	const LNKFloat value = handler(string);
+	[string release];
+
+	return value;
+}
+
+static BOOL _LNKCSVColumnPlanPrepare(_LNKCSVColumnPlan *plan, LNKSize fileColumnCount, NSDictionary<NSNumber *, LNKCSVColumnRule *> *preprocessingRules) {
+	plan->fileColumnCount = fileColumnCount;
+	plan->targets = malloc(fileColumnCount * sizeof(LNKSize));
+	plan->handlers = calloc(fileColumnCount, sizeof(LNKCSVColumnRuleTypeConversionHandler));
+
+	// The last column contains the output vector unless a rule says otherwise.
+	LNKSize outputColumnIndex = fileColumnCount - 1;
+
+	for (LNKSize column = 0; column < fileColumnCount; column++)
+		plan->targets[column] = 0;
+
+	for (NSNumber *key in preprocessingRules) {
+		const LNKSize column = key.LNKSizeValue;
+		LNKCSVColumnRule *rule = preprocessingRules[key];
+
+		if (column >= fileColumnCount)
+			continue;
+
+		switch (rule.type) {
+			case LNKCSVColumnRuleTypeDelete:
+				plan->targets[column] = COLUMN_DELETED;
+				break;
+			case LNKCSVColumnRuleTypeConversion:
+				NSCAssert(rule.object != nil, @"Conversions should always have a handler");
+				plan->handlers[column] = rule.object;
+				break;
+			case LNKCSVColumnRuleTypeOutput:
+				outputColumnIndex = column;
+				break;
+		}
+	}
+
+	if (plan->targets[outputColumnIndex] == COLUMN_DELETED) {
+		NSLog(@"Error while loading the matrix: the output column cannot be deleted");
+		return NO;
+	}
+
+	plan->targets[outputColumnIndex] = COLUMN_OUTPUT;
+	plan->columnCount = 0;
+
+	for (LNKSize column = 0; column < fileColumnCount; column++) {
+		if (plan->targets[column] != COLUMN_DELETED && plan->targets[column] != COLUMN_OUTPUT)
+			plan->targets[column] = plan->columnCount++;
+	}
+
+	if (plan->columnCount == 0) {
+		NSLog(@"Error while loading matrix: the matrix must have at least one column besides the output column");
+		return NO;
+	}
+
+	return YES;
+}
+
+static void _LNKCSVColumnPlanFree(_LNKCSVColumnPlan *plan) {
+	free(plan->targets);
+	free(plan->handlers);
+}
 
 @implementation LNKMatrix (CSV)
 
@@ -26,6 +170,10 @@
 		[NSException raise:NSInvalidArgumentException format:@"The dictionary of preprocessing rules must not be nil"];
 	}
 
+	if (delimiter > 127) {
+		[NSException raise:NSInvalidArgumentException format:@"The delimiter must be an ASCII character"];
+	}
+
 	NSParameterAssert(url);
 
 	if (!(self = [super init])) {
@@ -33,198 +181,174 @@
 	}
 
 	NSError *error = nil;
-	NSString *stringContents = [[NSString alloc] initWithContentsOfURL:url encoding:NSUTF8StringEncoding error:&error];
+	NSData *data = [[NSData alloc] initWithContentsOfURL:url options:NSDataReadingMappedAlways error:&error];
 
-	if (!stringContents) {
+	if (!data) {
 		NSLog(@"Error while loading matrix: could not load the file at the given URL: %@", error);
+		[self release];
 		return nil;
 	}
 
-	LNKFastArrayRef lines = [self _parseRawLinesAndElementsForString:stringContents delimiter:delimiter];
-	[stringContents release];
-
-	if (LNKFastArrayObjectCount(lines) == 0) {
-		NSLog(@"Error while loading matrix: the matrix does not contain any examples");
-		return nil;
-	}
+	const char *start = data.bytes;
+	const char *const end = start + data.length;
+	const char fieldDelimiter = (char)delimiter;
 
-	LNKFastArrayRef firstLine = (LNKFastArrayRef)LNKFastArrayObjectAtIndex(lines, 0);
-	const LNKSize firstLineColumns = LNKFastArrayObjectCount(firstLine);
-	__block LNKSize deletedColumns = 0;
+	// Skip the UTF-8 byte order mark.
+	if (data.length >= 3 && memcmp(start, "\xEF\xBB\xBF", 3) == 0)
+		start += 3;
 
-	[preprocessingRules enumerateKeysAndObjectsUsingBlock:^(NSNumber *column, LNKCSVColumnRule *rule, BOOL *stop) {
-#pragma unused(stop)
-		if (rule.type == LNKCSVColumnRuleTypeDelete && column.LNKSizeValue < firstLineColumns) {
-			deletedColumns += 1;
-		}
-	}];
+	// The first non-empty line determines the number of columns, whether or not it is a header.
+	LNKSize fileColumnCount = 0;
+	const char *firstLine = start;
 
-	const LNKSize lineCount = LNKFastArrayObjectCount(lines);
-	const LNKSize startRow = (ignoreHeader ? 1 : 0);
+	while (firstLine < end) {
+		const char *lineEnd = _LNKCSVLineEnd(firstLine, end);
+		fileColumnCount = _LNKCSVSplitLine(firstLine, lineEnd, fieldDelimiter, NULL, NULL, 0);
 
-	const LNKSize rowCount = ignoreHeader ? lineCount - 1 : lineCount;
+		if (fileColumnCount)
+			break;
 
-	// The matrix's column count does not include the output vector, but should include the optional ones column.
-	const LNKSize columnCount = firstLineColumns - 1 - deletedColumns;
+		firstLine = _LNKCSVNextLine(lineEnd, end);
+	}
 
-	self = [self initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
-		LNKSize localRow = 0;
-
-		for (LNKSize m = startRow; m < lineCount; m++) {
-			// The last column contains the output vector.
-			LNKFastArrayRef line = (LNKFastArrayRef)LNKFastArrayObjectAtIndex(lines, m);
-			const LNKSize ruleOutputColumnIndex = [self _outputColumnIndexForColumnPreprocessingRules:preprocessingRules];
-			const LNKSize outputColumnIndex = ruleOutputColumnIndex == LNKSizeMax ? firstLineColumns - 1 : ruleOutputColumnIndex;
-			LNKFastStringRef outputString = (LNKFastStringRef)LNKFastArrayObjectAtIndex(line, outputColumnIndex);
-
-			LNKCSVColumnRule *outputRule = preprocessingRules[@(outputColumnIndex)];
-			if (outputRule && outputRule.type == LNKCSVColumnRuleTypeConversion) {
-				LNKCSVColumnRuleTypeConversionHandler handler = outputRule.object;
-				NSAssert(handler != nil, @"Conversions should always have a handler");
-
-				outputVector[localRow] = handler([NSString stringWithUTF8String:LNKFastStringGetUTF8String(outputString)]);
-			} else if (outputRule && outputRule.type == LNKCSVColumnRuleTypeDelete) {
-				NSLog(@"Error while loading the matrix: the output column cannot be deleted");
-				return NO;
-			} else {
-				outputVector[localRow] = LNK_strtoflt(LNKFastStringGetUTF8String(outputString));
-			}
+	if (fileColumnCount < 2) {
+		NSLog(@"Error while loading matrix: the matrix must have at least two columns");
+		[data release];
+		[self release];
+		return nil;
+	}
 
-			LNKSize localColumn = 0;
+	const char *const dataStart = ignoreHeader ? _LNKCSVNextLine(_LNKCSVLineEnd(firstLine, end), end) : firstLine;
 
-			// Ignore the last column since it's actually our output vector.
-			for (LNKSize n = 0; n < firstLineColumns; n++) {
-				if (n == outputColumnIndex) {
-					// Skip the output column, but continue because it's not necessarily the last one!
-					continue;
-				}
+	_LNKCSVColumnPlan plan;
 
-				LNKFastStringRef columnString = (LNKFastStringRef)LNKFastArrayObjectAtIndex(line, n);
+	if (!_LNKCSVColumnPlanPrepare(&plan, fileColumnCount, preprocessingRules)) {
+		_LNKCSVColumnPlanFree(&plan);
+		[data release];
+		[self release];
+		return nil;
+	}
 
-				LNKCSVColumnRule *outputRule = preprocessingRules[@(n)];
-				if (outputRule && outputRule.type == LNKCSVColumnRuleTypeConversion) {
-					LNKCSVColumnRuleTypeConversionHandler handler = outputRule.object;
-					NSAssert(handler != nil, @"Conversions should always have a handler");
+	// Cut the file into chunks that start at the beginning of a line.
+	const LNKSize chunkCount = MAX(1, (LNKSize)(end - dataStart) / CHUNK_SIZE);
+	const char **chunkStarts = malloc((chunkCount + 1) * sizeof(const char *));
+	chunkStarts[0] = dataStart;
+	chunkStarts[chunkCount] = end;
 
-					matrix[localRow * columnCount + localColumn] = handler([NSString stringWithUTF8String:LNKFastStringGetUTF8String(columnString)]);
-					localColumn += 1;
-				} else if (outputRule && outputRule.type == LNKCSVColumnRuleTypeDelete) {
-					// Skips to the next column without storing anything.
-				} else {
-					matrix[localRow * columnCount + localColumn] = LNK_strtoflt(LNKFastStringGetUTF8String(columnString));
-					localColumn += 1;
-				}
-			}
-			
-			localRow++;
-		}
+	for (LNKSize chunk = 1; chunk < chunkCount; chunk++) {
+		const char *cursor = MAX(chunkStarts[chunk - 1], dataStart + chunk * CHUNK_SIZE);
 
-		return YES;
-	}];
+		if (cursor > dataStart && !_LNKIsLineTerminator(cursor[-1]))
+			cursor = _LNKCSVNextLine(_LNKCSVLineEnd(cursor, end), end);
 
-	LNKFastArrayRelease(lines);
+		chunkStarts[chunk] = cursor;
+	}
 
-	return self;
-}
+	// The first pass counts and validates the rows of every chunk so the second one knows where to put them.
+	LNKSize *chunkRowOffsets = malloc((chunkCount + 1) * sizeof(LNKSize));
+	__block BOOL inconsistentColumns = NO;
 
-- (LNKSize)_outputColumnIndexForColumnPreprocessingRules:(NSDictionary<NSNumber *, LNKCSVColumnRule *> *)rules {
-	__block LNKSize outputColumnIndex = LNKSizeMax;
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, chunkCount), 1, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		for (LNKSize chunk = range.location; chunk < range.location + range.length; chunk++) {
+			const char *const chunkEnd = chunkStarts[chunk + 1];
+			LNKSize rowCount = 0;
 
-	[rules enumerateKeysAndObjectsUsingBlock:^(NSNumber *key, LNKCSVColumnRule *obj, BOOL *stop) {
-		if (obj.type == LNKCSVColumnRuleTypeOutput) {
-			outputColumnIndex = key.LNKSizeValue;
-			*stop = YES;
-		}
-	}];
+			for (const char *line = chunkStarts[chunk]; line < chunkEnd;) {
+				const char *lineEnd = _LNKCSVLineEnd(line, chunkEnd);
+				const LNKSize fieldCount = _LNKCSVSplitLine(line, lineEnd, fieldDelimiter, NULL, NULL, 0);
 
-	return outputColumnIndex;
-}
+				if (fieldCount) {
+					if (fieldCount != fileColumnCount)
+						inconsistentColumns = YES;
 
-// The result must be memory-managed by the caller.
-- (LNKFastArrayRef)_parseLine:(NSString *)line delimiter:(unichar)delimiter {
-	LNKFastArrayRef currentLine = LNKFastArrayCreate();
-	const NSUInteger stringLength = line.length;
-	const char *const rawString = line.UTF8String;
+					rowCount++;
+				}
 
-	NSUInteger startIndex = NSNotFound;
-	BOOL inQuotes = NO;
+				line = _LNKCSVNextLine(lineEnd, chunkEnd);
+			}
 
-	for (NSUInteger n = 0; n < stringLength+1 /* one past to indicate EOL */; n++) {
-		if (startIndex == NSNotFound) {
-			startIndex = n;
+			chunkRowOffsets[chunk + 1] = rowCount;
 		}
+	});
 
-		if (n == stringLength || (rawString[n] == delimiter && !inQuotes)) {
-			LNKSize length = n - startIndex;
+	chunkRowOffsets[0] = 0;
 
-			if (length > 0) {
-				LNKFastStringRef string = LNKFastStringCreateWithUTF8String(rawString + startIndex, length);
-				LNKFastArrayAddFastObject(currentLine, (LNKFastObjectRef)string);
-				LNKFastObjectRelease((LNKFastObjectRef)string);
-			}
+	for (LNKSize chunk = 0; chunk < chunkCount; chunk++)
+		chunkRowOffsets[chunk + 1] += chunkRowOffsets[chunk];
 
-			startIndex = NSNotFound;
-		} else if (rawString[n] == '"') {
-			if (n == 0 || rawString[n-1] != '\\') {
-				inQuotes = !inQuotes;
-			}
-		}
-	}
+	const LNKSize rowCount = chunkRowOffsets[chunkCount];
+	const LNKSize columnCount = plan.columnCount;
 
-	if (LNKFastArrayObjectCount(currentLine) == 0) {
-		LNKFastArrayRelease(currentLine);
-		return NULL;
+	if (inconsistentColumns || rowCount == 0) {
+		if (inconsistentColumns)
+			NSLog(@"Error while loading matrix: lines have varying numbers of columns");
+		else
+			NSLog(@"Error while loading matrix: the matrix does not contain any examples");
+
+		free(chunkRowOffsets);
+		free(chunkStarts);
+		_LNKCSVColumnPlanFree(&plan);
+		[data release];
+		[self release];
+		return nil;
 	}
 
-	return currentLine;
-}
+	// The second pass parses every chunk straight into its rows.
+	self = [self initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, chunkCount), 1, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+			const char **fieldStarts = malloc(fileColumnCount * sizeof(const char *));
+			LNKSize *fieldLengths = malloc(fileColumnCount * sizeof(LNKSize));
 
-// The result must be memory-managed by the caller.
-- (LNKFastArrayRef)_parseRawLinesAndElementsForString:(NSString *)string delimiter:(unichar)delimiter {
-	__block LNKSize fileColumnCount = LNKSizeMax;
-	LNKFastArrayRef lines = LNKFastArrayCreate();
+			for (LNKSize chunk = range.location; chunk < range.location + range.length; chunk++) {
+				@autoreleasepool {
+					const char *const chunkEnd = chunkStarts[chunk + 1];
+					LNKSize row = chunkRowOffsets[chunk];
 
-	__block BOOL failed = NO;
+					for (const char *line = chunkStarts[chunk]; line < chunkEnd;) {
+						const char *lineEnd = _LNKCSVLineEnd(line, chunkEnd);
 
-	[string enumerateLinesUsingBlock:^(NSString *line, BOOL *stop) {
-		LNKFastArrayRef currentLine = [self _parseLine:line delimiter:delimiter];
-		if (currentLine == NULL) {
-			return;
-		}
+						if (_LNKCSVSplitLine(line, lineEnd, fieldDelimiter, fieldStarts, fieldLengths, fileColumnCount)) {
+							LNKFloat *const matrixRow = matrix + row * columnCount;
+
+							for (LNKSize column = 0; column < fileColumnCount; column++) {
+								const LNKSize target = plan.targets[column];
+
+								if (target == COLUMN_DELETED)
+									continue;
 
-		if (fileColumnCount == LNKSizeMax) {
-			fileColumnCount = LNKFastArrayObjectCount(currentLine);
+								LNKCSVColumnRuleTypeConversionHandler handler = plan.handlers[column];
+								const LNKFloat value = handler ? _LNKCSVConvertField(handler, fieldStarts[column], fieldLengths[column])
+															   : _LNKCSVParseField(fieldStarts[column], fieldLengths[column]);
 
-			if (fileColumnCount < 2) {
-				NSLog(@"Error while loading matrix: the matrix must have at least two columns");
-				failed = YES;
-				*stop = YES;
-				return;
+								if (target == COLUMN_OUTPUT)
+									outputVector[row] = value;
+								else
+									matrixRow[target] = value;
+							}
+
+							row++;
+						}
+
+						line = _LNKCSVNextLine(lineEnd, chunkEnd);
+					}
+				}
 			}
-		}
-		else if (fileColumnCount != LNKFastArrayObjectCount(currentLine)) {
-			NSLog(@"Error while loading matrix: lines have varying numbers of columns");
-			failed = YES;
-			*stop = YES;
-			return;
-		}
 
-		LNKFastArrayAddFastObject(lines, (LNKFastObjectRef)currentLine);
-		LNKFastArrayRelease(currentLine);
-	}];
+			free(fieldLengths);
+			free(fieldStarts);
+		});
 
-	if (failed) {
-		LNKFastArrayRelease(lines);
-		return NULL;
-	}
+		return YES;
+	}];
 
-	if (fileColumnCount == LNKSizeMax) {
-		NSLog(@"Error while loading matrix: the matrix does not contain any columns");
-		LNKFastArrayRelease(lines);
-		return NULL;
-	}
+	free(chunkRowOffsets);
+	free(chunkStarts);
+	_LNKCSVColumnPlanFree(&plan);
+	[data release];
 
-	return lines;
+	return self;
 }
 
 @end
@@ -13,6 +13,10 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (BOOL)writeCSVDataToURL:(NSURL *)url error:(NSError **)outError;
 
+/// Writes the matrix, output vector, normalization vectors and bias column flag in LearnKit's native format,
+/// which can be loaded without copying with `-initWithNativeMatrixAtURL:`.
+- (BOOL)writeNativeDataToURL:(NSURL *)url error:(NSError **)outError;
+
 @end
 
 NS_ASSUME_NONNULL_END
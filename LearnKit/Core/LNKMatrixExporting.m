@@ -7,6 +7,9 @@
 
 #import "LNKMatrixExporting.h"
 
+#import "LNKAccelerate.h"
+#import "LNKMatrixPrivate.h"
+
 @implementation LNKMatrix (Exporting)
 
 - (BOOL)writeCSVDataToURL:(NSURL *)url error:(NSError **)outError {
@@ -39,4 +42,79 @@
 	return YES;
 }
 
+static BOOL _LNKWriteSection(FILE *file, uint64_t *position, uint64_t offset, const void *bytes, uint64_t length) {
+	static const char padding[_LNK_NATIVE_MATRIX_ALIGNMENT] = { 0 };
+	NSCAssert(offset >= *position && offset - *position <= sizeof(padding), @"Sections must be written in order");
+	
+	const size_t paddingLength = (size_t)(offset - *position);
+	
+	if (fwrite(padding, 1, paddingLength, file) != paddingLength || fwrite(bytes, 1, (size_t)length, file) != length)
+		return NO;
+	
+	*position = offset + length;
+	return YES;
+}
+
+- (BOOL)writeNativeDataToURL:(NSURL *)url error:(NSError **)outError {
+	if (!url)
+		[NSException raise:NSInvalidArgumentException format:@"The url must not be nil"];
+	
+	const LNKSize rowCount = self.rowCount;
+	const LNKSize columnCount = self.columnCount;
+	
+	_LNKNativeMatrixHeader header = { .version = _LNK_NATIVE_MATRIX_VERSION, .byteOrder = _LNK_NATIVE_MATRIX_BYTE_ORDER,
+									  .valueSize = sizeof(LNKFloat), .rowCount = rowCount, .columnCount = columnCount };
+	memcpy(header.magic, _LNK_NATIVE_MATRIX_MAGIC, sizeof(header.magic));
+	
+	if (self.hasBiasColumn)
+		header.flags |= _LNKNativeMatrixFlagsHasBiasColumn;
+	
+	if (self.normalized)
+		header.flags |= _LNKNativeMatrixFlagsNormalized;
+	
+	_LNKNativeMatrixLayout(&header);
+	
+	// Matrices that have not been normalized get an identity transformation, which is what the bias column uses.
+	LNKFloat *meanVector = NULL, *sdVector = NULL;
+	
+	if (!self.normalized) {
+		const LNKFloat one = 1;
+		meanVector = LNKFloatCalloc(columnCount);
+		sdVector = LNKFloatAlloc(columnCount);
+		LNK_vfill(&one, sdVector, UNIT_STRIDE, columnCount);
+	}
+	
+	FILE *file = fopen(url.fileSystemRepresentation, "wb");
+	BOOL success = file != NULL;
+	uint64_t position = 0;
+	
+	success = success && _LNKWriteSection(file, &position, 0, &header, sizeof(header));
+	success = success && _LNKWriteSection(file, &position, header.matrixOffset, self.matrixBuffer, rowCount * columnCount * sizeof(LNKFloat));
+	success = success && _LNKWriteSection(file, &position, header.outputVectorOffset, self.outputVector, rowCount * sizeof(LNKFloat));
+	success = success && _LNKWriteSection(file, &position, header.meanVectorOffset, meanVector ?: self.normalizationMeanVector, columnCount * sizeof(LNKFloat));
+	success = success && _LNKWriteSection(file, &position, header.standardDeviationVectorOffset, sdVector ?: self.normalizationStandardDeviationVector, columnCount * sizeof(LNKFloat));
+	
+	int writeError = success ? 0 : errno;
+	
+	if (file && fclose(file) && success) {
+		writeError = errno;
+		success = NO;
+	}
+	
+	free(meanVector);
+	free(sdVector);
+	
+	if (!success) {
+		if (file)
+			unlink(url.fileSystemRepresentation);
+		
+		if (outError)
+			*outError = [NSError errorWithDomain:NSPOSIXErrorDomain code:writeError userInfo:nil];
+		
+		return NO;
+	}
+	
+	return YES;
+}
+
 @end
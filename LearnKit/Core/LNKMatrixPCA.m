@@ -56,29 +56,15 @@
 	LNKMatrix *const covarianceMatrix = [workingMatrix.covarianceMatrix retain];
 	const LNKFloat *const sigmaMatrix = covarianceMatrix.matrixBuffer;
 
-	__CLPK_integer columnCountCLPK = (__CLPK_integer)columnCount;
-	__CLPK_integer info = 0;
+	LNKFloat *const s = LNKFloatAlloc(columnCount * columnCount);
+	LNKFloat *const vt = LNKFloatAlloc(columnCount * columnCount);
 
-	LNKFloat *const s = LNKFloatAlloc(columnCountCLPK * columnCountCLPK);
-	LNKFloat *const vt = LNKFloatAlloc(columnCountCLPK * columnCountCLPK);
-
-	// We'll compute this dynamically!
-	__CLPK_integer workSize = -1;
-	LNKFloat workOptimal = 0;
-
-	// The first pass computes work sizes.
-	dgesvd_("N", "A", &columnCountCLPK, &columnCountCLPK, (/* const */ __CLPK_doublereal *)sigmaMatrix, &columnCountCLPK, s, NULL, &columnCountCLPK, vt, &columnCountCLPK, &workOptimal, &workSize, &info);
-
-	workSize = (__CLPK_integer)workOptimal;
-	LNKFloat *const work = LNKFloatAlloc(workSize);
-
-	// The second pass to decomposes the covariance matrix into eigenvectors and eigenvalues.
-	const int result = dgesvd_("N", "A", &columnCountCLPK, &columnCountCLPK, (/* const */ __CLPK_doublereal *)sigmaMatrix, &columnCountCLPK, s, NULL, &columnCountCLPK, vt, &columnCountCLPK, work, &workSize, &info);
-	free(work);
+	// Decompose the covariance matrix into eigenvectors and eigenvalues.
+	const BOOL result = LNK_msvd(sigmaMatrix, columnCount, s, vt);
 	[covarianceMatrix release];
 
-	if (result != 0) {
-		NSLog(@"%s: Singular value decomposition could not be performed (%d)", __PRETTY_FUNCTION__, result);
+	if (!result) {
+		NSLog(@"%s: Singular value decomposition could not be performed", __PRETTY_FUNCTION__);
 		free(s);
 		free(vt);
 		[workingMatrix release];
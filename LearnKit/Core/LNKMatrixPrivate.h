@@ -7,10 +7,55 @@
 
 #define _ROW_IN_MATRIX_BUFFER(index) (matrixBuffer + (index) * columnCount)
 
+/// Native on-disk matrices start with this header, followed by the row-major matrix, the output vector and the
+/// normalization mean and standard deviation vectors at the given offsets. Every section is aligned to
+/// `_LNK_NATIVE_MATRIX_ALIGNMENT` bytes so it can be used in place once the file is mapped into memory.
+#define _LNK_NATIVE_MATRIX_MAGIC		"LNKMATRX"
+#define _LNK_NATIVE_MATRIX_VERSION		1
+#define _LNK_NATIVE_MATRIX_BYTE_ORDER	0x01020304
+#define _LNK_NATIVE_MATRIX_ALIGNMENT	64
+
+typedef NS_OPTIONS(uint32_t, _LNKNativeMatrixFlags) {
+	_LNKNativeMatrixFlagsHasBiasColumn	= 1 << 0,
+	_LNKNativeMatrixFlagsNormalized		= 1 << 1
+};
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t valueSize;
+	_LNKNativeMatrixFlags flags;
+	uint64_t rowCount;
+	uint64_t columnCount;
+	uint64_t matrixOffset;
+	uint64_t outputVectorOffset;
+	uint64_t meanVectorOffset;
+	uint64_t standardDeviationVectorOffset;
+} _LNKNativeMatrixHeader;
+
+NS_INLINE uint64_t _LNKNativeMatrixAlign(uint64_t offset) {
+	return (offset + _LNK_NATIVE_MATRIX_ALIGNMENT - 1) & ~(uint64_t)(_LNK_NATIVE_MATRIX_ALIGNMENT - 1);
+}
+
+/// Lays out the sections of a native matrix file after the header and returns the total file size.
+NS_INLINE uint64_t _LNKNativeMatrixLayout(_LNKNativeMatrixHeader *header) {
+	const uint64_t valueSize = header->valueSize;
+	header->matrixOffset = _LNKNativeMatrixAlign(sizeof(_LNKNativeMatrixHeader));
+	header->outputVectorOffset = _LNKNativeMatrixAlign(header->matrixOffset + header->rowCount * header->columnCount * valueSize);
+	header->meanVectorOffset = _LNKNativeMatrixAlign(header->outputVectorOffset + header->rowCount * valueSize);
+	header->standardDeviationVectorOffset = _LNKNativeMatrixAlign(header->meanVectorOffset + header->columnCount * valueSize);
+	return header->standardDeviationVectorOffset + header->columnCount * valueSize;
+}
+
 NS_ASSUME_NONNULL_BEGIN
 
 @interface LNKMatrix (Private)
 
+/// Allocates the output vector and normalization vectors but no matrix buffer, for subclasses that store their values
+/// in another form. The output vector is copied if given and cleared otherwise.
+- (instancetype)_initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount hasBiasColumn:(BOOL)hasBiasColumn outputVector:(nullable const LNKFloat *)outputVector;
+
 - (LNKSize *)_shuffleIndices;
 
 @end
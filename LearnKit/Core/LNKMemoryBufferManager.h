@@ -8,10 +8,39 @@
 typedef struct _LNKMemoryBufferManager LNKMemoryBufferManager;
 typedef LNKMemoryBufferManager *LNKMemoryBufferManagerRef;
 
+typedef struct {
+	uint64_t hitCount;		// Requests served from cached blocks or existing scratch chunks.
+	uint64_t missCount;		// Requests that fell through to `malloc`.
+	int64_t bytesInUse;
+	int64_t highWaterBytes;
+} LNKMemoryBufferStatistics;
+
+/// A position in a manager's scratch arena, obtained before a batch and restored after it.
+typedef struct {
+	LNKSize chunk, offset;
+} LNKMemoryBufferScratchMark;
+
 LNKMemoryBufferManagerRef LNKMemoryBufferManagerCreate(void);
 void LNKMemoryBufferManagerFree(LNKMemoryBufferManagerRef manager);
 
+/// Blocks are cached in power-of-two size classes. The size passed to `FreeBlock` must match the one passed to `AllocBlock`.
+/// Managers aren't synchronized, so blocks must be freed on the thread that allocated them, with the same manager.
 LNKFloat *LNKMemoryBufferManagerAllocBlock(LNKMemoryBufferManagerRef manager, LNKSize size);
 void LNKMemoryBufferManagerFreeBlock(LNKMemoryBufferManagerRef manager, LNKFloat *buffer, LNKSize size);
 
+/// Scratch buffers are bump-allocated and are never freed individually; they are released in bulk by resetting to a mark.
+LNKFloat *LNKMemoryBufferManagerAllocScratch(LNKMemoryBufferManagerRef manager, LNKSize size);
+LNKMemoryBufferScratchMark LNKMemoryBufferManagerGetScratchMark(LNKMemoryBufferManagerRef manager);
+void LNKMemoryBufferManagerResetScratch(LNKMemoryBufferManagerRef manager, LNKMemoryBufferScratchMark mark);
+
+/// Returns cached blocks and unused scratch chunks to the system.
+void LNKMemoryBufferManagerTrim(LNKMemoryBufferManagerRef manager);
+
+LNKMemoryBufferStatistics LNKMemoryBufferManagerGetStatistics(LNKMemoryBufferManagerRef manager);
+
+/// Sums the statistics of every manager, including those of threads that have exited.
+/// The high-water mark is the sum of the per-thread high-water marks.
+LNKMemoryBufferStatistics LNKMemoryBufferGetGlobalStatistics(void);
+void LNKMemoryBufferResetGlobalStatistics(void);
+
 LNKMemoryBufferManagerRef LNKGetCurrentMemoryBufferManager(void);
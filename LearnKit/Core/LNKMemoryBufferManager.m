@@ -9,48 +9,118 @@
 
 #import <pthread.h>
 
-#define MEMORY_BUFFER_MANAGER_ENABLED 0
+#define MEMORY_BUFFER_MANAGER_ENABLED 1
 
-#define FIRST_PAGE_LENGTH	4096
-#define TOTAL_PAGES			1048575 // floor(UINT32_MAX / FIRST_PAGE_LENGTH)
-#define MAX_SUPPORTED_SIZE	4294963200
+#define MIN_CLASS_SHIFT			4	// The smallest size class holds 16 elements.
+#define SIZE_CLASS_COUNT		23	// The largest size class holds 2^26 elements.
+#define MAX_CACHED_BLOCKS		64	// Per size class.
 
-#define FIXED_BUCKET_DIM	8
+#define SCRATCH_CHUNK_LENGTH	32768
+#define SCRATCH_ALIGNMENT		4
 
-struct _LNKMemoryBufferBucket {
-	LNKSize size;
+struct _LNKMemoryBufferBlock {
+	struct _LNKMemoryBufferBlock *next;
+};
+
+struct _LNKMemoryBufferSizeClass {
+	struct _LNKMemoryBufferBlock *head;
+	LNKSize count;
+};
+
+struct _LNKMemoryBufferChunk {
 	LNKFloat *buffer;
-	
-	struct _LNKMemoryBufferBucket *previous;
-	struct _LNKMemoryBufferBucket *next;
+	LNKSize length;
 };
 
 struct _LNKMemoryBufferManager {
-	struct _LNKMemoryBufferBucket **pages;
-	struct _LNKMemoryBufferBucket *head;
+	struct _LNKMemoryBufferSizeClass sizeClasses[SIZE_CLASS_COUNT];
+
+	struct _LNKMemoryBufferChunk *chunks;
+	LNKSize chunkCount;
+	LNKSize currentChunk;
+	LNKSize currentOffset;
+
+	LNKMemoryBufferStatistics statistics;
+
+	LNKMemoryBufferManagerRef previous;
+	LNKMemoryBufferManagerRef next;
 };
 
+// Every manager is registered so statistics can be aggregated across threads.
+static pthread_mutex_t gRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+static LNKMemoryBufferManagerRef gRegistryHead = NULL;
+static LNKMemoryBufferStatistics gRetiredStatistics;
+
+// The owning thread is the only writer; atomics keep concurrent readers of the statistics well-defined.
+#define STATISTIC_ADD(manager, field, value) __atomic_fetch_add(&(manager)->statistics.field, (value), __ATOMIC_RELAXED)
+#define STATISTIC_LOAD(manager, field) __atomic_load_n(&(manager)->statistics.field, __ATOMIC_RELAXED)
+#define STATISTIC_STORE(manager, field, value) __atomic_store_n(&(manager)->statistics.field, (value), __ATOMIC_RELAXED)
+
+static void _LNKMemoryBufferRecord(LNKMemoryBufferManagerRef manager, BOOL hit, int64_t byteDelta) {
+	if (hit) {
+		STATISTIC_ADD(manager, hitCount, 1);
+	} else {
+		STATISTIC_ADD(manager, missCount, 1);
+	}
+
+	const int64_t bytesInUse = STATISTIC_ADD(manager, bytesInUse, byteDelta) + byteDelta;
+
+	if (bytesInUse > STATISTIC_LOAD(manager, highWaterBytes)) {
+		STATISTIC_STORE(manager, highWaterBytes, bytesInUse);
+	}
+}
+
+static inline int _LNKSizeClassForSize(LNKSize size) {
+	if (size <= (1 << MIN_CLASS_SHIFT))
+		return 0;
+
+	const int shift = 64 - __builtin_clzll(size - 1);
+	const int sizeClass = shift - MIN_CLASS_SHIFT;
+
+	return sizeClass < SIZE_CLASS_COUNT ? sizeClass : -1;
+}
+
+static inline LNKSize _LNKLengthOfSizeClass(int sizeClass) {
+	return (LNKSize)1 << (sizeClass + MIN_CLASS_SHIFT);
+}
+
 LNKMemoryBufferManagerRef LNKMemoryBufferManagerCreate() {
-	LNKMemoryBufferManagerRef manager = malloc(sizeof(LNKMemoryBufferManager));
-	manager->head = NULL;
-	manager->pages = calloc(sizeof(struct _LNKMemoryBufferBucket *), TOTAL_PAGES);
-	
+	LNKMemoryBufferManagerRef manager = calloc(1, sizeof(LNKMemoryBufferManager));
+
+	pthread_mutex_lock(&gRegistryLock);
+	manager->next = gRegistryHead;
+	if (gRegistryHead)
+		gRegistryHead->previous = manager;
+	gRegistryHead = manager;
+	pthread_mutex_unlock(&gRegistryLock);
+
 	return manager;
 }
 
 void LNKMemoryBufferManagerFree(LNKMemoryBufferManagerRef manager) {
 	NSCAssert(manager, @"The manager must not be NULL");
-	
-	struct _LNKMemoryBufferBucket **pages = manager->pages;
-	struct _LNKMemoryBufferBucket *bucket = manager->head;
-	
-	while (bucket) {
-		struct _LNKMemoryBufferBucket *next = bucket->next;
-		free(bucket);
-		bucket = next;
-	}
-	
-	free(pages);
+
+	pthread_mutex_lock(&gRegistryLock);
+	gRetiredStatistics.hitCount += manager->statistics.hitCount;
+	gRetiredStatistics.missCount += manager->statistics.missCount;
+	gRetiredStatistics.highWaterBytes += manager->statistics.highWaterBytes;
+
+	if (manager->previous)
+		manager->previous->next = manager->next;
+	else
+		gRegistryHead = manager->next;
+
+	if (manager->next)
+		manager->next->previous = manager->previous;
+	pthread_mutex_unlock(&gRegistryLock);
+
+	manager->currentChunk = 0;
+	LNKMemoryBufferManagerTrim(manager);
+
+	if (manager->chunkCount)
+		free(manager->chunks[0].buffer);
+
+	free(manager->chunks);
 	free(manager);
 }
 
@@ -61,38 +131,28 @@ LNKFloat *LNKMemoryBufferManagerAllocBlock(LNKMemoryBufferManagerRef manager, LN
 #else
 	NSCAssert(manager, @"The manager must not be NULL");
 	NSCAssert(size, @"The size must be greater than 0");
-	
-	// We don't support 64-bit sizes.
-	if (size > MAX_SUPPORTED_SIZE)
-		return malloc(size * sizeof(LNKFloat));
-	
-	LNKSize firstPageOffset = size / FIRST_PAGE_LENGTH;
-	struct _LNKMemoryBufferBucket *buckets = manager->pages[firstPageOffset];
-	
-	if (!buckets)
+
+	const int sizeClass = _LNKSizeClassForSize(size);
+
+	// Very large buffers are not worth caching.
+	if (sizeClass < 0) {
+		_LNKMemoryBufferRecord(manager, NO, (int64_t)(size * sizeof(LNKFloat)));
 		return malloc(size * sizeof(LNKFloat));
-	
-	for (LNKSize i = 0; i < FIXED_BUCKET_DIM; i++) {
-		struct _LNKMemoryBufferBucket *bucket = buckets + i;
-		
-		if (bucket->size == size) {
-			struct _LNKMemoryBufferBucket *previous = bucket->previous;
-			struct _LNKMemoryBufferBucket *next = bucket->next;
-			
-			if (previous == NULL) {
-//				assert(manager->head == bucket);
-				manager->head = next;
-			}
-			
-			if (previous) previous->next = next;
-			if (next) next->previous = previous;
-			
-			bucket->size = 0;
-			return bucket->buffer;
-		}
 	}
-	
-	return malloc(size * sizeof(LNKFloat));
+
+	const LNKSize length = _LNKLengthOfSizeClass(sizeClass);
+	struct _LNKMemoryBufferSizeClass *const entry = manager->sizeClasses + sizeClass;
+	struct _LNKMemoryBufferBlock *const block = entry->head;
+
+	if (block) {
+		entry->head = block->next;
+		entry->count--;
+		_LNKMemoryBufferRecord(manager, YES, (int64_t)(length * sizeof(LNKFloat)));
+		return (LNKFloat *)block;
+	}
+
+	_LNKMemoryBufferRecord(manager, NO, (int64_t)(length * sizeof(LNKFloat)));
+	return malloc(length * sizeof(LNKFloat));
 #endif
 }
 
@@ -106,43 +166,165 @@ void LNKMemoryBufferManagerFreeBlock(LNKMemoryBufferManagerRef manager, LNKFloat
 	NSCAssert(manager, @"The manager must not be NULL");
 	NSCAssert(buffer, @"The buffer must not be NULL");
 	NSCAssert(size, @"The size must be greater than 0");
-	
-	// We don't support 64-bit sizes.
-	if (size > MAX_SUPPORTED_SIZE)
+
+	const int sizeClass = _LNKSizeClassForSize(size);
+
+	if (sizeClass < 0) {
+		STATISTIC_ADD(manager, bytesInUse, -(int64_t)(size * sizeof(LNKFloat)));
 		free(buffer);
-	
-	LNKSize firstPageOffset = size / FIRST_PAGE_LENGTH;
-	struct _LNKMemoryBufferBucket *buckets = manager->pages[firstPageOffset];
-	struct _LNKMemoryBufferBucket *freeBucket = NULL;
-	
-	if (!buckets) {
-		manager->pages[firstPageOffset] = calloc(sizeof(struct _LNKMemoryBufferBucket), FIXED_BUCKET_DIM);
-		freeBucket = manager->pages[firstPageOffset];
-	}
-	else {
-		for (LNKSize i = 0; i < FIXED_BUCKET_DIM; i++) {
-			struct _LNKMemoryBufferBucket *bucket = buckets + i;
-			
-			if (bucket->size == 0) {
-				freeBucket = bucket;
-				break;
-			}
-		}
+		return;
 	}
-	
-	if (!freeBucket) {
+
+	STATISTIC_ADD(manager, bytesInUse, -(int64_t)(_LNKLengthOfSizeClass(sizeClass) * sizeof(LNKFloat)));
+
+	struct _LNKMemoryBufferSizeClass *const entry = manager->sizeClasses + sizeClass;
+
+	if (entry->count == MAX_CACHED_BLOCKS) {
 		free(buffer);
 		return;
 	}
-	
-	freeBucket->buffer = buffer;
-	freeBucket->size = size;
-	freeBucket->previous = NULL;
-	freeBucket->next = manager->head;
-	manager->head = freeBucket;
+
+	struct _LNKMemoryBufferBlock *const block = (struct _LNKMemoryBufferBlock *)buffer;
+	block->next = entry->head;
+	entry->head = block;
+	entry->count++;
 #endif
 }
 
+static LNKSize _LNKScratchPosition(LNKMemoryBufferManagerRef manager, LNKSize chunk, LNKSize offset) {
+	LNKSize position = offset;
+
+	for (LNKSize i = 0; i < chunk && i < manager->chunkCount; i++)
+		position += manager->chunks[i].length;
+
+	return position;
+}
+
+LNKFloat *LNKMemoryBufferManagerAllocScratch(LNKMemoryBufferManagerRef manager, LNKSize size) {
+	NSCAssert(manager, @"The manager must not be NULL");
+	NSCAssert(size, @"The size must be greater than 0");
+
+	const LNKSize roundedSize = (size + SCRATCH_ALIGNMENT - 1) & ~(LNKSize)(SCRATCH_ALIGNMENT - 1);
+	const LNKSize previousPosition = _LNKScratchPosition(manager, manager->currentChunk, manager->currentOffset);
+	BOOL hit = YES;
+
+	if (manager->chunkCount && manager->currentOffset + roundedSize > manager->chunks[manager->currentChunk].length) {
+		// Move past the exhausted chunk.
+		manager->currentChunk++;
+		manager->currentOffset = 0;
+	}
+
+	if (manager->currentChunk == manager->chunkCount) {
+		manager->chunks = realloc(manager->chunks, (manager->chunkCount + 1) * sizeof(struct _LNKMemoryBufferChunk));
+		manager->chunks[manager->chunkCount++] = (struct _LNKMemoryBufferChunk) { NULL, 0 };
+	}
+
+	struct _LNKMemoryBufferChunk *const chunk = manager->chunks + manager->currentChunk;
+
+	if (chunk->length < roundedSize) {
+		// Chunks past the current one are unused, so they can be replaced.
+		free(chunk->buffer);
+		chunk->length = MAX(roundedSize, (LNKSize)SCRATCH_CHUNK_LENGTH);
+		chunk->buffer = LNKFloatAlloc(chunk->length);
+		hit = NO;
+	}
+
+	LNKFloat *const buffer = chunk->buffer + manager->currentOffset;
+	manager->currentOffset += roundedSize;
+
+	const LNKSize position = _LNKScratchPosition(manager, manager->currentChunk, manager->currentOffset);
+	_LNKMemoryBufferRecord(manager, hit, (int64_t)((position - previousPosition) * sizeof(LNKFloat)));
+
+	return buffer;
+}
+
+LNKMemoryBufferScratchMark LNKMemoryBufferManagerGetScratchMark(LNKMemoryBufferManagerRef manager) {
+	NSCAssert(manager, @"The manager must not be NULL");
+	return (LNKMemoryBufferScratchMark) { manager->currentChunk, manager->currentOffset };
+}
+
+void LNKMemoryBufferManagerResetScratch(LNKMemoryBufferManagerRef manager, LNKMemoryBufferScratchMark mark) {
+	NSCAssert(manager, @"The manager must not be NULL");
+	NSCAssert(mark.chunk < manager->currentChunk || (mark.chunk == manager->currentChunk && mark.offset <= manager->currentOffset), @"Scratch marks must be reset in LIFO order");
+
+	const LNKSize previousPosition = _LNKScratchPosition(manager, manager->currentChunk, manager->currentOffset);
+	const LNKSize position = _LNKScratchPosition(manager, mark.chunk, mark.offset);
+	STATISTIC_ADD(manager, bytesInUse, -(int64_t)((previousPosition - position) * sizeof(LNKFloat)));
+
+	manager->currentChunk = mark.chunk;
+	manager->currentOffset = mark.offset;
+}
+
+void LNKMemoryBufferManagerTrim(LNKMemoryBufferManagerRef manager) {
+	NSCAssert(manager, @"The manager must not be NULL");
+
+	for (int sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+		struct _LNKMemoryBufferSizeClass *const entry = manager->sizeClasses + sizeClass;
+		struct _LNKMemoryBufferBlock *block = entry->head;
+
+		while (block) {
+			struct _LNKMemoryBufferBlock *next = block->next;
+			free(block);
+			block = next;
+		}
+
+		entry->head = NULL;
+		entry->count = 0;
+	}
+
+	// Keep the chunks that are still in use.
+	const LNKSize usedChunkCount = MIN(manager->currentChunk + 1, manager->chunkCount);
+
+	for (LNKSize i = usedChunkCount; i < manager->chunkCount; i++)
+		free(manager->chunks[i].buffer);
+
+	manager->chunkCount = usedChunkCount;
+}
+
+LNKMemoryBufferStatistics LNKMemoryBufferManagerGetStatistics(LNKMemoryBufferManagerRef manager) {
+	NSCAssert(manager, @"The manager must not be NULL");
+
+	LNKMemoryBufferStatistics statistics;
+	statistics.hitCount = STATISTIC_LOAD(manager, hitCount);
+	statistics.missCount = STATISTIC_LOAD(manager, missCount);
+	statistics.bytesInUse = STATISTIC_LOAD(manager, bytesInUse);
+	statistics.highWaterBytes = STATISTIC_LOAD(manager, highWaterBytes);
+
+	return statistics;
+}
+
+LNKMemoryBufferStatistics LNKMemoryBufferGetGlobalStatistics() {
+	pthread_mutex_lock(&gRegistryLock);
+
+	LNKMemoryBufferStatistics total = gRetiredStatistics;
+
+	for (LNKMemoryBufferManagerRef manager = gRegistryHead; manager; manager = manager->next) {
+		const LNKMemoryBufferStatistics statistics = LNKMemoryBufferManagerGetStatistics(manager);
+		total.hitCount += statistics.hitCount;
+		total.missCount += statistics.missCount;
+		total.bytesInUse += statistics.bytesInUse;
+		total.highWaterBytes += statistics.highWaterBytes;
+	}
+
+	pthread_mutex_unlock(&gRegistryLock);
+
+	return total;
+}
+
+void LNKMemoryBufferResetGlobalStatistics() {
+	pthread_mutex_lock(&gRegistryLock);
+
+	gRetiredStatistics = (LNKMemoryBufferStatistics) { 0, 0, 0, 0 };
+
+	for (LNKMemoryBufferManagerRef manager = gRegistryHead; manager; manager = manager->next) {
+		STATISTIC_STORE(manager, hitCount, 0);
+		STATISTIC_STORE(manager, missCount, 0);
+		STATISTIC_STORE(manager, highWaterBytes, STATISTIC_LOAD(manager, bytesInUse));
+	}
+
+	pthread_mutex_unlock(&gRegistryLock);
+}
+
 
 static pthread_key_t gMemoryBufferKey;
 
@@ -155,13 +337,13 @@ LNKMemoryBufferManagerRef LNKGetCurrentMemoryBufferManager() {
 	dispatch_once(&onceToken, ^{
 		pthread_key_create(&gMemoryBufferKey, &destroyMemoryBuffer);
 	});
-	
+
 	LNKMemoryBufferManagerRef memoryManager = pthread_getspecific(gMemoryBufferKey);
-	
+
 	if (!memoryManager) {
 		memoryManager = LNKMemoryBufferManagerCreate();
 		pthread_setspecific(gMemoryBufferKey, memoryManager);
 	}
-	
+
 	return memoryManager;
 }
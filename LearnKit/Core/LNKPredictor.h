@@ -11,6 +11,9 @@ NS_ASSUME_NONNULL_BEGIN
 @protocol LNKOptimizationAlgorithm;
 
 /// Abstract
+/// Predictions only read a trained predictor, keeping their scratch state on the stack or in per-thread buffers, so one
+/// trained predictor can serve predictions on any number of threads at once. Training, changing properties, and other
+/// methods that modify the model must not overlap with predictions.
 @interface LNKPredictor : NSObject
 
 + (NSArray<NSNumber *> *)supportedImplementationTypes;
@@ -32,6 +35,12 @@ NS_ASSUME_NONNULL_BEGIN
 /// The type of object returned varies by predictor.
 - (nullable id)predictValueForFeatureVector:(LNKVector)featureVector;
 
+/// Predicts the value of every row of `matrix`, whose rows are laid out like the feature vectors passed to
+/// `-predictValueForFeatureVector:`, into `outputBuffer`, which must have room for `matrix.rowCount` values.
+/// Predicted numbers are stored as they are, classes as their unsigned integer values, and missing predictions as NaN.
+/// Rows are predicted in parallel; predictors override this method with vectorized implementations where they can.
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
 @end
 
 NS_ASSUME_NONNULL_END
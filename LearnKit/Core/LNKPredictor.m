@@ -7,6 +7,7 @@
 
 #import "LNKPredictor.h"
 
+#import "LNKExecutor.h"
 #import "LNKMatrix.h"
 #import "LNKOptimizationAlgorithm.h"
 #import "LNKPredictorPrivate.h"
@@ -87,4 +88,22 @@
 	return nil;
 }
 
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	
+	const LNKSize columnCount = matrix.columnCount;
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), 0, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		for (LNKSize row = range.location; row < range.location + range.length; row++) {
+			NSNumber *value = [self predictValueForFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:row], columnCount)];
+			outputBuffer[row] = value ? value.LNKFloatValue : NAN;
+		}
+	});
+}
+
 @end
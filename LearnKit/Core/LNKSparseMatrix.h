@@ -0,0 +1,53 @@
+//
+//  LNKSparseMatrix.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKMatrix.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A non-zero value at a zero-based row and column.
+typedef struct {
+	LNKSize row, column;
+	LNKFloat value;
+} LNKSparseTriplet;
+
+/// A matrix that stores only its non-zero values, in compressed sparse row (CSR) form: the values of each row are
+/// stored one after the other, ordered by column, along with their column indices, and `rowPointers[row]` is the index
+/// of the first value of `row`.
+///
+/// Sparse matrices can be passed anywhere a matrix is expected. Linear and logistic regression trained with gradient
+/// descent or L-BFGS, the topic modeller and collaborative filtering work on the non-zero values directly, so their
+/// memory and time scale with the number of non-zero values rather than with rows times columns. Everything else
+/// works on the dense copy the matrix builds the first time `matrixBuffer` or `rowAtIndex:` is called.
+@interface LNKSparseMatrix : LNKMatrix
+
+/// Triplets may be given in any order. Values given more than once for the same row and column are added together,
+/// and zeros are dropped. If there is no output vector, pass `NULL`.
+/// The column count should not include the ones column.
+- (instancetype)initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount
+						triplets:(const LNKSparseTriplet *)triplets tripletCount:(LNKSize)tripletCount
+					outputVector:(nullable const LNKFloat *)outputVector;
+
+/// Initializes a matrix by loading a text file with a "row column value" triplet on every line, with one-based row and
+/// column indices, such as the bag-of-words data sets of the UCI repository or Matrix Market coordinate files.
+/// Lines that don't contain a triplet (headers and comments starting with '%') are skipped.
+/// Returns `nil` if the file cannot be read or contains indices outside of the given dimensions.
+- (nullable instancetype)initWithTripletFileAtURL:(NSURL *)url rowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount;
+
+/// Initializes a matrix with the non-zero values and the output vector of `matrix`.
+- (instancetype)initWithMatrix:(LNKMatrix *)matrix;
+
+@property (nonatomic, readonly) LNKSize nonzeroCount;
+
+/// `rowCount + 1` offsets into `columnIndices` and `values`.
+- (const LNKSize *)rowPointers NS_RETURNS_INNER_POINTER;
+- (const LNKSize *)columnIndices NS_RETURNS_INNER_POINTER;
+- (const LNKFloat *)values NS_RETURNS_INNER_POINTER;
+
+@end
+
+NS_ASSUME_NONNULL_END
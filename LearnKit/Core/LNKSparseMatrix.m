@@ -0,0 +1,462 @@
+//
+//  LNKSparseMatrix.m
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKSparseMatrix.h"
+
+#import "LNKAccelerate.h"
+#import "LNKExecutor.h"
+#import "LNKMatrixPrivate.h"
+
+@implementation LNKSparseMatrix {
+	LNKSize *_rowPointers;
+	LNKSize *_columnIndices;
+	LNKFloat *_values;
+	LNKFloat *_denseMatrix;
+}
+
+static int _LNKCompareTripletColumns(const void *a, const void *b) {
+	const LNKSize columnA = ((const LNKSparseTriplet *)a)->column;
+	const LNKSize columnB = ((const LNKSparseTriplet *)b)->column;
+	return columnA < columnB ? -1 : columnA > columnB;
+}
+
+// Takes ownership of the given buffers.
+- (instancetype)_initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount hasBiasColumn:(BOOL)hasBiasColumn outputVector:(const LNKFloat *)outputVector
+					  rowPointers:(LNKSize *)rowPointers columnIndices:(LNKSize *)columnIndices values:(LNKFloat *)values {
+	NSParameterAssert(rowPointers);
+
+	if (!(self = [super _initWithRowCount:rowCount columnCount:columnCount hasBiasColumn:hasBiasColumn outputVector:outputVector])) {
+		free(rowPointers);
+		free(columnIndices);
+		free(values);
+		return nil;
+	}
+
+	_rowPointers = rowPointers;
+	_columnIndices = columnIndices;
+	_values = values;
+	_nonzeroCount = rowPointers[rowCount];
+
+	return self;
+}
+
+- (instancetype)initWithRowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount triplets:(const LNKSparseTriplet *)triplets tripletCount:(LNKSize)tripletCount outputVector:(const LNKFloat *)outputVector {
+	NSParameterAssert(rowCount);
+	NSParameterAssert(columnCount);
+	NSParameterAssert(triplets || !tripletCount);
+
+	LNKSize *const rowPointers = calloc(rowCount + 1, sizeof(LNKSize));
+
+	for (LNKSize index = 0; index < tripletCount; index++) {
+		if (triplets[index].row >= rowCount || triplets[index].column >= columnCount) {
+			free(rowPointers);
+			[self release];
+			[NSException raise:NSInvalidArgumentException format:@"The triplet at index %llu is out of bounds", index];
+		}
+
+		rowPointers[triplets[index].row + 1]++;
+	}
+
+	for (LNKSize row = 0; row < rowCount; row++)
+		rowPointers[row + 1] += rowPointers[row];
+
+	// Bucket the triplets by row, then order each row by column so duplicates end up next to each other.
+	LNKSparseTriplet *const sortedTriplets = malloc(MAX(tripletCount, 1) * sizeof(LNKSparseTriplet));
+	LNKSize *const nextSlots = malloc(rowCount * sizeof(LNKSize));
+	memcpy(nextSlots, rowPointers, rowCount * sizeof(LNKSize));
+
+	for (LNKSize index = 0; index < tripletCount; index++)
+		sortedTriplets[nextSlots[triplets[index].row]++] = triplets[index];
+
+	free(nextSlots);
+
+	LNKSize *const columnIndices = malloc(MAX(tripletCount, 1) * sizeof(LNKSize));
+	LNKFloat *const values = LNKFloatAlloc(MAX(tripletCount, 1));
+	LNKSize nonzeroCount = 0;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKSize start = rowPointers[row];
+		const LNKSize end = rowPointers[row + 1];
+		qsort(sortedTriplets + start, end - start, sizeof(LNKSparseTriplet), _LNKCompareTripletColumns);
+
+		// Rows are compacted in place; every row starts at or before where it did.
+		rowPointers[row] = nonzeroCount;
+
+		for (LNKSize index = start; index < end;) {
+			const LNKSize column = sortedTriplets[index].column;
+			LNKFloat value = 0;
+
+			for (; index < end && sortedTriplets[index].column == column; index++)
+				value += sortedTriplets[index].value;
+
+			if (value != 0) {
+				columnIndices[nonzeroCount] = column;
+				values[nonzeroCount] = value;
+				nonzeroCount++;
+			}
+		}
+	}
+
+	rowPointers[rowCount] = nonzeroCount;
+	free(sortedTriplets);
+
+	return [self _initWithRowCount:rowCount columnCount:columnCount hasBiasColumn:NO outputVector:outputVector rowPointers:rowPointers columnIndices:columnIndices values:values];
+}
+
+- (instancetype)initWithTripletFileAtURL:(NSURL *)url rowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount {
+	NSParameterAssert(url);
+	NSParameterAssert(rowCount);
+	NSParameterAssert(columnCount);
+
+	FILE *const file = fopen(url.fileSystemRepresentation, "r");
+
+	if (!file) {
+		NSLog(@"Error while loading matrix: could not open the triplet file at the given URL: %s", strerror(errno));
+		[self release];
+		return nil;
+	}
+
+	LNKSize tripletCapacity = 1024;
+	LNKSize tripletCount = 0;
+	LNKSparseTriplet *triplets = malloc(tripletCapacity * sizeof(LNKSparseTriplet));
+
+	char *line = NULL;
+	size_t lineCapacity = 0;
+	BOOL isFirstLine = YES;
+	BOOL skipSizeLine = NO;
+	BOOL valid = YES;
+
+	while (getline(&line, &lineCapacity, file) != -1) {
+		// The first line of a Matrix Market file that isn't a comment holds its dimensions, not a triplet.
+		if (isFirstLine && !strncmp(line, "%%MatrixMarket", 14))
+			skipSizeLine = YES;
+
+		isFirstLine = NO;
+
+		if (line[0] == '%')
+			continue;
+
+		char *cursor = line, *end;
+		const unsigned long long row = strtoull(cursor, &end, 10);
+
+		if (end == cursor)
+			continue;
+
+		cursor = end;
+		const unsigned long long column = strtoull(cursor, &end, 10);
+
+		if (end == cursor)
+			continue;
+
+		cursor = end;
+		const LNKFloat value = (LNKFloat)strtod(cursor, &end);
+
+		// Headers listing counts have fewer than three fields.
+		if (end == cursor)
+			continue;
+
+		if (skipSizeLine) {
+			skipSizeLine = NO;
+			continue;
+		}
+
+		if (!row || !column || row > rowCount || column > columnCount) {
+			NSLog(@"Error while loading matrix: the triplet at row %llu and column %llu is out of bounds", row, column);
+			valid = NO;
+			break;
+		}
+
+		if (tripletCount == tripletCapacity) {
+			tripletCapacity *= 2;
+			triplets = realloc(triplets, tripletCapacity * sizeof(LNKSparseTriplet));
+		}
+
+		triplets[tripletCount++] = (LNKSparseTriplet) { row - 1, column - 1, value };
+	}
+
+	free(line);
+	fclose(file);
+
+	if (!valid) {
+		free(triplets);
+		[self release];
+		return nil;
+	}
+
+	self = [self initWithRowCount:rowCount columnCount:columnCount triplets:triplets tripletCount:tripletCount outputVector:NULL];
+	free(triplets);
+
+	return self;
+}
+
+- (instancetype)initWithMatrix:(LNKMatrix *)matrix {
+	NSParameterAssert(matrix);
+
+	const LNKSize rowCount = matrix.rowCount;
+	const LNKSize columnCount = matrix.columnCount;
+	LNKSize *const rowPointers = malloc((rowCount + 1) * sizeof(LNKSize));
+	rowPointers[0] = 0;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *const rowValues = [matrix rowAtIndex:row];
+		LNKSize count = 0;
+
+		for (LNKSize column = 0; column < columnCount; column++)
+			count += rowValues[column] != 0;
+
+		rowPointers[row + 1] = rowPointers[row] + count;
+	}
+
+	const LNKSize nonzeroCount = rowPointers[rowCount];
+	LNKSize *const columnIndices = malloc(MAX(nonzeroCount, 1) * sizeof(LNKSize));
+	LNKFloat *const values = LNKFloatAlloc(MAX(nonzeroCount, 1));
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *const rowValues = [matrix rowAtIndex:row];
+		LNKSize index = rowPointers[row];
+
+		for (LNKSize column = 0; column < columnCount; column++) {
+			if (rowValues[column] != 0) {
+				columnIndices[index] = column;
+				values[index] = rowValues[column];
+				index++;
+			}
+		}
+	}
+
+	return [self _initWithRowCount:rowCount columnCount:columnCount hasBiasColumn:matrix.hasBiasColumn outputVector:matrix.outputVector rowPointers:rowPointers columnIndices:columnIndices values:values];
+}
+
+- (void)dealloc {
+	free(_rowPointers);
+	free(_columnIndices);
+	free(_values);
+	free(_denseMatrix);
+	[super dealloc];
+}
+
+- (BOOL)isSparse {
+	return YES;
+}
+
+- (const LNKSize *)rowPointers {
+	return _rowPointers;
+}
+
+- (const LNKSize *)columnIndices {
+	return _columnIndices;
+}
+
+- (const LNKFloat *)values {
+	return _values;
+}
+
+/// Several threads may race to build the dense copy, in which case all but one of them discard theirs.
+- (const LNKFloat *)matrixBuffer {
+	LNKFloat *matrix = __atomic_load_n(&_denseMatrix, __ATOMIC_ACQUIRE);
+
+	if (matrix)
+		return matrix;
+
+	const LNKSize rowCount = self.rowCount;
+	const LNKSize columnCount = self.columnCount;
+	LNKFloat *const denseMatrix = LNKFloatCalloc(rowCount * columnCount);
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		for (LNKSize index = _rowPointers[row]; index < _rowPointers[row + 1]; index++)
+			denseMatrix[row * columnCount + _columnIndices[index]] = _values[index];
+	}
+
+	if (!__atomic_compare_exchange_n(&_denseMatrix, &matrix, denseMatrix, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		free(denseMatrix);
+		return matrix;
+	}
+
+	return denseMatrix;
+}
+
+- (const LNKFloat *)rowAtIndex:(LNKSize)index {
+	NSParameterAssert(index < self.rowCount);
+	return self.matrixBuffer + index * self.columnCount;
+}
+
+- (LNKFloat)valueAtRow:(LNKSize)row column:(LNKSize)column {
+	if (row >= self.rowCount)
+		[NSException raise:NSInvalidArgumentException format:@"The row index is out of bounds"];
+
+	if (column >= self.columnCount)
+		[NSException raise:NSInvalidArgumentException format:@"The column index is out of bounds"];
+
+	// Binary search through the columns of the row.
+	LNKSize low = _rowPointers[row];
+	LNKSize high = _rowPointers[row + 1];
+
+	while (low < high) {
+		const LNKSize middle = low + (high - low) / 2;
+
+		if (_columnIndices[middle] < column)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low < _rowPointers[row + 1] && _columnIndices[low] == column ? _values[low] : 0;
+}
+
+- (void)multiplyByBuffer:(const LNKFloat *)buffer columnCount:(LNKSize)columnCount outputBuffer:(LNKFloat *)outputBuffer {
+	NSParameterAssert(buffer);
+	NSParameterAssert(columnCount);
+	NSParameterAssert(outputBuffer);
+
+	const LNKSize *const rowPointers = _rowPointers;
+	const LNKSize *const columnIndices = _columnIndices;
+	const LNKFloat *const values = _values;
+
+	// Every row of the result only depends on the same row of the matrix, so rows are computed in parallel.
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, self.rowCount), 0, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		for (LNKSize row = range.location; row < range.location + range.length; row++) {
+			LNKFloat *const outputRow = outputBuffer + row * columnCount;
+
+			if (columnCount == 1) {
+				LNKFloat sum = 0;
+
+				for (LNKSize index = rowPointers[row]; index < rowPointers[row + 1]; index++)
+					sum += values[index] * buffer[columnIndices[index]];
+
+				*outputRow = sum;
+				continue;
+			}
+
+			LNK_vclr(outputRow, UNIT_STRIDE, columnCount);
+
+			for (LNKSize index = rowPointers[row]; index < rowPointers[row + 1]; index++)
+				LNK_vsma(buffer + columnIndices[index] * columnCount, UNIT_STRIDE, &values[index], outputRow, UNIT_STRIDE, outputRow, UNIT_STRIDE, columnCount);
+		}
+	});
+}
+
+- (void)multiplyTransposeByBuffer:(const LNKFloat *)buffer columnCount:(LNKSize)columnCount outputBuffer:(LNKFloat *)outputBuffer {
+	NSParameterAssert(buffer);
+	NSParameterAssert(columnCount);
+	NSParameterAssert(outputBuffer);
+
+	const LNKSize *const rowPointers = _rowPointers;
+	const LNKSize *const columnIndices = _columnIndices;
+	const LNKFloat *const values = _values;
+
+	// Rows of the matrix scatter into any row of the result, so every thread sums into its own copy of it.
+	LNKExecutorSum(LNKExecutorGetShared(), LNKRangeMake(0, self.rowCount), 0, outputBuffer, self.columnCount * columnCount, ^(LNKRange range, LNKFloat *accumulator) {
+		for (LNKSize row = range.location; row < range.location + range.length; row++) {
+			const LNKFloat *const bufferRow = buffer + row * columnCount;
+
+			for (LNKSize index = rowPointers[row]; index < rowPointers[row + 1]; index++) {
+				LNKFloat *const outputRow = accumulator + columnIndices[index] * columnCount;
+
+				if (columnCount == 1)
+					*outputRow += values[index] * *bufferRow;
+				else
+					LNK_vsma(bufferRow, UNIT_STRIDE, &values[index], outputRow, UNIT_STRIDE, outputRow, UNIT_STRIDE, columnCount);
+			}
+		}
+	});
+}
+
+- (LNKMatrix *)matrixByAddingBiasColumn {
+	const LNKSize rowCount = self.rowCount;
+	const LNKSize biasOffset = 1;
+	LNKSize *const rowPointers = malloc((rowCount + 1) * sizeof(LNKSize));
+	LNKSize *const columnIndices = malloc((_nonzeroCount + rowCount) * sizeof(LNKSize));
+	LNKFloat *const values = LNKFloatAlloc(_nonzeroCount + rowCount);
+
+	// The ones column adds a single value to every row.
+	for (LNKSize row = 0; row <= rowCount; row++)
+		rowPointers[row] = _rowPointers[row] + row;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		LNKSize index = rowPointers[row];
+		columnIndices[index] = 0;
+		values[index] = 1;
+
+		for (LNKSize sourceIndex = _rowPointers[row]; sourceIndex < _rowPointers[row + 1]; sourceIndex++) {
+			index++;
+			columnIndices[index] = _columnIndices[sourceIndex] + biasOffset;
+			values[index] = _values[sourceIndex];
+		}
+	}
+
+	return [[[LNKSparseMatrix alloc] _initWithRowCount:rowCount columnCount:self.columnCount + biasOffset hasBiasColumn:YES outputVector:self.outputVector
+										   rowPointers:rowPointers columnIndices:columnIndices values:values] autorelease];
+}
+
+// Copies, shuffled matrices, splits and row ranges copy the non-zero values of their rows, which takes time and memory
+// proportional to their number rather than to the size of a dense view.
+- (LNKSparseMatrix *)_copyOfRowCount:(LNKSize)rowCount firstRow:(LNKSize)firstRow rowIndices:(const LNKSize *)rowIndices {
+	const LNKFloat *const sourceOutputVector = self.outputVector;
+	LNKFloat *const outputVector = LNKFloatAlloc(rowCount);
+	LNKSize *const rowPointers = malloc((rowCount + 1) * sizeof(LNKSize));
+	rowPointers[0] = 0;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKSize sourceRow = rowIndices ? rowIndices[row] : firstRow + row;
+		outputVector[row] = sourceOutputVector[sourceRow];
+		rowPointers[row + 1] = rowPointers[row] + _rowPointers[sourceRow + 1] - _rowPointers[sourceRow];
+	}
+
+	const LNKSize nonzeroCount = rowPointers[rowCount];
+	LNKSize *const columnIndices = malloc(MAX(nonzeroCount, 1) * sizeof(LNKSize));
+	LNKFloat *const values = LNKFloatAlloc(MAX(nonzeroCount, 1));
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKSize sourceRow = rowIndices ? rowIndices[row] : firstRow + row;
+		const LNKSize count = rowPointers[row + 1] - rowPointers[row];
+		memcpy(columnIndices + rowPointers[row], _columnIndices + _rowPointers[sourceRow], count * sizeof(LNKSize));
+		LNKFloatCopy(values + rowPointers[row], _values + _rowPointers[sourceRow], count);
+	}
+
+	LNKSparseMatrix *const matrix = [[LNKSparseMatrix alloc] _initWithRowCount:rowCount columnCount:self.columnCount hasBiasColumn:self.hasBiasColumn outputVector:outputVector
+																  rowPointers:rowPointers columnIndices:columnIndices values:values];
+	free(outputVector);
+
+	return matrix;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+#pragma unused(zone)
+	return [self _copyOfRowCount:self.rowCount firstRow:0 rowIndices:NULL];
+}
+
+- (LNKMatrix *)copyShuffledSubmatrixWithRowCount:(LNKSize)rowCount {
+	if (rowCount > self.rowCount)
+		[NSException raise:NSInvalidArgumentException format:@"The number of examples in the submatrix cannot be greater than the number of examples in the current matrix"];
+
+	LNKSize *const indices = [self _shuffleIndices];
+	LNKSparseMatrix *const matrix = [self _copyOfRowCount:rowCount firstRow:0 rowIndices:indices];
+	free(indices);
+
+	return matrix;
+}
+
+- (void)splitIntoTrainingMatrix:(LNKMatrix **)trainingMatrix testMatrix:(LNKMatrix **)testMatrix trainingBias:(LNKFloat)trainingBias {
+	const LNKSize rowCount = self.rowCount;
+	const LNKSize trainingSize = rowCount * trainingBias;
+	const LNKSize testSize = rowCount - trainingSize;
+
+	LNKSize *const indices = [self _shuffleIndices];
+	*trainingMatrix = [[self _copyOfRowCount:trainingSize firstRow:0 rowIndices:indices] autorelease];
+	*testMatrix = [[self _copyOfRowCount:testSize firstRow:0 rowIndices:indices + trainingSize] autorelease];
+	free(indices);
+}
+
+- (LNKMatrix *)submatrixWithRowRange:(NSRange)range {
+	if (NSMaxRange(range) > self.rowCount)
+		[NSException raise:NSInvalidArgumentException format:@"The row range is out of bounds"];
+
+	return [[self _copyOfRowCount:range.length firstRow:range.location rowIndices:NULL] autorelease];
+}
+
+@end
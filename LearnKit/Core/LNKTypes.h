@@ -25,10 +25,12 @@ typedef NS_ENUM(NSUInteger, LNKImplementationType) {
 typedef double LNKFloat;
 #define LNKFloatMin	-DBL_MAX
 #define LNKFloatMax	DBL_MAX
+#define LNKFloatEpsilon	DBL_EPSILON
 #else
 typedef float LNKFloat;
 #define LNKFloatMin	-FLT_MAX
 #define LNKFloatMax	FLT_MAX
+#define LNKFloatEpsilon	FLT_EPSILON
 #endif
 
 typedef uint64_t LNKSize;
@@ -0,0 +1,30 @@
+//
+//  LNKDecisionForest.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKDecisionTree.h"
+
+/// Decision trees packed for batch inference. The nodes of all trees live in one array, each tree laid out breadth-first
+/// so the levels every row visits share cache lines. Rows are walked through each tree in blocks, one level at a time,
+/// so the loads of different rows overlap instead of waiting on each other.
+typedef struct _LNKDecisionForest LNKDecisionForest;
+typedef LNKDecisionForest *LNKDecisionForestRef;
+
+/// The trees are copied, so they can be freed afterwards. Their leaves must have classes in [0, `classCount`) or none.
+LNKDecisionForestRef LNKDecisionForestCreate(const LNKDecisionTreeRef *trees, LNKSize treeCount, LNKSize classCount);
+void LNKDecisionForestFree(LNKDecisionForestRef forest);
+
+LNKSize LNKDecisionForestGetTreeCount(LNKDecisionForestRef forest);
+LNKSize LNKDecisionForestGetClassCount(LNKDecisionForestRef forest);
+
+/// Counts the votes of the trees for every class of the `rowCount` rows of the row-major `matrix` into `outVotes`,
+/// which holds `classCount` values per row. Trees whose leaf has no class or that come across a value outside of
+/// a categorical column's categories don't vote. Larger matrices are scored in parallel.
+void LNKDecisionForestPredictVotes(LNKDecisionForestRef forest, const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount, LNKFloat *outVotes);
+
+/// Like `LNKDecisionForestPredictVotes`, with the votes of each row divided by their sum.
+/// Rows no tree votes for get probabilities of 0.
+void LNKDecisionForestPredictProbabilities(LNKDecisionForestRef forest, const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount, LNKFloat *outProbabilities);
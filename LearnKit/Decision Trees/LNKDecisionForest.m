@@ -0,0 +1,198 @@
+//
+//  LNKDecisionForest.m
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKDecisionForest.h"
+
+#import "LNKAccelerate.h"
+#import "LNKExecutor.h"
+
+#define BLOCK_SIZE 32
+#define LEAF_COLUMN UINT32_MAX
+#define NO_CLASS UINT32_MAX
+
+// Rows with values outside of a categorical column's categories end up at a shared leaf without a class.
+#define UNKNOWN_VALUE_NODE 0
+
+/// Continuous splits have a value count of 0. Leaves keep their class in `firstBranchIndex`.
+typedef struct {
+	uint32_t columnIndex;
+	uint32_t valueCount;
+	uint32_t firstBranchIndex;
+	LNKFloat threshold;
+} _LNKPackedNode;
+
+struct _LNKDecisionForest {
+	_LNKPackedNode *nodes;
+	uint32_t *rootIndices;
+	LNKSize treeCount;
+	LNKSize classCount;
+};
+
+LNKDecisionForestRef LNKDecisionForestCreate(const LNKDecisionTreeRef *trees, LNKSize treeCount, LNKSize classCount) {
+	NSCParameterAssert(trees || !treeCount);
+	NSCParameterAssert(classCount);
+	
+	LNKSize nodeCount = 1;
+	LNKSize maximumTreeNodeCount = 0;
+	
+	for (LNKSize tree = 0; tree < treeCount; tree++) {
+		nodeCount += LNKDecisionTreeGetNodeCount(trees[tree]);
+		maximumTreeNodeCount = MAX(maximumTreeNodeCount, LNKDecisionTreeGetNodeCount(trees[tree]));
+	}
+	
+	NSCAssert(nodeCount < UINT32_MAX, @"Too many nodes to pack");
+	
+	LNKDecisionForestRef forest = malloc(sizeof(LNKDecisionForest));
+	forest->nodes = malloc(nodeCount * sizeof(_LNKPackedNode));
+	forest->rootIndices = malloc(treeCount * sizeof(uint32_t));
+	forest->treeCount = treeCount;
+	forest->classCount = classCount;
+	forest->nodes[UNKNOWN_VALUE_NODE] = (_LNKPackedNode) { LEAF_COLUMN, 0, NO_CLASS, 0 };
+	
+	// The tree's nodes in breadth-first order. Siblings stay next to each other since they're queued together.
+	LNKSize *queue = malloc(maximumTreeNodeCount * sizeof(LNKSize));
+	uint32_t firstIndex = 1;
+	
+	for (LNKSize tree = 0; tree < treeCount; tree++) {
+		const LNKDecisionTreeNode *treeNodes = LNKDecisionTreeGetNodes(trees[tree]);
+		const LNKSize treeNodeCount = LNKDecisionTreeGetNodeCount(trees[tree]);
+		LNKSize queueLength = 1;
+		queue[0] = 0;
+		
+		for (LNKSize position = 0; position < queueLength; position++) {
+			const LNKDecisionTreeNode *node = treeNodes + queue[position];
+			_LNKPackedNode *packedNode = forest->nodes + firstIndex + position;
+			
+			if (node->columnIndex == LNKSizeMax) {
+				NSCAssert(node->classIndex < classCount || node->classIndex == LNKSizeMax, @"Invalid class");
+				*packedNode = (_LNKPackedNode) { LEAF_COLUMN, 0, node->classIndex == LNKSizeMax ? NO_CLASS : (uint32_t)node->classIndex, 0 };
+				continue;
+			}
+			
+			NSCAssert(node->columnIndex < LEAF_COLUMN, @"Too many columns to pack");
+			
+			const BOOL isContinuous = !isnan(node->threshold);
+			*packedNode = (_LNKPackedNode) { (uint32_t)node->columnIndex, isContinuous ? 0 : (uint32_t)node->valueCount, (uint32_t)(firstIndex + queueLength), node->threshold };
+			
+			for (LNKSize branch = 0; branch < node->valueCount; branch++)
+				queue[queueLength++] = node->firstBranchIndex + branch;
+		}
+		
+		NSCAssert(queueLength == treeNodeCount, @"Every node should be reachable from the root");
+		forest->rootIndices[tree] = firstIndex;
+		firstIndex += (uint32_t)treeNodeCount;
+	}
+	
+	free(queue);
+	
+	return forest;
+}
+
+void LNKDecisionForestFree(LNKDecisionForestRef forest) {
+	NSCParameterAssert(forest);
+	
+	free(forest->rootIndices);
+	free(forest->nodes);
+	free(forest);
+}
+
+LNKSize LNKDecisionForestGetTreeCount(LNKDecisionForestRef forest) {
+	NSCParameterAssert(forest);
+	return forest->treeCount;
+}
+
+LNKSize LNKDecisionForestGetClassCount(LNKDecisionForestRef forest) {
+	NSCParameterAssert(forest);
+	return forest->classCount;
+}
+
+/// `votes` must be zeroed and `rowCount` at most `BLOCK_SIZE`.
+static void _LNKDecisionForestVoteForBlock(LNKDecisionForestRef forest, const LNKFloat *rows, LNKSize rowCount, LNKSize columnCount, LNKFloat *votes) {
+	const _LNKPackedNode *nodes = forest->nodes;
+	const LNKSize classCount = forest->classCount;
+	uint32_t nodeIndices[BLOCK_SIZE];
+	
+	for (LNKSize tree = 0; tree < forest->treeCount; tree++) {
+		for (LNKSize row = 0; row < rowCount; row++)
+			nodeIndices[row] = forest->rootIndices[tree];
+		
+		// Advance every row by one level per pass until all of them have reached a leaf.
+		BOOL hasPendingRows = YES;
+		
+		while (hasPendingRows) {
+			hasPendingRows = NO;
+			
+			for (LNKSize row = 0; row < rowCount; row++) {
+				const _LNKPackedNode *node = nodes + nodeIndices[row];
+				
+				if (node->columnIndex == LEAF_COLUMN)
+					continue;
+				
+				const LNKFloat value = rows[row * columnCount + node->columnIndex];
+				hasPendingRows = YES;
+				
+				if (!node->valueCount) {
+					// Missing values compare false and take the upper branch.
+					nodeIndices[row] = node->firstBranchIndex + (value <= node->threshold ? 0 : 1);
+				}
+				else if (value >= 0 && value < node->valueCount && value == floor(value)) {
+					nodeIndices[row] = node->firstBranchIndex + (uint32_t)value;
+				}
+				else {
+					nodeIndices[row] = UNKNOWN_VALUE_NODE;
+				}
+			}
+		}
+		
+		for (LNKSize row = 0; row < rowCount; row++) {
+			const uint32_t classIndex = nodes[nodeIndices[row]].firstBranchIndex;
+			
+			if (classIndex != NO_CLASS)
+				votes[row * classCount + classIndex]++;
+		}
+	}
+}
+
+void LNKDecisionForestPredictVotes(LNKDecisionForestRef forest, const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount, LNKFloat *outVotes) {
+	NSCParameterAssert(forest);
+	NSCParameterAssert(matrix || !rowCount);
+	NSCParameterAssert(outVotes || !rowCount);
+	
+	const LNKSize classCount = forest->classCount;
+	LNK_vclr(outVotes, UNIT_STRIDE, rowCount * classCount);
+	
+	// Single rows, as predicted one at a time, aren't worth handing off to other threads.
+	if (rowCount <= BLOCK_SIZE) {
+		_LNKDecisionForestVoteForBlock(forest, matrix, rowCount, columnCount, outVotes);
+		return;
+	}
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), 0, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		for (LNKSize blockStart = range.location; blockStart < range.location + range.length; blockStart += BLOCK_SIZE) {
+			const LNKSize blockLength = MIN(BLOCK_SIZE, range.location + range.length - blockStart);
+			_LNKDecisionForestVoteForBlock(forest, matrix + blockStart * columnCount, blockLength, columnCount, outVotes + blockStart * classCount);
+		}
+	});
+}
+
+void LNKDecisionForestPredictProbabilities(LNKDecisionForestRef forest, const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount, LNKFloat *outProbabilities) {
+	LNKDecisionForestPredictVotes(forest, matrix, rowCount, columnCount, outProbabilities);
+	
+	const LNKSize classCount = forest->classCount;
+	
+	for (LNKSize row = 0; row < rowCount; row++) {
+		LNKFloat *rowProbabilities = outProbabilities + row * classCount;
+		LNKFloat voteCount;
+		LNK_vsum(rowProbabilities, UNIT_STRIDE, &voteCount, classCount);
+		
+		if (voteCount > 0) {
+			const LNKFloat scale = 1 / voteCount;
+			LNK_vsmul(rowProbabilities, UNIT_STRIDE, &scale, rowProbabilities, UNIT_STRIDE, classCount);
+		}
+	}
+}
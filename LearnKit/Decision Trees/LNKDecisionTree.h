@@ -5,38 +5,55 @@
 //  Copyright (c) 2014 Matt Rajca. All rights reserved.
 //
 
-#import "LNKClassifier.h"
-
-NS_ASSUME_NONNULL_BEGIN
-
-@interface LNKDecisionTreeNode : NSObject
-
-@end
-
-
-@interface LNKDecisionTreeClassificationNode : LNKDecisionTreeNode
-
-- (instancetype)init NS_UNAVAILABLE;
-
-+ (instancetype)withClass:(LNKClass *)class;
-+ (instancetype)unknownClass;
-
-@property (nonatomic, nullable, readonly) LNKClass *classification;
-
-@end
-
-
-@interface LNKDecisionTreeSplitNode : LNKDecisionTreeNode
-
-- (instancetype)init NS_UNAVAILABLE;
-- (instancetype)initWithColumnIndex:(LNKSize)columnIndex;
-
-@property (nonatomic, readonly) LNKSize columnIndex;
-
-- (void)addBranch:(LNKDecisionTreeNode *)branch value:(LNKSize)value;
-
-- (nullable LNKDecisionTreeNode *)branchForValue:(LNKSize)value;
-
-@end
-
-NS_ASSUME_NONNULL_END
+#import "LNKTypes.h"
+
+/// Passed as a column's value count to treat its values as continuous rather than categorical.
+#define LNKDecisionTreeContinuousColumn LNKSizeMax
+
+/// A node of a decision tree over categorical and continuous columns.
+typedef struct {
+	/// The column split on, or `LNKSizeMax` for leaves.
+	LNKSize columnIndex;
+	
+	/// Splits branch to `valueCount` consecutive nodes starting at `firstBranchIndex`, one per value of the column.
+	LNKSize valueCount;
+	LNKSize firstBranchIndex;
+	
+	/// The class of leaves, or `LNKSizeMax` if no training examples reached them.
+	LNKSize classIndex;
+	
+	/// Splits on continuous columns have two branches: values up to `threshold` take the first one, and all others,
+	/// including missing (NaN) values, the second. `threshold` is NaN for splits on categorical columns.
+	LNKFloat threshold;
+} LNKDecisionTreeNode;
+
+/// The columns of a matrix coded for growing trees, stored column by column. Categorical values are coded as themselves,
+/// or as their column's value count if outside of its categories, while continuous columns are quantized into at most
+/// 256 bins of about as many rows each. Codes take a byte per row, except in categorical columns with more than 255 values,
+/// which take two. A store is read-only once created, so trees can share it while growing in parallel.
+typedef struct _LNKDecisionTreeFeatureStore LNKDecisionTreeFeatureStore;
+typedef LNKDecisionTreeFeatureStore *LNKDecisionTreeFeatureStoreRef;
+
+/// Codes the `rowCount` rows of the row-major `matrix`. Values of column `i` are categorical in [0, `columnValueCounts[i]`),
+/// or continuous if its value count is `LNKDecisionTreeContinuousColumn`. Columns are coded in parallel.
+LNKDecisionTreeFeatureStoreRef LNKDecisionTreeFeatureStoreCreate(const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount, const LNKSize *columnValueCounts);
+void LNKDecisionTreeFeatureStoreFree(LNKDecisionTreeFeatureStoreRef store);
+
+/// A decision tree stored as a flat array of nodes, with the root at index 0.
+typedef struct _LNKDecisionTree LNKDecisionTree;
+typedef LNKDecisionTree *LNKDecisionTreeRef;
+
+/// Grows a tree on the rows of `store` at `exampleIndices`, which are partitioned in place and may repeat.
+/// Each split picks the column with the greatest information gain among `columnIndices`, which must be in ascending order.
+/// Categorical columns are split on once along a path, whereas continuous columns can be split on again at other bin
+/// thresholds. Gains are computed from class histograms over the codes of each column, so no split needs a pass over
+/// the examples. Outputs are class indices in [0, `classCount`).
+LNKDecisionTreeRef LNKDecisionTreeCreate(LNKDecisionTreeFeatureStoreRef store, const LNKFloat *outputVector, LNKSize classCount, LNKSize *exampleIndices, LNKSize exampleCount, const LNKSize *columnIndices, LNKSize columnIndexCount);
+void LNKDecisionTreeFree(LNKDecisionTreeRef tree);
+
+LNKSize LNKDecisionTreeGetNodeCount(LNKDecisionTreeRef tree);
+const LNKDecisionTreeNode *LNKDecisionTreeGetNodes(LNKDecisionTreeRef tree);
+
+/// Returns the class of the leaf `featureVector` ends up at, or `LNKSizeMax` if it reaches a leaf without a class or
+/// has a value outside of the categories of a categorical column along the way.
+LNKSize LNKDecisionTreePredict(LNKDecisionTreeRef tree, const LNKFloat *featureVector);
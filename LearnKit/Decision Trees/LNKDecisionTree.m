@@ -7,68 +7,650 @@
 
 #import "LNKDecisionTree.h"
 
-@implementation LNKDecisionTreeNode
+#import "LNKAccelerate.h"
+#import "LNKExecutor.h"
 
-@end
+#define INITIAL_NODE_CAPACITY 64
+#define MAX_BIN_COUNT 256
 
+// Columns with at most this many codes store them in a byte per row.
+#define MAX_NARROW_CODE_COUNT 256
 
-@implementation LNKDecisionTreeClassificationNode
+struct _LNKDecisionTree {
+	LNKDecisionTreeNode *nodes;
+	LNKSize nodeCount;
+	LNKSize nodeCapacity;
+};
 
-+ (instancetype)withClass:(LNKClass *)class {
-	NSParameterAssert(class);
+struct _LNKDecisionTreeFeatureStore {
+	LNKSize rowCount;
+	LNKSize columnCount;
+	LNKSize *columnValueCounts;
 	
-	return [[[self alloc] initWithClass:class] autorelease];
+	// The number of distinct codes of each column: its bins, or its categories and one more for values outside of them.
+	LNKSize *codeCounts;
+	
+	// `rowCount` codes per column, starting `codeOffsets[column]` bytes in. Codes take a byte each, or two bytes in
+	// categorical columns with more than `MAX_NARROW_CODE_COUNT` codes.
+	uint8_t *codes;
+	LNKSize *codeOffsets;
+	
+	// `MAX_BIN_COUNT - 1` thresholds per column, where values up to `thresholds[bin]` fall into `bin` or below.
+	LNKFloat *thresholds;
+};
+
+/// A column tracked while growing a tree, whose class counts per code start at `histogramOffset` in a histogram.
+typedef struct {
+	LNKSize columnIndex;
+	LNKSize codeCount;
+	BOOL isContinuous;
+	
+	// One of these is set, depending on the width of the column's codes.
+	const uint8_t *narrowCodes;
+	const uint16_t *wideCodes;
+	
+	const LNKFloat *thresholds;
+	LNKSize histogramOffset;
+} _LNKDecisionTreeColumn;
+
+/// The state shared while growing a tree. Buffers are sized once up front and reused by every node.
+typedef struct {
+	const LNKFloat *outputVector;
+	LNKSize classCount;
+	_LNKDecisionTreeColumn *columns;
+	LNKSize columnCount;
+	
+	// Whether each of `columns` has been split on along the path to the current node.
+	// Continuous columns are never used up since they can be split again at other thresholds.
+	BOOL *usedColumns;
+	
+	// A stack of histograms holding class counts per code of every column, one level per node being grown.
+	uint32_t **histograms;
+	LNKSize histogramCount;
+	LNKSize histogramLength;
+	
+	LNKSize *classCounts;
+	LNKSize *nodeClassCounts;
+	LNKSize *upperClassCounts;
+	LNKSize *bucketOffsets;
+	LNKSize *partitionedIndices;
+	
+	// A stack of the offsets of every node's branches into its examples, one frame per node being grown.
+	LNKSize *branchOffsets;
+	LNKSize branchOffsetCount;
+	LNKSize branchOffsetCapacity;
+} _LNKDecisionTreeBuilder;
+
+static LNKSize _LNKDecisionTreeAppendNodes(LNKDecisionTreeRef tree, LNKSize count) {
+	if (tree->nodeCount + count > tree->nodeCapacity) {
+		while (tree->nodeCount + count > tree->nodeCapacity)
+			tree->nodeCapacity *= 2;
+		
+		tree->nodes = realloc(tree->nodes, tree->nodeCapacity * sizeof(LNKDecisionTreeNode));
+	}
+	
+	const LNKSize firstIndex = tree->nodeCount;
+	tree->nodeCount += count;
+	
+	return firstIndex;
+}
+
+static void _LNKDecisionTreeSetLeaf(LNKDecisionTreeRef tree, LNKSize nodeIndex, LNKSize classIndex) {
+	tree->nodes[nodeIndex] = (LNKDecisionTreeNode) { LNKSizeMax, 0, 0, classIndex, NAN };
+}
+
+/// Values that aren't one of the column's categories don't follow any branch and land in the last bucket.
+static inline LNKSize _LNKBucketForValue(LNKFloat value, LNKSize valueCount) {
+	if (value >= 0 && value < valueCount && value == floor(value))
+		return (LNKSize)value;
+	
+	return valueCount;
+}
+
+/// Returns the first bin whose threshold isn't below `value`; missing values go to the last bin.
+static uint8_t _LNKBinForValue(const LNKFloat *thresholds, LNKSize binCount, LNKFloat value) {
+	if (isnan(value))
+		return (uint8_t)(binCount - 1);
+	
+	LNKSize low = 0;
+	LNKSize high = binCount - 1;
+	
+	while (low < high) {
+		const LNKSize middle = (low + high) / 2;
+		
+		if (thresholds[middle] < value)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	
+	return (uint8_t)low;
+}
+
+static int _LNKCompareFloats(const void *a, const void *b) {
+	const LNKFloat first = *(const LNKFloat *)a;
+	const LNKFloat second = *(const LNKFloat *)b;
+	
+	return (first > second) - (first < second);
 }
 
-+ (instancetype)unknownClass {
-	return [[[self alloc] initWithClass:nil] autorelease];
+/// Cuts the sorted values of the column into bins of roughly equal size without separating equal values,
+/// so columns with few distinct values get one bin per value. `values` must have room for a value per row.
+static void _LNKQuantizeColumn(LNKDecisionTreeFeatureStoreRef store, const LNKFloat *matrix, LNKSize column, LNKFloat *values) {
+	const LNKSize rowCount = store->rowCount;
+	const LNKSize columnCount = store->columnCount;
+	LNKFloat *thresholds = store->thresholds + column * (MAX_BIN_COUNT - 1);
+	uint8_t *codes = store->codes + store->codeOffsets[column];
+	LNKSize valueCount = 0;
+	
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat value = matrix[row * columnCount + column];
+		
+		if (!isnan(value))
+			values[valueCount++] = value;
+	}
+	
+	qsort(values, valueCount, sizeof(LNKFloat), _LNKCompareFloats);
+	
+	LNKSize binCount = 1;
+	LNKSize binStart = 0;
+	
+	while (binCount < MAX_BIN_COUNT) {
+		const LNKSize remainingBinCount = MAX_BIN_COUNT - binCount + 1;
+		LNKSize binEnd = binStart + MAX(1, (valueCount - binStart) / remainingBinCount);
+		
+		while (binEnd < valueCount && values[binEnd] == values[binEnd - 1])
+			binEnd++;
+		
+		if (binEnd >= valueCount)
+			break;
+		
+		// Thresholds sit halfway between bins, unless that overflows or involves infinite values.
+		LNKFloat threshold = values[binEnd - 1] + (values[binEnd] - values[binEnd - 1]) / 2;
+		
+		if (!isfinite(threshold))
+			threshold = values[binEnd - 1];
+		
+		thresholds[binCount - 1] = threshold;
+		binCount++;
+		binStart = binEnd;
+	}
+	
+	store->codeCounts[column] = binCount;
+	
+	for (LNKSize row = 0; row < rowCount; row++)
+		codes[row] = _LNKBinForValue(thresholds, binCount, matrix[row * columnCount + column]);
 }
 
-- (instancetype)initWithClass:(nullable LNKClass *)class {
-	self = [super init];
-	if (self) {
-		_classification = [class retain];
+LNKDecisionTreeFeatureStoreRef LNKDecisionTreeFeatureStoreCreate(const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount, const LNKSize *columnValueCounts) {
+	NSCParameterAssert(matrix || !rowCount);
+	NSCParameterAssert(columnValueCounts || !columnCount);
+	
+	LNKDecisionTreeFeatureStoreRef store = malloc(sizeof(LNKDecisionTreeFeatureStore));
+	store->rowCount = rowCount;
+	store->columnCount = columnCount;
+	store->columnValueCounts = malloc(columnCount * sizeof(LNKSize));
+	store->codeCounts = malloc(columnCount * sizeof(LNKSize));
+	store->codeOffsets = malloc(columnCount * sizeof(LNKSize));
+	store->thresholds = LNKFloatAlloc(columnCount * (MAX_BIN_COUNT - 1));
+	memcpy(store->columnValueCounts, columnValueCounts, columnCount * sizeof(LNKSize));
+	
+	// Bins and most categorical columns fit in a byte, which halves the memory histograms are filled from.
+	LNKSize codeByteCount = 0;
+	
+	for (LNKSize column = 0; column < columnCount; column++) {
+		const LNKSize valueCount = columnValueCounts[column];
+		NSCAssert(valueCount == LNKDecisionTreeContinuousColumn || valueCount < UINT16_MAX, @"Categorical columns can have at most %d values", UINT16_MAX - 1);
+		
+		const size_t codeSize = valueCount != LNKDecisionTreeContinuousColumn && valueCount + 1 > MAX_NARROW_CODE_COUNT ? sizeof(uint16_t) : sizeof(uint8_t);
+		
+		// Wide codes start at an even offset so they can be read as `uint16_t`s.
+		codeByteCount = (codeByteCount + codeSize - 1) / codeSize * codeSize;
+		store->codeOffsets[column] = codeByteCount;
+		codeByteCount += rowCount * codeSize;
 	}
-	return self;
+	
+	store->codes = malloc(codeByteCount);
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, columnCount), 1, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		LNKFloat *values = NULL;
+		
+		for (LNKSize column = range.location; column < range.location + range.length; column++) {
+			const LNKSize valueCount = columnValueCounts[column];
+			
+			if (valueCount == LNKDecisionTreeContinuousColumn) {
+				if (!values)
+					values = LNKFloatAlloc(rowCount);
+				
+				_LNKQuantizeColumn(store, matrix, column, values);
+				continue;
+			}
+			
+			void *codes = store->codes + store->codeOffsets[column];
+			store->codeCounts[column] = valueCount + 1;
+			
+			if (valueCount + 1 > MAX_NARROW_CODE_COUNT) {
+				for (LNKSize row = 0; row < rowCount; row++)
+					((uint16_t *)codes)[row] = (uint16_t)_LNKBucketForValue(matrix[row * columnCount + column], valueCount);
+			}
+			else {
+				for (LNKSize row = 0; row < rowCount; row++)
+					((uint8_t *)codes)[row] = (uint8_t)_LNKBucketForValue(matrix[row * columnCount + column], valueCount);
+			}
+		}
+		
+		free(values);
+	});
+	
+	return store;
 }
 
-- (void)dealloc {
-	[_classification release];
-	[super dealloc];
+void LNKDecisionTreeFeatureStoreFree(LNKDecisionTreeFeatureStoreRef store) {
+	NSCParameterAssert(store);
+	
+	free(store->thresholds);
+	free(store->codes);
+	free(store->codeOffsets);
+	free(store->codeCounts);
+	free(store->columnValueCounts);
+	free(store);
 }
 
-@end
+/// Histograms are allocated the first time the tree grows that deep.
+static uint32_t *_LNKDecisionTreeGetHistogram(_LNKDecisionTreeBuilder *builder, LNKSize index) {
+	if (index >= builder->histogramCount) {
+		builder->histograms = realloc(builder->histograms, (index + 1) * sizeof(uint32_t *));
+		
+		for (LNKSize histogram = builder->histogramCount; histogram <= index; histogram++)
+			builder->histograms[histogram] = malloc(builder->histogramLength * sizeof(uint32_t));
+		
+		builder->histogramCount = index + 1;
+	}
+	
+	return builder->histograms[index];
+}
 
+/// Codes are gathered column by column, which reads each column's codes in order when the examples are.
+static void _LNKDecisionTreeFillHistogram(const _LNKDecisionTreeBuilder *builder, uint32_t *histogram, const LNKSize *exampleIndices, LNKSize exampleCount) {
+	const LNKSize classCount = builder->classCount;
+	memset(histogram, 0, builder->histogramLength * sizeof(uint32_t));
+	
+	for (LNKSize position = 0; position < builder->columnCount; position++) {
+		const _LNKDecisionTreeColumn *column = &builder->columns[position];
+		uint32_t *columnHistogram = histogram + column->histogramOffset;
+		
+		if (column->narrowCodes) {
+			const uint8_t *codes = column->narrowCodes;
+			
+			for (LNKSize example = 0; example < exampleCount; example++) {
+				const LNKSize row = exampleIndices[example];
+				columnHistogram[codes[row] * classCount + (LNKSize)builder->outputVector[row]]++;
+			}
+		}
+		else {
+			const uint16_t *codes = column->wideCodes;
+			
+			for (LNKSize example = 0; example < exampleCount; example++) {
+				const LNKSize row = exampleIndices[example];
+				columnHistogram[codes[row] * classCount + (LNKSize)builder->outputVector[row]]++;
+			}
+		}
+	}
+}
 
+/// Returns the index of `count` offsets pushed onto the stack. The stack may be reallocated, so offsets are
+/// looked up by index rather than by pointer across calls that grow branches.
+static LNKSize _LNKDecisionTreePushBranchOffsets(_LNKDecisionTreeBuilder *builder, LNKSize count) {
+	if (builder->branchOffsetCount + count > builder->branchOffsetCapacity) {
+		while (builder->branchOffsetCount + count > builder->branchOffsetCapacity)
+			builder->branchOffsetCapacity *= 2;
+		
+		builder->branchOffsets = realloc(builder->branchOffsets, builder->branchOffsetCapacity * sizeof(LNKSize));
+	}
+	
+	const LNKSize firstIndex = builder->branchOffsetCount;
+	builder->branchOffsetCount += count;
+	
+	return firstIndex;
+}
 
-@implementation LNKDecisionTreeSplitNode {
-	NSMutableDictionary *_branches;
+static LNKFloat _LNKEntropy(const LNKSize *classCounts, LNKSize classCount, LNKSize total) {
+	LNKFloat sum = 0;
+	
+	for (LNKSize class = 0; class < classCount; class++) {
+		if (classCounts[class]) {
+			const LNKFloat fraction = (LNKFloat)classCounts[class] / total;
+			sum -= fraction * LNKLog2(fraction);
+		}
+	}
+	
+	return sum;
 }
 
-- (instancetype)initWithColumnIndex:(LNKSize)columnIndex {
-	NSParameterAssert(columnIndex != LNKSizeMax);
+/// The histogram at `histogramIndex` must hold the class counts of the examples for every code of the columns.
+static void _LNKDecisionTreeGrow(_LNKDecisionTreeBuilder *builder, LNKDecisionTreeRef tree, LNKSize nodeIndex, LNKSize *exampleIndices, LNKSize exampleCount, LNKSize histogramIndex) {
+	const LNKFloat *outputVector = builder->outputVector;
+	const LNKSize classCount = builder->classCount;
+	LNKSize *classCounts = builder->classCounts;
+	LNKSize *nodeClassCounts = builder->nodeClassCounts;
+	LNKSize *upperClassCounts = builder->upperClassCounts;
+	
+	if (!exampleCount) {
+		_LNKDecisionTreeSetLeaf(tree, nodeIndex, LNKSizeMax);
+		return;
+	}
+	
+	memset(nodeClassCounts, 0, classCount * sizeof(LNKSize));
+	BOOL allSame = YES;
+	
+	for (LNKSize example = 0; example < exampleCount; example++) {
+		const LNKFloat output = outputVector[exampleIndices[example]];
+		nodeClassCounts[(LNKSize)output]++;
+		
+		if (output != outputVector[exampleIndices[0]])
+			allSame = NO;
+	}
+	
+	if (allSame) {
+		_LNKDecisionTreeSetLeaf(tree, nodeIndex, (LNKSize)outputVector[exampleIndices[0]]);
+		return;
+	}
+	
+	// Split on the column with the greatest information gain; ties go to the earliest column, then the lowest threshold.
+	const LNKFloat currentEntropy = _LNKEntropy(nodeClassCounts, classCount, exampleCount);
+	LNKFloat bestInformationGain = LNKFloatMin;
+	LNKSize bestPosition = LNKSizeMax;
+	LNKSize bestBin = 0;
+	
+	for (LNKSize position = 0; position < builder->columnCount; position++) {
+		const _LNKDecisionTreeColumn *column = &builder->columns[position];
+		const uint32_t *columnHistogram = builder->histograms[histogramIndex] + column->histogramOffset;
+		
+		if (column->isContinuous) {
+			// Sweep the bins, keeping class counts of the examples at or below each threshold.
+			LNKSize lowerExampleCount = 0;
+			memset(classCounts, 0, classCount * sizeof(LNKSize));
+			
+			for (LNKSize bin = 0; bin + 1 < column->codeCount; bin++) {
+				for (LNKSize class = 0; class < classCount; class++) {
+					classCounts[class] += columnHistogram[bin * classCount + class];
+					lowerExampleCount += columnHistogram[bin * classCount + class];
+				}
+				
+				if (!lowerExampleCount)
+					continue;
+				
+				if (lowerExampleCount == exampleCount)
+					break;
+				
+				const LNKSize upperExampleCount = exampleCount - lowerExampleCount;
+				
+				for (LNKSize class = 0; class < classCount; class++)
+					upperClassCounts[class] = nodeClassCounts[class] - classCounts[class];
+				
+				const LNKFloat expectation = (LNKFloat)lowerExampleCount / exampleCount * _LNKEntropy(classCounts, classCount, lowerExampleCount) +
+											 (LNKFloat)upperExampleCount / exampleCount * _LNKEntropy(upperClassCounts, classCount, upperExampleCount);
+				const LNKFloat informationGain = currentEntropy - expectation;
+				
+				if (informationGain > bestInformationGain) {
+					bestInformationGain = informationGain;
+					bestPosition = position;
+					bestBin = bin;
+				}
+			}
+			
+			continue;
+		}
+		
+		if (builder->usedColumns[position])
+			continue;
+		
+		// Examples outside of the column's categories, counted under the last code, don't follow any branch.
+		LNKFloat expectation = 0;
+		
+		for (LNKSize value = 0; value + 1 < column->codeCount; value++) {
+			LNKSize valueExampleCount = 0;
+			
+			for (LNKSize class = 0; class < classCount; class++) {
+				classCounts[class] = columnHistogram[value * classCount + class];
+				valueExampleCount += classCounts[class];
+			}
+			
+			const LNKFloat probability = (LNKFloat)valueExampleCount / exampleCount;
+			expectation += probability * _LNKEntropy(classCounts, classCount, valueExampleCount);
+		}
+		
+		const LNKFloat informationGain = currentEntropy - expectation;
+		
+		if (informationGain > bestInformationGain) {
+			bestInformationGain = informationGain;
+			bestPosition = position;
+		}
+	}
+	
+	// Out of categorical columns, and no continuous column separates the examples.
+	if (bestPosition == LNKSizeMax) {
+		// Ties go to the lowest class.
+		LNKSize mostFrequentClass = 0;
+		
+		for (LNKSize class = 1; class < classCount; class++) {
+			if (nodeClassCounts[class] > nodeClassCounts[mostFrequentClass])
+				mostFrequentClass = class;
+		}
+		
+		_LNKDecisionTreeSetLeaf(tree, nodeIndex, mostFrequentClass);
+		return;
+	}
+	
+	const _LNKDecisionTreeColumn *splitColumn = &builder->columns[bestPosition];
+	const BOOL isContinuous = splitColumn->isContinuous;
+	const uint8_t *narrowCodes = splitColumn->narrowCodes;
+	const uint16_t *wideCodes = splitColumn->wideCodes;
+	
+	// Continuous splits have one branch for examples at or below the threshold and another for the rest.
+	const LNKSize valueCount = isContinuous ? 2 : splitColumn->codeCount - 1;
+	
+	#define CODE_FOR_ROW(row) (narrowCodes ? (LNKSize)narrowCodes[row] : (LNKSize)wideCodes[row])
+	#define BUCKET_FOR_ROW(row) (isContinuous ? (LNKSize)(CODE_FOR_ROW(row) > bestBin) : CODE_FOR_ROW(row))
+	
+	// Partition the examples by value with a counting sort, which keeps them in order within each branch.
+	LNKSize *bucketOffsets = builder->bucketOffsets;
+	memset(bucketOffsets, 0, (valueCount + 3) * sizeof(LNKSize));
+	
+	for (LNKSize example = 0; example < exampleCount; example++)
+		bucketOffsets[BUCKET_FOR_ROW(exampleIndices[example]) + 2]++;
+	
+	for (LNKSize bucket = 2; bucket < valueCount + 2; bucket++)
+		bucketOffsets[bucket] += bucketOffsets[bucket - 1];
+	
+	// Scattering advances `bucketOffsets[bucket + 1]` to the end of each bucket, so `bucketOffsets[value]` marks its start.
+	LNKSize *partitionedIndices = builder->partitionedIndices;
+	
+	for (LNKSize example = 0; example < exampleCount; example++) {
+		const LNKSize row = exampleIndices[example];
+		partitionedIndices[bucketOffsets[BUCKET_FOR_ROW(row) + 1]++] = row;
+	}
+	
+	#undef BUCKET_FOR_ROW
+	#undef CODE_FOR_ROW
+	
+	memcpy(exampleIndices, partitionedIndices, exampleCount * sizeof(LNKSize));
+	
+	// The buffers are reused by the branches, so take the offsets along.
+	// The final bucket holds the examples outside of the column's categories.
+	const LNKSize firstOffsetIndex = _LNKDecisionTreePushBranchOffsets(builder, valueCount + 2);
+	memcpy(builder->branchOffsets + firstOffsetIndex, bucketOffsets, (valueCount + 1) * sizeof(LNKSize));
+	builder->branchOffsets[firstOffsetIndex + valueCount + 1] = exampleCount;
+	
+	#define BRANCH_OFFSET(bucket) (builder->branchOffsets[firstOffsetIndex + (bucket)])
 	
-	self = [super init];
-	if (self) {
-		_columnIndex = columnIndex;
-		_branches = [[NSMutableDictionary alloc] init];
+	const LNKSize firstBranchIndex = _LNKDecisionTreeAppendNodes(tree, valueCount);
+	const LNKFloat threshold = isContinuous ? splitColumn->thresholds[bestBin] : NAN;
+	tree->nodes[nodeIndex] = (LNKDecisionTreeNode) { splitColumn->columnIndex, valueCount, firstBranchIndex, LNKSizeMax, threshold };
+	
+	if (!isContinuous)
+		builder->usedColumns[bestPosition] = YES;
+	
+	// Rather than scanning every branch, the largest one inherits this node's histogram
+	// once the histograms of the other buckets have been subtracted from it.
+	LNKSize largestBranch = 0;
+	
+	for (LNKSize value = 1; value < valueCount; value++) {
+		if (BRANCH_OFFSET(value + 1) - BRANCH_OFFSET(value) > BRANCH_OFFSET(largestBranch + 1) - BRANCH_OFFSET(largestBranch))
+			largestBranch = value;
 	}
-	return self;
+	
+	for (LNKSize bucket = 0; bucket <= valueCount; bucket++) {
+		LNKSize *bucketExampleIndices = exampleIndices + BRANCH_OFFSET(bucket);
+		const LNKSize bucketExampleCount = BRANCH_OFFSET(bucket + 1) - BRANCH_OFFSET(bucket);
+		
+		if (bucket == largestBranch)
+			continue;
+		
+		if (bucketExampleCount) {
+			// Growing branches may reallocate the stack, so histograms are looked up afresh for every bucket.
+			uint32_t *bucketHistogram = _LNKDecisionTreeGetHistogram(builder, histogramIndex + 1);
+			_LNKDecisionTreeFillHistogram(builder, bucketHistogram, bucketExampleIndices, bucketExampleCount);
+			
+			uint32_t *histogram = builder->histograms[histogramIndex];
+			
+			for (LNKSize index = 0; index < builder->histogramLength; index++)
+				histogram[index] -= bucketHistogram[index];
+		}
+		
+		if (bucket < valueCount)
+			_LNKDecisionTreeGrow(builder, tree, firstBranchIndex + bucket, bucketExampleIndices, bucketExampleCount, histogramIndex + 1);
+	}
+	
+	const LNKSize largestBranchOffset = BRANCH_OFFSET(largestBranch);
+	const LNKSize largestBranchExampleCount = BRANCH_OFFSET(largestBranch + 1) - largestBranchOffset;
+	
+	#undef BRANCH_OFFSET
+	
+	// The largest branch is grown last, so this node's frame can be popped before recursing into it.
+	builder->branchOffsetCount = firstOffsetIndex;
+	_LNKDecisionTreeGrow(builder, tree, firstBranchIndex + largestBranch, exampleIndices + largestBranchOffset, largestBranchExampleCount, histogramIndex);
+	
+	if (!isContinuous)
+		builder->usedColumns[bestPosition] = NO;
 }
 
-- (void)dealloc {
-	[_branches release];
-	[super dealloc];
+LNKDecisionTreeRef LNKDecisionTreeCreate(LNKDecisionTreeFeatureStoreRef store, const LNKFloat *outputVector, LNKSize classCount, LNKSize *exampleIndices, LNKSize exampleCount, const LNKSize *columnIndices, LNKSize columnIndexCount) {
+	NSCParameterAssert(store);
+	NSCParameterAssert(outputVector);
+	NSCParameterAssert(classCount);
+	NSCParameterAssert(exampleIndices || !exampleCount);
+	NSCParameterAssert(columnIndices || !columnIndexCount);
+	NSCParameterAssert(exampleCount <= UINT32_MAX);
+	
+	_LNKDecisionTreeBuilder builder = {
+		.outputVector = outputVector,
+		.classCount = classCount,
+		.columns = malloc(columnIndexCount * sizeof(_LNKDecisionTreeColumn)),
+		.columnCount = columnIndexCount,
+		.usedColumns = calloc(columnIndexCount, sizeof(BOOL)),
+		.classCounts = malloc(classCount * sizeof(LNKSize)),
+		.nodeClassCounts = malloc(classCount * sizeof(LNKSize)),
+		.upperClassCounts = malloc(classCount * sizeof(LNKSize)),
+		.partitionedIndices = malloc(exampleCount * sizeof(LNKSize))
+	};
+	
+	LNKSize maximumValueCount = 2;
+	
+	for (LNKSize position = 0; position < columnIndexCount; position++) {
+		const LNKSize columnIndex = columnIndices[position];
+		NSCAssert(columnIndex < store->columnCount, @"Invalid column");
+		
+		const LNKSize codeCount = store->codeCounts[columnIndex];
+		const BOOL isContinuous = store->columnValueCounts[columnIndex] == LNKDecisionTreeContinuousColumn;
+		const BOOL hasWideCodes = !isContinuous && codeCount > MAX_NARROW_CODE_COUNT;
+		uint8_t *const codes = store->codes + store->codeOffsets[columnIndex];
+		
+		builder.columns[position] = (_LNKDecisionTreeColumn) {
+			.columnIndex = columnIndex,
+			.codeCount = codeCount,
+			.isContinuous = isContinuous,
+			.narrowCodes = hasWideCodes ? NULL : codes,
+			.wideCodes = hasWideCodes ? (const uint16_t *)codes : NULL,
+			.thresholds = store->thresholds + columnIndex * (MAX_BIN_COUNT - 1),
+			.histogramOffset = builder.histogramLength
+		};
+		
+		builder.histogramLength += store->codeCounts[columnIndex] * classCount;
+		maximumValueCount = MAX(maximumValueCount, store->codeCounts[columnIndex]);
+	}
+	
+	builder.bucketOffsets = malloc((maximumValueCount + 3) * sizeof(LNKSize));
+	builder.branchOffsetCapacity = 4 * (maximumValueCount + 2);
+	builder.branchOffsets = malloc(builder.branchOffsetCapacity * sizeof(LNKSize));
+	
+	LNKDecisionTreeRef tree = malloc(sizeof(LNKDecisionTree));
+	tree->nodeCapacity = INITIAL_NODE_CAPACITY;
+	tree->nodeCount = 0;
+	tree->nodes = malloc(tree->nodeCapacity * sizeof(LNKDecisionTreeNode));
+	
+	_LNKDecisionTreeFillHistogram(&builder, _LNKDecisionTreeGetHistogram(&builder, 0), exampleIndices, exampleCount);
+	
+	const LNKSize rootIndex = _LNKDecisionTreeAppendNodes(tree, 1);
+	_LNKDecisionTreeGrow(&builder, tree, rootIndex, exampleIndices, exampleCount, 0);
+	
+	for (LNKSize histogram = 0; histogram < builder.histogramCount; histogram++)
+		free(builder.histograms[histogram]);
+	
+	free(builder.histograms);
+	free(builder.partitionedIndices);
+	free(builder.branchOffsets);
+	free(builder.bucketOffsets);
+	free(builder.upperClassCounts);
+	free(builder.nodeClassCounts);
+	free(builder.classCounts);
+	free(builder.usedColumns);
+	free(builder.columns);
+	
+	return tree;
 }
 
-- (void)addBranch:(LNKDecisionTreeNode *)branch value:(LNKSize)value {
-	NSParameterAssert(branch);
+void LNKDecisionTreeFree(LNKDecisionTreeRef tree) {
+	NSCParameterAssert(tree);
 	
-	_branches[@(value)] = branch;
+	free(tree->nodes);
+	free(tree);
 }
 
-- (LNKDecisionTreeNode *)branchForValue:(LNKSize)value {
-	return _branches[@(value)];
+LNKSize LNKDecisionTreeGetNodeCount(LNKDecisionTreeRef tree) {
+	NSCParameterAssert(tree);
+	return tree->nodeCount;
 }
 
-@end
+const LNKDecisionTreeNode *LNKDecisionTreeGetNodes(LNKDecisionTreeRef tree) {
+	NSCParameterAssert(tree);
+	return tree->nodes;
+}
+
+LNKSize LNKDecisionTreePredict(LNKDecisionTreeRef tree, const LNKFloat *featureVector) {
+	NSCParameterAssert(tree);
+	NSCParameterAssert(featureVector);
+	
+	const LNKDecisionTreeNode *node = tree->nodes;
+	
+	while (node->columnIndex != LNKSizeMax) {
+		const LNKFloat value = featureVector[node->columnIndex];
+		LNKSize branch;
+		
+		if (!isnan(node->threshold)) {
+			// Missing values compare false and take the upper branch, as they fall into the last bin during training.
+			branch = value <= node->threshold ? 0 : 1;
+		}
+		else {
+			branch = _LNKBucketForValue(value, node->valueCount);
+			
+			if (branch == node->valueCount)
+				return LNKSizeMax;
+		}
+		
+		node = tree->nodes + node->firstBranchIndex + branch;
+	}
+	
+	return node->classIndex;
+}
@@ -1,14 +0,0 @@
-//
-//  LNKDecisionTreeClassifier+Private.h
-//  LearnKit
-//
-//  Copyright © 2016 Matt Rajca. All rights reserved.
-//
-
-#import "LNKDecisionTreeClassifier.h"
-
-@interface LNKDecisionTreeClassifier (Private)
-
-- (void)_setColumnsToPossibleValues:(NSDictionary<NSNumber *, NSNumber *> *)values;
-
-@end
@@ -9,7 +9,7 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-/// A decision tree classifier for matrices of discrete values.
+/// A decision tree classifier for matrices of discrete and continuous values.
 /// The optimization algorithm is ignored and can be `nil`.
 /// The value types of the matrix must be registered prior to training.
 /// Output labels must be specified in form of classes.
@@ -23,6 +23,15 @@ NS_ASSUME_NONNULL_BEGIN
 /// Indicates values at `columnIndex` are categorical in range [0, valueCount).
 - (void)registerCategoricalValues:(LNKSize)valueCount forColumnAtIndex:(LNKSize)columnIndex;
 
+/// Indicates values at `columnIndex` are continuous. Splits on such columns compare values against thresholds,
+/// with missing (NaN) values following the upper branch.
+- (void)registerContinuousValuesForColumnAtIndex:(LNKSize)columnIndex;
+
+/// Scores every row of `matrix`, which must have as many columns as the training matrix, against a packed copy of the tree.
+/// `outputBuffer` must have room for `matrix.rowCount * classes.count` values and receives a probability of 1 for the
+/// predicted class of each row. Rows the tree can't classify get probabilities of 0.
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
 @end
 
 NS_ASSUME_NONNULL_END
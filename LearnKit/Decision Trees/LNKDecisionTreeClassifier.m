@@ -8,15 +8,16 @@
 #import "LNKDecisionTreeClassifier.h"
 
 #import "LNKAccelerate.h"
+#import "LNKClassifierPrivate.h"
+#import "LNKDecisionForest.h"
 #import "LNKDecisionTree.h"
 #import "LNKMatrix.h"
-#import "NSCountedSetAdditions.h"
-#import "NSIndexSetAdditions.h"
 
 @implementation LNKDecisionTreeClassifier {
 	NSIndexSet *_exampleIndices;
 	NSIndexSet *_columnIndices;
-	LNKDecisionTreeNode *_learnedTree;
+	LNKDecisionTreeRef _learnedTree;
+	LNKDecisionForestRef _packedTree;
 	NSMutableDictionary<NSNumber *, NSNumber *> *_columnsToPossibleValues;
 }
 
@@ -35,15 +36,6 @@
 	return [self class];
 }
 
-- (void)_setColumnsToPossibleValues:(NSDictionary<NSNumber *, NSNumber *> *)values {
-	if (_columnsToPossibleValues != nil) {
-		[_columnsToPossibleValues release];
-		_columnsToPossibleValues = nil;
-	}
-
-	_columnsToPossibleValues = [values copy];
-}
-
 - (instancetype)initWithMatrix:(LNKMatrix *)matrix implementationType:(LNKImplementationType)implementation optimizationAlgorithm:(id<LNKOptimizationAlgorithm>)algorithm classes:(LNKClasses *)classes {
 	NSIndexSet *allColumns = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, matrix.columnCount)];
 	NSIndexSet *allExamples = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, matrix.rowCount)];
@@ -62,7 +54,14 @@
 }
 
 - (void)dealloc {
-	[_learnedTree release];
+	if (_learnedTree)
+		LNKDecisionTreeFree(_learnedTree);
+	
+	if (_packedTree)
+		LNKDecisionForestFree(_packedTree);
+	
+	[_exampleIndices release];
+	[_columnIndices release];
 	[_columnsToPossibleValues release];
 	
 	[super dealloc];
@@ -79,234 +78,114 @@
 	_columnsToPossibleValues[@(columnIndex)] = @(valueCount);
 }
 
-- (BOOL)_doExamplesAtIndicesHaveSameLabel:(NSIndexSet *)indices {
-	NSParameterAssert(indices);
-	
-	const LNKFloat *outputVector = self.matrix.outputVector;
-	LNKSize firstClass = outputVector[indices.firstIndex];
-	
-	__block BOOL allSame = YES;
-	
-	[indices enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
-		if (outputVector[index] != firstClass) {
-			allSame = NO;
-			*stop = YES;
-		}
-	}];
-	
-	return allSame;
-}
-
-- (void)_enumerateExampleIndices:(NSIndexSet *)exampleIndices withColumnIndex:(LNKSize)columnIndex value:(LNKSize)value performBlock:(NSIndexSetSimpleEnumerator)block {
-	NSParameterAssert(exampleIndices);
-	NSParameterAssert(columnIndex != LNKSizeMax);
-	NSParameterAssert(columnIndex < self.matrix.columnCount);
-	NSParameterAssert(block);
-	
-	LNKMatrix *matrix = self.matrix;
-	
-	[exampleIndices enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
-#pragma unused(stop)
-		
-		const LNKFloat *example = [matrix rowAtIndex:index];
-		
-		if (example[columnIndex] == value)
-			block(index);
-	}];
+- (void)registerContinuousValuesForColumnAtIndex:(LNKSize)columnIndex {
+	[self registerCategoricalValues:LNKDecisionTreeContinuousColumn forColumnAtIndex:columnIndex];
 }
 
-- (NSIndexSet *)_filterExampleIndices:(NSIndexSet *)exampleIndices withColumnIndex:(LNKSize)columnIndex value:(LNKSize)value {
-	NSMutableIndexSet *filteredExampleIndices = [[NSMutableIndexSet alloc] init];
-	
-	[self _enumerateExampleIndices:exampleIndices withColumnIndex:columnIndex value:value performBlock:^(NSUInteger index) {
-		[filteredExampleIndices addIndex:index];
-	}];
+- (void)validate {
+	const LNKSize columnCount = self.matrix.columnCount;
 	
-	return [filteredExampleIndices autorelease];
+	for (LNKSize column = 0; column < columnCount; column++) {
+		if (!_columnsToPossibleValues[@(column)]) {
+			[NSException raise:NSInternalInconsistencyException
+						format:@"A value type has not been registered for column %lld.", column];
+		}
+	}
 }
 
-- (LNKFloat)_countFractionOfExampleIndices:(NSIndexSet *)exampleIndices withColumnIndex:(LNKSize)columnIndex value:(LNKSize)value {
-	__block LNKSize count = 0;
+/// The result must be freed by the caller.
+static LNKSize *_LNKCopyIndices(NSIndexSet *indexSet) {
+	LNKSize *indices = malloc(indexSet.count * sizeof(LNKSize));
+	__block LNKSize position = 0;
 	
-	[self _enumerateExampleIndices:exampleIndices withColumnIndex:columnIndex value:value performBlock:^(NSUInteger index) {
-#pragma unused(index)
-		count++;
+	[indexSet enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+#pragma unused(stop)
+		indices[position++] = index;
 	}];
 	
-	return (LNKFloat)count / exampleIndices.count;
+	return indices;
 }
 
-static LNKFloat _calculateEntropyForClasses(NSCountedSet<LNKClass *> *classFrequencies) {
-	LNKSize total = 0;
-	
-	for (LNKClass *class in classFrequencies) {
-		total += [classFrequencies countForObject:class];
+- (void)train {
+	if (_learnedTree) {
+		LNKDecisionTreeFree(_learnedTree);
+		_learnedTree = NULL;
 	}
 	
-	LNKFloat sum = 0;
-	
-	for (LNKClass *class in classFrequencies) {
-		const NSUInteger frequency = [classFrequencies countForObject:class];
-		
-		if (frequency) {
-			const LNKFloat fraction = (LNKFloat)frequency / total;
-			sum -= fraction * LNKLog2(fraction);
-		}
+	if (_packedTree) {
+		LNKDecisionForestFree(_packedTree);
+		_packedTree = NULL;
 	}
 	
-	return sum;
-}
-
-- (LNKFloat)_calculateEntropyOfExampleIndices:(NSIndexSet *)exampleIndices {
-	return [self _calculateEntropyOfExampleIndices:exampleIndices withColumnIndex:LNKSizeMax value:LNKSizeMax];
-}
-
-- (LNKFloat)_calculateEntropyOfExampleIndices:(NSIndexSet *)exampleIndices withColumnIndex:(LNKSize)columnIndex value:(LNKSize)value  {
-	NSParameterAssert(exampleIndices);
-	
-	LNKMatrix *matrix = self.matrix;
-	NSCountedSet<LNKClass *> *classFrequencies = [[NSCountedSet alloc] init];
-	
-	NSIndexSetSimpleEnumerator enumerator = ^(NSUInteger index) {
-		[classFrequencies addObject:[LNKClass classWithUnsignedInteger:matrix.outputVector[index]]];
-	};
+	LNKMatrix *const matrix = self.matrix;
+	const LNKSize columnCount = matrix.columnCount;
+	const LNKSize classCount = self.classes.count;
+	const LNKFloat *outputVector = matrix.outputVector;
 	
-	if (columnIndex == LNKSizeMax)
-		[exampleIndices enumerateAllIndicesUsingBlock:enumerator];
-	else
-		[self _enumerateExampleIndices:exampleIndices withColumnIndex:columnIndex value:value performBlock:enumerator];
+	LNKSize *columnValueCounts = malloc(columnCount * sizeof(LNKSize));
 	
-	LNKFloat entropy = _calculateEntropyForClasses(classFrequencies);
-	[classFrequencies release];
-	
-	return entropy;
-}
-
-- (LNKSize)_chooseSplittingColumnFromColumnIndices:(NSIndexSet *)columnIndices exampleIndices:(NSIndexSet *)exampleIndices {
-	NSParameterAssert(columnIndices);
-	NSParameterAssert(exampleIndices);
+	for (LNKSize column = 0; column < columnCount; column++) {
+		columnValueCounts[column] = [_columnsToPossibleValues[@(column)] LNKSizeValue];
+	}
 	
-	__block LNKFloat bestInformationGain = LNKFloatMin;
-	__block LNKSize bestColumnIndex = LNKSizeMax;
+	const LNKSize exampleCount = _exampleIndices.count;
+	LNKSize *exampleIndices = _LNKCopyIndices(_exampleIndices);
 	
-	[columnIndices enumerateIndexesUsingBlock:^(NSUInteger columnIndex, BOOL *stop) {
-#pragma unused(stop)
+	for (LNKSize example = 0; example < exampleCount; example++) {
+		const LNKFloat output = outputVector[exampleIndices[example]];
 		
-		LNKFloat expectation = 0;
-		
-		const LNKSize maxValues = [_columnsToPossibleValues[@(columnIndex)] LNKSizeValue];
-		
-		for (LNKSize value = 0; value < maxValues; value++) {
-			const LNKFloat probability = [self _countFractionOfExampleIndices:exampleIndices withColumnIndex:columnIndex value:value];
-			const LNKFloat entropy = [self _calculateEntropyOfExampleIndices:exampleIndices withColumnIndex:columnIndex value:value];
-			
-			expectation += probability * entropy;
-		}
-		
-		const LNKFloat currentEntropy = [self _calculateEntropyOfExampleIndices:exampleIndices];
-		const LNKFloat informationGain = currentEntropy - expectation;
-		
-		if (informationGain > bestInformationGain) {
-			bestInformationGain = informationGain;
-			bestColumnIndex = columnIndex;
+		if (output < 0 || output >= classCount || output != floor(output)) {
+			free(exampleIndices);
+			free(columnValueCounts);
+			[NSException raise:NSInternalInconsistencyException format:@"The output vector should only contain class indices in range [0, %lld)", classCount];
 		}
-	}];
-	
-	NSAssert(bestColumnIndex != LNKSizeMax, @"Invalid column");
-	
-	return bestColumnIndex;
-}
-
-- (LNKClass *)_mostFrequentClassAmongExampleIndices:(NSIndexSet *)exampleIndices {
-	NSParameterAssert(exampleIndices);
-	
-	const LNKFloat *outputVector = self.matrix.outputVector;
-	NSCountedSet<LNKClass *> *classFrequencies = [[NSCountedSet alloc] init];
-	
-	[exampleIndices enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
-#pragma unused(stop)
-		[classFrequencies addObject:[LNKClass classWithUnsignedInteger:outputVector[index]]];
-	}];
+	}
 	
-	LNKClass *class = [[classFrequencies mostFrequentObject] retain];
-	[classFrequencies release];
+	const LNKSize columnIndexCount = _columnIndices.count;
+	LNKSize *columnIndices = _LNKCopyIndices(_columnIndices);
 	
-	NSAssert(class, @"Invalid class");
+	LNKDecisionTreeFeatureStoreRef store = LNKDecisionTreeFeatureStoreCreate(matrix.matrixBuffer, matrix.rowCount, columnCount, columnValueCounts);
+	_learnedTree = LNKDecisionTreeCreate(store, outputVector, classCount, exampleIndices, exampleCount, columnIndices, columnIndexCount);
+	LNKDecisionTreeFeatureStoreFree(store);
+	_packedTree = LNKDecisionForestCreate(&_learnedTree, 1, classCount);
 	
-	return [class autorelease];
+	free(columnIndices);
+	free(exampleIndices);
+	free(columnValueCounts);
 }
 
-- (LNKDecisionTreeNode *)_learnTreeWithExampleIndices:(NSIndexSet *)exampleIndices columnIndices:(NSIndexSet *)columnIndices {
-	NSParameterAssert(exampleIndices);
-	NSParameterAssert(columnIndices);
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+	if (!featureVector.data)
+		[NSException raise:NSInvalidArgumentException format:@"The feature vector must contain data"];
 	
-	if (!exampleIndices.count) {
-		return [LNKDecisionTreeClassificationNode unknownClass];
-	}
-	else if ([self _doExamplesAtIndicesHaveSameLabel:exampleIndices]) {
-		const NSUInteger classPrimitive = self.matrix.outputVector[exampleIndices.firstIndex];
-		return [LNKDecisionTreeClassificationNode withClass:[LNKClass classWithUnsignedInteger:classPrimitive]];
-	}
-	else if (!columnIndices.count) {
-		return [LNKDecisionTreeClassificationNode withClass:[self _mostFrequentClassAmongExampleIndices:exampleIndices]];
-	}
+	if (featureVector.length != self.matrix.columnCount)
+		[NSException raise:NSInvalidArgumentException format:@"The feature vector's length should match the matrix's column count"];
 	
-	const LNKSize columnIndex = [self _chooseSplittingColumnFromColumnIndices:columnIndices exampleIndices:exampleIndices];
-	LNKDecisionTreeSplitNode *tree = [[LNKDecisionTreeSplitNode alloc] initWithColumnIndex:columnIndex];
+	if (!_learnedTree)
+		return NO;
 	
-	const LNKSize maxValues = [_columnsToPossibleValues[@(columnIndex)] LNKSizeValue];
+	const LNKSize classIndex = LNKDecisionTreePredict(_learnedTree, featureVector.data);
 	
-	for (LNKSize value = 0; value < maxValues; value++) {
-		NSIndexSet *filteredExampleIndices = [self _filterExampleIndices:exampleIndices withColumnIndex:columnIndex value:value];
-		NSIndexSet *reducedColumnIndices = [columnIndices indexSetByRemovingIndex:columnIndex];
-		
-		LNKDecisionTreeNode *subtree = [self _learnTreeWithExampleIndices:filteredExampleIndices columnIndices:reducedColumnIndices];
-		[tree addBranch:subtree value:value];
-	}
+	if (classIndex == LNKSizeMax)
+		return NO;
 	
-	return [tree autorelease];
-}
-
-- (void)validate {
-	const LNKSize columnCount = self.matrix.columnCount;
+	LNK_vclr(outProbabilities, UNIT_STRIDE, self.classes.count);
+	outProbabilities[classIndex] = 1;
 	
-	for (LNKSize column = 0; column < columnCount; column++) {
-		if (!_columnsToPossibleValues[@(column)]) {
-			[NSException raise:NSInternalInconsistencyException
-						format:@"A value type has not been registered for column %lld.", column];
-		}
-	}
+	return YES;
 }
 
-- (void)train {
-	if (_learnedTree != nil) {
-		[_learnedTree release];
-		_learnedTree = nil;
-	}
-
-	_learnedTree = [[self _learnTreeWithExampleIndices:_exampleIndices columnIndices:_columnIndices] retain];
-}
-
-- (LNKClass *)_predictValueForFeatureVector:(LNKVector)featureVector tree:(LNKDecisionTreeNode *)tree {
-	NSParameterAssert(tree != nil);
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (matrix.columnCount != self.matrix.columnCount)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix's column count should match that of the training matrix"];
 	
-	if ([tree isKindOfClass:[LNKDecisionTreeClassificationNode class]])
-		return ((LNKDecisionTreeClassificationNode *)tree).classification;
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
 	
-	LNKDecisionTreeSplitNode *splitNode = (LNKDecisionTreeSplitNode *)tree;
-	const LNKSize actualValue = featureVector.data[splitNode.columnIndex];
-	
-	return [self _predictValueForFeatureVector:featureVector tree:[splitNode branchForValue:actualValue]];
-}
-
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
-	if (!featureVector.data)
-		[NSException raise:NSInvalidArgumentException format:@"The feature vector must contain data"];
-	
-	if (featureVector.length != self.matrix.columnCount)
-		[NSException raise:NSInvalidArgumentException format:@"The feature vector's length should match the matrix's column count"];
+	if (!_packedTree)
+		[NSException raise:NSGenericException format:@"The classifier must be trained before making predictions"];
 	
-	return [self _predictValueForFeatureVector:featureVector tree:_learnedTree];
+	LNKDecisionForestPredictProbabilities(_packedTree, matrix.matrixBuffer, matrix.rowCount, matrix.columnCount, outputBuffer);
 }
 
 @end
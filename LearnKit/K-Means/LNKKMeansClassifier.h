@@ -9,10 +9,27 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+typedef NS_ENUM(NSUInteger, LNKKMeansSeedingMethod) {
+	/// Picks distinct examples at random.
+	LNKKMeansSeedingMethodRandom,
+	
+	/// Picks the first example at random and every subsequent one with probability proportional to its squared distance
+	/// from the closest centroid picked so far (k-means++). This spreads the initial centroids out, so training
+	/// converges in fewer iterations and to better clusters.
+	LNKKMeansSeedingMethodPlusPlus
+};
+
+/// Returns the next batch of examples for mini-batch training, or `nil` once there are no more.
+/// Batches must have as many columns as the classifier's matrix and no bias column. Sources may read batches
+/// from files or streams too large to fit in memory at once, or slice them from an existing matrix.
+typedef LNKMatrix *_Nullable (^LNKKMeansBatchSource)(void);
+
 /// The optimization algorithm for k-means classifiers is ignored and can be `nil`.
 /// The classes specified correspond to the number of clusters.
 /// For example, initializing a LNKClassifier with `[LNKClasses withCount:3]` specifies 3 clusters.
 /// Predicted values are of type NSNumber/LNKSize and indicate the index of the closest cluster.
+/// Besides training on the whole matrix, the centroids can be updated incrementally with batches of examples, so
+/// datasets that don't fit in memory or arrive over time can be clustered; the matrix then only needs to be a sample.
 @interface LNKKMeansClassifier : LNKClassifier
 
 /// The iteration count must be >= 1; the default is 100.
@@ -24,6 +41,42 @@ NS_ASSUME_NONNULL_BEGIN
 /// The default is `LNKFloatMax`, which effectively turns off the junk cluster.
 @property (nonatomic) LNKFloat maximumClusterDistance;
 
+/// The method used to pick the initial centroids, unless custom centroids are set.
+/// The default is `LNKKMeansSeedingMethodPlusPlus`.
+@property (nonatomic) LNKKMeansSeedingMethod seedingMethod;
+
+/// When nonzero, `train` runs mini-batch k-means: each iteration updates the centroids with this many examples
+/// drawn from the matrix at random, rather than assigning every example. With `LNKSizeMax` iterations, training
+/// stops once the centroids move little compared to the distances between them and their examples.
+/// The default is 0.
+@property (nonatomic) LNKSize miniBatchSize;
+
+/// Mini-batch updates move each centroid towards the examples assigned to it at a learning rate of `1 / n`, where `n`
+/// counts the examples assigned to it so far, so it tracks their mean. A nonzero minimum keeps the centroids
+/// following streams whose clusters drift over time. The rate must be between 0 and 1; the default is 0.
+@property (nonatomic) LNKFloat minimumLearningRate;
+
+/// After training, the number of example-to-centroid distance computations skipped in each iteration, out of
+/// `rowCount * classes.count`. Bounds on the distances between examples and centroids, maintained with the triangle
+/// inequality, rule out most clusters once the centroids stop moving much. Mini-batch training skips none and leaves this empty.
+@property (nonatomic, readonly) NSArray<NSNumber *> *skippedDistanceCounts;
+
+/// Moves the centroids towards the examples in `batch`. Updates continue from the centroids left by training, custom
+/// centroids or previous updates; without any, the initial centroids are picked from `batch` with the seeding method,
+/// in which case it must have more examples than there are clusters.
+- (void)updateWithBatchMatrix:(LNKMatrix *)batch;
+
+/// Updates the centroids with each batch returned by `source` until it returns `nil`.
+- (void)updateWithBatchSource:(LNKKMeansBatchSource)source;
+
+/// Returns a source of consecutive batches of up to `batchSize` rows of `matrix`.
++ (LNKKMeansBatchSource)batchSourceWithMatrix:(LNKMatrix *)matrix batchSize:(LNKSize)batchSize;
+
+/// Predicts the closest cluster of every row of `matrix`, which must have as many columns as the classifier's matrix and
+/// no bias column. Rows are processed in parallel, in blocks whose distances to the centroids come from matrix products.
+/// `outputBuffer` must have room for `matrix.rowCount` cluster indices.
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
 /// The returned vector is +1 reference counted.
 - (LNKVector)centroidForClusterAtIndex:(LNKSize)clusterIndex;
 
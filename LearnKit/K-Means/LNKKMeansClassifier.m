@@ -50,12 +50,15 @@ static const LNKSize kDefaultIterationCount = 100;
 	if (self) {
 		_iterationCount = kDefaultIterationCount;
 		_maximumClusterDistance = LNKFloatMax;
+		_seedingMethod = LNKKMeansSeedingMethodPlusPlus;
+		_skippedDistanceCounts = [@[] retain];
 		_clusterCentroids = LNKFloatAlloc(classes.count * matrix.columnCount);
 	}
 	return self;
 }
 
 - (void)dealloc {
+	[_skippedDistanceCounts release];
 	free(_clusterCentroids);
 	[super dealloc];
 }
@@ -73,6 +76,64 @@ static const LNKSize kDefaultIterationCount = 100;
 	[self didChangeValueForKey:@"iterationCount"];
 }
 
+- (void)setMinimumLearningRate:(LNKFloat)minimumLearningRate {
+	if (minimumLearningRate == _minimumLearningRate)
+		return;
+	
+	if (minimumLearningRate < 0 || minimumLearningRate > 1) {
+		@throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"The minimum learning rate must be between 0 and 1" userInfo:nil];
+	}
+	
+	[self willChangeValueForKey:@"minimumLearningRate"];
+	_minimumLearningRate = minimumLearningRate;
+	[self didChangeValueForKey:@"minimumLearningRate"];
+}
+
+- (void)updateWithBatchMatrix:(LNKMatrix *)batch {
+#pragma unused(batch)
+	
+	NSAssertNotReachable(@"%s should be implemented by subclasses", __PRETTY_FUNCTION__);
+}
+
+- (void)updateWithBatchSource:(LNKKMeansBatchSource)source {
+	NSParameterAssert(source);
+	
+	while (YES) {
+		@autoreleasepool {
+			LNKMatrix *const batch = source();
+			
+			if (!batch)
+				break;
+			
+			[self updateWithBatchMatrix:batch];
+		}
+	}
+}
+
++ (LNKKMeansBatchSource)batchSourceWithMatrix:(LNKMatrix *)matrix batchSize:(LNKSize)batchSize {
+	NSParameterAssert(matrix);
+	
+	if (batchSize < 1) {
+		@throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"The batch size must be >= 1" userInfo:nil];
+	}
+	
+	__block LNKSize nextRow = 0;
+	
+	LNKKMeansBatchSource source = ^LNKMatrix *{
+		const LNKSize rowCount = matrix.rowCount;
+		
+		if (nextRow >= rowCount)
+			return nil;
+		
+		const NSRange range = NSMakeRange(nextRow, MIN(batchSize, rowCount - nextRow));
+		nextRow = NSMaxRange(range);
+		
+		return [matrix submatrixWithRowRange:range];
+	};
+	
+	return [[source copy] autorelease];
+}
+
 - (LNKFloat *)_clusterCentroids {
 	return _clusterCentroids;
 }
@@ -82,6 +143,15 @@ static const LNKSize kDefaultIterationCount = 100;
 	LNKFloatCopy(_clusterCentroids, clusterCentroids, self.classes.count * self.matrix.columnCount);
 }
 
+- (void)_setSkippedDistanceCounts:(NSArray<NSNumber *> *)skippedDistanceCounts {
+	NSParameterAssert(skippedDistanceCounts);
+	
+	[self willChangeValueForKey:@"skippedDistanceCounts"];
+	[_skippedDistanceCounts release];
+	_skippedDistanceCounts = [skippedDistanceCounts copy];
+	[self didChangeValueForKey:@"skippedDistanceCounts"];
+}
+
 - (LNKVector)centroidForClusterAtIndex:(LNKSize)clusterIndex {
 	if (clusterIndex >= self.classes.count)
 		[NSException raise:NSGenericException format:@"The cluster index is out-of-bounds"];
@@ -14,6 +14,8 @@ NS_ASSUME_NONNULL_BEGIN
 - (LNKFloat *)_clusterCentroids NS_RETURNS_INNER_POINTER;
 - (void)_setClusterCentroids:(const LNKFloat *)clusterCentroids;
 
+- (void)_setSkippedDistanceCounts:(NSArray<NSNumber *> *)skippedDistanceCounts;
+
 @end
 
 NS_ASSUME_NONNULL_END
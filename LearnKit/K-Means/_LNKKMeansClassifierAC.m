@@ -8,24 +8,124 @@
 #import "_LNKKMeansClassifierAC.h"
 
 #import "LNKAccelerate.h"
+#import "LNKClassifierPrivate.h"
+#import "LNKExecutor.h"
 #import "LNKKMeansClassifierPrivate.h"
 #import "LNKMatrix.h"
 #import "LNKMatrixPrivate.h"
+#import "LNKMemoryBufferManager.h"
 
 static const LNKSize LNKJunkCluster = LNKSizeMax;
 
+/// Elkan's algorithm keeps a lower bound per example and cluster, so it only pays off with many clusters,
+/// and only fits in memory for so many examples.
+#define MIN_ELKAN_CLUSTER_COUNT	32
+#define MAX_ELKAN_BOUND_COUNT	(1ULL << 25)
+
+/// Mini-batch training runs until convergence stops once the centroids move less than this fraction of the average
+/// distance between the examples in a batch and their closest centroids.
+#define MINI_BATCH_CONVERGENCE_TOLERANCE	1e-3
+
+/// The number of examples whose distances to all centroids are computed with each matrix product.
+#define ASSIGNMENT_BLOCK_SIZE	64
+
+/// Returns the closest cluster along with the (unsquared) distances to the closest and second-closest clusters.
+static LNKSize _LNKFindClosestClusters(const LNKFloat *example, const LNKFloat *clusterCentroids, LNKSize clusterCount, LNKSize columnCount, LNKFloat *outDistance, LNKFloat *outSecondDistance) {
+	LNKSize closestCluster = 0;
+	LNKFloat closestDistance = LNKFloatMax;
+	LNKFloat secondDistance = LNKFloatMax;
+	
+	for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+		LNKFloat distance;
+		LNKVectorDistance(clusterCentroids + cluster * columnCount, example, &distance, columnCount);
+		
+		if (distance < closestDistance) {
+			secondDistance = closestDistance;
+			closestDistance = distance;
+			closestCluster = cluster;
+		}
+		else if (distance < secondDistance) {
+			secondDistance = distance;
+		}
+	}
+	
+	*outDistance = sqrt(closestDistance);
+	*outSecondDistance = sqrt(secondDistance);
+	
+	return closestCluster;
+}
+
+/// Finds the closest cluster of each of `rowCount` consecutive examples with a single matrix product against the
+/// `columnCount` x `clusterCount` transposed centroids. `squaredDistances` must hold `rowCount * clusterCount` values
+/// and receives the squared distances of every example to every cluster.
+static void _LNKFindClosestClustersOfBlock(const LNKFloat *examples, LNKSize rowCount, const LNKFloat *transposedCentroids, const LNKFloat *centroidSquaredNorms, LNKSize clusterCount, LNKSize columnCount, LNKFloat *squaredDistances, LNKSize *outClusters) {
+	// With examples as a and centroids as b, ||a - b||^2 = ||a||^2 + ||b||^2 - 2 a.b
+	LNK_mmul(examples, UNIT_STRIDE, transposedCentroids, UNIT_STRIDE, squaredDistances, UNIT_STRIDE, rowCount, clusterCount, columnCount);
+	
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *example = examples + row * columnCount;
+		LNKFloat *const exampleDistances = squaredDistances + row * clusterCount;
+		LNKFloat exampleSquaredNorm;
+		LNK_dotpr(example, UNIT_STRIDE, example, UNIT_STRIDE, &exampleSquaredNorm, columnCount);
+		
+		LNKSize closestCluster = 0;
+		LNKFloat closestDistance = LNKFloatMax;
+		
+		for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+			// Rounding can make the distance of (nearly) identical vectors slightly negative.
+			const LNKFloat distance = MAX(0, exampleSquaredNorm + centroidSquaredNorms[cluster] - 2 * exampleDistances[cluster]);
+			exampleDistances[cluster] = distance;
+			
+			if (distance < closestDistance) {
+				closestDistance = distance;
+				closestCluster = cluster;
+			}
+		}
+		
+		outClusters[row] = closestCluster;
+	}
+}
+
+/// Lowers a squared distance found by `_LNKFindClosestClustersOfBlock` by the most rounding can have added to it, so its
+/// root bounds the actual distance from below. The error of the expanded product grows with the length of the vectors
+/// and their squared norms rather than with the distance, which can be much smaller.
+static inline LNKFloat _LNKLowerBoundOfExpandedDistance(LNKFloat squaredDistance, LNKFloat exampleSquaredNorm, LNKFloat centroidSquaredNorm, LNKSize columnCount) {
+	const LNKFloat slack = 2 * (columnCount + 2) * LNKFloatEpsilon * (exampleSquaredNorm + centroidSquaredNorm);
+	return sqrt(MAX(0, squaredDistance - slack));
+}
+
+static inline LNKFloat _LNKDistance(const LNKFloat *vector1, const LNKFloat *vector2, LNKSize length) {
+	LNKFloat distance;
+	LNKVectorDistance(vector1, vector2, &distance, length);
+	
+	return sqrt(distance);
+}
+
 @implementation _LNKKMeansClassifierAC {
 	BOOL _isUsingCustomCentroids;
+	BOOL _hasCentroids;
+	
+	// The number of examples each centroid has been moved towards, which sets its mini-batch learning rate.
+	LNKFloat *_clusterExampleCounts;
+	
+	// The centroids laid out for `_LNKFindClosestClustersOfBlock`.
+	LNKFloat *_transposedCentroids;
+	LNKFloat *_centroidSquaredNorms;
+}
+
+- (void)dealloc {
+	free(_centroidSquaredNorms);
+	free(_transposedCentroids);
+	free(_clusterExampleCounts);
+	[super dealloc];
 }
 
-- (void)_setRandomClusters:(LNKFloat *)clusterCentroids {
+- (void)_setRandomClusters:(LNKFloat *)clusterCentroids fromExamples:(const LNKFloat *)matrixBuffer rowCount:(LNKSize)rowCount {
 	NSParameterAssert(clusterCentroids);
+	NSParameterAssert(matrixBuffer);
 	
-	LNKMatrix *matrix = self.matrix;
 	const LNKSize clusterCount = self.classes.count;
-	const LNKSize columnCount = matrix.columnCount;
-	const LNKSize rowCount = matrix.rowCount;
-	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	const LNKSize columnCount = self.matrix.columnCount;
 	
 	NSMutableIndexSet *usedIndices = [[NSMutableIndexSet alloc] init];
 	
@@ -44,36 +144,254 @@ static const LNKSize LNKJunkCluster = LNKSizeMax;
 	[usedIndices release];
 }
 
-- (LNKSize)_closestClusterToExample:(const LNKFloat *)example distance:(LNKFloat *)distance {
-	NSParameterAssert(example);
+- (void)_setPlusPlusClusters:(LNKFloat *)clusterCentroids fromExamples:(const LNKFloat *)matrixBuffer rowCount:(LNKSize)rowCount {
+	NSParameterAssert(clusterCentroids);
+	NSParameterAssert(matrixBuffer);
 	
+	const LNKSize clusterCount = self.classes.count;
 	const LNKSize columnCount = self.matrix.columnCount;
+	
+	// The squared distance from each example to its closest centroid so far.
+	LNKFloat *closestDistances = LNKFloatAlloc(rowCount);
+	const LNKFloat maximumDistance = LNKFloatMax;
+	LNK_vfill(&maximumDistance, closestDistances, UNIT_STRIDE, rowCount);
+	
+	LNKSize selectedExample = arc4random_uniform((uint32_t)rowCount);
+	LNKFloatCopy(clusterCentroids, _ROW_IN_MATRIX_BUFFER(selectedExample), columnCount);
+	
+	for (LNKSize cluster = 1; cluster < clusterCount; cluster++) {
+		const LNKFloat *previousCentroid = clusterCentroids + (cluster - 1) * columnCount;
+		LNKFloat totalDistance;
+		
+		LNKExecutorSum(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), 0, &totalDistance, 1, ^(LNKRange range, LNKFloat *accumulator) {
+			for (LNKSize index = range.location; index < range.location + range.length; index++) {
+				LNKFloat distance;
+				LNKVectorDistance(_ROW_IN_MATRIX_BUFFER(index), previousCentroid, &distance, columnCount);
+				
+				if (distance < closestDistances[index])
+					closestDistances[index] = distance;
+				
+				*accumulator += closestDistances[index];
+			}
+		});
+		
+		// Examples that coincide with a centroid are never picked, unless all of them do.
+		LNKFloat target = (LNKFloat)arc4random() / UINT32_MAX * totalDistance;
+		selectedExample = arc4random_uniform((uint32_t)rowCount);
+		
+		for (LNKSize index = 0; index < rowCount; index++) {
+			if (closestDistances[index] == 0)
+				continue;
+			
+			// Rounding may leave a sliver of the target past the last example.
+			selectedExample = index;
+			
+			if (target < closestDistances[index])
+				break;
+			
+			target -= closestDistances[index];
+		}
+		
+		LNKFloatCopy(clusterCentroids + cluster * columnCount, _ROW_IN_MATRIX_BUFFER(selectedExample), columnCount);
+	}
+	
+	free(closestDistances);
+}
+
+- (void)_setClusterExampleCount:(LNKFloat)count {
 	const LNKSize clusterCount = self.classes.count;
+	
+	if (!_clusterExampleCounts)
+		_clusterExampleCounts = LNKFloatAlloc(clusterCount);
+	
+	LNK_vfill(&count, _clusterExampleCounts, UNIT_STRIDE, clusterCount);
+}
+
+/// Must be called whenever the centroids change.
+- (void)_didUpdateCentroids {
+	const LNKSize clusterCount = self.classes.count;
+	const LNKSize columnCount = self.matrix.columnCount;
 	const LNKFloat *clusterCentroids = [self _clusterCentroids];
 	
-	LNKSize closestCluster = LNKSizeMax;
-	LNKFloat closestDistance = LNKFloatMax;
+	if (!_transposedCentroids) {
+		_transposedCentroids = LNKFloatAlloc(columnCount * clusterCount);
+		_centroidSquaredNorms = LNKFloatAlloc(clusterCount);
+	}
+	
+	LNK_mtrans(clusterCentroids, _transposedCentroids, columnCount, clusterCount);
 	
 	for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
-		LNKFloat distance;
-		LNKVectorDistance(clusterCentroids + cluster * columnCount, example, &distance, columnCount);
+		const LNKFloat *clusterCentroid = clusterCentroids + cluster * columnCount;
+		LNK_dotpr(clusterCentroid, UNIT_STRIDE, clusterCentroid, UNIT_STRIDE, &_centroidSquaredNorms[cluster], columnCount);
+	}
+}
+
+- (void)_seedClustersFromExamples:(const LNKFloat *)matrixBuffer rowCount:(LNKSize)rowCount {
+	LNKFloat *clusterCentroids = [self _clusterCentroids];
+	
+	switch (self.seedingMethod) {
+		case LNKKMeansSeedingMethodRandom:
+			[self _setRandomClusters:clusterCentroids fromExamples:matrixBuffer rowCount:rowCount];
+			break;
+		case LNKKMeansSeedingMethodPlusPlus:
+			[self _setPlusPlusClusters:clusterCentroids fromExamples:matrixBuffer rowCount:rowCount];
+			break;
+	}
+	
+	// Each centroid starts out as the mean of the single example it was picked from.
+	[self _setClusterExampleCount:1];
+	[self _didUpdateCentroids];
+	_hasCentroids = YES;
+}
+
+/// Moves the centroids towards the examples, each at the learning rate of the centroid closest to it, and returns
+/// how far the centroids moved on average relative to the average distance between the examples and their centroids.
+- (LNKFloat)_updateWithExamples:(const LNKFloat *)matrixBuffer rowCount:(LNKSize)rowCount {
+	NSParameterAssert(matrixBuffer);
+	NSAssert(_hasCentroids, @"The centroids should be set before they are updated");
+	
+	const LNKSize clusterCount = self.classes.count;
+	const LNKSize columnCount = self.matrix.columnCount;
+	const LNKFloat maximumClusterDistance = self.maximumClusterDistance;
+	const LNKFloat minimumLearningRate = self.minimumLearningRate;
+	LNKFloat *clusterCentroids = [self _clusterCentroids];
+	LNKFloat *clusterExampleCounts = _clusterExampleCounts;
+	const LNKFloat *transposedCentroids = _transposedCentroids;
+	const LNKFloat *centroidSquaredNorms = _centroidSquaredNorms;
+	LNKSize *examplesToClusters = malloc(rowCount * sizeof(LNKSize));
+	
+	// Examples are assigned to the centroids from before the batch, so they can be assigned in parallel.
+	LNKFloat distanceSum;
+	
+	LNKExecutorSum(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), ASSIGNMENT_BLOCK_SIZE, &distanceSum, 1, ^(LNKRange range, LNKFloat *accumulator) {
+		LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+		const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+		LNKFloat *squaredDistances = LNKMemoryBufferManagerAllocScratch(memoryManager, ASSIGNMENT_BLOCK_SIZE * clusterCount);
 		
-		if (distance < closestDistance) {
-			closestDistance = distance;
-			closestCluster = cluster;
+		for (LNKSize blockStart = range.location; blockStart < range.location + range.length; blockStart += ASSIGNMENT_BLOCK_SIZE) {
+			const LNKSize blockLength = MIN(ASSIGNMENT_BLOCK_SIZE, range.location + range.length - blockStart);
+			_LNKFindClosestClustersOfBlock(_ROW_IN_MATRIX_BUFFER(blockStart), blockLength, transposedCentroids, centroidSquaredNorms, clusterCount, columnCount, squaredDistances, examplesToClusters + blockStart);
+			
+			for (LNKSize row = 0; row < blockLength; row++) {
+				const LNKSize index = blockStart + row;
+				const LNKFloat squaredDistance = squaredDistances[row * clusterCount + examplesToClusters[index]];
+				
+				// The maximum cluster distance applies to squared distances.
+				if (squaredDistance > maximumClusterDistance)
+					examplesToClusters[index] = LNKJunkCluster;
+				
+				*accumulator += sqrt(squaredDistance);
+			}
 		}
+		
+		LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	});
+	
+	LNKFloat *previousClusterCentroids = LNKFloatAllocAndCopy(clusterCentroids, clusterCount * columnCount);
+	
+	for (LNKSize index = 0; index < rowCount; index++) {
+		const LNKSize cluster = examplesToClusters[index];
+		
+		if (cluster == LNKJunkCluster)
+			continue;
+		
+		LNKFloat *const clusterCentroid = clusterCentroids + cluster * columnCount;
+		clusterExampleCounts[cluster]++;
+		
+		const LNKFloat learningRate = MAX(1 / clusterExampleCounts[cluster], minimumLearningRate);
+		const LNKFloat retainedRate = 1 - learningRate;
+		LNK_vsmul(clusterCentroid, UNIT_STRIDE, &retainedRate, clusterCentroid, UNIT_STRIDE, columnCount);
+		LNK_vsma(_ROW_IN_MATRIX_BUFFER(index), UNIT_STRIDE, &learningRate, clusterCentroid, UNIT_STRIDE, clusterCentroid, UNIT_STRIDE, columnCount);
+	}
+	
+	LNKFloat driftSum = 0;
+	
+	for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+		driftSum += _LNKDistance(previousClusterCentroids + cluster * columnCount, clusterCentroids + cluster * columnCount, columnCount);
 	}
 	
-	NSAssert(closestCluster != LNKSizeMax, @"This should never occur as long as there is at least one cluster");
+	[self _didUpdateCentroids];
+	
+	free(previousClusterCentroids);
+	free(examplesToClusters);
+	
+	if (distanceSum == 0)
+		return 0;
+	
+	return (driftSum / clusterCount) / (distanceSum / rowCount);
+}
 
-	if (distance) {
-		*distance = closestDistance;
+- (void)_validateBatchMatrix:(LNKMatrix *)batch {
+	if (!batch)
+		[NSException raise:NSGenericException format:@"The batch matrix must be specified"];
+	
+	if (batch.hasBiasColumn)
+		[NSException raise:NSGenericException format:@"The batch matrix should not have a bias column"];
+	
+	if (batch.columnCount != self.matrix.columnCount)
+		[NSException raise:NSGenericException format:@"The number of columns in the batch matrix must match the number of columns in the matrix"];
+}
+
+- (void)updateWithBatchMatrix:(LNKMatrix *)batch {
+	[self _validateBatchMatrix:batch];
+	
+	const LNKSize rowCount = batch.rowCount;
+	const LNKFloat *matrixBuffer = batch.matrixBuffer;
+	
+	if (!_hasCentroids) {
+		if (rowCount <= self.classes.count)
+			[NSException raise:NSGenericException format:@"The first batch should have more examples than there are clusters"];
+		
+		[self _seedClustersFromExamples:matrixBuffer rowCount:rowCount];
 	}
 	
-	return closestCluster;
+	if (rowCount > 0)
+		[self _updateWithExamples:matrixBuffer rowCount:rowCount];
+}
+
+- (void)_trainMiniBatches {
+	LNKMatrix *const matrix = self.matrix;
+	const LNKSize columnCount = matrix.columnCount;
+	const LNKSize rowCount = matrix.rowCount;
+	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	const LNKSize batchSize = MIN(self.miniBatchSize, rowCount);
+	const LNKSize iterationCount = self.iterationCount;
+	const BOOL checkingConvergence = iterationCount == LNKSizeMax;
+	
+	if (_isUsingCustomCentroids) {
+		[self _setClusterExampleCount:1];
+	}
+	else {
+		[self _seedClustersFromExamples:matrixBuffer rowCount:rowCount];
+	}
+	
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	LNKFloat *batchBuffer = LNKMemoryBufferManagerAllocBlock(memoryManager, batchSize * columnCount);
+	
+	for (LNKSize iteration = 0; iteration < iterationCount; iteration++) {
+		for (LNKSize index = 0; index < batchSize; index++) {
+			const LNKSize selectedExample = arc4random_uniform((uint32_t)rowCount);
+			LNKFloatCopy(batchBuffer + index * columnCount, _ROW_IN_MATRIX_BUFFER(selectedExample), columnCount);
+		}
+		
+		const LNKFloat relativeDrift = [self _updateWithExamples:batchBuffer rowCount:batchSize];
+		
+		if (checkingConvergence && relativeDrift < MINI_BATCH_CONVERGENCE_TOLERANCE) {
+			break;
+		}
+	}
+	
+	LNKMemoryBufferManagerFreeBlock(memoryManager, batchBuffer, batchSize * columnCount);
+	
+	[self _setSkippedDistanceCounts:@[]];
 }
 
 - (void)train {
+	if (self.miniBatchSize > 0) {
+		[self _trainMiniBatches];
+		return;
+	}
+	
 	LNKMatrix *const matrix = self.matrix;
 	const LNKSize clusterCount = self.classes.count;
 	const LNKSize columnCount = matrix.columnCount;
@@ -82,76 +400,357 @@ static const LNKSize LNKJunkCluster = LNKSizeMax;
 	const LNKSize iterationCount = self.iterationCount;
 	const BOOL checkingConvergence = iterationCount == LNKSizeMax;
 	const LNKFloat maximumClusterDistance = self.maximumClusterDistance;
+	const BOOL usesJunkCluster = maximumClusterDistance < LNKFloatMax;
 	LNKFloat *clusterCentroids = [self _clusterCentroids];
 	
-	LNKFloat *clusterCentroidsWorkspace = LNKFloatAlloc(clusterCount * columnCount);
-	LNKFloat *clusterCounts = LNKFloatAlloc(clusterCount);
+	// Each thread sums the examples assigned to every cluster, counts them, counts changed assignments and counts distance computations.
+	const LNKSize accumulatorLength = clusterCount * columnCount + clusterCount + 2;
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	LNKFloat *clusterCentroidsWorkspace = LNKMemoryBufferManagerAllocBlock(memoryManager, accumulatorLength);
+	LNKFloat *clusterCounts = clusterCentroidsWorkspace + clusterCount * columnCount;
+	LNKFloat *changedAssignmentCount = clusterCounts + clusterCount;
+	LNKFloat *distanceComputationCount = changedAssignmentCount + 1;
 	LNKSize *examplesToClusters = malloc(rowCount * sizeof(LNKSize));
-
+	
 	for (LNKSize row = 0; row < rowCount; row++) {
 		examplesToClusters[row] = LNKJunkCluster;
 	}
 	
 	if (!_isUsingCustomCentroids) {
-		[self _setRandomClusters:clusterCentroids];
+		[self _seedClustersFromExamples:matrixBuffer rowCount:rowCount];
 	}
 	
+	// The closest cluster of every example, regardless of the junk cluster, is bounded from above by `upperBounds`.
+	// Hamerly's algorithm bounds the distance to the second-closest cluster from below; Elkan's algorithm bounds the distance to every cluster.
+	const BOOL usesElkan = clusterCount >= MIN_ELKAN_CLUSTER_COUNT && rowCount * clusterCount <= MAX_ELKAN_BOUND_COUNT;
+	const LNKSize lowerBoundCount = usesElkan ? clusterCount : 1;
+	LNKSize *closestClusters = malloc(rowCount * sizeof(LNKSize));
+	LNKFloat *upperBounds = LNKFloatAlloc(rowCount);
+	LNKFloat *lowerBounds = LNKFloatAlloc(rowCount * lowerBoundCount);
+	
+	// Half the distance between every pair of centroids, and from every centroid to its closest other centroid.
+	// Examples closer to their centroid than half the distance to another centroid can't be closer to that other centroid.
+	LNKFloat *halfCentroidDistances = LNKFloatAlloc(usesElkan ? clusterCount * clusterCount : 0);
+	LNKFloat *halfClosestCentroidDistances = LNKFloatAlloc(clusterCount);
+	
+	// How far each centroid moved in the last iteration.
+	LNKFloat *centroidDrifts = LNKFloatAlloc(clusterCount);
+	LNKFloat *updatedCentroid = LNKFloatAlloc(columnCount);
+	
+	const LNKFloat *transposedCentroids = _transposedCentroids;
+	const LNKFloat *centroidSquaredNorms = _centroidSquaredNorms;
+	
+	NSMutableArray<NSNumber *> *skippedDistanceCounts = [[NSMutableArray alloc] init];
+	
 	for (LNKSize iteration = 0; iteration < iterationCount; iteration++) {
-		LNK_vclr(clusterCounts, UNIT_STRIDE, clusterCount);
-		LNK_vclr(clusterCentroidsWorkspace, UNIT_STRIDE, clusterCount * columnCount);
-
-		BOOL unchangedAssignments = YES;
-
-		// Assign examples to clusters.
-		for (LNKSize index = 0; index < rowCount; index++) {
-			const LNKFloat *example = _ROW_IN_MATRIX_BUFFER(index);
-
-			LNKFloat distance;
-			const LNKSize rawCluster = [self _closestClusterToExample:example distance:&distance];
-			const LNKSize assignedCluster = distance > maximumClusterDistance ? LNKJunkCluster : rawCluster;
-
-			if (checkingConvergence && examplesToClusters[index] != assignedCluster) {
-				unchangedAssignments = NO;
+		const BOOL hasBounds = iteration > 0;
+		LNKFloat largestDrift = 0, secondLargestDrift = 0;
+		LNKSize largestDriftCluster = 0;
+		
+		if (hasBounds) {
+			for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+				if (centroidDrifts[cluster] > largestDrift) {
+					secondLargestDrift = largestDrift;
+					largestDrift = centroidDrifts[cluster];
+					largestDriftCluster = cluster;
+				}
+				else if (centroidDrifts[cluster] > secondLargestDrift) {
+					secondLargestDrift = centroidDrifts[cluster];
+				}
 			}
-
-			examplesToClusters[index] = assignedCluster;
-
-			if (assignedCluster != LNKJunkCluster) {
-				LNKFloat *const workspaceEntry = clusterCentroidsWorkspace + assignedCluster * columnCount;
-				LNK_vadd(example, UNIT_STRIDE, workspaceEntry, UNIT_STRIDE, workspaceEntry, UNIT_STRIDE, columnCount);
-
-				clusterCounts[assignedCluster]++;
+			
+			for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+				halfClosestCentroidDistances[cluster] = LNKFloatMax;
+			}
+			
+			for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+				for (LNKSize otherCluster = cluster + 1; otherCluster < clusterCount; otherCluster++) {
+					const LNKFloat halfDistance = _LNKDistance(clusterCentroids + cluster * columnCount, clusterCentroids + otherCluster * columnCount, columnCount) / 2;
+					halfClosestCentroidDistances[cluster] = MIN(halfClosestCentroidDistances[cluster], halfDistance);
+					halfClosestCentroidDistances[otherCluster] = MIN(halfClosestCentroidDistances[otherCluster], halfDistance);
+					
+					if (usesElkan) {
+						halfCentroidDistances[cluster * clusterCount + otherCluster] = halfDistance;
+						halfCentroidDistances[otherCluster * clusterCount + cluster] = halfDistance;
+					}
+				}
 			}
 		}
 		
-		// Update cluster centroids. The Junk cluster is not updated.
+		// Assign examples to clusters.
+		LNKExecutorSum(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), 0, clusterCentroidsWorkspace, accumulatorLength, ^(LNKRange range, LNKFloat *accumulator) {
+			LNKFloat *const threadClusterCounts = accumulator + clusterCount * columnCount;
+			LNKFloat *const threadDistanceComputationCount = threadClusterCounts + clusterCount + 1;
+			
+			// Without bounds, every distance is needed, so they're computed a block of examples at a time with matrix products.
+			if (!hasBounds) {
+				LNKMemoryBufferManagerRef threadMemoryManager = LNKGetCurrentMemoryBufferManager();
+				const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(threadMemoryManager);
+				LNKFloat *squaredDistances = LNKMemoryBufferManagerAllocScratch(threadMemoryManager, ASSIGNMENT_BLOCK_SIZE * clusterCount);
+				
+				for (LNKSize blockStart = range.location; blockStart < range.location + range.length; blockStart += ASSIGNMENT_BLOCK_SIZE) {
+					const LNKSize blockLength = MIN(ASSIGNMENT_BLOCK_SIZE, range.location + range.length - blockStart);
+					_LNKFindClosestClustersOfBlock(_ROW_IN_MATRIX_BUFFER(blockStart), blockLength, transposedCentroids, centroidSquaredNorms, clusterCount, columnCount, squaredDistances, closestClusters + blockStart);
+					
+					for (LNKSize row = 0; row < blockLength; row++) {
+						const LNKSize index = blockStart + row;
+						const LNKFloat *example = _ROW_IN_MATRIX_BUFFER(index);
+						const LNKSize closestCluster = closestClusters[index];
+						LNKFloat *const exampleLowerBounds = lowerBounds + index * lowerBoundCount;
+						
+						// Rounding in the matrix products could otherwise leave the upper bound slightly below the actual distance,
+						// and the lower bounds slightly above it.
+						upperBounds[index] = _LNKDistance(example, clusterCentroids + closestCluster * columnCount, columnCount);
+						
+						LNKFloat exampleSquaredNorm;
+						LNK_dotpr(example, UNIT_STRIDE, example, UNIT_STRIDE, &exampleSquaredNorm, columnCount);
+						LNKFloat secondLowerBound = LNKFloatMax;
+						
+						for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+							if (cluster == closestCluster)
+								continue;
+							
+							const LNKFloat lowerBound = _LNKLowerBoundOfExpandedDistance(squaredDistances[row * clusterCount + cluster], exampleSquaredNorm, centroidSquaredNorms[cluster], columnCount);
+							
+							if (usesElkan)
+								exampleLowerBounds[cluster] = lowerBound;
+							else
+								secondLowerBound = MIN(secondLowerBound, lowerBound);
+						}
+						
+						if (usesElkan)
+							exampleLowerBounds[closestCluster] = upperBounds[index];
+						else
+							*exampleLowerBounds = secondLowerBound;
+					}
+				}
+				
+				LNKMemoryBufferManagerResetScratch(threadMemoryManager, mark);
+			}
+			
+			for (LNKSize index = range.location; index < range.location + range.length; index++) {
+				const LNKFloat *example = _ROW_IN_MATRIX_BUFFER(index);
+				LNKFloat *const exampleLowerBounds = lowerBounds + index * lowerBoundCount;
+				LNKSize closestCluster = closestClusters[index];
+				LNKFloat upperBound = upperBounds[index];
+				BOOL isTight = NO;
+				
+				if (!hasBounds) {
+					*threadDistanceComputationCount += clusterCount;
+					isTight = YES;
+				}
+				else if (usesElkan) {
+					upperBound += centroidDrifts[closestCluster];
+					
+					for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+						exampleLowerBounds[cluster] = MAX(0, exampleLowerBounds[cluster] - centroidDrifts[cluster]);
+					}
+					
+					if (upperBound > halfClosestCentroidDistances[closestCluster]) {
+						for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+							if (cluster == closestCluster)
+								continue;
+							
+							const LNKFloat bound = MAX(exampleLowerBounds[cluster], halfCentroidDistances[closestCluster * clusterCount + cluster]);
+							
+							if (upperBound <= bound)
+								continue;
+							
+							if (!isTight) {
+								upperBound = _LNKDistance(example, clusterCentroids + closestCluster * columnCount, columnCount);
+								exampleLowerBounds[closestCluster] = upperBound;
+								*threadDistanceComputationCount += 1;
+								isTight = YES;
+								
+								if (upperBound <= bound)
+									continue;
+							}
+							
+							const LNKFloat distance = _LNKDistance(example, clusterCentroids + cluster * columnCount, columnCount);
+							exampleLowerBounds[cluster] = distance;
+							*threadDistanceComputationCount += 1;
+							
+							if (distance < upperBound) {
+								closestCluster = cluster;
+								upperBound = distance;
+							}
+						}
+					}
+				}
+				else {
+					upperBound += centroidDrifts[closestCluster];
+					*exampleLowerBounds -= closestCluster == largestDriftCluster ? secondLargestDrift : largestDrift;
+					
+					const LNKFloat bound = MAX(halfClosestCentroidDistances[closestCluster], *exampleLowerBounds);
+					
+					if (upperBound > bound) {
+						upperBound = _LNKDistance(example, clusterCentroids + closestCluster * columnCount, columnCount);
+						*threadDistanceComputationCount += 1;
+						isTight = YES;
+						
+						if (upperBound > bound) {
+							closestCluster = _LNKFindClosestClusters(example, clusterCentroids, clusterCount, columnCount, &upperBound, exampleLowerBounds);
+							*threadDistanceComputationCount += clusterCount;
+						}
+					}
+				}
+				
+				// The junk cluster needs the exact distance to the closest cluster.
+				if (usesJunkCluster && !isTight) {
+					upperBound = _LNKDistance(example, clusterCentroids + closestCluster * columnCount, columnCount);
+					*threadDistanceComputationCount += 1;
+					
+					if (usesElkan)
+						exampleLowerBounds[closestCluster] = upperBound;
+				}
+				
+				closestClusters[index] = closestCluster;
+				upperBounds[index] = upperBound;
+				
+				// The maximum cluster distance applies to squared distances.
+				const LNKSize assignedCluster = usesJunkCluster && upperBound * upperBound > maximumClusterDistance ? LNKJunkCluster : closestCluster;
+				
+				if (examplesToClusters[index] != assignedCluster) {
+					threadClusterCounts[clusterCount]++;
+				}
+				
+				examplesToClusters[index] = assignedCluster;
+				
+				if (assignedCluster != LNKJunkCluster) {
+					LNKFloat *const workspaceEntry = accumulator + assignedCluster * columnCount;
+					LNK_vadd(example, UNIT_STRIDE, workspaceEntry, UNIT_STRIDE, workspaceEntry, UNIT_STRIDE, columnCount);
+					
+					threadClusterCounts[assignedCluster]++;
+				}
+			}
+		});
+		
+		[skippedDistanceCounts addObject:[NSNumber numberWithLNKSize:rowCount * clusterCount - (LNKSize)*distanceComputationCount]];
+		
+		// Update cluster centroids. The Junk cluster is not updated, nor are clusters left without examples.
 		for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
-			LNK_vsdiv(clusterCentroidsWorkspace + cluster * columnCount, UNIT_STRIDE, &clusterCounts[cluster], clusterCentroids + cluster * columnCount, UNIT_STRIDE, columnCount);
+			LNKFloat *const clusterCentroid = clusterCentroids + cluster * columnCount;
+			
+			if (clusterCounts[cluster] == 0) {
+				centroidDrifts[cluster] = 0;
+				continue;
+			}
+			
+			LNK_vsdiv(clusterCentroidsWorkspace + cluster * columnCount, UNIT_STRIDE, &clusterCounts[cluster], updatedCentroid, UNIT_STRIDE, columnCount);
+			centroidDrifts[cluster] = _LNKDistance(updatedCentroid, clusterCentroid, columnCount);
+			LNKFloatCopy(clusterCentroid, updatedCentroid, columnCount);
 		}
-
-		if (checkingConvergence && unchangedAssignments) {
+		
+		if (checkingConvergence && *changedAssignmentCount == 0) {
 			break;
 		}
 	}
 	
-	free(clusterCentroidsWorkspace);
-	free(clusterCounts);
+	[self _setSkippedDistanceCounts:skippedDistanceCounts];
+	[skippedDistanceCounts release];
+	
+	// Later mini-batch updates weigh each centroid by the examples it was last computed from.
+	[self _setClusterExampleCount:1];
+	
+	for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+		_clusterExampleCounts[cluster] = MAX(1, clusterCounts[cluster]);
+	}
+	
+	[self _didUpdateCentroids];
+	_hasCentroids = YES;
+	
+	free(updatedCentroid);
+	free(centroidDrifts);
+	free(halfClosestCentroidDistances);
+	free(halfCentroidDistances);
+	free(lowerBounds);
+	free(upperBounds);
+	free(closestClusters);
+	
+	LNKMemoryBufferManagerFreeBlock(memoryManager, clusterCentroidsWorkspace, accumulatorLength);
 	free(examplesToClusters);
 }
 
 - (void)_setClusterCentroids:(const LNKFloat *)clusterCentroids {
 	_isUsingCustomCentroids = YES;
 	[super _setClusterCentroids:clusterCentroids];
+	
+	// Custom centroids count as much as a single example towards mini-batch updates.
+	[self _setClusterExampleCount:1];
+	[self _didUpdateCentroids];
+	_hasCentroids = YES;
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+- (void)_validatePredictionMatrix:(LNKMatrix *)matrix {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	
+	if (matrix.columnCount != self.matrix.columnCount || matrix.hasBiasColumn)
+		[NSException raise:NSGenericException format:@"The columns of the matrix are incompatible with the training matrix"];
+	
+	if (!_hasCentroids)
+		[NSException raise:NSGenericException format:@"The classifier must be trained before making predictions"];
+}
+
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _validatePredictionMatrix:matrix];
+	
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	
+	const LNKSize clusterCount = self.classes.count;
+	const LNKSize columnCount = matrix.columnCount;
+	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	const LNKFloat *transposedCentroids = _transposedCentroids;
+	const LNKFloat *centroidSquaredNorms = _centroidSquaredNorms;
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), ASSIGNMENT_BLOCK_SIZE, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+		const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+		LNKFloat *squaredDistances = LNKMemoryBufferManagerAllocScratch(memoryManager, ASSIGNMENT_BLOCK_SIZE * clusterCount);
+		LNKSize closestClusters[ASSIGNMENT_BLOCK_SIZE];
+		
+		for (LNKSize blockStart = range.location; blockStart < range.location + range.length; blockStart += ASSIGNMENT_BLOCK_SIZE) {
+			const LNKSize blockLength = MIN(ASSIGNMENT_BLOCK_SIZE, range.location + range.length - blockStart);
+			_LNKFindClosestClustersOfBlock(_ROW_IN_MATRIX_BUFFER(blockStart), blockLength, transposedCentroids, centroidSquaredNorms, clusterCount, columnCount, squaredDistances, closestClusters);
+			
+			for (LNKSize row = 0; row < blockLength; row++) {
+				outputBuffer[blockStart + row] = closestClusters[row];
+			}
+		}
+		
+		LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	});
+}
+
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
 	if (!featureVector.data)
 		[NSException raise:NSGenericException format:@"The feature vector must contain data"];
 		
 	if (featureVector.length != self.matrix.columnCount)
 		[NSException raise:NSGenericException format:@"The length of the feature vector must match the number of columns in the matrix"];
 	
-	return [NSNumber numberWithLNKSize:[self _closestClusterToExample:featureVector.data distance:NULL]];
+	if (!_hasCentroids)
+		[NSException raise:NSGenericException format:@"The classifier must be trained before making predictions"];
+	
+	const LNKSize clusterCount = self.classes.count;
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+	LNKFloat *squaredDistances = LNKMemoryBufferManagerAllocScratch(memoryManager, clusterCount);
+	LNKSize closestCluster;
+	
+	_LNKFindClosestClustersOfBlock(featureVector.data, 1, _transposedCentroids, _centroidSquaredNorms, clusterCount, featureVector.length, squaredDistances, &closestCluster);
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	
+	LNK_vclr(outProbabilities, UNIT_STRIDE, clusterCount);
+	outProbabilities[closestCluster] = 1;
+	
+	return YES;
+}
+
+- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+	return [NSNumber numberWithLNKSize:[self predictClassIndexForFeatureVector:featureVector probabilities:NULL]];
 }
 
 @end
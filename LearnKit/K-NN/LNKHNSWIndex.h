@@ -0,0 +1,29 @@
+//
+//  LNKHNSWIndex.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKNeighborHeap.h"
+
+/// A hierarchical navigable small world graph for approximate nearest neighbor searches by squared euclidean distance.
+/// The index refers to rows of a row-major matrix by their indices and does not own the matrix. Since the matrix may
+/// move as rows are appended to it, every call takes its current location.
+typedef struct _LNKHNSWIndex LNKHNSWIndex;
+typedef LNKHNSWIndex *LNKHNSWIndexRef;
+
+/// Each row is linked to up to `neighborCount` rows on the upper layers of the graph and twice as many on the bottom layer.
+LNKHNSWIndexRef LNKHNSWIndexCreate(LNKSize columnCount, LNKSize neighborCount);
+void LNKHNSWIndexFree(LNKHNSWIndexRef index);
+
+LNKSize LNKHNSWIndexGetRowCount(LNKHNSWIndexRef index);
+
+/// Inserts the rows of `matrix` in `range`, which must start at the index's row count, using the shared executor.
+/// Each insertion tracks the `constructionBreadth` closest rows per layer; larger values build a better graph, more slowly.
+/// Insertions must not run concurrently with searches.
+void LNKHNSWIndexAddRows(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKRange range, LNKSize constructionBreadth);
+
+/// Finds rows close to `point`, up to the capacity of `heap`, while tracking the `searchBreadth` closest rows found so far.
+/// Larger search breadths find more of the exact nearest neighbors, more slowly. Searches are read-only and may run concurrently.
+void LNKHNSWIndexFindNearestNeighbors(LNKHNSWIndexRef index, const LNKFloat *matrix, const LNKFloat *point, LNKSize searchBreadth, LNKNeighborHeap *heap);
@@ -0,0 +1,513 @@
+//
+//  LNKHNSWIndex.m
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKHNSWIndex.h"
+
+#import "LNKAccelerate.h"
+#import "LNKExecutor.h"
+#import <pthread.h>
+
+#define LINK_LOCK_COUNT		4096	// Rows share locks so their number stays bounded.
+#define MAX_LEVEL			31
+#define MIN_QUEUE_CAPACITY	64
+#define SERIAL_ROW_COUNT	1024	// Rows inserted one at a time while the graph is too small to insert into in parallel.
+
+// Every list of links starts with the number of links in it.
+typedef uint32_t _LNKHNSWLink;
+
+struct _LNKHNSWVisitedList {
+	uint16_t *marks;
+	LNKSize capacity;
+	uint16_t mark;		// Rows marked with the current mark have been visited.
+	struct _LNKHNSWVisitedList *next;
+};
+
+// A min-heap of rows left to explore.
+typedef struct {
+	LNKNeighbor *neighbors;
+	LNKSize count;
+	LNKSize capacity;
+} _LNKHNSWQueue;
+
+struct _LNKHNSWIndex {
+	LNKSize columnCount;
+	LNKSize neighborCount;
+	LNKFloat levelMultiplier;
+	
+	LNKSize rowCount;
+	LNKSize rowCapacity;
+	_LNKHNSWLink *baseLinks;	// A list of up to 2 * neighborCount links per row.
+	_LNKHNSWLink **upperLinks;	// Per row, a list of up to neighborCount links for every level above the bottom one.
+	uint8_t *levels;
+	
+	pthread_mutex_t lock;		// Guards the entry point and top level during insertions.
+	LNKSize entryPoint;
+	LNKSize topLevel;
+	
+	pthread_mutex_t linkLocks[LINK_LOCK_COUNT];
+	
+	pthread_mutex_t visitedListLock;
+	struct _LNKHNSWVisitedList *visitedLists;
+};
+
+static inline LNKSize _LNKHNSWGetMaxLinkCount(LNKHNSWIndexRef index, LNKSize level) {
+	return level ? index->neighborCount : 2 * index->neighborCount;
+}
+
+static inline _LNKHNSWLink *_LNKHNSWGetLinks(LNKHNSWIndexRef index, LNKSize row, LNKSize level) {
+	if (level == 0)
+		return index->baseLinks + row * (1 + 2 * index->neighborCount);
+	
+	return index->upperLinks[row] + (level - 1) * (1 + index->neighborCount);
+}
+
+static inline pthread_mutex_t *_LNKHNSWGetLinkLock(LNKHNSWIndexRef index, LNKSize row) {
+	return &index->linkLocks[row % LINK_LOCK_COUNT];
+}
+
+/// Insertions lock the links they read since other insertions may be rewriting them.
+static void _LNKHNSWCopyLinks(LNKHNSWIndexRef index, LNKSize row, LNKSize level, _LNKHNSWLink *outLinks, BOOL locksLinks) {
+	const _LNKHNSWLink *const links = _LNKHNSWGetLinks(index, row, level);
+	
+	if (locksLinks)
+		pthread_mutex_lock(_LNKHNSWGetLinkLock(index, row));
+	
+	memcpy(outLinks, links, (1 + links[0]) * sizeof(_LNKHNSWLink));
+	
+	if (locksLinks)
+		pthread_mutex_unlock(_LNKHNSWGetLinkLock(index, row));
+}
+
+static inline LNKFloat _LNKHNSWDistance(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKSize row, const LNKFloat *point) {
+	LNKFloat distance;
+	LNKVectorDistance(matrix + row * index->columnCount, point, &distance, index->columnCount);
+	
+	return distance;
+}
+
+/// Levels are exponentially distributed and derived from the row index so graphs don't depend on the order of parallel insertions.
+static LNKSize _LNKHNSWGetRandomLevel(LNKHNSWIndexRef index, LNKSize row) {
+	// SplitMix64
+	uint64_t z = (row + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	
+	// Uniform in (0, 1].
+	const LNKFloat uniform = ((z >> 11) + 1) * 0x1.0p-53;
+	
+	return MIN(MAX_LEVEL, (LNKSize)(-log(uniform) * index->levelMultiplier));
+}
+
+static void _LNKHNSWQueuePush(_LNKHNSWQueue *queue, LNKNeighbor neighbor) {
+	if (queue->count == queue->capacity) {
+		queue->capacity = MAX(MIN_QUEUE_CAPACITY, 2 * queue->capacity);
+		queue->neighbors = realloc(queue->neighbors, queue->capacity * sizeof(LNKNeighbor));
+	}
+	
+	LNKNeighbor *const neighbors = queue->neighbors;
+	LNKSize child = queue->count++;
+	
+	while (child > 0) {
+		const LNKSize parent = (child - 1) / 2;
+		
+		if (neighbors[parent].distance <= neighbor.distance)
+			break;
+		
+		neighbors[child] = neighbors[parent];
+		child = parent;
+	}
+	
+	neighbors[child] = neighbor;
+}
+
+static LNKNeighbor _LNKHNSWQueuePop(_LNKHNSWQueue *queue) {
+	LNKNeighbor *const neighbors = queue->neighbors;
+	const LNKNeighbor closest = neighbors[0];
+	const LNKNeighbor last = neighbors[--queue->count];
+	const LNKSize count = queue->count;
+	LNKSize parent = 0;
+	
+	while (YES) {
+		LNKSize child = 2 * parent + 1;
+		
+		if (child >= count)
+			break;
+		
+		if (child + 1 < count && neighbors[child + 1].distance < neighbors[child].distance)
+			child++;
+		
+		if (neighbors[child].distance >= last.distance)
+			break;
+		
+		neighbors[parent] = neighbors[child];
+		parent = child;
+	}
+	
+	neighbors[parent] = last;
+	
+	return closest;
+}
+
+static struct _LNKHNSWVisitedList *_LNKHNSWGetVisitedList(LNKHNSWIndexRef index) {
+	pthread_mutex_lock(&index->visitedListLock);
+	struct _LNKHNSWVisitedList *visited = index->visitedLists;
+	
+	if (visited)
+		index->visitedLists = visited->next;
+	
+	pthread_mutex_unlock(&index->visitedListLock);
+	
+	if (!visited)
+		visited = calloc(1, sizeof(struct _LNKHNSWVisitedList));
+	
+	if (visited->capacity < index->rowCount) {
+		free(visited->marks);
+		visited->capacity = index->rowCapacity;
+		visited->marks = calloc(visited->capacity, sizeof(uint16_t));
+		visited->mark = 0;
+	}
+	
+	return visited;
+}
+
+static void _LNKHNSWReturnVisitedList(LNKHNSWIndexRef index, struct _LNKHNSWVisitedList *visited) {
+	pthread_mutex_lock(&index->visitedListLock);
+	visited->next = index->visitedLists;
+	index->visitedLists = visited;
+	pthread_mutex_unlock(&index->visitedListLock);
+}
+
+/// Forgets all visited rows.
+static void _LNKHNSWResetVisitedList(struct _LNKHNSWVisitedList *visited) {
+	if (++visited->mark == 0) {
+		memset(visited->marks, 0, visited->capacity * sizeof(uint16_t));
+		visited->mark = 1;
+	}
+}
+
+/// Greedily moves toward `point` on each level above `level`.
+static LNKNeighbor _LNKHNSWDescend(LNKHNSWIndexRef index, const LNKFloat *matrix, const LNKFloat *point, LNKNeighbor closest, LNKSize topLevel, LNKSize level, BOOL locksLinks) {
+	_LNKHNSWLink links[1 + index->neighborCount];
+	
+	for (LNKSize currentLevel = topLevel; currentLevel > level; currentLevel--) {
+		BOOL movedCloser = YES;
+		
+		while (movedCloser) {
+			movedCloser = NO;
+			_LNKHNSWCopyLinks(index, closest.index, currentLevel, links, locksLinks);
+			
+			for (LNKSize linkIndex = 1; linkIndex <= links[0]; linkIndex++) {
+				const LNKFloat distance = _LNKHNSWDistance(index, matrix, links[linkIndex], point);
+				
+				if (distance < closest.distance) {
+					closest = (LNKNeighbor) { distance, links[linkIndex] };
+					movedCloser = YES;
+				}
+			}
+		}
+	}
+	
+	return closest;
+}
+
+/// Explores the rows linked on `level` in order of increasing distance from `point`, keeping the closest ones in `results`.
+/// The search stops once the closest unexplored row is farther than all of the results.
+static void _LNKHNSWSearchLevel(LNKHNSWIndexRef index, const LNKFloat *matrix, const LNKFloat *point, LNKNeighbor entry, LNKSize level, BOOL locksLinks,
+								struct _LNKHNSWVisitedList *visited, _LNKHNSWQueue *queue, LNKNeighborHeap *results) {
+	_LNKHNSWLink links[1 + 2 * index->neighborCount];
+	
+	_LNKHNSWResetVisitedList(visited);
+	uint16_t *const marks = visited->marks;
+	const uint16_t mark = visited->mark;
+	
+	marks[entry.index] = mark;
+	queue->count = 0;
+	_LNKHNSWQueuePush(queue, entry);
+	LNKNeighborHeapPush(results, entry.distance, entry.index);
+	
+	while (queue->count) {
+		const LNKNeighbor closest = _LNKHNSWQueuePop(queue);
+		
+		if (closest.distance > LNKNeighborHeapGetBound(results))
+			break;
+		
+		_LNKHNSWCopyLinks(index, closest.index, level, links, locksLinks);
+		
+		for (LNKSize linkIndex = 1; linkIndex <= links[0]; linkIndex++) {
+			const LNKSize row = links[linkIndex];
+			
+			if (marks[row] == mark)
+				continue;
+			
+			marks[row] = mark;
+			
+			const LNKFloat distance = _LNKHNSWDistance(index, matrix, row, point);
+			
+			if (distance < LNKNeighborHeapGetBound(results)) {
+				_LNKHNSWQueuePush(queue, (LNKNeighbor) { distance, row });
+				LNKNeighborHeapPush(results, distance, row);
+			}
+		}
+	}
+}
+
+/// `candidates` must be sorted in order of increasing distance from a row. Candidates closer to an already selected candidate
+/// than to the row are skipped, so links point in diverse directions and the graph stays navigable across clusters.
+/// The selected candidates are moved to the front and their number is returned.
+static LNKSize _LNKHNSWSelectNeighbors(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKNeighbor *candidates, LNKSize candidateCount, LNKSize maxCount) {
+	LNKSize selectedCount = 0;
+	
+	for (LNKSize candidateIndex = 0; candidateIndex < candidateCount && selectedCount < maxCount; candidateIndex++) {
+		const LNKNeighbor candidate = candidates[candidateIndex];
+		const LNKFloat *candidateRow = matrix + candidate.index * index->columnCount;
+		BOOL isDiverse = YES;
+		
+		for (LNKSize selectedIndex = 0; selectedIndex < selectedCount; selectedIndex++) {
+			if (_LNKHNSWDistance(index, matrix, candidates[selectedIndex].index, candidateRow) < candidate.distance) {
+				isDiverse = NO;
+				break;
+			}
+		}
+		
+		if (isDiverse)
+			candidates[selectedCount++] = candidate;
+	}
+	
+	return selectedCount;
+}
+
+static int _LNKHNSWCompareNeighbors(const void *a, const void *b) {
+	const LNKFloat distanceA = ((const LNKNeighbor *)a)->distance;
+	const LNKFloat distanceB = ((const LNKNeighbor *)b)->distance;
+	
+	return (distanceA > distanceB) - (distanceA < distanceB);
+}
+
+/// Links `row` to `neighbors` on `level` and links the neighbors back, pruning their links when they have too many.
+static void _LNKHNSWConnect(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKSize row, const LNKNeighbor *neighbors, LNKSize neighborCount, LNKSize level) {
+	const LNKSize maxLinkCount = _LNKHNSWGetMaxLinkCount(index, level);
+	LNKNeighbor candidates[maxLinkCount + 1];
+	
+	pthread_mutex_lock(_LNKHNSWGetLinkLock(index, row));
+	_LNKHNSWLink *const links = _LNKHNSWGetLinks(index, row, level);
+	links[0] = (_LNKHNSWLink)neighborCount;
+	
+	for (LNKSize neighborIndex = 0; neighborIndex < neighborCount; neighborIndex++)
+		links[1 + neighborIndex] = (_LNKHNSWLink)neighbors[neighborIndex].index;
+	
+	pthread_mutex_unlock(_LNKHNSWGetLinkLock(index, row));
+	
+	for (LNKSize neighborIndex = 0; neighborIndex < neighborCount; neighborIndex++) {
+		const LNKNeighbor neighbor = neighbors[neighborIndex];
+		
+		pthread_mutex_lock(_LNKHNSWGetLinkLock(index, neighbor.index));
+		_LNKHNSWLink *const neighborLinks = _LNKHNSWGetLinks(index, neighbor.index, level);
+		const LNKSize linkCount = neighborLinks[0];
+		
+		if (linkCount < maxLinkCount) {
+			neighborLinks[1 + linkCount] = (_LNKHNSWLink)row;
+			neighborLinks[0]++;
+		}
+		else {
+			// Pick the neighbor's links again from its current links and the new row.
+			const LNKFloat *neighborRow = matrix + neighbor.index * index->columnCount;
+			candidates[0] = (LNKNeighbor) { neighbor.distance, row };
+			
+			for (LNKSize linkIndex = 0; linkIndex < linkCount; linkIndex++) {
+				const LNKSize linkedRow = neighborLinks[1 + linkIndex];
+				candidates[1 + linkIndex] = (LNKNeighbor) { _LNKHNSWDistance(index, matrix, linkedRow, neighborRow), linkedRow };
+			}
+			
+			qsort(candidates, linkCount + 1, sizeof(LNKNeighbor), &_LNKHNSWCompareNeighbors);
+			const LNKSize selectedCount = _LNKHNSWSelectNeighbors(index, matrix, candidates, linkCount + 1, maxLinkCount);
+			
+			neighborLinks[0] = (_LNKHNSWLink)selectedCount;
+			
+			for (LNKSize linkIndex = 0; linkIndex < selectedCount; linkIndex++)
+				neighborLinks[1 + linkIndex] = (_LNKHNSWLink)candidates[linkIndex].index;
+		}
+		
+		pthread_mutex_unlock(_LNKHNSWGetLinkLock(index, neighbor.index));
+	}
+}
+
+static void _LNKHNSWInsertRow(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKSize row, LNKSize constructionBreadth,
+							  struct _LNKHNSWVisitedList *visited, _LNKHNSWQueue *queue, LNKNeighbor *results) {
+	const LNKFloat *point = matrix + row * index->columnCount;
+	const LNKSize level = index->levels[row];
+	
+	pthread_mutex_lock(&index->lock);
+	const LNKSize entryPoint = index->entryPoint;
+	const LNKSize topLevel = index->topLevel;
+	const BOOL becomesEntryPoint = level > topLevel;
+	
+	// Other insertions wait for a new entry point to be linked before they start from it.
+	if (!becomesEntryPoint)
+		pthread_mutex_unlock(&index->lock);
+	
+	LNKNeighbor closest = { _LNKHNSWDistance(index, matrix, entryPoint, point), entryPoint };
+	closest = _LNKHNSWDescend(index, matrix, point, closest, topLevel, level, YES);
+	
+	for (LNKSize currentLevel = MIN(level, topLevel) + 1; currentLevel-- > 0;) {
+		LNKNeighborHeap heap = LNKNeighborHeapMake(results, constructionBreadth);
+		_LNKHNSWSearchLevel(index, matrix, point, closest, currentLevel, YES, visited, queue, &heap);
+		LNKNeighborHeapSort(&heap);
+		
+		closest = results[0];
+		
+		const LNKSize neighborCount = _LNKHNSWSelectNeighbors(index, matrix, results, heap.count, index->neighborCount);
+		_LNKHNSWConnect(index, matrix, row, results, neighborCount, currentLevel);
+	}
+	
+	if (becomesEntryPoint) {
+		index->entryPoint = row;
+		index->topLevel = level;
+		pthread_mutex_unlock(&index->lock);
+	}
+}
+
+static void _LNKHNSWInsertRows(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKRange range, LNKSize constructionBreadth) {
+	struct _LNKHNSWVisitedList *visited = _LNKHNSWGetVisitedList(index);
+	_LNKHNSWQueue queue = { NULL, 0, 0 };
+	LNKNeighbor *results = malloc(constructionBreadth * sizeof(LNKNeighbor));
+	
+	for (LNKSize row = range.location; row < range.location + range.length; row++)
+		_LNKHNSWInsertRow(index, matrix, row, constructionBreadth, visited, &queue, results);
+	
+	free(results);
+	free(queue.neighbors);
+	_LNKHNSWReturnVisitedList(index, visited);
+}
+
+LNKHNSWIndexRef LNKHNSWIndexCreate(LNKSize columnCount, LNKSize neighborCount) {
+	NSCAssert(columnCount, @"The column count must be greater than 0");
+	NSCAssert(neighborCount >= 2, @"Rows must be linked to at least 2 neighbors");
+	
+	LNKHNSWIndexRef index = calloc(1, sizeof(LNKHNSWIndex));
+	index->columnCount = columnCount;
+	index->neighborCount = neighborCount;
+	index->levelMultiplier = 1 / log(neighborCount);
+	
+	pthread_mutex_init(&index->lock, NULL);
+	pthread_mutex_init(&index->visitedListLock, NULL);
+	
+	for (LNKSize lockIndex = 0; lockIndex < LINK_LOCK_COUNT; lockIndex++)
+		pthread_mutex_init(&index->linkLocks[lockIndex], NULL);
+	
+	return index;
+}
+
+void LNKHNSWIndexFree(LNKHNSWIndexRef index) {
+	NSCAssert(index, @"The index must not be NULL");
+	
+	for (LNKSize row = 0; row < index->rowCount; row++)
+		free(index->upperLinks[row]);
+	
+	while (index->visitedLists) {
+		struct _LNKHNSWVisitedList *next = index->visitedLists->next;
+		free(index->visitedLists->marks);
+		free(index->visitedLists);
+		index->visitedLists = next;
+	}
+	
+	for (LNKSize lockIndex = 0; lockIndex < LINK_LOCK_COUNT; lockIndex++)
+		pthread_mutex_destroy(&index->linkLocks[lockIndex]);
+	
+	pthread_mutex_destroy(&index->visitedListLock);
+	pthread_mutex_destroy(&index->lock);
+	
+	free(index->levels);
+	free(index->upperLinks);
+	free(index->baseLinks);
+	free(index);
+}
+
+LNKSize LNKHNSWIndexGetRowCount(LNKHNSWIndexRef index) {
+	NSCAssert(index, @"The index must not be NULL");
+	return index->rowCount;
+}
+
+void LNKHNSWIndexAddRows(LNKHNSWIndexRef index, const LNKFloat *matrix, LNKRange range, LNKSize constructionBreadth) {
+	NSCAssert(index, @"The index must not be NULL");
+	NSCAssert(matrix, @"The matrix must not be NULL");
+	NSCAssert(range.location == index->rowCount, @"Rows must be added in order");
+	NSCAssert(range.location + range.length <= UINT32_MAX, @"The index holds at most UINT32_MAX rows");
+	NSCAssert(constructionBreadth, @"The construction breadth must be greater than 0");
+	
+	if (!range.length)
+		return;
+	
+	const LNKSize rowCount = range.location + range.length;
+	const LNKSize baseLinksLength = 1 + 2 * index->neighborCount;
+	
+	if (rowCount > index->rowCapacity) {
+		index->rowCapacity = MAX(rowCount, 2 * index->rowCapacity);
+		index->baseLinks = realloc(index->baseLinks, index->rowCapacity * baseLinksLength * sizeof(_LNKHNSWLink));
+		index->upperLinks = realloc(index->upperLinks, index->rowCapacity * sizeof(_LNKHNSWLink *));
+		index->levels = realloc(index->levels, index->rowCapacity * sizeof(uint8_t));
+	}
+	
+	for (LNKSize row = range.location; row < rowCount; row++) {
+		const LNKSize level = _LNKHNSWGetRandomLevel(index, row);
+		index->levels[row] = (uint8_t)level;
+		index->upperLinks[row] = level ? calloc(level * (1 + index->neighborCount), sizeof(_LNKHNSWLink)) : NULL;
+		index->baseLinks[row * baseLinksLength] = 0;
+	}
+	
+	LNKSize location = range.location;
+	
+	if (location == 0) {
+		index->entryPoint = 0;
+		index->topLevel = index->levels[0];
+		location++;
+	}
+	
+	index->rowCount = rowCount;
+	
+	// Parallel insertions into a small graph link rows to each other before they can find their true neighbors.
+	if (location < SERIAL_ROW_COUNT) {
+		const LNKSize serialRowCount = MIN(SERIAL_ROW_COUNT, rowCount) - location;
+		_LNKHNSWInsertRows(index, matrix, LNKRangeMake(location, serialRowCount), constructionBreadth);
+		location += serialRowCount;
+	}
+	
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(location, rowCount - location), 0, ^(LNKRange innerRange, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		_LNKHNSWInsertRows(index, matrix, innerRange, constructionBreadth);
+	});
+}
+
+void LNKHNSWIndexFindNearestNeighbors(LNKHNSWIndexRef index, const LNKFloat *matrix, const LNKFloat *point, LNKSize searchBreadth, LNKNeighborHeap *heap) {
+	NSCAssert(index, @"The index must not be NULL");
+	NSCAssert(matrix, @"The matrix must not be NULL");
+	NSCAssert(point, @"The point must not be NULL");
+	NSCAssert(heap, @"The heap must not be NULL");
+	
+	if (!index->rowCount)
+		return;
+	
+	searchBreadth = MAX(searchBreadth, heap->capacity);
+	
+	const LNKSize entryPoint = index->entryPoint;
+	LNKNeighbor closest = { _LNKHNSWDistance(index, matrix, entryPoint, point), entryPoint };
+	closest = _LNKHNSWDescend(index, matrix, point, closest, index->topLevel, 0, NO);
+	
+	struct _LNKHNSWVisitedList *visited = _LNKHNSWGetVisitedList(index);
+	_LNKHNSWQueue queue = { NULL, 0, 0 };
+	LNKNeighbor *results = malloc(searchBreadth * sizeof(LNKNeighbor));
+	LNKNeighborHeap resultHeap = LNKNeighborHeapMake(results, searchBreadth);
+	
+	_LNKHNSWSearchLevel(index, matrix, point, closest, 0, NO, visited, &queue, &resultHeap);
+	
+	for (LNKSize resultIndex = 0; resultIndex < resultHeap.count; resultIndex++)
+		LNKNeighborHeapPush(heap, results[resultIndex].distance, results[resultIndex].index);
+	
+	free(results);
+	free(queue.neighbors);
+	_LNKHNSWReturnVisitedList(index, visited);
+}
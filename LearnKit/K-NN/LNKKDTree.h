@@ -0,0 +1,19 @@
+//
+//  LNKKDTree.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKNeighborHeap.h"
+
+typedef struct _LNKKDTree LNKKDTree;
+typedef LNKKDTree *LNKKDTreeRef;
+
+/// Builds a k-d tree over the rows of the row-major matrix. The rows are copied in tree order.
+LNKKDTreeRef LNKKDTreeCreate(const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount);
+void LNKKDTreeFree(LNKKDTreeRef tree);
+
+/// Finds the rows closest to `point` by squared euclidean distance, up to the capacity of `heap`.
+/// Searches are read-only and may run concurrently.
+void LNKKDTreeFindNearestNeighbors(LNKKDTreeRef tree, const LNKFloat *point, LNKNeighborHeap *heap);
@@ -0,0 +1,189 @@
+//
+//  LNKKDTree.m
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import "LNKKDTree.h"
+
+#import "LNKAccelerate.h"
+
+#define LEAF_SIZE	16
+
+typedef struct {
+	LNKSize begin, end;		// The node's rows, in tree order.
+	LNKSize left, right;	// 0 for leaves; the root is never a child.
+	LNKSize splitColumn;
+	LNKFloat splitValue;
+} _LNKKDTreeNode;
+
+struct _LNKKDTree {
+	LNKFloat *rows;			// Copied in tree order so leaves are contiguous.
+	LNKSize *rowIndices;	// Maps tree order back to the original row indices.
+	LNKSize rowCount;
+	LNKSize columnCount;
+
+	_LNKKDTreeNode *nodes;
+	LNKSize nodeCount;
+	LNKSize nodeCapacity;
+};
+
+/// Partially sorts `indices` so the element at `nth` is in place and everything before it is no greater (Wirth's method).
+static void _LNKSelectNth(LNKSize *indices, LNKSize count, LNKSize nth, const LNKFloat *matrix, LNKSize columnCount, LNKSize column) {
+#define VALUE(i) matrix[indices[(i)] * columnCount + column]
+	long low = 0, high = (long)count - 1;
+	const long target = (long)nth;
+
+	while (low < high) {
+		const LNKFloat pivot = VALUE(target);
+		long i = low, j = high;
+
+		do {
+			while (VALUE(i) < pivot)
+				i++;
+
+			while (pivot < VALUE(j))
+				j--;
+
+			if (i <= j) {
+				const LNKSize temp = indices[i];
+				indices[i] = indices[j];
+				indices[j] = temp;
+				i++;
+				j--;
+			}
+		} while (i <= j);
+
+		if (j < target)
+			low = i;
+
+		if (target < i)
+			high = j;
+	}
+#undef VALUE
+}
+
+static LNKSize _LNKKDTreeBuildNode(LNKKDTreeRef tree, const LNKFloat *matrix, LNKSize begin, LNKSize end) {
+	if (tree->nodeCount == tree->nodeCapacity) {
+		tree->nodeCapacity *= 2;
+		tree->nodes = realloc(tree->nodes, tree->nodeCapacity * sizeof(_LNKKDTreeNode));
+	}
+
+	const LNKSize nodeIndex = tree->nodeCount++;
+	const LNKSize columnCount = tree->columnCount;
+	LNKSize *const rowIndices = tree->rowIndices;
+
+	tree->nodes[nodeIndex] = (_LNKKDTreeNode) { begin, end, 0, 0, 0, 0 };
+
+	if (end - begin <= LEAF_SIZE)
+		return nodeIndex;
+
+	// Split along the column with the largest spread.
+	LNKSize splitColumn = 0;
+	LNKFloat largestSpread = -1;
+
+	for (LNKSize column = 0; column < columnCount; column++) {
+		LNKFloat minimum = LNKFloatMax, maximum = -LNKFloatMax;
+
+		for (LNKSize i = begin; i < end; i++) {
+			const LNKFloat value = matrix[rowIndices[i] * columnCount + column];
+			minimum = MIN(minimum, value);
+			maximum = MAX(maximum, value);
+		}
+
+		if (maximum - minimum > largestSpread) {
+			largestSpread = maximum - minimum;
+			splitColumn = column;
+		}
+	}
+
+	// All remaining rows are identical.
+	if (largestSpread == 0)
+		return nodeIndex;
+
+	const LNKSize middle = begin + (end - begin) / 2;
+	_LNKSelectNth(rowIndices + begin, end - begin, middle - begin, matrix, columnCount, splitColumn);
+
+	// Building the children reorders their rows, so read the median first.
+	const LNKFloat splitValue = matrix[rowIndices[middle] * columnCount + splitColumn];
+	const LNKSize left = _LNKKDTreeBuildNode(tree, matrix, begin, middle);
+	const LNKSize right = _LNKKDTreeBuildNode(tree, matrix, middle, end);
+
+	// `tree->nodes` may have moved while building the children.
+	_LNKKDTreeNode *const node = &tree->nodes[nodeIndex];
+	node->left = left;
+	node->right = right;
+	node->splitColumn = splitColumn;
+	node->splitValue = splitValue;
+
+	return nodeIndex;
+}
+
+LNKKDTreeRef LNKKDTreeCreate(const LNKFloat *matrix, LNKSize rowCount, LNKSize columnCount) {
+	NSCAssert(matrix, @"The matrix must not be NULL");
+	NSCAssert(rowCount, @"The matrix must not be empty");
+	NSCAssert(columnCount, @"The matrix must not be empty");
+
+	LNKKDTreeRef tree = calloc(1, sizeof(LNKKDTree));
+	tree->rowCount = rowCount;
+	tree->columnCount = columnCount;
+	tree->rowIndices = malloc(rowCount * sizeof(LNKSize));
+	tree->nodeCapacity = 2 * (rowCount / LEAF_SIZE + 1);
+	tree->nodes = malloc(tree->nodeCapacity * sizeof(_LNKKDTreeNode));
+
+	for (LNKSize row = 0; row < rowCount; row++)
+		tree->rowIndices[row] = row;
+
+	_LNKKDTreeBuildNode(tree, matrix, 0, rowCount);
+
+	tree->rows = LNKFloatAlloc(rowCount * columnCount);
+
+	for (LNKSize i = 0; i < rowCount; i++)
+		LNKFloatCopy(tree->rows + i * columnCount, matrix + tree->rowIndices[i] * columnCount, columnCount);
+
+	return tree;
+}
+
+void LNKKDTreeFree(LNKKDTreeRef tree) {
+	NSCAssert(tree, @"The tree must not be NULL");
+
+	free(tree->rows);
+	free(tree->rowIndices);
+	free(tree->nodes);
+	free(tree);
+}
+
+static void _LNKKDTreeSearch(LNKKDTreeRef tree, LNKSize nodeIndex, const LNKFloat *point, LNKNeighborHeap *heap) {
+	const _LNKKDTreeNode *const node = &tree->nodes[nodeIndex];
+	const LNKSize columnCount = tree->columnCount;
+
+	if (!node->left) {
+		for (LNKSize i = node->begin; i < node->end; i++) {
+			LNKFloat distance;
+			LNKVectorDistance(tree->rows + i * columnCount, point, &distance, columnCount);
+			LNKNeighborHeapPush(heap, distance, tree->rowIndices[i]);
+		}
+
+		return;
+	}
+
+	// Visit the side of the split containing the point first; the other side only needs to be visited
+	// if the splitting plane is closer than the farthest neighbor found so far.
+	const LNKFloat offset = point[node->splitColumn] - node->splitValue;
+	const LNKSize nearChild = offset < 0 ? node->left : node->right;
+	const LNKSize farChild = offset < 0 ? node->right : node->left;
+
+	_LNKKDTreeSearch(tree, nearChild, point, heap);
+
+	if (offset * offset < LNKNeighborHeapGetBound(heap))
+		_LNKKDTreeSearch(tree, farChild, point, heap);
+}
+
+void LNKKDTreeFindNearestNeighbors(LNKKDTreeRef tree, const LNKFloat *point, LNKNeighborHeap *heap) {
+	NSCAssert(tree, @"The tree must not be NULL");
+	NSCAssert(point, @"The point must not be NULL");
+	NSCAssert(heap, @"The heap must not be NULL");
+
+	_LNKKDTreeSearch(tree, 0, point, heap);
+}
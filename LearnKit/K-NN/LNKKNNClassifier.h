@@ -17,16 +17,33 @@ typedef NS_ENUM(NSUInteger, LNKKNNOutputFunction) {
 	LNKKNNOutputFunctionMostFrequent,
 	
 	/// This output function finds the average of the k-closest output values.
-	/// It returns NSNumbers with type LNKFloat.
+	/// It returns NSNumbers with type LNKFloat, and class indices can't be predicted with it.
 	LNKKNNOutputFunctionAverage
 };
 
+typedef NS_ENUM(NSUInteger, LNKKNNSearchAlgorithm) {
+	/// Uses a k-d tree with `LNKKNNEuclideanDistanceFunction` on matrices with few columns, and brute force otherwise.
+	LNKKNNSearchAlgorithmAutomatic,
+	
+	/// Compares the feature vector against every example.
+	LNKKNNSearchAlgorithmBruteForce,
+	
+	/// Searches a k-d tree built over the examples. This only applies to `LNKKNNEuclideanDistanceFunction`;
+	/// other distance functions always use brute force.
+	LNKKNNSearchAlgorithmKDTree,
+	
+	/// Searches a hierarchical navigable small world graph built over the examples. Searches take roughly logarithmic time
+	/// even with hundreds of columns, but may miss some of the nearest neighbors; see `-computeApproximateRecallOnMatrix:`.
+	/// Like k-d trees, this only applies to `LNKKNNEuclideanDistanceFunction`.
+	LNKKNNSearchAlgorithmApproximate
+};
+
 /// The optimization algorithm for k-NN classifiers is ignored and can be `nil`.
 /// Predicted values depend on the output function used.
 /// LNKKNNClassifier makes a copy of the matrix it is created with and normalizes it so that all features are on the same scale.
 @interface LNKKNNClassifier : LNKClassifier
 
-/// The value of `k` must be >= 1 and less than the number of examples in the matrix.
+/// The value of `k` must be >= 1 and less than the number of examples, including ones added with `-addExamplesFromMatrix:`.
 /// The default value is 1.
 @property (nonatomic) LNKSize k;
 
@@ -38,6 +55,36 @@ typedef NS_ENUM(NSUInteger, LNKKNNOutputFunction) {
 /// The default is `LNKKNNOutputFunctionMostFrequent`.
 @property (nonatomic) LNKKNNOutputFunction outputFunction;
 
+/// The search algorithm used to find the k-nearest neighbors. All but `LNKKNNSearchAlgorithmApproximate` find the exact neighbors.
+/// The default is `LNKKNNSearchAlgorithmAutomatic`.
+@property (nonatomic) LNKKNNSearchAlgorithm searchAlgorithm;
+
+/// The number of candidates tracked while inserting examples into the approximate search graph.
+/// Larger values build a more accurate graph, more slowly. Changes apply to examples inserted afterwards.
+/// The default value is 200.
+@property (nonatomic) LNKSize approximateConstructionBreadth;
+
+/// The number of candidates tracked while searching the approximate search graph; values below `k` are treated as `k`.
+/// Larger values find more of the exact nearest neighbors, more slowly.
+/// The default value is 64.
+@property (nonatomic) LNKSize approximateSearchBreadth;
+
+/// Adds the rows of `matrix` and their outputs to the examples. Rows are normalized like feature vectors passed to
+/// `-predictValueForFeatureVector:`. The approximate search graph is updated incrementally; a k-d tree is rebuilt.
+/// Examples must not be added while predictions are running on other threads.
+- (void)addExamplesFromMatrix:(LNKMatrix *)matrix;
+
+/// Returns the average fraction of the exact k-nearest neighbors of each row of `matrix` that the approximate search finds.
+/// Rows should be held out from the examples and are normalized like feature vectors passed to `-predictValueForFeatureVector:`.
+/// Raises `NSInvalidArgumentException` if `k` exceeds the number of examples.
+- (LNKFloat)computeApproximateRecallOnMatrix:(LNKMatrix *)matrix;
+
+/// Predicts the value of every row of `matrix`, which are normalized like feature vectors passed to `-predictValueForFeatureVector:`.
+/// `outputBuffer` must hold `matrix.rowCount` values. Depending on the output function, they are the unsigned integer values of the
+/// most frequent classes or the averages of the k-closest output values.
+/// With `LNKKNNEuclideanDistanceFunction`, distances are computed between tiles of rows and tiles of examples with matrix multiplication.
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -21,6 +21,8 @@ const LNKKNNDistanceFunction LNKKNNEuclideanDistanceFunction = ^LNKFloat(LNKVect
 @implementation LNKKNNClassifier
 
 #define DEFAULT_K 1
+#define DEFAULT_APPROXIMATE_CONSTRUCTION_BREADTH	200
+#define DEFAULT_APPROXIMATE_SEARCH_BREADTH			64
 
 + (NSArray<NSNumber *> *)supportedImplementationTypes {
 	return @[ @(LNKImplementationTypeAccelerate) ];
@@ -59,16 +61,24 @@ const LNKKNNDistanceFunction LNKKNNEuclideanDistanceFunction = ^LNKFloat(LNKVect
 	_k = DEFAULT_K;
 	_distanceFunction = [LNKKNNEuclideanDistanceFunction copy];
 	_outputFunction = LNKKNNOutputFunctionMostFrequent;
+	_searchAlgorithm = LNKKNNSearchAlgorithmAutomatic;
+	_approximateConstructionBreadth = DEFAULT_APPROXIMATE_CONSTRUCTION_BREADTH;
+	_approximateSearchBreadth = DEFAULT_APPROXIMATE_SEARCH_BREADTH;
 
 	return self;
 }
 
+/// Subclasses that store examples of their own return how many there are, including ones added after initialization.
+- (LNKSize)_exampleCount {
+	return self.matrix.rowCount;
+}
+
 - (void)setK:(LNKSize)k {
 	if (k < 1) {
 		@throw [NSException exceptionWithName:NSGenericException reason:@"The parameter k must not be less than 1" userInfo:nil];
 	}
 	
-	if (k >= self.matrix.rowCount) {
+	if (k >= [self _exampleCount]) {
 		@throw [NSException exceptionWithName:NSGenericException reason:@"The parameter k must be less than the number of examples" userInfo:nil];
 	}
 	
@@ -95,6 +105,43 @@ const LNKKNNDistanceFunction LNKKNNEuclideanDistanceFunction = ^LNKFloat(LNKVect
 	[self didChangeValueForKey:@"distanceFunction"];
 }
 
+- (void)setApproximateConstructionBreadth:(LNKSize)approximateConstructionBreadth {
+	if (approximateConstructionBreadth < 1) {
+		@throw [NSException exceptionWithName:NSGenericException reason:@"The approximate construction breadth must not be less than 1" userInfo:nil];
+	}
+	
+	if (_approximateConstructionBreadth != approximateConstructionBreadth) {
+		[self willChangeValueForKey:@"approximateConstructionBreadth"];
+		_approximateConstructionBreadth = approximateConstructionBreadth;
+		[self didChangeValueForKey:@"approximateConstructionBreadth"];
+	}
+}
+
+- (void)setApproximateSearchBreadth:(LNKSize)approximateSearchBreadth {
+	if (approximateSearchBreadth < 1) {
+		@throw [NSException exceptionWithName:NSGenericException reason:@"The approximate search breadth must not be less than 1" userInfo:nil];
+	}
+	
+	if (_approximateSearchBreadth != approximateSearchBreadth) {
+		[self willChangeValueForKey:@"approximateSearchBreadth"];
+		_approximateSearchBreadth = approximateSearchBreadth;
+		[self didChangeValueForKey:@"approximateSearchBreadth"];
+	}
+}
+
+- (void)addExamplesFromMatrix:(LNKMatrix *)matrix {
+#pragma unused(matrix)
+	
+	NSAssertNotReachable(@"%s should be implemented by subclasses", __PRETTY_FUNCTION__);
+}
+
+- (LNKFloat)computeApproximateRecallOnMatrix:(LNKMatrix *)matrix {
+#pragma unused(matrix)
+	
+	NSAssertNotReachable(@"%s should be implemented by subclasses", __PRETTY_FUNCTION__);
+	return 0;
+}
+
 - (void)dealloc {
 	[_distanceFunction release];
 	[super dealloc];
@@ -0,0 +1,107 @@
+//
+//  LNKNeighborHeap.h
+//  LearnKit
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+typedef struct {
+	LNKFloat distance;
+	LNKSize index;
+} LNKNeighbor;
+
+/// A bounded max-heap that keeps the `capacity` closest neighbors pushed onto it.
+/// The farthest kept neighbor is at the root so it can be replaced in O(log k).
+typedef struct {
+	LNKNeighbor *neighbors;
+	LNKSize count;
+	LNKSize capacity;
+} LNKNeighborHeap;
+
+static inline LNKNeighborHeap LNKNeighborHeapMake(LNKNeighbor *storage, LNKSize capacity) {
+	return (LNKNeighborHeap) { storage, 0, capacity };
+}
+
+/// Neighbors farther than the bound can't make it onto the heap.
+static inline LNKFloat LNKNeighborHeapGetBound(const LNKNeighborHeap *heap) {
+	return heap->count < heap->capacity ? LNKFloatMax : heap->neighbors[0].distance;
+}
+
+static inline void LNKNeighborHeapPush(LNKNeighborHeap *heap, LNKFloat distance, LNKSize index) {
+	LNKNeighbor *const neighbors = heap->neighbors;
+
+	if (heap->count < heap->capacity) {
+		// Sift up.
+		LNKSize child = heap->count++;
+
+		while (child > 0) {
+			const LNKSize parent = (child - 1) / 2;
+
+			if (neighbors[parent].distance >= distance)
+				break;
+
+			neighbors[child] = neighbors[parent];
+			child = parent;
+		}
+
+		neighbors[child] = (LNKNeighbor) { distance, index };
+		return;
+	}
+
+	if (distance >= neighbors[0].distance)
+		return;
+
+	// Replace the root and sift down.
+	const LNKSize count = heap->count;
+	LNKSize parent = 0;
+
+	while (YES) {
+		LNKSize child = 2 * parent + 1;
+
+		if (child >= count)
+			break;
+
+		if (child + 1 < count && neighbors[child + 1].distance > neighbors[child].distance)
+			child++;
+
+		if (neighbors[child].distance <= distance)
+			break;
+
+		neighbors[parent] = neighbors[child];
+		parent = child;
+	}
+
+	neighbors[parent] = (LNKNeighbor) { distance, index };
+}
+
+/// Sorts the kept neighbors in order of increasing distance. The heap must not be pushed to afterwards.
+static inline void LNKNeighborHeapSort(LNKNeighborHeap *heap) {
+	LNKNeighbor *const neighbors = heap->neighbors;
+
+	// Repeatedly move the farthest remaining neighbor to the end.
+	for (LNKSize count = heap->count; count > 1; count--) {
+		const LNKNeighbor farthest = neighbors[0];
+		const LNKNeighbor last = neighbors[count - 1];
+		const LNKSize remaining = count - 1;
+		LNKSize parent = 0;
+
+		while (YES) {
+			LNKSize child = 2 * parent + 1;
+
+			if (child >= remaining)
+				break;
+
+			if (child + 1 < remaining && neighbors[child + 1].distance > neighbors[child].distance)
+				child++;
+
+			if (neighbors[child].distance <= last.distance)
+				break;
+
+			neighbors[parent] = neighbors[child];
+			parent = child;
+		}
+
+		neighbors[parent] = last;
+		neighbors[count - 1] = farthest;
+	}
+}
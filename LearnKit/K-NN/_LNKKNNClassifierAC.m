@@ -7,70 +7,226 @@
 
 #import "_LNKKNNClassifierAC.h"
 
+#import "LNKAccelerate.h"
+#import "LNKClassifierPrivate.h"
+#import "LNKExecutor.h"
+#import "LNKHNSWIndex.h"
+#import "LNKKDTree.h"
 #import "LNKMatrix.h"
+#import "LNKMatrixPrivate.h"
+#import "LNKMemoryBufferManager.h"
+#import <pthread.h>
 
-typedef struct {
-	LNKFloat distance;
-	LNKSize index;
-} _LNKDistanceBucket;
+/// Beyond this many columns, k-d trees prune too little to beat brute force.
+#define MAX_KD_TREE_COLUMN_COUNT 16
 
-@implementation _LNKKNNClassifierAC
+/// Batched predictions compute distances between tiles of this many rows and examples.
+#define QUERY_TILE_SIZE		64
+#define EXAMPLE_TILE_SIZE	1024
 
-- (void)train {
-	// k-NN does not involve training.
+/// Brute-force searches for single feature vectors only fan out to other threads with at least this many examples.
+#define MIN_PARALLEL_EXAMPLE_COUNT 16384
+
+/// The number of links per example on the upper layers of the approximate search graph.
+#define APPROXIMATE_NEIGHBOR_COUNT 16
+
+typedef void (^_LNKNeighborHandler)(LNKSize row, const LNKNeighbor *closestExamples, LNKSize count);
+
+@implementation _LNKKNNClassifierAC {
+	// Indexes may be built by searches running concurrently, so they're built under a lock and published atomically.
+	LNKKDTreeRef _tree;
+	LNKHNSWIndexRef _graph;
+	pthread_mutex_t _indexLock;
+	
+	// The examples are read from the matrix until more are added, after which they live in buffers of our own.
+	const LNKFloat *_examples;
+	const LNKFloat *_outputs;
+	LNKFloat *_exampleBuffer;
+	LNKFloat *_outputBuffer;
+	LNKSize _exampleCount;
+	LNKSize _exampleCapacity;
+	
+	LNKFloat *_exampleSquaredNorms;
 }
 
-- (LNKClass *)_predictMostFrequentClassWithClosestExamples:(_LNKDistanceBucket *)closestExamples k:(LNKSize)k {
-	NSParameterAssert(closestExamples);
+- (instancetype)initWithMatrix:(LNKMatrix *)matrix optimizationAlgorithm:(id<LNKOptimizationAlgorithm>)algorithm {
+	if (!(self = [super initWithMatrix:matrix optimizationAlgorithm:algorithm]))
+		return nil;
 	
-	const LNKFloat *outputVector = self.matrix.outputVector;
+	_examples = matrix.matrixBuffer;
+	_outputs = matrix.outputVector;
+	_exampleCount = matrix.rowCount;
+	_exampleCapacity = _exampleCount;
+	pthread_mutex_init(&_indexLock, NULL);
 	
-	// Vote for the item with the most-frequent class.
-	NSCountedSet<LNKClass *> *frequencies = [[NSCountedSet alloc] initWithCapacity:k];
+	// ||b||^2 for the ||a||^2 + ||b||^2 - 2 a.b distance identity used by batched predictions.
+	_exampleSquaredNorms = LNKFloatAlloc(_exampleCount);
+	[self _computeSquaredNormsInRange:LNKRangeMake(0, _exampleCount)];
 	
-	for (LNKSize kOffset = 0; kOffset < k; kOffset++) {
-		const _LNKDistanceBucket example = closestExamples[kOffset];
-		const LNKFloat outputValue = outputVector[example.index];
-		
-		LNKClass *class = [[LNKClass classWithUnsignedInteger:outputValue] retain];
-		
-		[frequencies addObject:class];
-		[class release];
+	// The index is built once, up front, when the automatic search algorithm would use it.
+	if (matrix.columnCount <= MAX_KD_TREE_COLUMN_COUNT)
+		[self _buildTreeIfNeeded];
+	
+	return self;
+}
+
+- (void)dealloc {
+	if (_tree)
+		LNKKDTreeFree(_tree);
+	
+	if (_graph)
+		LNKHNSWIndexFree(_graph);
+	
+	free(_exampleBuffer);
+	free(_outputBuffer);
+	free(_exampleSquaredNorms);
+	pthread_mutex_destroy(&_indexLock);
+	[super dealloc];
+}
+
+- (void)_computeSquaredNormsInRange:(LNKRange)range {
+	const LNKSize columnCount = self.matrix.columnCount;
+	
+	for (LNKSize row = range.location; row < range.location + range.length; row++) {
+		const LNKFloat *example = _examples + row * columnCount;
+		LNK_dotpr(example, UNIT_STRIDE, example, UNIT_STRIDE, &_exampleSquaredNorms[row], columnCount);
 	}
+}
+
+- (LNKSize)_exampleCount {
+	return _exampleCount;
+}
+
+- (void)_buildTreeIfNeeded {
+	if (__atomic_load_n(&_tree, __ATOMIC_ACQUIRE))
+		return;
 	
-	LNKClass *bestClass = nil;
-	NSUInteger bestFrequency = 0;
+	pthread_mutex_lock(&_indexLock);
 	
-	for (LNKClass *class in frequencies) {
-		const NSUInteger classFrequency = [frequencies countForObject:class];
-		
-		if (classFrequency > bestFrequency) {
-			bestFrequency = classFrequency;
-			bestClass = [class retain];
-		}
+	if (!_tree)
+		__atomic_store_n(&_tree, LNKKDTreeCreate(_examples, _exampleCount, self.matrix.columnCount), __ATOMIC_RELEASE);
+	
+	pthread_mutex_unlock(&_indexLock);
+}
+
+- (void)_buildGraphIfNeeded {
+	if (__atomic_load_n(&_graph, __ATOMIC_ACQUIRE))
+		return;
+	
+	pthread_mutex_lock(&_indexLock);
+	
+	if (!_graph) {
+		LNKHNSWIndexRef graph = LNKHNSWIndexCreate(self.matrix.columnCount, APPROXIMATE_NEIGHBOR_COUNT);
+		LNKHNSWIndexAddRows(graph, _examples, LNKRangeMake(0, _exampleCount), self.approximateConstructionBreadth);
+		__atomic_store_n(&_graph, graph, __ATOMIC_RELEASE);
 	}
 	
-	[frequencies release];
+	pthread_mutex_unlock(&_indexLock);
+}
+
+- (void)setSearchAlgorithm:(LNKKNNSearchAlgorithm)searchAlgorithm {
+	[super setSearchAlgorithm:searchAlgorithm];
 	
-	return [bestClass autorelease];
+	if (searchAlgorithm == LNKKNNSearchAlgorithmKDTree)
+		[self _buildTreeIfNeeded];
+	else if (searchAlgorithm == LNKKNNSearchAlgorithmApproximate)
+		[self _buildGraphIfNeeded];
 }
 
-- (NSNumber *)_predictAverageOutputWithClosestExamples:(_LNKDistanceBucket *)closestExamples k:(LNKSize)k {
-	NSParameterAssert(closestExamples);
+- (BOOL)_usesEuclideanDistance {
+	return self.distanceFunction == LNKKNNEuclideanDistanceFunction;
+}
+
+/// Resolves the automatic search algorithm. Indexes only apply to the euclidean distance function.
+/// Missing indexes are built here, before searches fan out to other threads.
+- (LNKKNNSearchAlgorithm)_prepareSearchAlgorithm:(LNKKNNSearchAlgorithm)searchAlgorithm {
+	if (![self _usesEuclideanDistance])
+		return LNKKNNSearchAlgorithmBruteForce;
 	
-	const LNKFloat *outputVector = self.matrix.outputVector;
+	switch (searchAlgorithm) {
+		case LNKKNNSearchAlgorithmAutomatic:
+			return [self _prepareSearchAlgorithm:self.matrix.columnCount <= MAX_KD_TREE_COLUMN_COUNT ? LNKKNNSearchAlgorithmKDTree : LNKKNNSearchAlgorithmBruteForce];
+		case LNKKNNSearchAlgorithmBruteForce:
+			break;
+		case LNKKNNSearchAlgorithmKDTree:
+			[self _buildTreeIfNeeded];
+			break;
+		case LNKKNNSearchAlgorithmApproximate:
+			[self _buildGraphIfNeeded];
+			break;
+	}
 	
-	LNKFloat sum = 0;
+	return searchAlgorithm;
+}
+
+- (void)train {
+	// k-NN does not involve training.
+}
+
+/// `closestExamples` must be sorted in order of increasing distance.
+/// Returns the unsigned integer value of the most frequent class or the average output value, depending on the output function.
+static LNKFloat _LNKPredictOutput(const LNKNeighbor *closestExamples, LNKSize k, const LNKFloat *outputVector, LNKKNNOutputFunction outputFunction) {
+	switch (outputFunction) {
+		case LNKKNNOutputFunctionMostFrequent: {
+			// Vote for the item with the most-frequent class. Ties go to the class of the closer example.
+			LNKFloat bestClass = outputVector[closestExamples[0].index];
+			LNKSize bestFrequency = 0;
+			
+			for (LNKSize kOffset = 0; kOffset < k; kOffset++) {
+				const LNKFloat class = outputVector[closestExamples[kOffset].index];
+				LNKSize classFrequency = 0;
+				
+				for (LNKSize otherOffset = 0; otherOffset < k; otherOffset++) {
+					if (outputVector[closestExamples[otherOffset].index] == class)
+						classFrequency++;
+				}
+				
+				if (classFrequency > bestFrequency) {
+					bestFrequency = classFrequency;
+					bestClass = class;
+				}
+			}
+			
+			return bestClass;
+		}
+		case LNKKNNOutputFunctionAverage: {
+			LNKFloat sum = 0;
+			
+			for (LNKSize kOffset = 0; kOffset < k; kOffset++) {
+				sum += outputVector[closestExamples[kOffset].index];
+			}
+			
+			return sum / k;
+		}
+	}
+}
+
+/// Runs a single-threaded search for the neighbors of a normalized vector.
+/// The search algorithm must have been prepared with `-_prepareSearchAlgorithm:`.
+- (void)_findNeighborsOfNormalizedVector:(const LNKFloat *)normalizedVector searchAlgorithm:(LNKKNNSearchAlgorithm)searchAlgorithm heap:(LNKNeighborHeap *)heap {
+	const LNKSize columnCount = self.matrix.columnCount;
 	
-	for (LNKSize kOffset = 0; kOffset < k; kOffset++) {
-		const _LNKDistanceBucket example = closestExamples[kOffset];
-		sum += outputVector[example.index];
+	switch (searchAlgorithm) {
+		case LNKKNNSearchAlgorithmKDTree:
+			LNKKDTreeFindNearestNeighbors(_tree, normalizedVector, heap);
+			return;
+		case LNKKNNSearchAlgorithmApproximate:
+			LNKHNSWIndexFindNearestNeighbors(_graph, _examples, normalizedVector, self.approximateSearchBreadth, heap);
+			return;
+		case LNKKNNSearchAlgorithmBruteForce:
+		case LNKKNNSearchAlgorithmAutomatic:
+			break;
 	}
 	
-	return [NSNumber numberWithLNKFloat:sum / k];
+	const LNKKNNDistanceFunction distanceFunction = self.distanceFunction;
+	
+	for (LNKSize row = 0; row < _exampleCount; row++) {
+		const LNKFloat *exampleRow = _examples + row * columnCount;
+		LNKNeighborHeapPush(heap, distanceFunction(LNKVectorCreateUnsafe(exampleRow, columnCount), LNKVectorCreateUnsafe(normalizedVector, columnCount)), row);
+	}
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+- (LNKFloat)_predictOutputForFeatureVector:(LNKVector)featureVector {
 	if (!featureVector.data) {
 		@throw [NSException exceptionWithName:NSGenericException reason:@"The feature vector data must not be NULL" userInfo:nil];
 	}
@@ -81,52 +237,321 @@ typedef struct {
 	if (featureVector.length != columnCount) {
 		@throw [NSException exceptionWithName:NSGenericException reason:@"The length of the feature vector is incompatible with the matrix" userInfo:nil];
 	}
-
+	
 	NSAssert(matrix.isNormalized, @"The matrix should have been normalized during initialization");
-	LNKFloat *const normalizedVector = LNKFloatAllocAndCopy(featureVector.data, featureVector.length);
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+	
+	LNKFloat *const normalizedVector = LNKMemoryBufferManagerAllocScratch(memoryManager, columnCount);
+	LNKFloatCopy(normalizedVector, featureVector.data, columnCount);
 	[matrix normalizeVector:normalizedVector];
 	
-	const LNKSize rowCount = matrix.rowCount;
+	const LNKSize exampleCount = _exampleCount;
+	const LNKFloat *examples = _examples;
 	const LNKSize k = self.k;
 	const LNKKNNDistanceFunction distanceFunction = self.distanceFunction;
+	const LNKKNNSearchAlgorithm searchAlgorithm = [self _prepareSearchAlgorithm:self.searchAlgorithm];
+	
+	LNKNeighbor *closestExamples = malloc(k * sizeof(LNKNeighbor));
+	LNKNeighborHeap heap = LNKNeighborHeapMake(closestExamples, k);
+	
+	if (searchAlgorithm != LNKKNNSearchAlgorithmBruteForce || exampleCount < MIN_PARALLEL_EXAMPLE_COUNT) {
+		// Indexed searches, and brute force over few examples, are cheaper than handing work to other threads.
+		[self _findNeighborsOfNormalizedVector:normalizedVector searchAlgorithm:searchAlgorithm heap:&heap];
+	}
+	else {
+		// Distances to all examples are computed in parallel; selecting the closest ones is cheap in comparison.
+		LNKFloat *distances = LNKMemoryBufferManagerAllocScratch(memoryManager, exampleCount);
+		
+		LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, exampleCount), 0, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+			for (LNKSize row = range.location; row < range.location + range.length; row++) {
+				const LNKFloat *exampleRow = examples + row * columnCount;
+				distances[row] = distanceFunction(LNKVectorCreateUnsafe(exampleRow, columnCount), LNKVectorCreateUnsafe(normalizedVector, columnCount));
+			}
+		});
+		
+		// Find the k closest examples.
+		for (LNKSize row = 0; row < exampleCount; row++) {
+			LNKNeighborHeapPush(&heap, distances[row], row);
+		}
+	}
+	
+	LNKNeighborHeapSort(&heap);
+	
+	const LNKFloat predictedOutput = _LNKPredictOutput(closestExamples, heap.count, _outputs, self.outputFunction);
+	
+	free(closestExamples);
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	
+	return predictedOutput;
+}
+
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+	if (self.outputFunction != LNKKNNOutputFunctionMostFrequent) {
+		@throw [NSException exceptionWithName:NSGenericException reason:@"Classes can only be predicted with the most-frequent output function" userInfo:nil];
+	}
+	
+	LNKClasses *const classes = self.classes;
+	const LNKSize classIndex = [classes indexForClassWithUnsignedInteger:(NSUInteger)[self _predictOutputForFeatureVector:featureVector]];
+	
+	if (classIndex == NSNotFound) {
+		return NO;
+	}
+	
+	LNK_vclr(outProbabilities, UNIT_STRIDE, classes.count);
+	outProbabilities[classIndex] = 1;
+	
+	return YES;
+}
+
+- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+	if (self.outputFunction == LNKKNNOutputFunctionAverage) {
+		return [NSNumber numberWithLNKFloat:[self _predictOutputForFeatureVector:featureVector]];
+	}
 	
-	_LNKDistanceBucket *closestExamples = calloc(sizeof(_LNKDistanceBucket), k);
+	return [super predictValueForFeatureVector:featureVector];
+}
+
+/// `normalizedRows` holds `rowCount` normalized rows; their neighbors are pushed onto `heaps`.
+- (void)_findNeighborsOfNormalizedRows:(const LNKFloat *)normalizedRows count:(LNKSize)rowCount heaps:(LNKNeighborHeap *)heaps {
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	
+	const LNKSize exampleCount = _exampleCount;
+	const LNKSize columnCount = self.matrix.columnCount;
+	const LNKFloat *matrixBuffer = _examples;
+	
+	// With rows as a and examples as b, ||a - b||^2 = ||a||^2 + ||b||^2 - 2 a.b
+	LNKFloat *transposedRows = LNKMemoryBufferManagerAllocScratch(memoryManager, columnCount * rowCount);
+	LNK_mtrans(normalizedRows, transposedRows, columnCount, rowCount);
+	
+	LNKFloat *rowSquaredNorms = LNKMemoryBufferManagerAllocScratch(memoryManager, rowCount);
 	
-	// Find the k closest examples.
 	for (LNKSize row = 0; row < rowCount; row++) {
-		const LNKFloat *exampleRow = [matrix rowAtIndex:row];
-		const LNKFloat distance = distanceFunction(LNKVectorCreateUnsafe(exampleRow, columnCount), LNKVectorCreateUnsafe(normalizedVector, rowCount));
+		const LNKFloat *normalizedRow = normalizedRows + row * columnCount;
+		LNK_dotpr(normalizedRow, UNIT_STRIDE, normalizedRow, UNIT_STRIDE, &rowSquaredNorms[row], columnCount);
+	}
+	
+	LNKFloat *products = LNKMemoryBufferManagerAllocScratch(memoryManager, EXAMPLE_TILE_SIZE * rowCount);
+	
+	for (LNKSize tileStart = 0; tileStart < exampleCount; tileStart += EXAMPLE_TILE_SIZE) {
+		const LNKSize tileLength = MIN(EXAMPLE_TILE_SIZE, exampleCount - tileStart);
+		
+		// Each row of `products` holds the dot products of one example with every row.
+		LNK_mmul(_ROW_IN_MATRIX_BUFFER(tileStart), UNIT_STRIDE, transposedRows, UNIT_STRIDE, products, UNIT_STRIDE, tileLength, rowCount, columnCount);
+		
+		for (LNKSize example = 0; example < tileLength; example++) {
+			const LNKFloat exampleSquaredNorm = _exampleSquaredNorms[tileStart + example];
+			const LNKFloat *exampleProducts = products + example * rowCount;
+			
+			for (LNKSize row = 0; row < rowCount; row++) {
+				// Rounding can make the distance of (nearly) identical vectors slightly negative.
+				const LNKFloat distance = MAX(0, rowSquaredNorms[row] + exampleSquaredNorm - 2 * exampleProducts[row]);
+				LNKNeighborHeapPush(&heaps[row], distance, tileStart + example);
+			}
+		}
+	}
+}
+
+- (void)_validateMatrix:(LNKMatrix *)matrix {
+	if (!matrix) {
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	}
+	
+	if (matrix.columnCount != self.matrix.columnCount || matrix.hasBiasColumn) {
+		[NSException raise:NSGenericException format:@"The columns of the matrix are incompatible with the training matrix"];
+	}
+}
+
+/// Finds the k-nearest neighbors of every row of `matrix` in parallel. `handler` receives the neighbors of each row
+/// in order of increasing distance and may be called concurrently.
+- (void)_findNeighborsOfRowsInMatrix:(LNKMatrix *)matrix searchAlgorithm:(LNKKNNSearchAlgorithm)searchAlgorithm handler:(_LNKNeighborHandler)handler {
+	LNKMatrix *trainingMatrix = self.matrix;
+	const LNKSize columnCount = trainingMatrix.columnCount;
+	
+	NSAssert(trainingMatrix.isNormalized, @"The matrix should have been normalized during initialization");
+	
+	const LNKSize k = self.k;
+	searchAlgorithm = [self _prepareSearchAlgorithm:searchAlgorithm];
+	const BOOL usesMatrixMultiplication = searchAlgorithm == LNKKNNSearchAlgorithmBruteForce && [self _usesEuclideanDistance];
+	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	
+	// Each thread processes a tile of rows at a time, which keeps the matrix multiplications reasonably large.
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), QUERY_TILE_SIZE, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+		const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+		
+		LNKFloat *normalizedRows = LNKMemoryBufferManagerAllocScratch(memoryManager, range.length * columnCount);
+		LNKFloatCopy(normalizedRows, _ROW_IN_MATRIX_BUFFER(range.location), range.length * columnCount);
+		
+		LNKNeighbor *closestExamples = malloc(range.length * k * sizeof(LNKNeighbor));
+		LNKNeighborHeap heaps[range.length];
+		
+		for (LNKSize row = 0; row < range.length; row++) {
+			[trainingMatrix normalizeVector:normalizedRows + row * columnCount];
+			heaps[row] = LNKNeighborHeapMake(closestExamples + row * k, k);
+		}
 		
-		if (row < k) {
-			closestExamples[row].distance = distance;
-			closestExamples[row].index = row;
+		if (usesMatrixMultiplication) {
+			[self _findNeighborsOfNormalizedRows:normalizedRows count:range.length heaps:heaps];
 		}
 		else {
-			for (LNKSize kOffset = 0; kOffset < k; kOffset++) {
-				if (distance < closestExamples[kOffset].distance) {
-					closestExamples[kOffset].distance = distance;
-					closestExamples[kOffset].index = row;
-					break;
-				}
+			for (LNKSize row = 0; row < range.length; row++) {
+				[self _findNeighborsOfNormalizedVector:normalizedRows + row * columnCount searchAlgorithm:searchAlgorithm heap:&heaps[row]];
 			}
 		}
+		
+		for (LNKSize row = 0; row < range.length; row++) {
+			LNKNeighborHeapSort(&heaps[row]);
+			handler(range.location + row, heaps[row].neighbors, heaps[row].count);
+		}
+		
+		free(closestExamples);
+		LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	});
+}
+
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _validateMatrix:matrix];
+	
+	if (!outputBuffer) {
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
 	}
 	
-	id predictedValue = nil;
+	const LNKKNNOutputFunction outputFunction = self.outputFunction;
+	const LNKFloat *outputs = _outputs;
 	
-	switch (self.outputFunction) {
-		case LNKKNNOutputFunctionMostFrequent:
-			predictedValue = [self _predictMostFrequentClassWithClosestExamples:closestExamples k:k];
-			break;
-		case LNKKNNOutputFunctionAverage:
-			predictedValue = [self _predictAverageOutputWithClosestExamples:closestExamples k:k];
-			break;
+	[self _findNeighborsOfRowsInMatrix:matrix searchAlgorithm:self.searchAlgorithm handler:^(LNKSize row, const LNKNeighbor *closestExamples, LNKSize count) {
+		outputBuffer[row] = _LNKPredictOutput(closestExamples, count, outputs, outputFunction);
+	}];
+}
+
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _validateMatrix:matrix];
+
+	if (!outputBuffer) {
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	}
+
+	if (self.outputFunction != LNKKNNOutputFunctionMostFrequent) {
+		@throw [NSException exceptionWithName:NSGenericException reason:@"Classes can only be predicted with the most-frequent output function" userInfo:nil];
 	}
+
+	LNKClasses *const classes = self.classes;
+	const LNKSize classCount = classes.count;
+	const LNKFloat *outputs = _outputs;
+
+	LNK_vclr(outputBuffer, UNIT_STRIDE, matrix.rowCount * classCount);
+
+	[self _findNeighborsOfRowsInMatrix:matrix searchAlgorithm:self.searchAlgorithm handler:^(LNKSize row, const LNKNeighbor *closestExamples, LNKSize count) {
+		const LNKFloat output = _LNKPredictOutput(closestExamples, count, outputs, LNKKNNOutputFunctionMostFrequent);
+		const NSUInteger classIndex = [classes indexForClassWithUnsignedInteger:(NSUInteger)output];
+
+		if (classIndex != NSNotFound) {
+			outputBuffer[row * classCount + classIndex] = 1;
+		}
+	}];
+}
+
+- (void)addExamplesFromMatrix:(LNKMatrix *)matrix {
+	[self _validateMatrix:matrix];
 	
-	free(closestExamples);
-	free(normalizedVector);
+	LNKMatrix *trainingMatrix = self.matrix;
+	const LNKSize columnCount = trainingMatrix.columnCount;
+	const LNKSize addedCount = matrix.rowCount;
+	const LNKSize exampleCount = _exampleCount + addedCount;
+	
+	if (!addedCount)
+		return;
+	
+	// Holding the lock keeps searches that build indexes from seeing the examples half-updated.
+	pthread_mutex_lock(&_indexLock);
+	
+	if (exampleCount > _exampleCapacity) {
+		_exampleCapacity = MAX(exampleCount, 2 * _exampleCapacity);
+		
+		// The first addition copies the examples out of the matrix.
+		if (!_exampleBuffer) {
+			_exampleBuffer = LNKFloatAllocAndCopy(_examples, _exampleCount * columnCount);
+			_outputBuffer = LNKFloatAllocAndCopy(_outputs, _exampleCount);
+		}
+		
+		_exampleBuffer = realloc(_exampleBuffer, _exampleCapacity * columnCount * sizeof(LNKFloat));
+		_outputBuffer = realloc(_outputBuffer, _exampleCapacity * sizeof(LNKFloat));
+		_exampleSquaredNorms = realloc(_exampleSquaredNorms, _exampleCapacity * sizeof(LNKFloat));
+		
+		_examples = _exampleBuffer;
+		_outputs = _outputBuffer;
+	}
+	
+	LNKFloat *addedExamples = _exampleBuffer + _exampleCount * columnCount;
+	LNKFloatCopy(addedExamples, matrix.matrixBuffer, addedCount * columnCount);
+	LNKFloatCopy(_outputBuffer + _exampleCount, matrix.outputVector, addedCount);
+	
+	for (LNKSize row = 0; row < addedCount; row++)
+		[trainingMatrix normalizeVector:addedExamples + row * columnCount];
+	
+	const LNKRange addedRange = LNKRangeMake(_exampleCount, addedCount);
+	_exampleCount = exampleCount;
+	[self _computeSquaredNormsInRange:addedRange];
+	
+	if (_graph)
+		LNKHNSWIndexAddRows(_graph, _examples, addedRange, self.approximateConstructionBreadth);
+	
+	// k-d trees are balanced for the examples they're built with, so they're rebuilt rather than updated.
+	if (_tree) {
+		LNKKDTreeFree(_tree);
+		__atomic_store_n(&_tree, LNKKDTreeCreate(_examples, _exampleCount, columnCount), __ATOMIC_RELEASE);
+	}
+	
+	pthread_mutex_unlock(&_indexLock);
+}
 
-	return predictedValue;
+- (LNKFloat)computeApproximateRecallOnMatrix:(LNKMatrix *)matrix {
+	[self _validateMatrix:matrix];
+	
+	const LNKSize rowCount = matrix.rowCount;
+	const LNKSize k = self.k;
+	
+	if (!rowCount)
+		return 1;
+	
+	if (k > _exampleCount) {
+		[NSException raise:NSInvalidArgumentException format:@"k must not exceed the number of examples"];
+	}
+	
+	LNKSize *exactNeighbors = malloc(rowCount * k * sizeof(LNKSize));
+	
+	[self _findNeighborsOfRowsInMatrix:matrix searchAlgorithm:LNKKNNSearchAlgorithmAutomatic handler:^(LNKSize row, const LNKNeighbor *closestExamples, LNKSize count) {
+		for (LNKSize kOffset = 0; kOffset < count; kOffset++)
+			exactNeighbors[row * k + kOffset] = closestExamples[kOffset].index;
+	}];
+	
+	LNKFloat *recalls = LNKFloatAlloc(rowCount);
+	
+	[self _findNeighborsOfRowsInMatrix:matrix searchAlgorithm:LNKKNNSearchAlgorithmApproximate handler:^(LNKSize row, const LNKNeighbor *closestExamples, LNKSize count) {
+		LNKSize foundCount = 0;
+		
+		for (LNKSize kOffset = 0; kOffset < count; kOffset++) {
+			for (LNKSize exactOffset = 0; exactOffset < k; exactOffset++) {
+				if (closestExamples[kOffset].index == exactNeighbors[row * k + exactOffset]) {
+					foundCount++;
+					break;
+				}
+			}
+		}
+		
+		recalls[row] = (LNKFloat)foundCount / k;
+	}];
+	
+	LNKFloat recall;
+	LNK_vmean(recalls, UNIT_STRIDE, &recall, rowCount);
+	
+	free(recalls);
+	free(exactNeighbors);
+	
+	return recall;
 }
 
 @end
@@ -11,6 +11,7 @@
 #import <LearnKit/LNKClassifier.h>
 #import <LearnKit/LNKCollaborativeFilteringPredictor.h>
 #import <LearnKit/LNKDecisionTreeClassifier.h>
+#import <LearnKit/LNKExecutor.h>
 #import <LearnKit/LNKGoldenSectionSearch.h>
 #import <LearnKit/LNKHillClimbingSearch.h>
 #import <LearnKit/LNKKMeansClassifier.h>
@@ -34,4 +35,5 @@
 #import <LearnKit/LNKPredictor.h>
 #import <LearnKit/LNKRegularizationConfiguration.h>
 #import <LearnKit/LNKSVMClassifier.h>
+#import <LearnKit/LNKSparseMatrix.h>
 #import <LearnKit/LNKUtilities.h>
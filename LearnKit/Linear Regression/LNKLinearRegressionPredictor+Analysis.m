@@ -17,10 +17,9 @@
 {
 	LNKMatrix *const matrix = self.matrix;
 	const LNKSize rowCount = matrix.rowCount;
-	const LNKSize columnCount = matrix.columnCount;
 
 	LNKFloat *predictions = LNKFloatAlloc(rowCount);
-	LNK_mmul(matrix.matrixBuffer, UNIT_STRIDE, [self _thetaVector], UNIT_STRIDE, predictions, UNIT_STRIDE, rowCount, 1, columnCount);
+	[matrix multiplyByBuffer:[self _thetaVector] columnCount:1 outputBuffer:predictions];
 	LNK_vsub(predictions, UNIT_STRIDE, matrix.outputVector, UNIT_STRIDE, predictions, UNIT_STRIDE, rowCount);
 
 	return LNKVectorCreateUnsafe(predictions, rowCount);
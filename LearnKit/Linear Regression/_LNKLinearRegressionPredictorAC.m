@@ -55,7 +55,7 @@
 	const LNKFloat factor = 0.5 / rowCount;
 	LNKFloat *workgroup = LNKFloatAlloc(rowCount);
 	
-	LNK_mmul(matrix.matrixBuffer, UNIT_STRIDE, thetaVector, UNIT_STRIDE, workgroup, UNIT_STRIDE, rowCount, 1, columnCount);
+	[matrix multiplyByBuffer:thetaVector columnCount:1 outputBuffer:workgroup];
 	LNK_vsub(workgroup, UNIT_STRIDE, matrix.outputVector, UNIT_STRIDE, workgroup, UNIT_STRIDE, rowCount);
 	LNKFloat sum;
 	LNK_dotpr(workgroup, UNIT_STRIDE, workgroup, UNIT_STRIDE, &sum, rowCount);
@@ -13,7 +13,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 /// For logistic regression classifiers, the only supported algorithm is L-BFGS.
 /// Two classes are defined by default, and predicted values are of type NSNumber / LNKFloat.
-/// A bias column is added to the matrix automatically.
+/// A bias column is added to the matrix automatically, so matrices passed to the batch prediction methods shouldn't have one.
+/// They score all rows with a single matrix-vector product.
 @interface LNKLogisticRegressionClassifier : LNKClassifier
 
 @property (nonatomic, nullable, retain) LNKRegularizationConfiguration *regularizationConfiguration;
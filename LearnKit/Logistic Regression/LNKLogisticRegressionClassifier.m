@@ -8,6 +8,7 @@
 #import "LNKLogisticRegressionClassifier.h"
 
 #import "_LNKLogisticRegressionClassifierLBFGS_AC.h"
+#import "LNKClassifierPrivate.h"
 #import "LNKMatrix.h"
 #import "LNKOptimizationAlgorithm.h"
 #import "LNKPredictorPrivate.h"
@@ -40,7 +41,7 @@
 
 	LNKMatrix *const workingMatrix = [matrix matrixByAddingBiasColumn];
 
-	self = [super initWithMatrix:workingMatrix optimizationAlgorithm:algorithm];
+	self = [super initWithMatrix:workingMatrix optimizationAlgorithm:algorithm classes:[LNKClasses withCount:2]];
 	if (self) {
 		// The Theta vector is initially zero.
 		_thetaVector = LNKFloatCalloc(workingMatrix.columnCount);
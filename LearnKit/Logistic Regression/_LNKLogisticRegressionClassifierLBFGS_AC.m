@@ -9,7 +9,9 @@
 
 #import "LNKAccelerate.h"
 #import "LNKAccelerateGradient.h"
+#import "LNKClassifierPrivate.h"
 #import "LNKLogisticRegressionClassifierPrivate.h"
+#import "LNKMemoryBufferManager.h"
 #import "LNKPredictorPrivate.h"
 #import "LNKRegularizationConfiguration.h"
 
@@ -27,7 +29,7 @@
 	});
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
 	NSParameterAssert(featureVector.data);
 	NSParameterAssert(featureVector.length);
 
@@ -36,18 +38,65 @@
 	NSAssert(featureVector.length + biasOffset == self.matrix.columnCount, @"The length of the feature vector must be equal to the number of columns in the matrix");
 	// Otherwise, we can't compute the dot product.
 
-	LNKFloat *featuresWithBias = LNKFloatAlloc(featureVector.length + biasOffset);
-	featuresWithBias[0] = 1;
-	LNKFloatCopy(featuresWithBias + biasOffset, featureVector.data, featureVector.length);
-
-	// sigmoid(theta . input)
+	// sigmoid(theta . input), with the bias unit's weight added separately so the input doesn't need to be copied
+	const LNKFloat *thetaVector = [self _thetaVector];
 	LNKFloat result = 0;
-	LNK_dotpr([self _thetaVector], UNIT_STRIDE, featuresWithBias, UNIT_STRIDE, &result, self.matrix.columnCount);
+	LNK_dotpr(thetaVector + biasOffset, UNIT_STRIDE, featureVector.data, UNIT_STRIDE, &result, featureVector.length);
+	result += thetaVector[0];
 	LNK_vsigmoid(&result, 1);
+	
+	outProbabilities[0] = 1 - result;
+	outProbabilities[1] = result;
+	
+	return YES;
+}
 
-	free(featuresWithBias);
+- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+	LNKFloat probabilities[2];
+	[self predictClassIndexForFeatureVector:featureVector probabilities:probabilities];
 	
-	return [NSNumber numberWithLNKFloat:result];
+	return [NSNumber numberWithLNKFloat:probabilities[1]];
+}
+
+/// `outputBuffer` receives the probability of the positive class for every row of `matrix`, which must not have a bias column.
+- (void)_predictPositiveProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	
+	const LNKSize biasOffset = 1;
+	
+	if (matrix.hasBiasColumn || matrix.columnCount + biasOffset != self.matrix.columnCount)
+		[NSException raise:NSInvalidArgumentException format:@"The columns of the matrix are incompatible with the training matrix"];
+	
+	const LNKSize rowCount = matrix.rowCount;
+	
+	if (!rowCount)
+		return;
+	
+	// sigmoid(X . theta) as a single matrix-vector product, with the bias unit's weight added separately so the matrix
+	// doesn't need a column of ones.
+	const LNKFloat *thetaVector = [self _thetaVector];
+	[matrix multiplyByBuffer:thetaVector + biasOffset columnCount:1 outputBuffer:outputBuffer];
+	LNK_vsadd(outputBuffer, UNIT_STRIDE, thetaVector, outputBuffer, UNIT_STRIDE, rowCount);
+	LNK_vsigmoid(outputBuffer, rowCount);
+}
+
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _predictPositiveProbabilitiesForMatrix:matrix outputBuffer:outputBuffer];
+}
+
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _predictPositiveProbabilitiesForMatrix:matrix outputBuffer:outputBuffer];
+	
+	// Spread the probabilities out into (1 - p, p) pairs, starting from the last row so none is overwritten before it's read.
+	for (LNKSize row = matrix.rowCount; row-- > 0;) {
+		const LNKFloat p = outputBuffer[row];
+		outputBuffer[2 * row] = 1 - p;
+		outputBuffer[2 * row + 1] = p;
+	}
 }
 
 - (LNKFloat)_evaluateCostFunction {
@@ -55,12 +104,14 @@
 	LNKMatrix *matrix = self.matrix;
 	const LNKSize rowCount = matrix.rowCount;
 	const LNKSize columnCount = matrix.columnCount;
-	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
 	const LNKFloat *outputVector = matrix.outputVector;
 	
+	// This is evaluated on every optimizer step, so the temporaries come from the thread's pool.
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	
 	// 1 / m * sum(-y log(h) - (1 - y) log(1 - h))
-	LNKFloat *workgroup = LNKFloatAlloc(rowCount);
-	LNK_mmul(matrixBuffer, UNIT_STRIDE, thetaVector, UNIT_STRIDE, workgroup, UNIT_STRIDE, rowCount, 1, columnCount);
+	LNKFloat *workgroup = LNKMemoryBufferManagerAllocBlock(memoryManager, rowCount);
+	[matrix multiplyByBuffer:thetaVector columnCount:1 outputBuffer:workgroup];
 	
 	// At this point, `workgroup` contains 'h'.
 	LNK_vsigmoid(workgroup, rowCount);
@@ -68,10 +119,10 @@
 	const int n = (int)rowCount;
 	const LNKFloat one = 1;
 	
-	LNKFloat *logVector = LNKFloatAlloc(rowCount);
+	LNKFloat *logVector = LNKMemoryBufferManagerAllocBlock(memoryManager, rowCount);
 	LNK_vlog(logVector, workgroup, &n);
 	
-	LNKFloat *negativeOutputVector = LNKFloatAlloc(rowCount);
+	LNKFloat *negativeOutputVector = LNKMemoryBufferManagerAllocBlock(memoryManager, rowCount);
 	LNK_vneg(outputVector, UNIT_STRIDE, negativeOutputVector, UNIT_STRIDE, rowCount);
 	
 	LNKFloat sum1;
@@ -88,9 +139,9 @@
 	LNKFloat sum2;
 	LNK_dotpr(negativeOutputVector, UNIT_STRIDE, minusLogVector, UNIT_STRIDE, &sum2, rowCount);
 	
-	free(logVector);
-	free(minusLogVector);
-	free(negativeOutputVector);
+	LNKMemoryBufferManagerFreeBlock(memoryManager, logVector, rowCount);
+	LNKMemoryBufferManagerFreeBlock(memoryManager, minusLogVector, rowCount);
+	LNKMemoryBufferManagerFreeBlock(memoryManager, negativeOutputVector, rowCount);
 	
 	LNKFloat cost = (sum1 - sum2) / rowCount;
 	
@@ -113,31 +164,4 @@
 	return cost;
 }
 
-- (LNKFloat)computeClassificationAccuracyOnMatrix:(LNKMatrix *)matrix {
-	LNKMatrix *const matrixWithOnes = [matrix.matrixByAddingBiasColumn retain];
-
-	LNKFloat *thetaVector = [self _thetaVector];
-	
-	const LNKSize rowCount = matrixWithOnes.rowCount;
-	const LNKSize columnCount = matrixWithOnes.columnCount;
-	const LNKFloat *matrixBuffer = matrixWithOnes.matrixBuffer;
-	const LNKFloat *outputVector = matrixWithOnes.outputVector;
-	
-	LNKFloat *workgroup = LNKFloatAlloc(rowCount);
-	LNK_mmul(matrixBuffer, UNIT_STRIDE, thetaVector, UNIT_STRIDE, workgroup, UNIT_STRIDE, rowCount, 1, columnCount);
-	[matrixWithOnes release];
-	
-	LNKSize hits = 0;
-	
-	// With a sigmoid function, y=1 when X . theta > 0
-	for (LNKSize m = 0; m < rowCount; m++) {
-		if ((workgroup[m] > 0 && outputVector[m] == 1) || (workgroup[m] <= 0 && outputVector[m] == 0))
-			hits++;
-	}
-	
-	free(workgroup);
-	
-	return (LNKFloat)hits / rowCount;
-}
-
 @end
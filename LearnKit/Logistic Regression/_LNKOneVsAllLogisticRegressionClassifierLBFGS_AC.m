@@ -13,14 +13,29 @@
 #import "LNKPredictorPrivate.h"
 
 @implementation _LNKOneVsAllLogisticRegressionClassifierLBFGS_AC {
-	NSMapTable *_classesToClassifiers;
+	// One binary classifier per class, in the order of the class indices.
+	LNKLogisticRegressionClassifier **_classifiers;
+}
+
+- (void)_releaseClassifiers {
+	if (!_classifiers)
+		return;
+	
+	for (LNKSize classIndex = 0; classIndex < self.classes.count; classIndex++) {
+		[_classifiers[classIndex] release];
+	}
+	
+	free(_classifiers);
+	_classifiers = NULL;
 }
 
 - (void)train {
 	NSAssert(self.classes.count >= 2, @"There should be at least two output classes");
 	
-	if (!_classesToClassifiers)
-		_classesToClassifiers = [[NSMapTable strongToStrongObjectsMapTable] retain];
+	[self _releaseClassifiers];
+	_classifiers = calloc(self.classes.count, sizeof(LNKLogisticRegressionClassifier *));
+	
+	LNKSize classIndex = 0;
 	
 	for (LNKClass *class in self.classes) {
 		LNKMatrix *matrixCopy = [self.matrix copy];
@@ -34,12 +49,11 @@
 		[matrixCopy release];
 		[classifier train];
 		
-		[_classesToClassifiers setObject:classifier forKey:class];
-		[classifier release];
+		_classifiers[classIndex++] = classifier;
 	}
 }
 
-- (void)_predictValueForFeatureVector:(LNKVector)featureVector {
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
 	NSParameterAssert(featureVector.data);
 	NSParameterAssert(featureVector.length);
 
@@ -47,16 +61,21 @@
 		[NSException raise:NSGenericException format:@"The length of the feature vector must be equal to the number of columns in the matrix"]; // otherwise, we can't do matrix multiplication
 	}
 	
-	for (LNKClass *class in _classesToClassifiers) {
-		LNKLogisticRegressionClassifier *classifier = [_classesToClassifiers objectForKey:class];
-		LNKFloat probability = [[classifier predictValueForFeatureVector:featureVector] LNKFloatValue];
+	if (!_classifiers)
+		return NO;
+	
+	for (LNKSize classIndex = 0; classIndex < self.classes.count; classIndex++) {
+		LNKFloat binaryProbabilities[2];
+		[_classifiers[classIndex] predictClassIndexForFeatureVector:featureVector probabilities:binaryProbabilities];
 		
-		[self _didPredictProbability:probability forClass:class];
+		outProbabilities[classIndex] = binaryProbabilities[1];
 	}
+	
+	return YES;
 }
 
 - (void)dealloc {
-	[_classesToClassifiers release];
+	[self _releaseClassifiers];
 	[super dealloc];
 }
 
@@ -8,8 +8,12 @@
 #import "_LNKNaiveBayesClassifierAC.h"
 
 #import "LNKAccelerate.h"
+#import "LNKClassifierPrivate.h"
 #import "LNKClassProbabilityDistribution.h"
+#import "LNKExecutor.h"
 #import "LNKMatrix.h"
+#import "LNKMatrixPrivate.h"
+#import "LNKMemoryBufferManager.h"
 
 @implementation _LNKNaiveBayesClassifierAC
 
@@ -17,49 +21,121 @@
 	[self.probabilityDistribution buildWithMatrix:self.matrix];
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
-	return [self predictValueForFeatureVector:featureVector probability:NULL];
+/// Sets each of the `rowCount` rows of `outLikelihoods` to the log-priors of the classes.
+- (void)_setLogPriors:(LNKFloat *)outLikelihoods rowCount:(LNKSize)rowCount {
+	LNKClassProbabilityDistribution *const probabilityDistribution = self.probabilityDistribution;
+	const LNKSize classCount = self.classes.count;
+
+	for (LNKSize classIndex = 0; classIndex < classCount; classIndex++) {
+		outLikelihoods[classIndex] = LNKLog([probabilityDistribution priorForClassAtIndex:classIndex]);
+	}
+
+	for (LNKSize row = 1; row < rowCount; row++) {
+		LNKFloatCopy(outLikelihoods + row * classCount, outLikelihoods, classCount);
+	}
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector probability:(LNKFloat *)outProbability {
+/// Writes the log-likelihood of every class into `outLikelihoods`, or -infinity for classes that can't have produced `featureVector`.
+/// Sum of logarithms:
+///   log(P(c)) + log(P(f_1 | c)) + log(P(f_2 | c)) ... + log(P(f_n | c))
+- (void)_computeLikelihoods:(LNKFloat *)outLikelihoods forFeatureVector:(LNKVector)featureVector {
 	if (featureVector.data == NULL || featureVector.length == 0) {
 		[NSException raise:NSGenericException format:@"The feature vector must have a non-zero length"];
 	}
 
-	LNKClasses *const classes = self.classes;
-	LNKClassProbabilityDistribution *const probabilityDistribution = self.probabilityDistribution;
-	const LNKSize columnCount = self.matrix.columnCount;
-	LNKSize classIndex = 0;
+	if (featureVector.length != self.matrix.columnCount) {
+		[NSException raise:NSGenericException format:@"The length of the feature vector must be equal to the number of columns in the matrix"];
+	}
 
-	LNKClass *bestClass = nil;
+	[self _setLogPriors:outLikelihoods rowCount:1];
+	[self.probabilityDistribution accumulateProbabilityLogsForRows:featureVector.data count:1 likelihoods:outLikelihoods];
+}
+
+/// Turns log-likelihoods into posterior probabilities in place. Returns NO, leaving them untouched, if no class has a finite likelihood.
+static BOOL _LNKNormalizeLikelihoods(LNKFloat *likelihoods, LNKSize classCount) {
 	LNKFloat bestLikelihood = LNKFloatMin;
 
-	for (LNKClass *class in classes) {
-		// Sum of logarithms:
-		//   log(P(c)) + log(P(f_1 | c)) + log(P(f_2 | c)) ... + log(P(f_3 | c))
-		const LNKFloat priorProbability = [probabilityDistribution priorForClassAtIndex:classIndex];
-		LNKFloat expectation = LNKLog(priorProbability);
+	for (LNKSize classIndex = 0; classIndex < classCount; classIndex++) {
+		bestLikelihood = MAX(bestLikelihood, likelihoods[classIndex]);
+	}
 
-		for (LNKSize column = 0; column < columnCount; column++) {
-			const LNKFloat featureValue = featureVector.data[column];
-			const LNKFloat probabilityLog = [probabilityDistribution probabilityLogForClassAtIndex:classIndex featureAtIndex:column value:featureValue];
+	if (bestLikelihood == LNKFloatMin) {
+		return NO;
+	}
 
-			if (LNK_fabs(probabilityLog) < FLT_MIN) {
-				expectation = LNKFloatMin;
-				break;
-			}
+	// Offset the likelihoods by the greatest one so they don't underflow.
+	LNKFloat sum = 0;
 
-			expectation += probabilityLog;
-		}
+	for (LNKSize classIndex = 0; classIndex < classCount; classIndex++) {
+		likelihoods[classIndex] = likelihoods[classIndex] <= LNKFloatMin ? 0 : LNK_exp(likelihoods[classIndex] - bestLikelihood);
+		sum += likelihoods[classIndex];
+	}
+
+	const LNKFloat scale = 1 / sum;
+	LNK_vsmul(likelihoods, UNIT_STRIDE, &scale, likelihoods, UNIT_STRIDE, classCount);
+
+	return YES;
+}
+
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+	[self _computeLikelihoods:outProbabilities forFeatureVector:featureVector];
+	return _LNKNormalizeLikelihoods(outProbabilities, self.classes.count);
+}
+
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix) {
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	}
 
-		if (expectation > bestLikelihood) {
-			bestLikelihood = expectation;
-			bestClass = class;
+	if (!outputBuffer) {
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	}
+
+	if (matrix.columnCount != self.matrix.columnCount) {
+		[NSException raise:NSInvalidArgumentException format:@"The matrix's column count should match that of the training matrix"];
+	}
+
+	const LNKSize classCount = self.classes.count;
+	const LNKSize columnCount = matrix.columnCount;
+	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	LNKClassProbabilityDistribution *const probabilityDistribution = self.probabilityDistribution;
+
+	// Rows are scored a range at a time, so the distribution can gather the probability logs of many rows at once.
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), 0, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		LNKFloat *likelihoods = outputBuffer + range.location * classCount;
+		[self _setLogPriors:likelihoods rowCount:range.length];
+		[probabilityDistribution accumulateProbabilityLogsForRows:_ROW_IN_MATRIX_BUFFER(range.location) count:range.length likelihoods:likelihoods];
+
+		for (LNKSize row = 0; row < range.length; row++) {
+			if (!_LNKNormalizeLikelihoods(likelihoods + row * classCount, classCount)) {
+				LNK_vclr(likelihoods + row * classCount, UNIT_STRIDE, classCount);
+			}
 		}
+	});
+}
+
+- (id)predictValueForFeatureVector:(LNKVector)featureVector probability:(LNKFloat *)outProbability {
+	LNKClasses *const classes = self.classes;
+	const LNKSize classCount = classes.count;
+
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+	LNKFloat *likelihoods = LNKMemoryBufferManagerAllocScratch(memoryManager, classCount);
+	[self _computeLikelihoods:likelihoods forFeatureVector:featureVector];
 
-		classIndex++;
+	LNKClass *bestClass = nil;
+	LNKFloat bestLikelihood = LNKFloatMin;
+
+	for (LNKSize classIndex = 0; classIndex < classCount; classIndex++) {
+		if (likelihoods[classIndex] > bestLikelihood) {
+			bestLikelihood = likelihoods[classIndex];
+			bestClass = [classes classAtIndex:classIndex];
+		}
 	}
 
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+
 	if (outProbability) {
 		const LNKFloat probability = LNK_exp(bestLikelihood);
 		*outProbability = bestClass ? probability : 0;
@@ -104,8 +104,7 @@
 	return ^(const LNKFloat *vector, LNKFloat *outVector, LNKSize length) {
 		const int lengthInt = (int)length;
 		LNK_vtanh(outVector, vector, &lengthInt);
-		const LNKFloat power = 2;
-		LNK_vpows(outVector, &power, outVector, &lengthInt);
+		LNK_vpows(outVector, 2, outVector, length);
 		LNK_vneg(outVector, UNIT_STRIDE, outVector, UNIT_STRIDE, lengthInt);
 		const LNKFloat one = 1;
 		LNK_vsadd(outVector, UNIT_STRIDE, &one, outVector, UNIT_STRIDE, lengthInt);
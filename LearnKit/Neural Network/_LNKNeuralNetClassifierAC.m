@@ -9,6 +9,7 @@
 
 #import "LNKAccelerate.h"
 #import "LNKClassifierPrivate.h"
+#import "LNKExecutor.h"
 #import "LNKMatrix.h"
 #import "LNKMatrixPrivate.h"
 #import "LNKMemoryBufferManager.h"
@@ -30,119 +31,178 @@
 	[super dealloc];
 }
 
-- (void)_computeGradientForExamplesInRange:(LNKRange)range delta:(LNKFloat ***)deltas {
+/// Examples are fed through the network in batches of this many rows so each layer is a matrix-matrix product.
+#define BATCH_SIZE 256
+
+/// `outVectors` receives a copy of every theta vector transposed to columns * rows, allocated from the current thread's scratch arena.
+- (void)_copyTransposedThetaVectors:(LNKFloat **)outVectors {
+	NSParameterAssert(outVectors);
+	
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKSize thetaVectorCount = [self _thetaVectorCount];
+	
+	for (LNKSize i = 0; i < thetaVectorCount; i++) {
+		LNKSize rows, columns;
+		const LNKFloat *thetaVector = [self _thetaVectorForLayerAtIndex:i rows:&rows columns:&columns];
+		
+		outVectors[i] = LNKMemoryBufferManagerAllocScratch(memoryManager, rows * columns);
+		LNK_mtrans(thetaVector, outVectors[i], columns, rows);
+	}
+}
+
+/// Feeds `batchLength` consecutive rows of `batch` forward.
+/// `activations[i]` receives the batchLength * (units + 1) activations of layer i, including a bias column for all but the output layer.
+/// `outputs[i]` receives the batchLength * units activations of layer i without the bias column (`outputs[0]` is not set).
+/// Both are allocated from the current thread's scratch arena.
+- (void)_feedForwardBatch:(const LNKFloat *)batch length:(LNKSize)batchLength transposedThetaVectors:(LNKFloat **)transposedThetaVectors activations:(LNKFloat **)activations outputs:(LNKFloat **)outputs {
+	NSParameterAssert(batch);
+	NSParameterAssert(batchLength);
+	NSParameterAssert(transposedThetaVectors);
+	NSParameterAssert(activations);
+	NSParameterAssert(outputs);
+	
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKSize thetaVectorCount = [self _thetaVectorCount];
+	const LNKFloat one = 1;
+	
+	// The activation values for the input layer are just the original feature vectors.
+	activations[0] = (LNKFloat *)batch;
+	LNKSize currentInputLayerLength = self.matrix.columnCount;
+	
+	for (LNKSize layerIndex = 1 /* ignore input layer */; layerIndex <= thetaVectorCount; layerIndex++) {
+		LNKNeuralNetLayer *layer = [self layerAtIndex:layerIndex];
+		
+		LNKSize rows, columns;
+		[self _getDimensionsOfLayerAtIndex:layerIndex-1 rows:&rows columns:&columns];
+		
+		if (currentInputLayerLength != columns)
+			[NSException raise:NSGenericException format:@"The transition to layer %lld is invalid due to incompatible theta matrix sizes", layerIndex];
+		
+		// Z = A . Theta^T, followed by the layer's (element-wise) activation function.
+		LNKFloat *output = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * rows);
+		LNK_mmul(activations[layerIndex-1], UNIT_STRIDE, transposedThetaVectors[layerIndex-1], UNIT_STRIDE, output, UNIT_STRIDE, batchLength, rows, columns);
+		layer.activationFunction(output, batchLength * rows);
+		outputs[layerIndex] = output;
+		
+		// We don't need a bias unit when prediciting outputs.
+		if (layerIndex == thetaVectorCount) {
+			activations[layerIndex] = output;
+			currentInputLayerLength = rows;
+			break;
+		}
+		
+		// Prepend the bias unit to every row.
+		LNKFloat *activation = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * (rows + 1));
+		LNK_mmov(output, activation + 1, rows, batchLength, rows, rows + 1);
+		LNK_vfill(&one, activation, rows + 1, batchLength);
+		
+		activations[layerIndex] = activation;
+		currentInputLayerLength = rows + 1;
+	}
+	
+	if (currentInputLayerLength != self.classes.count)
+		[NSException raise:NSGenericException format:@"Every class must be given an output"];
+}
+
+/// `deltas` must hold one zeroed buffer per theta vector; the gradients of the examples in `range` are accumulated into it.
+- (void)_computeGradientForExamplesInRange:(LNKRange)range deltas:(LNKFloat **)deltas {
 	NSParameterAssert(range.length);
 	NSParameterAssert(deltas);
 	
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+	
 	LNKMatrix *matrix = self.shuffleMatrixOnEachIteration ? _shuffledMatrix : self.matrix;
 	LNKClasses *classes = self.classes;
 	const LNKSize classesCount = classes.count;
 	const LNKSize columnCount = matrix.columnCount;
 	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
 	const LNKSize thetaVectorCount = [self _thetaVectorCount];
-	const LNKSize layerCount = self.layerCount;
 	const LNKFloat *outputVector = matrix.outputVector;
 	
-	LNKSize *unitsInThetaVector = malloc(thetaVectorCount * sizeof(LNKSize)); // Cache
-	*deltas = malloc(thetaVectorCount * sizeof(LNKFloat *));
-	LNKFloat **deltasValue = *deltas;
-	LNKFloat **gradients = malloc(thetaVectorCount * sizeof(LNKFloat *));
+	LNKFloat *transposedThetaVectors[thetaVectorCount];
+	[self _copyTransposedThetaVectors:transposedThetaVectors];
 	
-	for (LNKSize i = 0; i < thetaVectorCount; i++) {
-		unitsInThetaVector[i] = [self _unitsInThetaVectorAtIndex:i];
-		deltasValue[i] = LNKFloatCalloc(unitsInThetaVector[i]); // Initially zero
-		gradients[i] = LNKFloatAlloc(unitsInThetaVector[i]);
-	}
+	LNKFloat *activations[thetaVectorCount + 1];
+	LNKFloat *outputs[thetaVectorCount + 1];
 	
-	LNKFloat **activations = malloc(layerCount * sizeof(LNKFloat *));
-	
-	// Accumulate the deltas through all the examples.
-	for (LNKSize m = range.location; m < range.location + range.length; m++) {
-		const LNKFloat *featureVector = _ROW_IN_MATRIX_BUFFER(m);
+	// Accumulate the deltas through all the batches.
+	for (LNKSize batchStart = range.location; batchStart < range.location + range.length; batchStart += BATCH_SIZE) {
+		const LNKSize batchLength = MIN(BATCH_SIZE, range.location + range.length - batchStart);
 		
-		// First predict the output, then use backpropagation to find weight gradients.
-		[self _feedForwardFeatureVector:LNKVectorCreateUnsafe(featureVector, columnCount) activations:activations outputVector:NULL];
+		// Everything allocated for this batch is released in bulk once its gradients are accumulated.
+		const LNKMemoryBufferScratchMark batchMark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
 		
-		// Calculate the error for the output layer (the last array of activations).
-		LNKFloat *outputError = LNKFloatAllocAndCopy(activations[layerCount-1], classesCount);
+		// First predict the outputs, then use backpropagation to find weight gradients.
+		[self _feedForwardBatch:_ROW_IN_MATRIX_BUFFER(batchStart) length:batchLength transposedThetaVectors:transposedThetaVectors activations:activations outputs:outputs];
 		
+		// Calculate the error for the output layer (the last batch of activations).
 		// In this case, the error signal s_outputLayer = a_outputLayer - y
-		const LNKSize classIndex = [classes indexForClass:[LNKClass classWithUnsignedInteger:outputVector[m]]];
-		outputError[classIndex] -= 1; // This is the row where y = 1
-		
-		[self _runBackpropogationForActivations:activations outputError:outputError gradients:gradients];
+		LNKFloat *error = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * classesCount);
+		LNKFloatCopy(error, activations[thetaVectorCount], batchLength * classesCount);
 		
-		// Accumulate the gradients.
-		for (LNKSize i = 0; i < layerCount; i++) {
-			if (i < layerCount - 1) // ignore the input layer
-				LNK_vadd(deltasValue[i], UNIT_STRIDE, gradients[i], UNIT_STRIDE, deltasValue[i], UNIT_STRIDE, unitsInThetaVector[i]);
-			
-			free(activations[i]);
+		for (LNKSize example = 0; example < batchLength; example++) {
+			const LNKSize classIndex = [classes indexForClass:[LNKClass classWithUnsignedInteger:outputVector[batchStart + example]]];
+			error[example * classesCount + classIndex] -= 1; // This is the column where y = 1
 		}
+		
+		[self _runBackpropogationForBatchLength:batchLength activations:activations outputs:outputs outputError:error deltas:deltas];
+		
+		LNKMemoryBufferManagerResetScratch(memoryManager, batchMark);
 	}
 	
-	for (LNKSize i = 0; i < thetaVectorCount; i++) {
-		free(gradients[i]);
-	}
-	
-	free(gradients);
-	free(unitsInThetaVector);
-	free(activations);
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
 }
 
-- (void)_runBackpropogationForActivations:(LNKFloat **)activations
+/// Accumulates the gradients of a batch into `deltas`. `outputError` holds batchLength * classes error signals.
+/// Intermediate error signals are allocated from the current thread's scratch arena.
+- (void)_runBackpropogationForBatchLength:(LNKSize)batchLength
+							  activations:(LNKFloat **)activations
+								  outputs:(LNKFloat **)outputs
 							  outputError:(LNKFloat *)outputError
-								gradients:(LNKFloat **)gradients {
+								   deltas:(LNKFloat **)deltas {
 	
 	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
 	
 	const LNKSize thetaVectorCount = [self _thetaVectorCount];
 	const LNKSize layerPrior = 1;
+	LNKFloat *error = outputError;
 	
 	for (LNKSize layerIndex = thetaVectorCount; layerIndex >= 1; layerIndex--) {
-		if (layerIndex == thetaVectorCount) {
-			LNKSize rows, columns;
-			[self _getDimensionsOfLayerAtIndex:layerIndex - layerPrior rows:&rows columns:&columns]; // These weights map from layer-1 to the outputLayer
-			
-			// The term that gets accumulated is s_outputLayer * a_layer-1
-			LNK_mmul(outputError, UNIT_STRIDE, activations[layerIndex - layerPrior], UNIT_STRIDE, gradients[layerIndex - layerPrior], UNIT_STRIDE, rows, columns, 1);
-		}
-		else {
-			// Propagate the error vector going from layer -> layer-1.
-			LNKSize rows, columns;
-			const LNKFloat *thetaVector = [self _thetaVectorForLayerAtIndex:layerIndex rows:&rows columns:&columns];
-			const LNKSize columnsIgnoringBias = columns - 1;
-			
-			// s_i = theta * s_i+1
-			LNKFloat *errorVector = LNKFloatAlloc(columns);
-			LNK_mmul(thetaVector, UNIT_STRIDE, outputError, UNIT_STRIDE, errorVector, UNIT_STRIDE, columns, 1, rows);
-			
-			free(outputError);
-			outputError = errorVector;
-			
-			LNKFloat *errorVectorIgnoringBias = errorVector + 1;
-			LNKFloat *activationGradient = LNKMemoryBufferManagerAllocBlock(memoryManager, columnsIgnoringBias);
-			LNKNeuralNetLayer *layer = [self layerAtIndex:layerIndex];
-			layer.activationGradientFunction(activations[layerIndex] + 1 /* ignore bias unit */, activationGradient, columnsIgnoringBias);
-			
-			// Multiply the error vector by the derivative of the activation function.
-			// s_i = s_i * g'(i)
-			LNK_vmul(errorVectorIgnoringBias, UNIT_STRIDE, activationGradient, UNIT_STRIDE, errorVectorIgnoringBias, UNIT_STRIDE, columnsIgnoringBias);
-			LNKMemoryBufferManagerFreeBlock(memoryManager, activationGradient, columnsIgnoringBias);
-			
-			LNKSize previousRows, previousColumns;
-			[self _getDimensionsOfLayerAtIndex:layerIndex - layerPrior rows:&previousRows columns:&previousColumns];
-			
-			if (previousRows != columnsIgnoringBias)
-				[NSException raise:NSGenericException format:@"The transition to layer %lld is invalid due to incompatible matrix sizes", layerIndex];
-			
-			// Error term = s_i * a_i-1
-			const LNKFloat *activationVector = activations[layerIndex - layerPrior];
-			LNK_mmul(errorVectorIgnoringBias, UNIT_STRIDE, activationVector, UNIT_STRIDE, gradients[layerIndex - layerPrior], UNIT_STRIDE, columnsIgnoringBias, previousColumns, 1);
-		}
+		// These weights map from layer-1 to layer.
+		LNKSize rows, columns;
+		const LNKFloat *thetaVector = [self _thetaVectorForLayerAtIndex:layerIndex - layerPrior rows:&rows columns:&columns];
+		
+		// The term that gets accumulated is s_layer^T . a_layer-1
+		LNKFloat *errorTransposed = LNKMemoryBufferManagerAllocScratch(memoryManager, rows * batchLength);
+		LNK_mtrans(error, errorTransposed, rows, batchLength);
+		
+		LNKFloat *gradient = LNKMemoryBufferManagerAllocScratch(memoryManager, rows * columns);
+		LNK_mmul(errorTransposed, UNIT_STRIDE, activations[layerIndex - layerPrior], UNIT_STRIDE, gradient, UNIT_STRIDE, rows, columns, batchLength);
+		LNK_vadd(deltas[layerIndex - layerPrior], UNIT_STRIDE, gradient, UNIT_STRIDE, deltas[layerIndex - layerPrior], UNIT_STRIDE, rows * columns);
+		
+		if (layerIndex == layerPrior) // The input layer has no error signal.
+			break;
+		
+		// Propagate the error going from layer -> layer-1.
+		// s_layer-1 = s_layer . theta
+		LNKFloat *propagatedError = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * columns);
+		LNK_mmul(error, UNIT_STRIDE, thetaVector, UNIT_STRIDE, propagatedError, UNIT_STRIDE, batchLength, columns, rows);
+		
+		// Drop the column corresponding to the bias unit.
+		const LNKSize columnsIgnoringBias = columns - 1;
+		LNKFloat *previousError = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * columnsIgnoringBias);
+		LNK_mmov(propagatedError + 1, previousError, columnsIgnoringBias, batchLength, columns, columnsIgnoringBias);
+		
+		// Multiply the error by the derivative of the activation function.
+		// s_i = s_i * g'(i)
+		LNKFloat *activationGradient = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * columnsIgnoringBias);
+		LNKNeuralNetLayer *layer = [self layerAtIndex:layerIndex - layerPrior];
+		layer.activationGradientFunction(outputs[layerIndex - layerPrior], activationGradient, batchLength * columnsIgnoringBias);
+		LNK_vmul(previousError, UNIT_STRIDE, activationGradient, UNIT_STRIDE, previousError, UNIT_STRIDE, batchLength * columnsIgnoringBias);
+		
+		error = previousError;
 	}
-	
-	free(outputError);
 }
 
 - (void)computeGradientForOptimizationAlgorithm:(LNKFloat *)gradient inRange:(LNKRange)range {
@@ -151,69 +211,55 @@
 	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
 	
 	const LNKSize thetaVectorCount = [self _thetaVectorCount];
+	const LNKSize totalUnitCount = [self _totalUnitCount];
 	
-	LNKSize *unitsInThetaVector = malloc(thetaVectorCount * sizeof(LNKSize)); // Cache
-	LNKFloat **globalDeltas = malloc(thetaVectorCount * sizeof(LNKFloat *));
+	LNKSize unitsInThetaVectorCache[thetaVectorCount];
+	LNKSize *unitsInThetaVector = unitsInThetaVectorCache; // Blocks can't capture arrays.
 	
 	for (LNKSize i = 0; i < thetaVectorCount; i++) {
 		unitsInThetaVector[i] = [self _unitsInThetaVectorAtIndex:i];
-		globalDeltas[i] = LNKFloatCalloc(unitsInThetaVector[i]); // Initially zero
 	}
 	
-	const NSUInteger processorCount = _parallelProcessorCount();
-	LNKFloat ***results = malloc(processorCount * sizeof(LNKFloat **));
-	
-	// We can parallelize running FP-BP on examples.
-	[self _parallelReduceExamplesInRange:range worker:^(LNKRange innerRange, NSUInteger index) {
-		[self _computeGradientForExamplesInRange:innerRange delta:&results[index]];
-	}];
-	
-	for (NSUInteger p = 0; p < processorCount; p++) {
+	// We can parallelize running FP-BP on examples. Each thread accumulates into its own unrolled deltas,
+	// which the executor sums into the gradient.
+	LNKExecutorSum(LNKExecutorGetShared(), range, BATCH_SIZE, gradient, totalUnitCount, ^(LNKRange innerRange, LNKFloat *accumulator) {
+		LNKFloat *deltas[thetaVectorCount];
+		LNKSize offset = 0;
+		
 		for (LNKSize i = 0; i < thetaVectorCount; i++) {
-			LNK_vadd(globalDeltas[i], UNIT_STRIDE, results[p][i], UNIT_STRIDE, globalDeltas[i], UNIT_STRIDE, unitsInThetaVector[i]);
-			free(results[p][i]);
+			deltas[i] = accumulator + offset;
+			offset += unitsInThetaVector[i];
 		}
 		
-		free(results[p]);
-	}
-	
-	free(results);
+		[self _computeGradientForExamplesInRange:innerRange deltas:deltas];
+	});
 	
 	// Need the 1/m factor.
 	const LNKFloat m = (LNKFloat)range.length;
-	LNKSize gradientOffset = 0;
+	LNK_vsdiv(gradient, UNIT_STRIDE, &m, gradient, UNIT_STRIDE, totalUnitCount);
 	
-	for (LNKSize i = 0; i < thetaVectorCount; i++) {
-		LNK_vsdiv(globalDeltas[i], UNIT_STRIDE, &m, globalDeltas[i], UNIT_STRIDE, unitsInThetaVector[i]);
+	// (Optional) regularization.
+	if (self.regularizationConfiguration != nil) {
+		LNKSize gradientOffset = 0;
 		
-		// (Optional) regularization.
-		if (self.regularizationConfiguration != nil) {
+		for (LNKSize i = 0; i < thetaVectorCount; i++) {
 			// Delta += lambda / m * Theta
 			LNKSize rows, columns;
 			const LNKFloat *thetaVector = [self _thetaVectorForLayerAtIndex:i rows:&rows columns:&columns];
-
+			
 			LNKFloat *thetaVectorCopy = LNKMemoryBufferManagerAllocBlock(memoryManager, rows * columns);
 			LNKFloatCopy(thetaVectorCopy, thetaVector, rows * columns);
-
+			
 			// Ignore weights corresponding to bias units (first column).
 			LNK_vclr(thetaVectorCopy, columns, rows);
-
+			
 			const LNKFloat factor = self.regularizationConfiguration.lambda / m;
-			LNK_vsma(thetaVectorCopy, UNIT_STRIDE, &factor, globalDeltas[i], UNIT_STRIDE, globalDeltas[i], UNIT_STRIDE, rows * columns);
+			LNK_vsma(thetaVectorCopy, UNIT_STRIDE, &factor, gradient + gradientOffset, UNIT_STRIDE, gradient + gradientOffset, UNIT_STRIDE, rows * columns);
 			LNKMemoryBufferManagerFreeBlock(memoryManager, thetaVectorCopy, rows * columns);
+			
+			gradientOffset += unitsInThetaVector[i];
 		}
-		
-		// Pack the gradient.
-		LNKFloatCopy(gradient + gradientOffset, globalDeltas[i], unitsInThetaVector[i]);
-		gradientOffset += unitsInThetaVector[i];
 	}
-	
-	for (LNKSize i = 0; i < thetaVectorCount; i++) {
-		free(globalDeltas[i]);
-	}
-	
-	free(globalDeltas);
-	free(unitsInThetaVector);
 }
 
 - (void)_initializeRandomThetaVectors {
@@ -274,15 +320,13 @@
 	}
 }
 
-/// Only one of `activations` or `outOutputVector` can be retrieved.
-/// `outOutputVector`/members of `activations` must be freed by the caller.
-- (void)_feedForwardFeatureVector:(LNKVector)featureVector activations:(LNKFloat **)activations outputVector:(LNKFloat **)outOutputVector {
+/// `outOutputVector` is allocated from the current thread's scratch arena and remains valid until the caller resets it.
+- (void)_feedForwardFeatureVector:(LNKVector)featureVector outputVector:(LNKFloat **)outOutputVector {
 	NSParameterAssert(featureVector.data);
 	NSParameterAssert(featureVector.length);
-	NSParameterAssert((activations && !outOutputVector) || (!activations && outOutputVector));
+	NSParameterAssert(outOutputVector);
 	
-	if (activations) // The activation values for the input layer are just the original feature vectors.
-		activations[0] = LNKFloatAllocAndCopy(featureVector.data, featureVector.length);
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
 	
 	const LNKSize thetaVectorCount = [self _thetaVectorCount];
 	const LNKFloat *currentInputLayer = featureVector.data;
@@ -304,25 +348,15 @@
 		
 		// Perform linear combination: featureVector . thetaVector
 		// In anticipation of the bias unit we may need to add, allocate space for one more element.
-		LNKFloat *outputVector = LNKFloatAlloc(actualOutputVectorLength);
+		LNKFloat *outputVector = LNKMemoryBufferManagerAllocScratch(memoryManager, actualOutputVectorLength);
 		LNK_mmul(thetaVector, UNIT_STRIDE, currentInputLayer, UNIT_STRIDE, outputVector + biasUnitOffset, UNIT_STRIDE, rows, 1, columns);
 		
 		if (shouldAddBiasUnit)
 			outputVector[0] = 1;
 		
-		if (currentInputLayer != featureVector.data) {
-			NSCAssert(layerIndex >= 1, @"The layer index must be greater than 0");
-			free((void *)currentInputLayer);
-		}
-		
 		// Apply the layer's activation function:
 		layer.activationFunction(outputVector + biasUnitOffset, rows);
 		
-		if (activations) {
-			activations[layerIndex] = LNKFloatAllocAndCopy(outputVector, actualOutputVectorLength);
-			// We ignore the bias unit.
-		}
-		
 		currentInputLayer = outputVector;
 		currentInputLayerLength = actualOutputVectorLength;
 	}
@@ -330,11 +364,10 @@
 	if (currentInputLayerLength != self.classes.count)
 		[NSException raise:NSGenericException format:@"Every class must be given an output"];
 	
-	if (outOutputVector)
-		*outOutputVector = (LNKFloat *)currentInputLayer;
+	*outOutputVector = (LNKFloat *)currentInputLayer;
 }
 
-- (void)_predictValueForFeatureVector:(LNKVector)featureVector {
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
 	NSParameterAssert(featureVector.data);
 	NSParameterAssert(featureVector.length);
 
@@ -342,23 +375,72 @@
 		[NSException raise:NSGenericException format:@"The length of the feature vector must be equal to the number of columns in the matrix"]; // otherwise, we can't do matrix multiplication
 	}
 
+	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+
 	const LNKSize biasOffset = 1;
-	LNKFloat *featuresWithBias = LNKFloatAlloc(featureVector.length + biasOffset);
+	LNKFloat *featuresWithBias = LNKMemoryBufferManagerAllocScratch(memoryManager, featureVector.length + biasOffset);
 	featuresWithBias[0] = 1;
 	LNKFloatCopy(featuresWithBias + biasOffset, featureVector.data, featureVector.length);
 
 	LNKFloat *outputLayer = NULL;
-	[self _feedForwardFeatureVector:LNKVectorCreateUnsafe(featuresWithBias, featureVector.length + biasOffset) activations:NULL outputVector:&outputLayer];
-	free(featuresWithBias);
+	[self _feedForwardFeatureVector:LNKVectorCreateUnsafe(featuresWithBias, featureVector.length + biasOffset) outputVector:&outputLayer];
 
 	NSAssert(outputLayer != NULL, @"We should get an output vector back.");
 
-	LNKSize index = 0;
-	for (LNKClass *class in self.classes) {
-		[self _didPredictProbability:outputLayer[index++] forClass:class];
-	}
-	
-	free(outputLayer);
+	LNKFloatCopy(outProbabilities, outputLayer, self.classes.count);
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+
+	return YES;
+}
+
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+
+	const LNKSize biasOffset = 1;
+	const LNKSize columnCount = matrix.columnCount;
+
+	if (matrix.hasBiasColumn || columnCount + biasOffset != self.matrix.columnCount)
+		[NSException raise:NSGenericException format:@"The columns of the matrix are incompatible with the training matrix"];
+
+	const LNKSize classCount = self.classes.count;
+	const LNKSize thetaVectorCount = [self _thetaVectorCount];
+	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	const LNKFloat one = 1;
+
+	// Rows are fed forward in batches, like they are during training, so every layer is a matrix-matrix product.
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, matrix.rowCount), BATCH_SIZE, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+		const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+
+		LNKFloat *transposedThetaVectors[thetaVectorCount];
+		[self _copyTransposedThetaVectors:transposedThetaVectors];
+
+		LNKFloat *activations[thetaVectorCount + 1];
+		LNKFloat *outputs[thetaVectorCount + 1];
+
+		for (LNKSize batchStart = range.location; batchStart < range.location + range.length; batchStart += BATCH_SIZE) {
+			const LNKSize batchLength = MIN(BATCH_SIZE, range.location + range.length - batchStart);
+			const LNKMemoryBufferScratchMark batchMark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+
+			// Prepend the bias unit to every row.
+			LNKFloat *batch = LNKMemoryBufferManagerAllocScratch(memoryManager, batchLength * (columnCount + biasOffset));
+			LNK_mmov(_ROW_IN_MATRIX_BUFFER(batchStart), batch + biasOffset, columnCount, batchLength, columnCount, columnCount + biasOffset);
+			LNK_vfill(&one, batch, columnCount + biasOffset, batchLength);
+
+			[self _feedForwardBatch:batch length:batchLength transposedThetaVectors:transposedThetaVectors activations:activations outputs:outputs];
+			LNKFloatCopy(outputBuffer + batchStart * classCount, activations[thetaVectorCount], batchLength * classCount);
+
+			LNKMemoryBufferManagerResetScratch(memoryManager, batchMark);
+		}
+
+		LNKMemoryBufferManagerResetScratch(memoryManager, mark);
+	});
 }
 
 - (BOOL)shuffleMatrixOnEachIteration {
@@ -367,6 +449,7 @@
 
 - (LNKFloat)_evaluateCostFunctionForExamplesInRange:(LNKRange)range {
 	LNKMemoryBufferManagerRef memoryManager = LNKGetCurrentMemoryBufferManager();
+	const LNKMemoryBufferScratchMark mark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
 	
 	LNKMatrix *matrix = self.shuffleMatrixOnEachIteration ? _shuffledMatrix : self.matrix;
 	LNKClasses *classes = self.classes;
@@ -374,49 +457,50 @@
 	const LNKSize columnCount = matrix.columnCount;
 	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
 	const LNKFloat *classOutputVector = matrix.outputVector;
-	const int classesCountInt = (int)classesCount;
+	const LNKSize thetaVectorCount = [self _thetaVectorCount];
 	const LNKFloat one = 1;
 	
-	LNKFloat *logVector = LNKMemoryBufferManagerAllocBlock(memoryManager, classesCount);
-	LNKFloat *outputVector = LNKMemoryBufferManagerAllocBlock(memoryManager, classesCount);
+	LNKFloat *transposedThetaVectors[thetaVectorCount];
+	[self _copyTransposedThetaVectors:transposedThetaVectors];
+	
+	LNKFloat *activations[thetaVectorCount + 1];
+	LNKFloat *outputs[thetaVectorCount + 1];
 	
 	LNKFloat J = 0;
 	
-	for (LNKSize m = range.location; m < range.location + range.length; m++) {
-		const LNKFloat *featureVector = _ROW_IN_MATRIX_BUFFER(m);
-		LNKFloat *outputLayer;
-		[self _feedForwardFeatureVector:LNKVectorCreateUnsafe(featureVector, columnCount) activations:NULL outputVector:&outputLayer];
+	for (LNKSize batchStart = range.location; batchStart < range.location + range.length; batchStart += BATCH_SIZE) {
+		const LNKSize batchLength = MIN(BATCH_SIZE, range.location + range.length - batchStart);
+		const LNKSize outputLength = batchLength * classesCount;
+		const int outputLengthInt = (int)outputLength;
+		const LNKMemoryBufferScratchMark batchMark = LNKMemoryBufferManagerGetScratchMark(memoryManager);
+		
+		[self _feedForwardBatch:_ROW_IN_MATRIX_BUFFER(batchStart) length:batchLength transposedThetaVectors:transposedThetaVectors activations:activations outputs:outputs];
+		const LNKFloat *outputLayer = activations[thetaVectorCount];
 		
 		// Optimize for true positives and negatives for all classes.
 		// -y log(h) - (1 - y) log(1 - h)
-		LNK_vlog(logVector, outputLayer, &classesCountInt);
-		
-		LNK_vclr(outputVector, UNIT_STRIDE, classesCount);
-		const LNKSize index = [classes indexForClass:[LNKClass classWithUnsignedInteger:classOutputVector[m]]];
-		
-		// The output vector y will only hold a 1 for the example corresponding to the true class.
-		outputVector[index] = -1; // Note -y log(h)...
+		LNKFloat *logVector = LNKMemoryBufferManagerAllocScratch(memoryManager, outputLength);
+		LNK_vlog(logVector, outputLayer, &outputLengthInt);
 		
-		LNKFloat sum;
-		LNK_dotpr(outputVector, UNIT_STRIDE, logVector, UNIT_STRIDE, &sum, classesCount);
-		J += sum;
+		LNKFloat *logComplementVector = LNKMemoryBufferManagerAllocScratch(memoryManager, outputLength);
+		LNK_vneg(outputLayer, UNIT_STRIDE, logComplementVector, UNIT_STRIDE, outputLength);
+		LNK_vsadd(logComplementVector, UNIT_STRIDE, &one, logComplementVector, UNIT_STRIDE, outputLength);
+		LNK_vlog(logComplementVector, logComplementVector, &outputLengthInt);
 		
-		// When subtracting 1 - y, the output vector will only hold a 0 for the example corresponding to the true class.
-		LNK_vfill(&one, outputVector, UNIT_STRIDE, classesCount);
-		outputVector[index] = 0;
+		// Start with the (1 - y) log(1 - h) term of every class, then swap in the -y log(h) term for each true class.
+		LNKFloat complementSum;
+		LNK_vsum(logComplementVector, UNIT_STRIDE, &complementSum, outputLength);
+		J -= complementSum;
 		
-		LNK_vneg(outputLayer, UNIT_STRIDE, logVector, UNIT_STRIDE, classesCount);
-		free(outputLayer);
-		
-		LNK_vsadd(logVector, UNIT_STRIDE, &one, logVector, UNIT_STRIDE, classesCount);
-		LNK_vlog(logVector, logVector, &classesCountInt);
+		for (LNKSize example = 0; example < batchLength; example++) {
+			const LNKSize index = example * classesCount + [classes indexForClass:[LNKClass classWithUnsignedInteger:classOutputVector[batchStart + example]]];
+			J += logComplementVector[index] - logVector[index];
+		}
 		
-		LNK_dotpr(logVector, UNIT_STRIDE, outputVector, UNIT_STRIDE, &sum, classesCount);
-		J -= sum;
+		LNKMemoryBufferManagerResetScratch(memoryManager, batchMark);
 	}
 	
-	LNKMemoryBufferManagerFreeBlock(memoryManager, logVector, classesCount);
-	LNKMemoryBufferManagerFreeBlock(memoryManager, outputVector, classesCount);
+	LNKMemoryBufferManagerResetScratch(memoryManager, mark);
 	
 	return J;
 }
@@ -427,17 +511,12 @@
 
 - (LNKFloat)_evaluateCostFunction {
 	const LNKSize rowCount = self.matrix.rowCount;
-	const NSUInteger processorCount = _parallelProcessorCount();
-	LNKFloat *results = LNKFloatAlloc(processorCount);
 	
 	// We can parallelize running feed-forward on examples.
-	[self _parallelReduceExamplesInRange:LNKRangeMake(0, rowCount) worker:^(LNKRange range, NSUInteger index) {
-		results[index] = [self _evaluateCostFunctionForExamplesInRange:range];
-	}];
-	
 	LNKFloat J;
-	LNK_vsum(results, UNIT_STRIDE, &J, processorCount);
-	free(results);
+	LNKExecutorSum(LNKExecutorGetShared(), LNKRangeMake(0, rowCount), BATCH_SIZE, &J, 1, ^(LNKRange range, LNKFloat *accumulator) {
+		*accumulator += [self _evaluateCostFunctionForExamplesInRange:range];
+	});
 	
 	// Finally take into account the 1/m factor.
 	J /= rowCount;
@@ -465,31 +544,4 @@
 	return J;
 }
 
-static inline NSUInteger _parallelProcessorCount() {
-	return [NSProcessInfo processInfo].processorCount;
-}
-
-- (void)_parallelReduceExamplesInRange:(LNKRange)exampleRange worker:(void(^)(LNKRange range, NSUInteger index))worker {
-	dispatch_queue_t queue = dispatch_queue_create(NULL, DISPATCH_QUEUE_CONCURRENT);
-	dispatch_group_t group = dispatch_group_create();
-	
-	const NSUInteger processorCount = _parallelProcessorCount();
-	const LNKSize rowCount = exampleRange.length;
-	const LNKSize workgroupSize = rowCount / processorCount;
-	
-	for (NSUInteger p = 0; p < processorCount; p++) {
-		const LNKSize location = p * workgroupSize + exampleRange.location;
-		const LNKSize length = p == processorCount - 1 ? rowCount - p * workgroupSize : workgroupSize;
-		LNKRange range = LNKRangeMake(location, length);
-		
-		dispatch_group_async(group, queue, ^{
-			worker(range, p);
-		});
-	}
-	
-	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
-	dispatch_release(group);
-	dispatch_release(queue);
-}
-
 @end
@@ -166,10 +166,13 @@
 
 @end
 
-@implementation LNKOptimizationAlgorithmCG {
-	id<LNKOptimizationAlgorithmDelegate> _delegate;
-	LNKSize _rowCount;
-}
+/// The state of a single run, so one algorithm can drive any number of runs at once.
+typedef struct {
+	id<LNKOptimizationAlgorithmDelegate> delegate;
+	LNKSize rowCount;
+} _LNKCGRunContext;
+
+@implementation LNKOptimizationAlgorithmCG
 
 - (instancetype)init {
 	self = [super init];
@@ -179,17 +182,15 @@
 	return self;
 }
 
-static LNKOptimizationAlgorithmCG *tempSelf = nil;
-
-static void _fmincg_evaluate(LNKFloat *inputVector, LNKFloat *outCost, LNKFloat *gradientVector) {
-	LNKOptimizationAlgorithmCG *self = tempSelf;
-	NSCAssert(self, @"The self reference must not be nil");
+static void _fmincg_evaluate(void *context, LNKFloat *inputVector, LNKFloat *outCost, LNKFloat *gradientVector) {
+	const _LNKCGRunContext *runContext = context;
+	NSCAssert(runContext, @"The context must not be NULL");
 	NSCAssert(inputVector, @"The input vector must not be NULL");
 	NSCAssert(outCost, @"The output cost vector must not be NULL");
 	NSCAssert(gradientVector, @"The gradient vector must not be NULL");
 	
-	id<LNKOptimizationAlgorithmDelegate> delegate = self->_delegate;
-	LNKRange range = LNKRangeMake(0, self->_rowCount);
+	id<LNKOptimizationAlgorithmDelegate> delegate = runContext->delegate;
+	LNKRange range = LNKRangeMake(0, runContext->rowCount);
 	
 	[delegate optimizationAlgorithmWillBeginWithInputVector:inputVector];
 	const LNKFloat cost = [delegate costForOptimizationAlgorithm];
@@ -204,15 +205,13 @@ static void _fmincg_evaluate(LNKFloat *inputVector, LNKFloat *outCost, LNKFloat
 	NSParameterAssert(delegate);
 	NSParameterAssert(rowCount);
 	
-	_delegate = delegate;
-	_rowCount = rowCount;
-	tempSelf = self;
+	_LNKCGRunContext runContext = { delegate, rowCount };
 	
 #ifdef DEBUG
-	int result = fmincg(_fmincg_evaluate, (LNKFloat *)vector.data, (int)vector.length, (int)_iterationCount);
+	int result = fmincg(_fmincg_evaluate, &runContext, (LNKFloat *)vector.data, (int)vector.length, (int)_iterationCount);
 	NSAssert(result == 0 || result == 1, @"Could not minimize the function");
 #else
-	fmincg(_fmincg_evaluate, (LNKFloat *)vector.data, (int)vector.length, (int)_iterationCount);
+	fmincg(_fmincg_evaluate, &runContext, (LNKFloat *)vector.data, (int)vector.length, (int)_iterationCount);
 #endif
 }
 
@@ -26,6 +26,12 @@ NS_ASSUME_NONNULL_BEGIN
 - (LNKFloat)priorForClassAtIndex:(LNKSize)index;
 - (LNKFloat)probabilityLogForClassAtIndex:(LNKSize)classIndex featureAtIndex:(LNKSize)featureIndex value:(LNKFloat)value;
 
+/// Adds the probability logs of all features of each of the `rowCount` rows of `rows`, stored row by row, to `likelihoods`,
+/// which holds a value for every class of every row. Values a class can't have give -infinity.
+/// The default implementation calls `-probabilityLogForClassAtIndex:featureAtIndex:value:` for every term; subclasses
+/// override it to score whole matrices without sending messages.
+- (void)accumulateProbabilityLogsForRows:(const LNKFloat *)rows count:(LNKSize)rowCount likelihoods:(LNKFloat *)likelihoods;
+
 // Subclasses must override this method to build a probability distribution.
 - (void)buildWithMatrix:(LNKMatrix *)matrix;
 
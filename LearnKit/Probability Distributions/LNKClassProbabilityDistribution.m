@@ -56,6 +56,24 @@
 	return 0;
 }
 
+- (void)accumulateProbabilityLogsForRows:(const LNKFloat *)rows count:(LNKSize)rowCount likelihoods:(LNKFloat *)likelihoods {
+	NSParameterAssert(rows || !rowCount);
+	NSParameterAssert(likelihoods || !rowCount);
+
+	const LNKSize classCount = self.classes.count;
+	const LNKSize featureCount = self.featureCount;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *featureVector = rows + row * featureCount;
+
+		for (LNKSize classIndex = 0; classIndex < classCount; classIndex++) {
+			for (LNKSize feature = 0; feature < featureCount; feature++) {
+				likelihoods[row * classCount + classIndex] += [self probabilityLogForClassAtIndex:classIndex featureAtIndex:feature value:featureVector[feature]];
+			}
+		}
+	}
+}
+
 - (LNKFloat)priorForClassAtIndex:(LNKSize)index {
 	if (index >= self.classes.count) {
 		[NSException raise:NSInvalidArgumentException format:@"The class index is out-of-bounds"];
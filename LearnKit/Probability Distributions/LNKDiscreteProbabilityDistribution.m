@@ -14,7 +14,11 @@
 
 @implementation LNKDiscreteProbabilityDistribution {
 	NSPointerArray *_columnsToValues;
-	LNKFloat **_featureProbabilities;
+	
+	// log(P(f_x = n | c)) for every value n of every column x, with the classes of each value next to each other so rows
+	// can be scored by gathering a run of values per feature. The values of column x start at slot `_valueOffsets[x]`.
+	LNKFloat *_featureProbabilityLogs;
+	LNKSize *_valueOffsets;
 }
 
 - (instancetype)initWithClasses:(LNKClasses *)classes featureCount:(LNKSize)featureCount {
@@ -28,19 +32,14 @@
 }
 
 - (void)_freeBuffers {
-	if (_featureProbabilities == NULL) {
+	if (_featureProbabilityLogs == NULL) {
 		return;
 	}
 
-	const LNKSize entryCount = self.featureCount * self.classes.count;
-
-	for (LNKSize i = 0; i < entryCount; i++) {
-		if (_featureProbabilities[i] != NULL) {
-			free(_featureProbabilities[i]);
-		}
-	}
-
-	free(_featureProbabilities);
+	free(_featureProbabilityLogs);
+	free(_valueOffsets);
+	_featureProbabilityLogs = NULL;
+	_valueOffsets = NULL;
 }
 
 - (void)dealloc {
@@ -88,7 +87,15 @@
 	LNKClasses *const classes = self.classes;
 	const LNKSize classCount = classes.count;
 
-	_featureProbabilities = calloc(sizeof(LNKFloat *), classCount * columnCount);
+	_valueOffsets = malloc((columnCount + 1) * sizeof(LNKSize));
+	_valueOffsets[0] = 0;
+
+	for (LNKSize column = 0; column < columnCount; column++) {
+		NSArray<NSNumber *> *values = [_columnsToValues pointerAtIndex:column];
+		_valueOffsets[column + 1] = _valueOffsets[column] + values.count;
+	}
+
+	_featureProbabilityLogs = LNKFloatAlloc(_valueOffsets[columnCount] * classCount);
 
 	const LNKSize rowCount = matrix.rowCount;
 	const LNKFloat *const outputVector = matrix.outputVector;
@@ -121,31 +128,29 @@
 			NSArray<NSNumber *> *values = [_columnsToValues pointerAtIndex:column];
 			const NSUInteger valuesCount = values.count;
 
-			LNKFloat *valuesVector = LNKFloatCalloc(valuesCount);
-			_featureProbabilities[classIndex * columnCount + column] = valuesVector;
-
 			NSUInteger valueIndex = 0;
 
 			for (NSNumber *value in values) {
 				const NSUInteger valueUnboxed = value.unsignedIntegerValue;
+				LNKFloat frequency = 0;
 
 				for (LNKSize row = 0; row < rowCount; row++) {
 					if (outputVector[row] == outputValue) {
 						const LNKFloat *exampleRow = [matrix rowAtIndex:row];
 
 						if (exampleRow[column] == valueUnboxed)
-							valuesVector[valueIndex]++;
+							frequency++;
 					}
 				}
 
 				adjustedDenominator = 0;
 
 				if (performsLaplacianSmoothing) {
-					valuesVector[valueIndex] += laplacianSmoothingFactor;
+					frequency += laplacianSmoothingFactor;
 					adjustedDenominator = valuesCount * laplacianSmoothingFactor;
 				}
 
-				valuesVector[valueIndex] /= (LNKFloat)(hits + adjustedDenominator);
+				_featureProbabilityLogs[(_valueOffsets[column] + valueIndex) * classCount + classIndex] = LNKLog(frequency / (LNKFloat)(hits + adjustedDenominator));
 				valueIndex++;
 			}
 		}
@@ -165,7 +170,39 @@
 		[NSException raise:NSGenericException format:@"The feature index is out-of-bounds"];
 	}
 
-	return LNKLog(_featureProbabilities[classIndex * featureCount + featureIndex][(LNKSize)value]);
+	return _featureProbabilityLogs[(_valueOffsets[featureIndex] + (LNKSize)value) * self.classes.count + classIndex];
+}
+
+- (void)accumulateProbabilityLogsForRows:(const LNKFloat *)rows count:(LNKSize)rowCount likelihoods:(LNKFloat *)likelihoods {
+	NSParameterAssert(rows || !rowCount);
+	NSParameterAssert(likelihoods || !rowCount);
+
+	if (_featureProbabilityLogs == NULL) {
+		[NSException raise:NSGenericException format:@"The distribution must be built before computing probabilities"];
+	}
+
+	const LNKSize classCount = self.classes.count;
+	const LNKSize featureCount = self.featureCount;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *featureVector = rows + row * featureCount;
+		LNKFloat *rowLikelihoods = likelihoods + row * classCount;
+
+		for (LNKSize feature = 0; feature < featureCount; feature++) {
+			const LNKFloat value = featureVector[feature];
+			const LNKSize valueCount = _valueOffsets[feature + 1] - _valueOffsets[feature];
+
+			// Values that weren't registered can't have been produced by any class.
+			if (!(value >= 0 && value < valueCount)) {
+				const LNKFloat impossible = -INFINITY;
+				LNK_vfill(&impossible, rowLikelihoods, UNIT_STRIDE, classCount);
+				break;
+			}
+
+			const LNKFloat *valueLogs = _featureProbabilityLogs + (_valueOffsets[feature] + (LNKSize)value) * classCount;
+			LNK_vadd(rowLikelihoods, UNIT_STRIDE, valueLogs, UNIT_STRIDE, rowLikelihoods, UNIT_STRIDE, classCount);
+		}
+	}
 }
 
 @end
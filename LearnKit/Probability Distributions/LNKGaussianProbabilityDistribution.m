@@ -103,4 +103,33 @@ typedef struct {
 	return -0.5 * top * top / bottom - LNKLog(parameters.sd);
 }
 
+- (void)accumulateProbabilityLogsForRows:(const LNKFloat *)rows count:(LNKSize)rowCount likelihoods:(LNKFloat *)likelihoods {
+	NSParameterAssert(rows || !rowCount);
+	NSParameterAssert(likelihoods || !rowCount);
+
+	if (_featureParameters == NULL) {
+		[NSException raise:NSGenericException format:@"The distribution must be built before computing probabilities"];
+	}
+
+	const LNKSize classCount = self.classes.count;
+	const LNKSize featureCount = self.featureCount;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *featureVector = rows + row * featureCount;
+
+		for (LNKSize classIndex = 0; classIndex < classCount; classIndex++) {
+			const LNKGaussianParameters *classParameters = _featureParameters + classIndex * featureCount;
+			LNKFloat sum = 0;
+
+			for (LNKSize feature = 0; feature < featureCount; feature++) {
+				const LNKFloat top = featureVector[feature] - classParameters[feature].mean;
+				const LNKFloat bottom = classParameters[feature].sd * classParameters[feature].sd;
+				sum += -0.5 * top * top / bottom - LNKLog(classParameters[feature].sd);
+			}
+
+			likelihoods[row * classCount + classIndex] += sum;
+		}
+	}
+}
+
 @end
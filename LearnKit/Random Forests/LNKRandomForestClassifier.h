@@ -14,7 +14,7 @@ typedef NS_ENUM(NSInteger, LNKRandomForestClassifierMaxFeatures) {
 	LNKRandomForestClassifierMaxFeaturesLog2
 };
 
-/// A random forest classifier for matrices of discrete values.
+/// A random forest classifier for matrices of discrete and continuous values.
 /// The optimization algorithm is ignored and can be `nil`.
 /// The value types of the matrix must be registered prior to training.
 /// Output labels must be specified in form of classes.
@@ -26,15 +26,36 @@ typedef NS_ENUM(NSInteger, LNKRandomForestClassifierMaxFeatures) {
 /// Determines how many trees should be built during training. The default is `10`.
 @property (nonatomic) LNKSize treeCount;
 
-/// Determines how many examples should be randomly selected when training a tree. A value of `0` indicates 'all'.
+/// Determines how many examples should be drawn with replacement when training a tree. A value of `0` indicates
+/// as many as the matrix has rows.
 @property (nonatomic) LNKSize maxExampleCount;
 
+/// Trees draw their examples and columns from generators seeded with `seed` and their index, so forests trained
+/// with the same seed and parameters are identical regardless of how trees are scheduled across threads.
+/// The default is random.
+@property (nonatomic) LNKSize seed;
+
+/// The fraction of examples misclassified by a vote of the trees that didn't draw them during the last training,
+/// or NaN if every example was drawn by every tree.
+@property (nonatomic, readonly) LNKFloat outOfBagError;
+
 /// Indicates values at `columnIndex` are boolean values.
 - (void)registerBooleanValueForColumnAtIndex:(LNKSize)columnIndex;
 
 /// Indicates values at `columnIndex` are categorical in range [0, valueCount).
 - (void)registerCategoricalValues:(LNKSize)valueCount forColumnAtIndex:(LNKSize)columnIndex;
 
+/// Indicates values at `columnIndex` are continuous.
+- (void)registerContinuousValuesForColumnAtIndex:(LNKSize)columnIndex;
+
+/// Counts the votes of the trees for every class for each row of `matrix`, which must have as many columns as the
+/// training matrix. Rows are scored against all trees in blocks and in parallel, using a packed copy of the trees.
+/// `outputBuffer` must have room for `matrix.rowCount * classes.count` values, stored row by row.
+- (void)predictVoteCountsForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
+/// Like `predictVoteCountsForMatrix:outputBuffer:`, with the votes of each row divided by their sum.
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -7,14 +7,15 @@
 
 #import "LNKRandomForestClassifier.h"
 
-#import "LNKDecisionTreeClassifier.h"
-#import "LNKDecisionTreeClassifier+Private.h"
+#import "LNKAccelerate.h"
+#import "LNKClassifierPrivate.h"
+#import "LNKDecisionForest.h"
+#import "LNKDecisionTree.h"
+#import "LNKExecutor.h"
 #import "LNKMatrix.h"
-#import "NSCountedSetAdditions.h"
-#import "NSIndexSetAdditions.h"
 
 @implementation LNKRandomForestClassifier {
-	NSArray<LNKDecisionTreeClassifier *> *_trees;
+	LNKDecisionForestRef _forest;
 	NSMutableDictionary<NSNumber *, NSNumber *> *_columnsToPossibleValues;
 }
 
@@ -39,12 +40,18 @@
 	}
 
 	_treeCount = 10;
+	_seed = ((LNKSize)arc4random() << 32) | arc4random();
+	_outOfBagError = NAN;
 	_columnsToPossibleValues = [[NSMutableDictionary alloc] init];
 
 	return self;
 }
 
 - (void)dealloc {
+	if (_forest) {
+		LNKDecisionForestFree(_forest);
+	}
+
 	[_columnsToPossibleValues release];
 	[super dealloc];
 }
@@ -61,16 +68,57 @@
 	_columnsToPossibleValues[@(columnIndex)] = @(valueCount);
 }
 
+- (void)registerContinuousValuesForColumnAtIndex:(LNKSize)columnIndex {
+	[self registerCategoricalValues:LNKDecisionTreeContinuousColumn forColumnAtIndex:columnIndex];
+}
+
+- (void)validate {
+	const LNKSize columnCount = self.matrix.columnCount;
+
+	for (LNKSize column = 0; column < columnCount; column++) {
+		if (!_columnsToPossibleValues[@(column)]) {
+			[NSException raise:NSInternalInconsistencyException format:@"A value type has not been registered for column %lld.", column];
+		}
+	}
+}
+
+static uint64_t _LNKMixBits(uint64_t value) {
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return value ^ (value >> 31);
+}
+
+/// A SplitMix64 generator, which is cheap enough to give every tree its own.
+static uint64_t _LNKNextRandom(uint64_t *state) {
+	*state += 0x9E3779B97F4A7C15ULL;
+	return _LNKMixBits(*state);
+}
+
+/// Returns a random index in [0, `count`).
+static LNKSize _LNKRandomIndex(uint64_t *state, LNKSize count) {
+	return (LNKSize)(((unsigned __int128)_LNKNextRandom(state) * count) >> 64);
+}
+
+static int _LNKCompareSizes(const void *a, const void *b) {
+	const LNKSize first = *(const LNKSize *)a;
+	const LNKSize second = *(const LNKSize *)b;
+
+	return (first > second) - (first < second);
+}
+
 - (void)train {
-	if (_trees != nil) {
-		[_trees release];
-		_trees = nil;
+	if (_forest) {
+		LNKDecisionForestFree(_forest);
+		_forest = NULL;
 	}
 
 	LNKMatrix *const matrix = self.matrix;
 	const LNKSize totalExampleCount = matrix.rowCount;
 	const LNKSize totalFeatureCount = matrix.columnCount;
 	const LNKSize exampleCount = _maxExampleCount == 0 ? totalExampleCount : _maxExampleCount;
+	const LNKSize classCount = self.classes.count;
+	const LNKFloat *matrixBuffer = matrix.matrixBuffer;
+	const LNKFloat *outputVector = matrix.outputVector;
 
 	LNKSize featureCount;
 	switch (_maxFeatures) {
@@ -82,44 +130,192 @@
 		break;
 	}
 
-	NSMutableArray<LNKDecisionTreeClassifier *> *const newTrees = [[NSMutableArray alloc] init];
+	featureCount = MIN(MAX(featureCount, 1), totalFeatureCount);
+
+	for (LNKSize example = 0; example < totalExampleCount; example++) {
+		const LNKFloat output = outputVector[example];
+
+		if (output < 0 || output >= classCount || output != floor(output)) {
+			[NSException raise:NSInternalInconsistencyException format:@"The output vector should only contain class indices in range [0, %lld)", classCount];
+		}
+	}
+
+	LNKSize *const columnValueCounts = malloc(totalFeatureCount * sizeof(LNKSize));
+
+	for (LNKSize column = 0; column < totalFeatureCount; column++) {
+		columnValueCounts[column] = [_columnsToPossibleValues[@(column)] LNKSizeValue];
+	}
+
+	// Columns are coded once and shared by all trees, whatever columns they pick.
+	LNKDecisionTreeFeatureStoreRef const store = LNKDecisionTreeFeatureStoreCreate(matrixBuffer, totalExampleCount, totalFeatureCount, columnValueCounts);
+	free(columnValueCounts);
+
+	const uint64_t seed = _seed;
+	LNKDecisionTreeRef *const trees = malloc(_treeCount * sizeof(LNKDecisionTreeRef));
+
+	// Each tree marks the examples it drew in its own row of bits, so out-of-bag votes can be taken once all trees are grown.
+	const LNKSize maskWordCount = (totalExampleCount + 63) / 64;
+	uint64_t *const inBagMasks = calloc(_treeCount * maskWordCount, sizeof(uint64_t));
+
+	// Trees only read the shared matrix, so they can be grown in parallel.
+	LNKExecutorApply(LNKExecutorGetShared(), LNKRangeMake(0, _treeCount), 1, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(threadIndex)
+		uint32_t *multiplicities = malloc(totalExampleCount * sizeof(uint32_t));
+		LNKSize *exampleIndices = malloc(exampleCount * sizeof(LNKSize));
+		LNKSize *columnIndices = malloc(totalFeatureCount * sizeof(LNKSize));
+
+		for (LNKSize index = range.location; index < range.location + range.length; index++) {
+			uint64_t state = _LNKMixBits(seed ^ _LNKMixBits(index + 1));
+			uint64_t *const inBagMask = inBagMasks + index * maskWordCount;
+
+			// Bootstrap by counting how often each example is drawn, which yields the examples in order
+			// and tells apart those left out of the bag.
+			memset(multiplicities, 0, totalExampleCount * sizeof(uint32_t));
+
+			for (LNKSize draw = 0; draw < exampleCount; draw++) {
+				multiplicities[_LNKRandomIndex(&state, totalExampleCount)]++;
+			}
+
+			LNKSize drawnExampleCount = 0;
+
+			for (LNKSize example = 0; example < totalExampleCount; example++) {
+				if (multiplicities[example]) {
+					inBagMask[example / 64] |= 1ULL << (example % 64);
+				}
+
+				for (uint32_t copy = 0; copy < multiplicities[example]; copy++) {
+					exampleIndices[drawnExampleCount++] = example;
+				}
+			}
+
+			// Pick columns without replacement with a partial Fisher-Yates shuffle, then restore their order for the tree.
+			for (LNKSize column = 0; column < totalFeatureCount; column++) {
+				columnIndices[column] = column;
+			}
+
+			for (LNKSize column = 0; column < featureCount; column++) {
+				const LNKSize otherColumn = column + _LNKRandomIndex(&state, totalFeatureCount - column);
+				const LNKSize temporary = columnIndices[column];
+				columnIndices[column] = columnIndices[otherColumn];
+				columnIndices[otherColumn] = temporary;
+			}
+
+			qsort(columnIndices, featureCount, sizeof(LNKSize), _LNKCompareSizes);
+
+			trees[index] = LNKDecisionTreeCreate(store, outputVector, classCount, exampleIndices, drawnExampleCount, columnIndices, featureCount);
+		}
+
+		free(columnIndices);
+		free(exampleIndices);
+		free(multiplicities);
+	});
+
+	const LNKSize treeCount = _treeCount;
+
+	// Every example gets a vote from each tree that didn't draw it; counts[0] tallies the examples that got any vote
+	// and counts[1] those whose most voted class is wrong.
+	LNKSize counts[2];
+	LNKExecutorCount(LNKExecutorGetShared(), LNKRangeMake(0, totalExampleCount), 0, counts, 2, ^(LNKRange range, LNKSize *counters) {
+		LNKSize *const votes = malloc(classCount * sizeof(LNKSize));
+
+		for (LNKSize example = range.location; example < range.location + range.length; example++) {
+			memset(votes, 0, classCount * sizeof(LNKSize));
+			LNKSize voteCount = 0;
+
+			for (LNKSize index = 0; index < treeCount; index++) {
+				if (inBagMasks[index * maskWordCount + example / 64] & (1ULL << (example % 64))) {
+					continue;
+				}
+
+				const LNKSize classIndex = LNKDecisionTreePredict(trees[index], matrixBuffer + example * totalFeatureCount);
+
+				if (classIndex != LNKSizeMax) {
+					votes[classIndex]++;
+					voteCount++;
+				}
+			}
+
+			if (voteCount == 0) {
+				continue;
+			}
+
+			LNKSize mostVotedClass = 0;
+
+			for (LNKSize class = 1; class < classCount; class++) {
+				if (votes[class] > votes[mostVotedClass]) {
+					mostVotedClass = class;
+				}
+			}
+
+			counters[0]++;
+
+			if (mostVotedClass != (LNKSize)outputVector[example]) {
+				counters[1]++;
+			}
+		}
+
+		free(votes);
+	});
+
+	_outOfBagError = counts[0] ? (LNKFloat)counts[1] / counts[0] : NAN;
+
+	free(inBagMasks);
+	LNKDecisionTreeFeatureStoreFree(store);
+
+	// Only the packed copies of the trees are needed for predictions.
+	_forest = LNKDecisionForestCreate(trees, _treeCount, classCount);
 
 	for (LNKSize index = 0; index < _treeCount; index++) {
-		NSIndexSet *const exampleIndices = [[NSIndexSet withCount:totalExampleCount] indexSetByRandomlySamplingTo:exampleCount];
-		NSIndexSet *const columnIndices = [[NSIndexSet withCount:totalFeatureCount] indexSetByRandomlySamplingTo:featureCount];
+		LNKDecisionTreeFree(trees[index]);
+	}
 
-		LNKDecisionTreeClassifier *const classifier = [[LNKDecisionTreeClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:self.classes examplesIndices:exampleIndices columnIndices:columnIndices];
-		[newTrees addObject:classifier];
-		[classifier release];
+	free(trees);
+}
+
+- (void)_validatePredictionMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (matrix.columnCount != self.matrix.columnCount) {
+		[NSException raise:NSInvalidArgumentException format:@"The matrix's column count should match that of the training matrix"];
+	}
 
-		[classifier _setColumnsToPossibleValues:_columnsToPossibleValues];
-		[classifier train];
+	if (!outputBuffer) {
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
 	}
 
-	_trees = [newTrees copy];
-	[newTrees release];
+	if (!_forest) {
+		[NSException raise:NSGenericException format:@"The classifier must be trained before making predictions"];
+	}
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
-	if (_trees == nil) {
-		return nil;
+- (void)predictVoteCountsForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _validatePredictionMatrix:matrix outputBuffer:outputBuffer];
+	LNKDecisionForestPredictVotes(_forest, matrix.matrixBuffer, matrix.rowCount, matrix.columnCount, outputBuffer);
+}
+
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self _validatePredictionMatrix:matrix outputBuffer:outputBuffer];
+	LNKDecisionForestPredictProbabilities(_forest, matrix.matrixBuffer, matrix.rowCount, matrix.columnCount, outputBuffer);
+}
+
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+	if (!featureVector.data) {
+		[NSException raise:NSInvalidArgumentException format:@"The feature vector must contain data"];
 	}
 
-	NSCountedSet<LNKClass *> *classes = [[NSCountedSet alloc] initWithCapacity:(NSUInteger)_treeCount];
-	for (LNKDecisionTreeClassifier *tree in _trees) {
-		id value = [tree predictValueForFeatureVector:featureVector];
-		if (![value isKindOfClass:[LNKClass class]]) {
-			continue;
-		}
-		[classes addObject:(LNKClass *)value];
+	if (featureVector.length != self.matrix.columnCount) {
+		[NSException raise:NSInvalidArgumentException format:@"The feature vector's length should match the matrix's column count"];
+	}
+
+	if (_forest == NULL) {
+		return NO;
 	}
 
-	LNKClass *const mostFrequentClass = classes.mostFrequentObject;
-	NSAssert(mostFrequentClass != nil, @"There should be a most frequent class always");
+	LNKDecisionForestPredictProbabilities(_forest, featureVector.data, 1, featureVector.length, outProbabilities);
 
-	[classes release];
+	// The probabilities sum to 0 if no tree voted.
+	LNKFloat probabilitySum;
+	LNK_vsum(outProbabilities, UNIT_STRIDE, &probabilitySum, self.classes.count);
 
-	return mostFrequentClass;
+	return probabilitySum > 0;
 }
 
 @end
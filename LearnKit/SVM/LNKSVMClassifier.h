@@ -15,6 +15,8 @@ NS_ASSUME_NONNULL_BEGIN
 /// The only supported optimization algorithm is stochastic gradient descent.
 /// An SVM may perform better if the input matrix (and feature vectors) are normalized.
 /// The output classes must currently be -1 and 1.
+/// Predicted values are NSNumbers holding the signed scores of feature vectors, while predicted class indices are 1 for
+/// positive scores and 0 otherwise.
 /// A bias column is added to the matrix automatically.
 @interface LNKSVMClassifier : LNKClassifier
 
@@ -128,7 +128,7 @@
 	return cost;
 }
 
-- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+- (LNKFloat)_scoreForFeatureVector:(LNKVector)featureVector {
 	if (!featureVector.data)
 		[NSException raise:NSInvalidArgumentException format:@"The feature vector must not be NULL"];
 	
@@ -139,35 +139,75 @@
 		[NSException raise:NSInvalidArgumentException format:@"The length of the feature vector must match the number of columns in the training matrix"];
 	}
 
-	LNKFloat *featuresWithBias = LNKFloatAlloc(featureVector.length + biasOffset);
-	featuresWithBias[0] = 1;
-	LNKFloatCopy(featuresWithBias + biasOffset, featureVector.data, featureVector.length);
-	
+	// theta . (1, x)
 	LNKFloat result;
-	LNK_dotpr(featuresWithBias, UNIT_STRIDE, _theta, UNIT_STRIDE, &result, columnCount + biasOffset);
+	LNK_dotpr(_theta + biasOffset, UNIT_STRIDE, featureVector.data, UNIT_STRIDE, &result, featureVector.length);
+	
+	return result + _theta[0];
+}
+
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+	const BOOL isPositive = [self _scoreForFeatureVector:featureVector] > 0;
+	outProbabilities[0] = isPositive ? 0 : 1;
+	outProbabilities[1] = isPositive ? 1 : 0;
+	
+	return YES;
+}
+
+- (id)predictValueForFeatureVector:(LNKVector)featureVector {
+	return @([self _scoreForFeatureVector:featureVector]);
+}
+
+- (void)predictValuesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	if (!matrix)
+		[NSException raise:NSInvalidArgumentException format:@"The matrix must not be nil"];
+	
+	if (!outputBuffer)
+		[NSException raise:NSInvalidArgumentException format:@"The output buffer must not be NULL"];
+	
+	const LNKSize biasOffset = 1;
+	
+	if (matrix.hasBiasColumn || matrix.columnCount + biasOffset != self.matrix.columnCount)
+		[NSException raise:NSInvalidArgumentException format:@"The columns of the matrix are incompatible with the training matrix"];
+	
+	const LNKSize rowCount = matrix.rowCount;
+	
+	if (!rowCount)
+		return;
+	
+	// X . theta as a single matrix-vector product, adding the bias separately.
+	LNK_mmul(matrix.matrixBuffer, UNIT_STRIDE, _theta + biasOffset, UNIT_STRIDE, outputBuffer, UNIT_STRIDE, rowCount, 1, matrix.columnCount);
+	LNK_vsadd(outputBuffer, UNIT_STRIDE, _theta, outputBuffer, UNIT_STRIDE, rowCount);
+}
 
-	free(featuresWithBias);
+- (void)predictProbabilitiesForMatrix:(LNKMatrix *)matrix outputBuffer:(LNKFloat *)outputBuffer {
+	[self predictValuesForMatrix:matrix outputBuffer:outputBuffer];
 	
-	return @(result);
+	// Expand the scores in place, starting from the last row so none is overwritten before it's read.
+	for (LNKSize row = matrix.rowCount; row-- > 0;) {
+		const BOOL isPositive = outputBuffer[row] > 0;
+		outputBuffer[2 * row] = isPositive ? 0 : 1;
+		outputBuffer[2 * row + 1] = isPositive ? 1 : 0;
+	}
 }
 
 - (LNKFloat)computeClassificationAccuracyOnMatrix:(LNKMatrix *)matrix {
 	const LNKSize rowCount = matrix.rowCount;
-	const LNKSize columnCount = matrix.columnCount;
 	const LNKFloat *outputVector = matrix.outputVector;
 	
+	// The outputs are -1 and 1 rather than class values, so scores are compared with them directly.
+	LNKFloat *scores = LNKFloatAlloc(rowCount);
+	[self predictValuesForMatrix:matrix outputBuffer:scores];
+	
 	LNKSize hits = 0;
 	
 	for (LNKSize m = 0; m < rowCount; m++) {
-		id predictedValue = [self predictValueForFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:m], columnCount)];
-		NSAssert([predictedValue isKindOfClass:[NSNumber class]], @"Unexpected value");
-		
-		const LNKFloat value = [predictedValue LNKFloatValue];
-		
-		if (value * outputVector[m] > 0)
+		if (scores[m] * outputVector[m] > 0)
 			hits++;
 	}
 	
+	free(scores);
+	
 	return (LNKFloat)hits / rowCount;
 }
 
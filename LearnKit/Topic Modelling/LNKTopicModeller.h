@@ -23,6 +23,8 @@ NS_ASSUME_NONNULL_BEGIN
 @interface LNKTopicModeller : NSOperation
 
 /// The document matrix contains documents as row vectors represented as word counts for words in the vocabulary.
+/// Most documents only use a small part of the vocabulary, so it is typically loaded as an `LNKSparseMatrix`,
+/// in which case each iteration takes time proportional to the number of non-zero word counts.
 - (instancetype)initWithDocumentMatrix:(LNKMatrix *)documentMatrix vocabulary:(NSArray<NSString *> *)vocabulary topicCount:(LNKSize)topicCount delegate:(id<LNKTopicModellerDelegate>)delegate;
 
 @end
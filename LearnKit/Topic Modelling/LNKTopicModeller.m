@@ -10,6 +10,7 @@
 
 #import "LNKAccelerate.h"
 #import "LNKMatrix.h"
+#import "LNKSparseMatrix.h"
 
 @implementation LNKTopicSet {
 	NSMutableArray<NSMutableArray<NSString *> *> *_topics;
@@ -83,10 +84,17 @@ typedef struct {
 	LNKFloat frequency;
 } Word;
 
+/// Computes the logarithm of the topic distributions `p` into `logP`, and its transpose into `logPT`.
+static void _LNKComputeLogDistributions(const LNKFloat *p, LNKFloat *logP, LNKFloat *logPT, LNKSize topicCount, LNKSize wordCount) {
+	const int valueCount = (int)(topicCount * wordCount);
+	LNK_vlog(logP, p, &valueCount);
+	LNK_mtrans(logP, logPT, wordCount, topicCount);
+}
+
 - (void)main {
-	const LNKSize wordCount = _documentMatrix.columnCount;
-	const LNKSize documentCount = _documentMatrix.rowCount;
-	const LNKFloat *const matrixBuffer = _documentMatrix.matrixBuffer;
+	LNKMatrix *const documentMatrix = _documentMatrix;
+	const LNKSize wordCount = documentMatrix.columnCount;
+	const LNKSize documentCount = documentMatrix.rowCount;
 
 	// Stores the topic weights.
 	LNKFloat *const pi = LNKFloatAlloc(_topicCount);
@@ -103,73 +111,90 @@ typedef struct {
 		const LNKSize row = (LNKSize)arc4random_uniform((uint32_t)documentCount);
 
 		LNKFloat *const pRow = &p[topic * wordCount];
-		const LNKFloat *const matrixRow = &matrixBuffer[row * wordCount];
+
+		if (documentMatrix.sparse) {
+			LNKSparseMatrix *const sparseMatrix = (LNKSparseMatrix *)documentMatrix;
+			const LNKSize *const rowPointers = sparseMatrix.rowPointers;
+			LNK_vclr(pRow, UNIT_STRIDE, wordCount);
+
+			for (LNKSize index = rowPointers[row]; index < rowPointers[row + 1]; index++)
+				pRow[sparseMatrix.columnIndices[index]] = sparseMatrix.values[index];
+		}
+		else {
+			LNKFloatCopy(pRow, [documentMatrix rowAtIndex:row], wordCount);
+		}
 
 		LNKFloat additiveSmoothing = 1.0 / wordCount;
-		LNK_vsadd(matrixRow, UNIT_STRIDE, &additiveSmoothing, pRow, UNIT_STRIDE, wordCount);
+		LNK_vsadd(pRow, UNIT_STRIDE, &additiveSmoothing, pRow, UNIT_STRIDE, wordCount);
 
 		LNKFloat normalizer = 0;
 		LNK_vsum(pRow, UNIT_STRIDE, &normalizer, wordCount);
 		LNK_vsdiv(pRow, UNIT_STRIDE, &normalizer, pRow, UNIT_STRIDE, wordCount);
 	}
 
+	// The document matrix is only ever multiplied by dense matrices, so sparse document matrices are never densified.
+	LNKFloat *const ones = LNKFloatAlloc(MAX(documentCount, wordCount));
+	const LNKFloat one = 1;
+	LNK_vfill(&one, ones, UNIT_STRIDE, MAX(documentCount, wordCount));
+
+	// The number of words in every document, and the number of times every word occurs across all documents.
+	LNKFloat *const documentLengths = LNKFloatAlloc(documentCount);
+	LNKFloat *const wordTotals = LNKFloatAlloc(wordCount);
+	[documentMatrix multiplyByBuffer:ones columnCount:1 outputBuffer:documentLengths];
+	[documentMatrix multiplyTransposeByBuffer:ones columnCount:1 outputBuffer:wordTotals];
+	free(ones);
+
 	LNKFloat previousLikelihood = LNKFloatMax;
 	LNKFloat currentLikelihood = LNKFloatMax;
 	LNKSize iteration = 0;
 
 	const int topicCountInt = (int)_topicCount;
-	const int wordCountInt = (int)wordCount;
-	LNKFloat *const logWorkspace = LNKFloatAlloc(wordCount);
-	LNKFloat *const sums = LNKFloatCalloc(wordCount);
-	LNKFloat *const Alog = LNKFloatAlloc(_topicCount);
-	LNKFloat *const wlog = LNKFloatAlloc(_topicCount);
+	LNKFloat *const logP = LNKFloatAlloc(_topicCount * wordCount);
+	LNKFloat *const logPT = LNKFloatAlloc(wordCount * _topicCount);
+	LNKFloat *const logPi = LNKFloatAlloc(_topicCount);
+	LNKFloat *const W = LNKFloatAlloc(documentCount * _topicCount);
+	LNKFloat *const wordTopicWeights = LNKFloatAlloc(wordCount * _topicCount);
+	LNKFloat *const weightSums = LNKFloatAlloc(_topicCount);
+	LNKFloat *const bottoms = LNKFloatAlloc(_topicCount);
+
+	// The logarithms of the distributions are shared by the likelihood of one iteration and the weights of the next.
+	_LNKComputeLogDistributions(p, logP, logPT, _topicCount, wordCount);
 
 	while (iteration < 2 || LNK_fabs(previousLikelihood - currentLikelihood) > 1000) {
-		LNKFloat *const W = LNKFloatCalloc(documentCount * _topicCount);
+		// Compute W: the log-likelihood of every document under every topic is X . log(p)' + log(pi), normalized per document.
+		[documentMatrix multiplyByBuffer:logPT columnCount:_topicCount outputBuffer:W];
+		LNK_vlog(logPi, pi, &topicCountInt);
 
-		// Compute W
 		for (LNKSize docIndex = 0; docIndex < documentCount; docIndex++) {
-			for (LNKSize topic = 0; topic < _topicCount; topic++) {
-				Alog[topic] = LNKLog(pi[topic]);
-
-				LNK_vlog(logWorkspace, &p[topic * wordCount], &wordCountInt);
-
-				LNKFloat localSum = 0;
-				LNK_dotpr(&matrixBuffer[docIndex * wordCount], UNIT_STRIDE, logWorkspace, UNIT_STRIDE, &localSum, wordCount);
-				Alog[topic] += localSum;
-			}
+			LNKFloat *const Alog = &W[docIndex * _topicCount];
+			LNK_vadd(Alog, UNIT_STRIDE, logPi, UNIT_STRIDE, Alog, UNIT_STRIDE, _topicCount);
 
 			const LNKFloat logSum = LNK_vlogsumexp(Alog, _topicCount);
 
 			LNKFloat negativeLogSum = -logSum;
-			LNK_vsadd(Alog, UNIT_STRIDE, &negativeLogSum, wlog, UNIT_STRIDE, _topicCount);
-
-			LNK_vexp(wlog, wlog, &topicCountInt);
-			LNKFloatCopy(&W[docIndex * _topicCount], wlog, _topicCount);
+			LNK_vsadd(Alog, UNIT_STRIDE, &negativeLogSum, Alog, UNIT_STRIDE, _topicCount);
+			LNK_vexp(Alog, Alog, &topicCountInt);
 		}
 
-		for (LNKSize topic = 0; topic < _topicCount; topic++) {
-			LNKFloat weightSum = 0;
-			LNKFloat bottom = 0;
-
-			for (LNKSize i = 0; i < documentCount; i++) {
-				weightSum += W[i * _topicCount + topic];
+		// The word counts of every topic, X' . W, are gathered in a single product.
+		[documentMatrix multiplyTransposeByBuffer:W columnCount:_topicCount outputBuffer:wordTopicWeights];
 
-				LNKFloat rowSum = 0;
-				LNK_vsum(&matrixBuffer[i * wordCount], UNIT_STRIDE, &rowSum, wordCount);
-				bottom += rowSum * W[i * _topicCount + topic];
-			}
+		LNK_vclr(weightSums, UNIT_STRIDE, _topicCount);
+		LNK_vclr(bottoms, UNIT_STRIDE, _topicCount);
 
-			LNK_vclr(sums, UNIT_STRIDE, wordCount);
+		for (LNKSize i = 0; i < documentCount; i++) {
+			const LNKFloat *const weights = &W[i * _topicCount];
+			LNK_vadd(weightSums, UNIT_STRIDE, weights, UNIT_STRIDE, weightSums, UNIT_STRIDE, _topicCount);
+			LNK_vsma(weights, UNIT_STRIDE, &documentLengths[i], bottoms, UNIT_STRIDE, bottoms, UNIT_STRIDE, _topicCount);
+		}
 
-			for (LNKSize i = 0; i < documentCount; i++) {
-				const LNKFloat weight = W[i * _topicCount + topic];
-				LNK_vsma(&matrixBuffer[i * wordCount], UNIT_STRIDE, &weight, sums, UNIT_STRIDE, sums, UNIT_STRIDE, wordCount);
-			}
+		LNK_mtrans(wordTopicWeights, p, _topicCount, wordCount);
 
-			LNK_vsdiv(sums, UNIT_STRIDE, &bottom, &p[topic * wordCount], UNIT_STRIDE, wordCount);
+		for (LNKSize topic = 0; topic < _topicCount; topic++) {
+			LNKFloat *const pRow = &p[topic * wordCount];
+			LNK_vsdiv(pRow, UNIT_STRIDE, &bottoms[topic], pRow, UNIT_STRIDE, wordCount);
 
-			pi[topic] = weightSum / documentCount;
+			pi[topic] = weightSums[topic] / documentCount;
 		}
 
 		// Re-smooth
@@ -184,28 +209,31 @@ typedef struct {
 			LNK_vsdiv(pRow, UNIT_STRIDE, &normalizer, pRow, UNIT_STRIDE, wordCount);
 		}
 
+		_LNKComputeLogDistributions(p, logP, logPT, _topicCount, wordCount);
+
+		// The sum over documents and topics of log(pi) + X . log(p)' only depends on the number of times every word occurs.
 		previousLikelihood = currentLikelihood;
 		currentLikelihood = 0;
 
-		for (LNKSize docIndex = 0; docIndex < documentCount; docIndex++) {
-			for (LNKSize topic = 0; topic < _topicCount; topic++) {
-				LNKFloat sumK = 0;
-				LNK_vlog(logWorkspace, &p[topic * wordCount], &wordCountInt);
-				LNK_dotpr(&matrixBuffer[docIndex * wordCount], UNIT_STRIDE, logWorkspace, UNIT_STRIDE, &sumK, wordCount);
-				currentLikelihood += LNKLog(pi[topic]) + sumK;
-			}
+		for (LNKSize topic = 0; topic < _topicCount; topic++) {
+			LNKFloat sumK = 0;
+			LNK_dotpr(wordTotals, UNIT_STRIDE, &logP[topic * wordCount], UNIT_STRIDE, &sumK, wordCount);
+			currentLikelihood += documentCount * LNKLog(pi[topic]) + sumK;
 		}
 
 		iteration += 1;
-
-		free(W);
 	}
 
 	free(pi);
-	free(logWorkspace);
-	free(sums);
-	free(Alog);
-	free(wlog);
+	free(documentLengths);
+	free(wordTotals);
+	free(logP);
+	free(logPT);
+	free(logPi);
+	free(W);
+	free(wordTopicWeights);
+	free(weightSums);
+	free(bottoms);
 
 	LNKTopicSet *const topicSet = [[LNKTopicSet alloc] initWithTopics:_topicCount];
 
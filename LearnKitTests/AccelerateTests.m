@@ -48,4 +48,284 @@
 	XCTAssertEqualWithAccuracy(result[2], 2, DACCURACY);
 }
 
+#define XCTAssertVectorsEqualWithAccuracy(expected, actual, length, accuracy, description) \
+	for (LNKSize index = 0; index < (length); index++) { \
+		XCTAssertEqualWithAccuracy((expected)[index], (actual)[index], (accuracy), @"%@ at index %llu", (description), index); \
+	}
+
+/// Checks the portable kernels against values computed element by element, so they're covered without Accelerate too.
+- (void)testPortableKernelsMatchReferenceValues {
+	const LNKSize n = 1027;
+	LNKFloat *a = LNKFloatAlloc(n);
+	LNKFloat *b = LNKFloatAlloc(n);
+	LNKFloat *expected = LNKFloatAlloc(n);
+	LNKFloat *actual = LNKFloatAlloc(n);
+	
+	for (LNKSize i = 0; i < n; i++) {
+		a[i] = (LNKFloat)arc4random_uniform(1000) / 100 + 1;
+		b[i] = (LNKFloat)arc4random_uniform(1000) / 100 + 1;
+	}
+	
+	LNKPortable_vadd(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, n);
+	for (LNKSize i = 0; i < n; i++)
+		expected[i] = a[i] + b[i];
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Invalid vadd");
+	
+	// vDSP subtracts the first vector from the second.
+	LNKPortable_vsub(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, n);
+	for (LNKSize i = 0; i < n; i++)
+		expected[i] = b[i] - a[i];
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Invalid vsub");
+	
+	// vDSP divides the second vector by the first.
+	LNKPortable_vdiv(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, n);
+	for (LNKSize i = 0; i < n; i++)
+		expected[i] = b[i] / a[i];
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Invalid vdiv");
+	
+	LNKFloat expectedScalar = 0, actualScalar;
+	LNKPortable_dotpr(a, UNIT_STRIDE, b, UNIT_STRIDE, &actualScalar, n);
+	for (LNKSize i = 0; i < n; i++)
+		expectedScalar += a[i] * b[i];
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Invalid dotpr");
+	
+	expectedScalar = 0;
+	LNKPortable_vsum(a, 3, &actualScalar, n / 3);
+	for (LNKSize i = 0; i < n / 3; i++)
+		expectedScalar += a[i * 3];
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Invalid strided vsum");
+	
+	expectedScalar = 0;
+	LNKPortable_distancesq(a, UNIT_STRIDE, b, UNIT_STRIDE, &actualScalar, n);
+	for (LNKSize i = 0; i < n; i++)
+		expectedScalar += (a[i] - b[i]) * (a[i] - b[i]);
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Invalid distance");
+	
+	const int intLength = (int)n;
+	LNKPortable_vlog(actual, a, &intLength);
+	for (LNKSize i = 0; i < n; i++)
+		expected[i] = log(a[i]);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Invalid vlog");
+	
+	LNKPortable_vexp(actual, a, &intLength);
+	for (LNKSize i = 0; i < n; i++)
+		expected[i] = exp(a[i]);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, expected[index] * 1e-10, @"Invalid vexp");
+	
+	// The exponent is shared by every element.
+	LNKPortable_vpows(actual, 2, a, n);
+	LNK_vpows(b, 2, a, n);
+	for (LNKSize i = 0; i < n; i++)
+		expected[i] = a[i] * a[i];
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Invalid vpows");
+	XCTAssertVectorsEqualWithAccuracy(expected, b, n, DACCURACY, @"Invalid vpows");
+	
+	for (LNKSize i = 0; i < n; i++)
+		b[i] = (LNKFloat)arc4random_uniform(1000) / 100 + 1;
+	
+	// (13 x 79) * (79 x 13)
+	const LNKSize rows = 13, inner = 79;
+	LNKPortable_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, rows, rows, inner);
+	for (LNKSize row = 0; row < rows; row++) {
+		for (LNKSize column = 0; column < rows; column++) {
+			expected[row * rows + column] = 0;
+			
+			for (LNKSize k = 0; k < inner; k++)
+				expected[row * rows + column] += a[row * inner + k] * b[k * rows + column];
+		}
+	}
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, rows * rows, DACCURACY, @"Invalid mmul");
+	
+	LNKPortable_mtrans(a, UNIT_STRIDE, actual, UNIT_STRIDE, rows, inner);
+	for (LNKSize row = 0; row < rows; row++) {
+		for (LNKSize column = 0; column < inner; column++)
+			expected[row * inner + column] = a[column * rows + row];
+	}
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, rows * inner, 0, @"Invalid mtrans");
+	
+	// (79 x 13)' * (79 x 13)
+	LNK_mmultrans(a, a, actual, rows, rows, inner);
+	for (LNKSize row = 0; row < rows; row++) {
+		for (LNKSize column = 0; column < rows; column++) {
+			expected[row * rows + column] = 0;
+			
+			for (LNKSize k = 0; k < inner; k++)
+				expected[row * rows + column] += a[k * rows + row] * a[k * rows + column];
+		}
+	}
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, rows * rows, DACCURACY, @"Invalid mmultrans");
+	
+	free(a);
+	free(b);
+	free(expected);
+	free(actual);
+}
+
+#if USE_ACCELERATE
+/// Without Accelerate, the LNK_* kernels are the portable ones, so this only means something with it.
+- (void)testPortableKernelsMatchAccelerate {
+	const LNKSize n = 1027;
+	LNKFloat *a = LNKFloatAlloc(n);
+	LNKFloat *b = LNKFloatAlloc(n);
+	LNKFloat *expected = LNKFloatAlloc(n);
+	LNKFloat *actual = LNKFloatAlloc(n);
+	
+	for (LNKSize i = 0; i < n; i++) {
+		a[i] = (LNKFloat)arc4random_uniform(1000) / 100 + 1;
+		b[i] = (LNKFloat)arc4random_uniform(1000) / 100 + 1;
+	}
+	
+	LNK_vadd(a, UNIT_STRIDE, b, UNIT_STRIDE, expected, UNIT_STRIDE, n);
+	LNKPortable_vadd(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, n);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Mismatched vadd");
+	
+	LNK_vsub(a, UNIT_STRIDE, b, UNIT_STRIDE, expected, UNIT_STRIDE, n);
+	LNKPortable_vsub(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, n);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Mismatched vsub");
+	
+	LNK_vdiv(a, UNIT_STRIDE, b, UNIT_STRIDE, expected, UNIT_STRIDE, n);
+	LNKPortable_vdiv(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, n);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Mismatched vdiv");
+	
+	LNKFloat expectedScalar, actualScalar;
+	LNK_dotpr(a, UNIT_STRIDE, b, UNIT_STRIDE, &expectedScalar, n);
+	LNKPortable_dotpr(a, UNIT_STRIDE, b, UNIT_STRIDE, &actualScalar, n);
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Mismatched dotpr");
+	
+	LNK_vsum(a, 3, &expectedScalar, n / 3);
+	LNKPortable_vsum(a, 3, &actualScalar, n / 3);
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Mismatched strided vsum");
+	
+	LNKVectorDistance(a, b, &expectedScalar, n);
+	LNKPortable_distancesq(a, UNIT_STRIDE, b, UNIT_STRIDE, &actualScalar, n);
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Mismatched distance");
+	
+	const int intLength = (int)n;
+	LNK_vlog(expected, a, &intLength);
+	LNKPortable_vlog(actual, a, &intLength);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Mismatched vlog");
+	
+	LNK_vexp(expected, a, &intLength);
+	LNKPortable_vexp(actual, a, &intLength);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, expected[index] * 1e-10, @"Mismatched vexp");
+	
+	// The exponent is shared by every element.
+	LNK_vpows(expected, 2, a, n);
+	LNKPortable_vpows(actual, 2, a, n);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, n, DACCURACY, @"Mismatched vpows");
+	
+	// (1 x 1027) * (1027 x 1)
+	LNK_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, &expectedScalar, UNIT_STRIDE, 1, 1, n);
+	LNKPortable_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, &actualScalar, UNIT_STRIDE, 1, 1, n);
+	XCTAssertEqualWithAccuracy(expectedScalar, actualScalar, DACCURACY, @"Mismatched mmul");
+	
+	// (13 x 79) * (79 x 13)
+	const LNKSize rows = 13, inner = 79;
+	LNK_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, expected, UNIT_STRIDE, rows, rows, inner);
+	LNKPortable_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, actual, UNIT_STRIDE, rows, rows, inner);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, rows * rows, DACCURACY, @"Mismatched mmul");
+	
+	LNK_mtrans(a, expected, rows, inner);
+	LNKPortable_mtrans(a, UNIT_STRIDE, actual, UNIT_STRIDE, rows, inner);
+	XCTAssertVectorsEqualWithAccuracy(expected, actual, rows * inner, 0, @"Mismatched mtrans");
+	
+	free(a);
+	free(b);
+	free(expected);
+	free(actual);
+}
+#endif
+
+- (void)testPortableInversion {
+	LNKFloat matrix[4] = { 4, 7,
+	                       2, 6 };
+	XCTAssertTrue(LNK_minvert(matrix, 2));
+	
+	XCTAssertEqualWithAccuracy(matrix[0], 0.6, DACCURACY);
+	XCTAssertEqualWithAccuracy(matrix[1], -0.7, DACCURACY);
+	XCTAssertEqualWithAccuracy(matrix[2], -0.2, DACCURACY);
+	XCTAssertEqualWithAccuracy(matrix[3], 0.4, DACCURACY);
+	
+	LNKFloat singular[4] = { 1, 2,
+	                         2, 4 };
+	XCTAssertFalse(LNK_minvert(singular, 2));
+}
+
+/* Kernel benchmarks: the portable kernels, and with Accelerate, the `LNK_*` kernels they stand in for on the same data.
+   Without Accelerate the `LNK_*` kernels are the portable ones, so their benchmarks are left out. */
+
+#define BENCHMARK_LENGTH 1000000
+#define BENCHMARK_MATRIX_DIM 256
+#define BENCHMARK_ITERATIONS 20
+
+static LNKFloat *_randomBuffer(LNKSize length) {
+	LNKFloat *buffer = LNKFloatAlloc(length);
+	
+	for (LNKSize i = 0; i < length; i++)
+		buffer[i] = (LNKFloat)arc4random_uniform(1000) / 1000 + 0.5;
+	
+	return buffer;
+}
+
+#define BENCHMARK_VECTOR_KERNEL(name, kernel) \
+	- (void)name { \
+		LNKFloat *a = _randomBuffer(BENCHMARK_LENGTH); \
+		LNKFloat *b = _randomBuffer(BENCHMARK_LENGTH); \
+		LNKFloat *c = LNKFloatAlloc(BENCHMARK_LENGTH); \
+		const LNKSize n = BENCHMARK_LENGTH; \
+		const int intLength = BENCHMARK_LENGTH; \
+		LNKFloat scalar = 0.5; \
+		_Pragma("unused(intLength, scalar)") \
+		[self measureBlock:^{ \
+			for (int iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) { \
+				LNKFloat result = 0; \
+				_Pragma("unused(result)") \
+				kernel; \
+			} \
+		}]; \
+		free(a); \
+		free(b); \
+		free(c); \
+	}
+
+BENCHMARK_VECTOR_KERNEL(testBenchmarkPortableVectorAdd, LNKPortable_vadd(a, UNIT_STRIDE, b, UNIT_STRIDE, c, UNIT_STRIDE, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkPortableVectorScalarMultiplyAdd, LNKPortable_vsma(a, UNIT_STRIDE, &scalar, b, UNIT_STRIDE, c, UNIT_STRIDE, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkPortableDotProduct, LNKPortable_dotpr(a, UNIT_STRIDE, b, UNIT_STRIDE, &result, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkPortableSum, LNKPortable_vsum(a, UNIT_STRIDE, &result, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkPortableDistance, LNKPortable_distancesq(a, UNIT_STRIDE, b, UNIT_STRIDE, &result, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkPortableExp, LNKPortable_vexp(c, a, &intLength))
+
+#if USE_ACCELERATE
+BENCHMARK_VECTOR_KERNEL(testBenchmarkAccelerateVectorAdd, LNK_vadd(a, UNIT_STRIDE, b, UNIT_STRIDE, c, UNIT_STRIDE, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkAccelerateVectorScalarMultiplyAdd, LNK_vsma(a, UNIT_STRIDE, &scalar, b, UNIT_STRIDE, c, UNIT_STRIDE, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkAccelerateDotProduct, LNK_dotpr(a, UNIT_STRIDE, b, UNIT_STRIDE, &result, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkAccelerateSum, LNK_vsum(a, UNIT_STRIDE, &result, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkAccelerateDistance, LNKVectorDistance(a, b, &result, n))
+BENCHMARK_VECTOR_KERNEL(testBenchmarkAccelerateExp, LNK_vexp(c, a, &intLength))
+#endif
+
+#define BENCHMARK_MATRIX_KERNEL(name, kernel) \
+	- (void)name { \
+		const LNKSize n = BENCHMARK_MATRIX_DIM; \
+		LNKFloat *a = _randomBuffer(n * n); \
+		LNKFloat *b = _randomBuffer(n * n); \
+		LNKFloat *c = LNKFloatAlloc(n * n); \
+		[self measureBlock:^{ \
+			for (int iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) { \
+				kernel; \
+			} \
+		}]; \
+		free(a); \
+		free(b); \
+		free(c); \
+	}
+
+BENCHMARK_MATRIX_KERNEL(testBenchmarkPortableMatrixMultiply, LNKPortable_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, c, UNIT_STRIDE, n, n, n))
+BENCHMARK_MATRIX_KERNEL(testBenchmarkPortableMatrixTranspose, LNKPortable_mtrans(a, UNIT_STRIDE, c, UNIT_STRIDE, n, n))
+
+#if USE_ACCELERATE
+BENCHMARK_MATRIX_KERNEL(testBenchmarkAccelerateMatrixMultiply, LNK_mmul(a, UNIT_STRIDE, b, UNIT_STRIDE, c, UNIT_STRIDE, n, n, n))
+BENCHMARK_MATRIX_KERNEL(testBenchmarkAccelerateMatrixTranspose, LNK_mtrans(a, c, n, n))
+#endif
+
 @end
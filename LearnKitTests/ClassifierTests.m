@@ -0,0 +1,86 @@
+//
+//  ClassifierTests.m
+//  LearnKit Tests
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <XCTest/XCTest.h>
+
+#import "LNKClassifierPrivate.h"
+#import "LNKMatrix.h"
+
+#define CLASS_COUNT	3
+
+/// Gives every class a probability of 0 for rows whose first column is negative, and class `row % CLASS_COUNT` a
+/// probability of 1 otherwise, where `row` is stored in the first column.
+@interface _LNKZeroProbabilityClassifier : LNKClassifier
+@end
+
+@implementation _LNKZeroProbabilityClassifier
+
+- (BOOL)_predictProbabilities:(LNKFloat *)outProbabilities forFeatureVector:(LNKVector)featureVector {
+	LNK_vclr(outProbabilities, UNIT_STRIDE, CLASS_COUNT);
+
+	if (featureVector.data[0] >= 0)
+		outProbabilities[(LNKSize)featureVector.data[0] % CLASS_COUNT] = 1;
+
+	return YES;
+}
+
+@end
+
+@interface ClassifierTests : XCTestCase
+@end
+
+@implementation ClassifierTests
+
+- (void)testAllZeroProbabilitiesPredictNoClass {
+	const LNKSize rowCount = 8;
+	LNKMatrix *matrix = [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:1 prepareBuffers:^BOOL(LNKFloat *matrixBuffer, LNKFloat *outputVector) {
+		for (LNKSize row = 0; row < rowCount; row++) {
+			matrixBuffer[row] = row % 2 ? -1 : row;
+			outputVector[row] = row % CLASS_COUNT;
+		}
+
+		return YES;
+	}];
+
+	LNKClassifier *classifier = [[_LNKZeroProbabilityClassifier alloc] initWithMatrix:matrix optimizationAlgorithm:nil classes:[LNKClasses withCount:CLASS_COUNT]];
+
+	LNKFloat *batchProbabilities = LNKFloatAlloc(rowCount * CLASS_COUNT);
+	LNKFloat *batchValues = LNKFloatAlloc(rowCount);
+	[classifier predictProbabilitiesForMatrix:matrix outputBuffer:batchProbabilities];
+	[classifier predictValuesForMatrix:matrix outputBuffer:batchValues];
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKVector featureVector = LNKVectorCreateUnsafe([matrix rowAtIndex:row], 1);
+		LNKFloat probabilities[CLASS_COUNT];
+		const LNKSize classIndex = [classifier predictClassIndexForFeatureVector:featureVector probabilities:probabilities];
+
+		for (LNKSize index = 0; index < CLASS_COUNT; index++)
+			XCTAssertEqual(probabilities[index], batchProbabilities[row * CLASS_COUNT + index]);
+
+		if (row % 2) {
+			XCTAssertEqual(classIndex, LNKSizeMax);
+			XCTAssertNil([classifier predictValueForFeatureVector:featureVector]);
+			XCTAssertTrue(isnan(batchValues[row]));
+		}
+		else {
+			XCTAssertEqual(classIndex, row % CLASS_COUNT);
+			XCTAssertEqualObjects([classifier predictValueForFeatureVector:featureVector], @(row % CLASS_COUNT));
+			XCTAssertEqual(batchValues[row], row % CLASS_COUNT);
+		}
+	}
+
+	// Rows with all-zero probabilities count as misses.
+	XCTAssertEqualWithAccuracy([classifier computeClassificationAccuracyOnMatrix:matrix], 0.5, DBL_EPSILON);
+
+	free(batchProbabilities);
+	free(batchValues);
+	[classifier release];
+	[matrix release];
+}
+
+@end
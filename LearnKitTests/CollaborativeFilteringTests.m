@@ -135,4 +135,82 @@
 	[predictor release];
 }
 
+#define MODEL_COUNT 4
+
+- (void)testConcurrentTraining {
+	const LNKSize movieCount = 1682;
+	const LNKSize userCount = 943;
+	const LNKSize featureCount = 10;
+	
+	const LNKSize reducedMovieCount = 200;
+	const LNKSize reducedUserCount = 100;
+	const LNKSize parameterCount = (reducedMovieCount + reducedUserCount) * featureCount;
+	
+	NSBundle *bundle = [NSBundle bundleForClass:[self class]];
+	NSURL *urlY = [bundle URLForResource:@"Movies_Y" withExtension:@"mat"];
+	NSURL *urlR = [bundle URLForResource:@"Movies_R" withExtension:@"mat"];
+	
+	LNKMatrix *indicatorMatrix = [[LNKMatrix alloc] initWithBinaryMatrixAtURL:urlR matrixValueType:LNKValueTypeDouble
+															outputVectorAtURL:nil outputVectorValueType:LNKValueTypeNone
+																	 rowCount:movieCount columnCount:userCount];
+	
+	LNKMatrix *outputMatrix = [[LNKMatrix alloc] initWithBinaryMatrixAtURL:urlY matrixValueType:LNKValueTypeDouble
+														 outputVectorAtURL:nil outputVectorValueType:LNKValueTypeNone
+																  rowCount:movieCount columnCount:userCount];
+	
+	// All models share one algorithm, so any state it keeps between calls would be clobbered.
+	LNKOptimizationAlgorithmCG *algorithm = [[LNKOptimizationAlgorithmCG alloc] init];
+	algorithm.iterationCount = 50;
+	
+	NSMutableArray<LNKCollaborativeFilteringPredictor *> *predictors = [[NSMutableArray alloc] init];
+	
+	for (LNKSize model = 0; model < MODEL_COUNT; model++) {
+		LNKCollaborativeFilteringPredictor *predictor = [[LNKCollaborativeFilteringPredictor alloc] initWithMatrix:[outputMatrix submatrixWithRowCount:reducedMovieCount columnCount:reducedUserCount]
+																								   indicatorMatrix:[indicatorMatrix submatrixWithRowCount:reducedMovieCount columnCount:reducedUserCount]
+																								implementationType:LNKImplementationTypeAccelerate
+																							 optimizationAlgorithm:algorithm
+																									  featureCount:featureCount];
+		predictor.regularizationConfiguration = [LNKRegularizationConfiguration withLambda:model + 1];
+		[predictors addObject:predictor];
+		[predictor release];
+	}
+	
+	[indicatorMatrix release];
+	[outputMatrix release];
+	
+	// Training starts from random parameters, so drive the algorithm directly from a fixed starting point instead.
+	LNKFloat *startingParameters = LNKFloatAlloc(parameterCount);
+	
+	for (LNKSize index = 0; index < parameterCount; index++)
+		startingParameters[index] = sin((LNKFloat)index);
+	
+	LNKFloat *sequentialParameters = LNKFloatAlloc(MODEL_COUNT * parameterCount);
+	LNKFloat *concurrentParameters = LNKFloatAlloc(MODEL_COUNT * parameterCount);
+	
+	for (LNKSize model = 0; model < MODEL_COUNT; model++) {
+		LNKFloat *parameters = sequentialParameters + model * parameterCount;
+		LNKFloatCopy(parameters, startingParameters, parameterCount);
+		[algorithm runWithParameterVector:LNKVectorCreateUnsafe(parameters, parameterCount) rowCount:reducedMovieCount delegate:predictors[model]];
+	}
+	
+	dispatch_apply(MODEL_COUNT, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t model) {
+		LNKFloat *parameters = concurrentParameters + model * parameterCount;
+		LNKFloatCopy(parameters, startingParameters, parameterCount);
+		[algorithm runWithParameterVector:LNKVectorCreateUnsafe(parameters, parameterCount) rowCount:reducedMovieCount delegate:predictors[model]];
+	});
+	
+	for (LNKSize model = 0; model < MODEL_COUNT; model++) {
+		XCTAssertEqual(memcmp(sequentialParameters + model * parameterCount, concurrentParameters + model * parameterCount, parameterCount * sizeof(LNKFloat)), 0, @"Model %llu trained differently on its own", model);
+	}
+	
+	// Different regularization must lead to different models, or the comparison above proves nothing.
+	XCTAssertNotEqual(memcmp(sequentialParameters, sequentialParameters + parameterCount, parameterCount * sizeof(LNKFloat)), 0);
+	
+	free(concurrentParameters);
+	free(sequentialParameters);
+	free(startingParameters);
+	[predictors release];
+	[algorithm release];
+}
+
 @end
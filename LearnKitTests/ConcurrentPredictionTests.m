@@ -0,0 +1,194 @@
+//
+//  ConcurrentPredictionTests.m
+//  LearnKit Tests
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <XCTest/XCTest.h>
+
+#import "LNKKMeansClassifier.h"
+#import "LNKGaussianProbabilityDistribution.h"
+#import "LNKKNNClassifier.h"
+#import "LNKMatrix.h"
+#import "LNKNaiveBayesClassifier.h"
+#import "LNKNeuralNetClassifier.h"
+#import "LNKNeuralNetLayer.h"
+#import "LNKOneVsAllLogisticRegressionClassifier.h"
+#import "LNKOptimizationAlgorithm.h"
+#import "LNKRandomForestClassifier.h"
+
+#define COLUMN_COUNT	4
+#define CLASS_COUNT		4
+#define THREAD_COUNT	8
+
+@interface ConcurrentPredictionTests : XCTestCase
+@end
+
+@implementation ConcurrentPredictionTests
+
+/// The class of each row is determined by its first column, so trees and neighbors have something to learn.
+static LNKMatrix *_randomMatrix(LNKSize rowCount) {
+	return [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:COLUMN_COUNT prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		for (LNKSize index = 0; index < rowCount * COLUMN_COUNT; index++)
+			matrix[index] = (LNKFloat)arc4random() / UINT32_MAX;
+
+		for (LNKSize row = 0; row < rowCount; row++)
+			outputVector[row] = MIN(CLASS_COUNT - 1, (LNKSize)(matrix[row * COLUMN_COUNT] * CLASS_COUNT));
+
+		return YES;
+	}];
+}
+
+static LNKRandomForestClassifier *_trainedForest(LNKMatrix *matrix) {
+	LNKRandomForestClassifier *classifier = [[LNKRandomForestClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:CLASS_COUNT]];
+	classifier.treeCount = 25;
+	classifier.seed = 1;
+
+	for (LNKSize column = 0; column < COLUMN_COUNT; column++)
+		[classifier registerContinuousValuesForColumnAtIndex:column];
+
+	[classifier train];
+
+	return classifier;
+}
+
+static LNKKNNClassifier *_knnClassifier(LNKMatrix *matrix, LNKKNNSearchAlgorithm searchAlgorithm) {
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:CLASS_COUNT]];
+	classifier.k = 5;
+	classifier.searchAlgorithm = searchAlgorithm;
+
+	return classifier;
+}
+
+static LNKNeuralNetClassifier *_trainedNeuralNet(LNKMatrix *matrix) {
+	LNKOptimizationAlgorithmCG *algorithm = [[LNKOptimizationAlgorithmCG alloc] init];
+	algorithm.iterationCount = 20;
+
+	NSArray<LNKNeuralNetLayer *> *hiddenLayers = @[ [[[LNKNeuralNetSigmoidLayer alloc] initWithUnitCount:8] autorelease] ];
+	LNKNeuralNetLayer *outputLayer = [[LNKNeuralNetSigmoidLayer alloc] initWithClasses:[LNKClasses withCount:CLASS_COUNT]];
+	LNKNeuralNetClassifier *classifier = [[LNKNeuralNetClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:algorithm hiddenLayers:hiddenLayers outputLayer:outputLayer];
+	[outputLayer release];
+	[algorithm release];
+
+	[classifier train];
+
+	return classifier;
+}
+
+static LNKNaiveBayesClassifier *_trainedNaiveBayes(LNKMatrix *matrix) {
+	LNKClasses *classes = [LNKClasses withCount:CLASS_COUNT];
+	LNKGaussianProbabilityDistribution *distribution = [[LNKGaussianProbabilityDistribution alloc] initWithClasses:classes featureCount:COLUMN_COUNT];
+	LNKNaiveBayesClassifier *classifier = [[LNKNaiveBayesClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:classes probabilityDistribution:distribution];
+	[distribution release];
+
+	[classifier train];
+
+	return classifier;
+}
+
+static LNKOneVsAllLogisticRegressionClassifier *_trainedLogisticRegression(LNKMatrix *matrix) {
+	LNKOptimizationAlgorithmLBFGS *algorithm = [[LNKOptimizationAlgorithmLBFGS alloc] init];
+	LNKOneVsAllLogisticRegressionClassifier *classifier = [[LNKOneVsAllLogisticRegressionClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:algorithm classes:[LNKClasses withCount:CLASS_COUNT]];
+	[algorithm release];
+
+	[classifier train];
+
+	return classifier;
+}
+
+/// Predicts every row of `queries` on many threads at once, each thread going through all of them, and checks that
+/// every prediction matches the one made on a single thread afterwards. `classifier` should not have made predictions yet,
+/// so the threads race to build any indexes it builds lazily.
+- (void)_verifyConcurrentPredictionsOfClassifier:(LNKClassifier *)classifier queries:(LNKMatrix *)queries {
+	const LNKSize rowCount = queries.rowCount;
+	LNKSize *classIndices = malloc(THREAD_COUNT * rowCount * sizeof(LNKSize));
+	LNKFloat *probabilities = LNKFloatAlloc(THREAD_COUNT * rowCount * CLASS_COUNT);
+
+	dispatch_apply(THREAD_COUNT, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+		for (LNKSize offset = 0; offset < rowCount; offset++) {
+			// Threads start at different rows so they don't go through the same ones in lock-step.
+			const LNKSize row = (offset + thread * rowCount / THREAD_COUNT) % rowCount;
+			const LNKSize index = thread * rowCount + row;
+			classIndices[index] = [classifier predictClassIndexForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], COLUMN_COUNT) probabilities:probabilities + index * CLASS_COUNT];
+		}
+	});
+
+	LNKSize mismatchCount = 0;
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		LNKFloat expectedProbabilities[CLASS_COUNT];
+		const LNKSize expectedClassIndex = [classifier predictClassIndexForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], COLUMN_COUNT) probabilities:expectedProbabilities];
+
+		for (LNKSize thread = 0; thread < THREAD_COUNT; thread++) {
+			const LNKSize index = thread * rowCount + row;
+
+			if (classIndices[index] != expectedClassIndex || memcmp(probabilities + index * CLASS_COUNT, expectedProbabilities, sizeof(expectedProbabilities)))
+				mismatchCount++;
+		}
+	}
+
+	XCTAssertEqual(mismatchCount, 0ULL);
+
+	free(probabilities);
+	free(classIndices);
+}
+
+- (void)testConcurrentPredictions {
+	LNKMatrix *matrix = _randomMatrix(2000);
+	LNKMatrix *queries = _randomMatrix(1000);
+
+	// The automatic search algorithm builds its k-d tree on the first prediction.
+	LNKKNNClassifier *knnClassifier = _knnClassifier(matrix, LNKKNNSearchAlgorithmAutomatic);
+	[self _verifyConcurrentPredictionsOfClassifier:knnClassifier queries:queries];
+	[knnClassifier release];
+
+	knnClassifier = _knnClassifier(matrix, LNKKNNSearchAlgorithmApproximate);
+	[self _verifyConcurrentPredictionsOfClassifier:knnClassifier queries:queries];
+	[knnClassifier release];
+
+	LNKKMeansClassifier *kMeansClassifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:CLASS_COUNT]];
+	[kMeansClassifier train];
+	[self _verifyConcurrentPredictionsOfClassifier:kMeansClassifier queries:queries];
+	[kMeansClassifier release];
+
+	LNKRandomForestClassifier *forest = _trainedForest(matrix);
+	[self _verifyConcurrentPredictionsOfClassifier:forest queries:queries];
+	[forest release];
+
+	LNKNeuralNetClassifier *neuralNet = _trainedNeuralNet(matrix);
+	[self _verifyConcurrentPredictionsOfClassifier:neuralNet queries:queries];
+	[neuralNet release];
+
+	LNKNaiveBayesClassifier *naiveBayes = _trainedNaiveBayes(matrix);
+	[self _verifyConcurrentPredictionsOfClassifier:naiveBayes queries:queries];
+	[naiveBayes release];
+
+	LNKOneVsAllLogisticRegressionClassifier *logisticRegression = _trainedLogisticRegression(matrix);
+	[self _verifyConcurrentPredictionsOfClassifier:logisticRegression queries:queries];
+	[logisticRegression release];
+
+	[queries release];
+	[matrix release];
+}
+
+- (void)testConcurrentPredictionPerformance {
+	LNKMatrix *matrix = _randomMatrix(10000);
+	LNKMatrix *queries = _randomMatrix(20000);
+	LNKRandomForestClassifier *forest = _trainedForest(matrix);
+	const LNKSize rowCount = queries.rowCount;
+
+	[self measureBlock:^{
+		dispatch_apply(THREAD_COUNT, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+			for (LNKSize row = thread; row < rowCount; row += THREAD_COUNT)
+				[forest predictClassIndexForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], COLUMN_COUNT) probabilities:NULL];
+		});
+	}];
+
+	[forest release];
+	[queries release];
+	[matrix release];
+}
+
+@end
@@ -9,6 +9,7 @@
 #import <XCTest/XCTest.h>
 
 #import "LNKMatrixCSV.h"
+#import "LNKDecisionTree.h"
 #import "LNKDecisionTreeClassifier.h"
 #import "LNKRandomForestClassifier.h"
 
@@ -85,7 +86,250 @@
 	[classifier release];
 }
 
-- (void)testHiringRandomForest {
+/// Examples with `columnCount` categorical columns of 4 values each, whose class is the parity of the first two columns.
+/// A fraction of `noise` of the classes is flipped.
+static LNKMatrix *_categoricalMatrix(LNKSize rowCount, LNKSize columnCount, double noise) {
+	return [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		for (LNKSize row = 0; row < rowCount; row++) {
+			for (LNKSize column = 0; column < columnCount; column++)
+				matrix[row * columnCount + column] = arc4random_uniform(4);
+			
+			const LNKSize parity = ((LNKSize)matrix[row * columnCount] + (LNKSize)matrix[row * columnCount + 1]) % 2;
+			const BOOL flipped = arc4random_uniform(1000) < noise * 1000;
+			outputVector[row] = flipped ? 1 - parity : parity;
+		}
+		
+		return YES;
+	}];
+}
+
+- (void)testLargeCategoricalSet {
+	LNKMatrix *matrix = _categoricalMatrix(20000, 8, 0);
+	LNKDecisionTreeClassifier *classifier = [[LNKDecisionTreeClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	
+	for (LNKSize column = 0; column < matrix.columnCount; column++)
+		[classifier registerCategoricalValues:4 forColumnAtIndex:column];
+	
+	[classifier validate];
+	[classifier train];
+	
+	XCTAssertEqualWithAccuracy([classifier computeClassificationAccuracyOnMatrix:matrix], 1.0, 0.0001);
+	
+	// Values outside of a column's categories don't lead anywhere.
+	LNKFloat unknownExample[8] = { 7, 0, 0, 0, 0, 0, 0, 0 };
+	XCTAssertNil([classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(unknownExample, 8)]);
+	
+	[matrix release];
+	[classifier release];
+}
+
+- (void)testTrainingPerformance {
+	LNKMatrix *matrix = _categoricalMatrix(200000, 10, 0.05);
+	LNKDecisionTreeClassifier *classifier = [[LNKDecisionTreeClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	
+	for (LNKSize column = 0; column < matrix.columnCount; column++)
+		[classifier registerCategoricalValues:4 forColumnAtIndex:column];
+	
+	[matrix release];
+	
+	[self measureBlock:^{
+		[classifier train];
+	}];
+	
+	[classifier release];
+}
+
+/// Examples with `columnCount` continuous columns uniform in [0, 1) and a final categorical column of 2 values.
+/// The class is 1 if the first column exceeds 0.3 and either the second exceeds 0.6 or the categorical value is 1.
+static LNKMatrix *_continuousMatrix(LNKSize rowCount, LNKSize columnCount) {
+	return [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount + 1 prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		for (LNKSize row = 0; row < rowCount; row++) {
+			LNKFloat *example = matrix + row * (columnCount + 1);
+			
+			for (LNKSize column = 0; column < columnCount; column++)
+				example[column] = arc4random_uniform(1000000) / 1000000.0;
+			
+			example[columnCount] = arc4random_uniform(2);
+			outputVector[row] = example[0] > 0.3 && (example[1] > 0.6 || example[columnCount] == 1);
+		}
+		
+		return YES;
+	}];
+}
+
+- (void)testContinuousSet {
+	const LNKSize columnCount = 4;
+	LNKMatrix *matrix = _continuousMatrix(20000, columnCount);
+	LNKDecisionTreeClassifier *classifier = [[LNKDecisionTreeClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	
+	for (LNKSize column = 0; column < columnCount; column++)
+		[classifier registerContinuousValuesForColumnAtIndex:column];
+	
+	[classifier registerBooleanValueForColumnAtIndex:columnCount];
+	[classifier validate];
+	[classifier train];
+	
+	XCTAssertGreaterThan([classifier computeClassificationAccuracyOnMatrix:matrix], 0.99);
+	
+	LNKFloat positiveExample[columnCount + 1] = { 0.9, 0.9, 0.5, 0.5, 0 };
+	LNKFloat negativeExample[columnCount + 1] = { 0.1, 0.9, 0.5, 0.5, 1 };
+	LNKFloat categoricalExample[columnCount + 1] = { 0.9, 0.1, 0.5, 0.5, 1 };
+	XCTAssertEqual([[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(positiveExample, columnCount + 1)] unsignedIntegerValue], 1UL);
+	XCTAssertEqual([[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(negativeExample, columnCount + 1)] unsignedIntegerValue], 0UL);
+	XCTAssertEqual([[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(categoricalExample, columnCount + 1)] unsignedIntegerValue], 1UL);
+	
+	// Missing values take the upper branch of continuous splits.
+	LNKFloat missingExample[columnCount + 1] = { NAN, 0.9, 0.5, 0.5, 0 };
+	XCTAssertEqual([[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(missingExample, columnCount + 1)] unsignedIntegerValue], 1UL);
+	
+	[matrix release];
+	[classifier release];
+}
+
+static LNKFloat _binaryEntropy(LNKSize positiveCount, LNKSize total) {
+	LNKFloat sum = 0;
+	
+	for (LNKSize class = 0; class < 2; class++) {
+		const LNKSize count = class ? positiveCount : total - positiveCount;
+		
+		if (count) {
+			const LNKFloat fraction = (LNKFloat)count / total;
+			sum -= fraction * log2(fraction);
+		}
+	}
+	
+	return sum;
+}
+
+- (void)testBinnedSplitsMatchExactSplitSearch {
+	// With fewer distinct values than bins, every value gets its own bin, so the root split should be the one
+	// an exact search over sorted values finds.
+	const LNKSize rowCount = 5000;
+	const LNKSize columnCount = 3;
+	LNKFloat *matrix = malloc(rowCount * columnCount * sizeof(LNKFloat));
+	LNKFloat *outputVector = malloc(rowCount * sizeof(LNKFloat));
+	LNKSize *exampleIndices = malloc(rowCount * sizeof(LNKSize));
+	LNKSize columnValueCounts[columnCount] = { LNKDecisionTreeContinuousColumn, LNKDecisionTreeContinuousColumn, LNKDecisionTreeContinuousColumn };
+	LNKSize columnIndices[columnCount] = { 0, 1, 2 };
+	
+	for (LNKSize row = 0; row < rowCount; row++) {
+		LNKFloat *example = matrix + row * columnCount;
+		
+		for (LNKSize column = 0; column < columnCount; column++)
+			example[column] = arc4random_uniform(200) / 8.0;
+		
+		const BOOL flipped = arc4random_uniform(10) < 2;
+		const BOOL positive = (example[0] > 12) != (example[1] > 5 && example[2] > 20);
+		outputVector[row] = positive != flipped;
+		exampleIndices[row] = row;
+	}
+	
+	LNKSize positiveCount = 0;
+	
+	for (LNKSize row = 0; row < rowCount; row++)
+		positiveCount += (LNKSize)outputVector[row];
+	
+	const LNKFloat entropy = _binaryEntropy(positiveCount, rowCount);
+	LNKFloat bestInformationGain = LNKFloatMin;
+	LNKSize bestColumn = LNKSizeMax;
+	LNKFloat bestThreshold = NAN;
+	LNKSize *sortedRows = malloc(rowCount * sizeof(LNKSize));
+	
+	for (LNKSize column = 0; column < columnCount; column++) {
+		memcpy(sortedRows, exampleIndices, rowCount * sizeof(LNKSize));
+		qsort_b(sortedRows, rowCount, sizeof(LNKSize), ^int(const void *a, const void *b) {
+			const LNKFloat valueA = matrix[*(const LNKSize *)a * columnCount + column];
+			const LNKFloat valueB = matrix[*(const LNKSize *)b * columnCount + column];
+			return (valueA > valueB) - (valueA < valueB);
+		});
+		
+		LNKSize lowerPositiveCount = 0;
+		
+		for (LNKSize lowerCount = 1; lowerCount < rowCount; lowerCount++) {
+			lowerPositiveCount += (LNKSize)outputVector[sortedRows[lowerCount - 1]];
+			
+			const LNKFloat lowerValue = matrix[sortedRows[lowerCount - 1] * columnCount + column];
+			const LNKFloat upperValue = matrix[sortedRows[lowerCount] * columnCount + column];
+			
+			if (lowerValue == upperValue)
+				continue;
+			
+			const LNKSize upperCount = rowCount - lowerCount;
+			const LNKFloat expectation = (LNKFloat)lowerCount / rowCount * _binaryEntropy(lowerPositiveCount, lowerCount) +
+										 (LNKFloat)upperCount / rowCount * _binaryEntropy(positiveCount - lowerPositiveCount, upperCount);
+			const LNKFloat informationGain = entropy - expectation;
+			
+			if (informationGain > bestInformationGain) {
+				bestInformationGain = informationGain;
+				bestColumn = column;
+				bestThreshold = lowerValue + (upperValue - lowerValue) / 2;
+			}
+		}
+	}
+	
+	LNKDecisionTreeFeatureStoreRef store = LNKDecisionTreeFeatureStoreCreate(matrix, rowCount, columnCount, columnValueCounts);
+	LNKDecisionTreeRef tree = LNKDecisionTreeCreate(store, outputVector, 2, exampleIndices, rowCount, columnIndices, columnCount);
+	const LNKDecisionTreeNode *root = LNKDecisionTreeGetNodes(tree);
+	
+	XCTAssertEqual(root->columnIndex, bestColumn);
+	XCTAssertEqualWithAccuracy(root->threshold, bestThreshold, 0.0001);
+	
+	LNKDecisionTreeFree(tree);
+	LNKDecisionTreeFeatureStoreFree(store);
+	free(sortedRows);
+	free(exampleIndices);
+	free(outputVector);
+	free(matrix);
+}
+
+- (void)testWideCategoricalColumn {
+	// Columns with more than 255 categories need two bytes per code.
+	const LNKSize rowCount = 3000;
+	const LNKSize valueCount = 300;
+	LNKMatrix *matrix = [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:2 prepareBuffers:^BOOL(LNKFloat *matrixBuffer, LNKFloat *outputVector) {
+		for (LNKSize row = 0; row < rowCount; row++) {
+			matrixBuffer[row * 2] = arc4random_uniform(2);
+			matrixBuffer[row * 2 + 1] = row % valueCount;
+			outputVector[row] = (row % valueCount) % 3 == 0;
+		}
+		
+		return YES;
+	}];
+	LNKDecisionTreeClassifier *classifier = [[LNKDecisionTreeClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	
+	[classifier registerBooleanValueForColumnAtIndex:0];
+	[classifier registerCategoricalValues:valueCount forColumnAtIndex:1];
+	[classifier validate];
+	[classifier train];
+	
+	XCTAssertEqualWithAccuracy([classifier computeClassificationAccuracyOnMatrix:matrix], 1.0, 0.0001);
+	
+	LNKFloat example[2] = { 0, 297 };
+	XCTAssertEqual([[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(example, 2)] unsignedIntegerValue], 1UL);
+	
+	[matrix release];
+	[classifier release];
+}
+
+- (void)testContinuousTrainingPerformance {
+	const LNKSize columnCount = 10;
+	LNKMatrix *matrix = _continuousMatrix(200000, columnCount);
+	LNKDecisionTreeClassifier *classifier = [[LNKDecisionTreeClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	
+	for (LNKSize column = 0; column < columnCount; column++)
+		[classifier registerContinuousValuesForColumnAtIndex:column];
+	
+	[classifier registerBooleanValueForColumnAtIndex:columnCount];
+	[matrix release];
+	
+	[self measureBlock:^{
+		[classifier train];
+	}];
+	
+	[classifier release];
+}
+
+- (LNKRandomForestClassifier *)_hiringRandomForestWithSeed:(LNKSize)seed {
 	NSBundle *bundle = [NSBundle bundleForClass:self.class];
 	NSURL *matrixURL = [bundle URLForResource:@"Hiring" withExtension:@"csv"];
 	LNKMatrix *matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:matrixURL];
@@ -96,6 +340,7 @@
 																		optimizationAlgorithm:nil
 																					  classes:[LNKClasses withCount:2]]; /* binary */
 	classifier.maxExampleCount = 6;
+	classifier.seed = seed;
 	[matrix release];
 
 	[classifier registerCategoricalValues:3 forColumnAtIndex:0];
@@ -106,14 +351,170 @@
 	[classifier validate];
 	[classifier train];
 
+	return [classifier autorelease];
+}
+
+- (void)testHiringRandomForest {
 	const LNKSize newExampleLength = 4;
-	LNKFloat newExample1[newExampleLength] = { 0, 0, 1, 0 };
-	LNKFloat newExample2[newExampleLength] = { 0, 0, 1, 1 };
-	LNKClass *class1 = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(newExample1, newExampleLength)];
+	LNKFloat newExamples[2 * newExampleLength] = { 0, 0, 1, 0,
+	                                               0, 0, 1, 1 };
+	const LNKFloat *newExamplesBuffer = newExamples;
+	LNKMatrix *newMatrix = [[LNKMatrix alloc] initWithRowCount:2 columnCount:newExampleLength prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+#pragma unused(outputVector)
+		LNKFloatCopy(matrix, newExamplesBuffer, 2 * newExampleLength);
+		return YES;
+	}];
+	LNKFloat votes[2 * 2];
+
+	// Whatever the seed, every tree casts at most one vote per example and the forest predicts the most voted class.
+	for (LNKSize seed = 1; seed <= 32; seed++) {
+		LNKRandomForestClassifier *classifier = [self _hiringRandomForestWithSeed:seed];
+		[classifier predictVoteCountsForMatrix:newMatrix outputBuffer:votes];
+
+		XCTAssertGreaterThanOrEqual(classifier.outOfBagError, 0);
+		XCTAssertLessThanOrEqual(classifier.outOfBagError, 1);
+
+		for (LNKSize example = 0; example < 2; example++) {
+			const LNKFloat *exampleVotes = votes + example * 2;
+			XCTAssertEqual(exampleVotes[0], floor(exampleVotes[0]));
+			XCTAssertEqual(exampleVotes[1], floor(exampleVotes[1]));
+			XCTAssertLessThanOrEqual(exampleVotes[0] + exampleVotes[1], (LNKFloat)classifier.treeCount);
+
+			if (exampleVotes[0] != exampleVotes[1]) {
+				LNKClass *predictedClass = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(newExamples + example * newExampleLength, newExampleLength)];
+				XCTAssertEqual(predictedClass.unsignedIntegerValue, exampleVotes[1] > exampleVotes[0] ? 1UL : 0UL);
+			}
+		}
+	}
+
+	[newMatrix release];
+
+	// Each tree sees six of the fourteen rows and two of the four columns, so which way ten trees lean on these
+	// examples depends on the draw. The seed is fixed to check the predictions of one known forest.
+	LNKRandomForestClassifier *classifier = [self _hiringRandomForestWithSeed:1];
+	LNKClass *class1 = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(newExamples, newExampleLength)];
 	XCTAssertEqual(class1.unsignedIntegerValue, 1UL);
-	LNKClass *class2 = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(newExample2, newExampleLength)];
+	LNKClass *class2 = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(newExamples + newExampleLength, newExampleLength)];
 	XCTAssertEqual(class2.unsignedIntegerValue, 0UL);
+}
+
+- (void)testRandomForestOutOfBagError {
+	const LNKSize columnCount = 4;
+	LNKMatrix *matrix = _continuousMatrix(2000, columnCount);
+	NSMutableArray<LNKRandomForestClassifier *> *classifiers = [NSMutableArray array];
+	
+	for (NSUInteger index = 0; index < 2; index++) {
+		LNKRandomForestClassifier *classifier = [[LNKRandomForestClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+		classifier.treeCount = 50;
+		classifier.seed = 42;
+		
+		for (LNKSize column = 0; column < columnCount; column++)
+			[classifier registerContinuousValuesForColumnAtIndex:column];
+		
+		[classifier registerBooleanValueForColumnAtIndex:columnCount];
+		[classifier validate];
+		[classifier train];
+		
+		[classifiers addObject:classifier];
+		[classifier release];
+	}
+	
+	XCTAssertLessThan(classifiers[0].outOfBagError, 0.1);
+	
+	// Forests grown from the same seed are identical, however their trees were scheduled.
+	XCTAssertEqual(classifiers[0].outOfBagError, classifiers[1].outOfBagError);
+	
+	for (LNKSize row = 0; row < matrix.rowCount; row++) {
+		LNKVector example = LNKVectorCreateUnsafe(matrix.matrixBuffer + row * matrix.columnCount, matrix.columnCount);
+		XCTAssertEqualObjects([classifiers[0] predictValueForFeatureVector:example], [classifiers[1] predictValueForFeatureVector:example]);
+	}
+	
+	[matrix release];
+}
 
+- (void)testRandomForestTrainingPerformance {
+	const LNKSize columnCount = 10;
+	LNKMatrix *matrix = _continuousMatrix(10000, columnCount);
+	LNKRandomForestClassifier *classifier = [[LNKRandomForestClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	classifier.treeCount = 500;
+	
+	for (LNKSize column = 0; column < columnCount; column++)
+		[classifier registerContinuousValuesForColumnAtIndex:column];
+	
+	[classifier registerBooleanValueForColumnAtIndex:columnCount];
+	[matrix release];
+	
+	[self measureBlock:^{
+		[classifier train];
+	}];
+	
+	[classifier release];
+}
+
+/// The returned classifier is +1 reference counted.
+static LNKRandomForestClassifier *_trainedForest(LNKMatrix *matrix, LNKSize continuousColumnCount, LNKSize treeCount) {
+	LNKRandomForestClassifier *classifier = [[LNKRandomForestClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	classifier.treeCount = treeCount;
+	
+	for (LNKSize column = 0; column < continuousColumnCount; column++)
+		[classifier registerContinuousValuesForColumnAtIndex:column];
+	
+	[classifier registerBooleanValueForColumnAtIndex:continuousColumnCount];
+	[classifier train];
+	
+	return classifier;
+}
+
+- (void)testRandomForestBatchPredictionsMatchSinglePredictions {
+	LNKMatrix *matrix = _continuousMatrix(5000, 6);
+	LNKRandomForestClassifier *classifier = _trainedForest(matrix, 6, 25);
+	
+	LNKFloat *votes = LNKFloatAlloc(matrix.rowCount * 2);
+	LNKFloat *probabilities = LNKFloatAlloc(matrix.rowCount * 2);
+	[classifier predictVoteCountsForMatrix:matrix outputBuffer:votes];
+	[classifier predictProbabilitiesForMatrix:matrix outputBuffer:probabilities];
+	
+	for (LNKSize row = 0; row < matrix.rowCount; row++) {
+		const LNKFloat *rowVotes = votes + row * 2;
+		const LNKFloat voteCount = rowVotes[0] + rowVotes[1];
+		LNKClass *class = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:row], matrix.columnCount)];
+		
+		// Trees that reach a leaf no training example did abstain.
+		XCTAssertLessThanOrEqual(voteCount, 25);
+		XCTAssertEqual(class.unsignedIntegerValue, rowVotes[1] > rowVotes[0] ? 1UL : 0UL);
+		XCTAssertEqualWithAccuracy(probabilities[row * 2 + 1], voteCount ? rowVotes[1] / voteCount : 0, 0.0001);
+	}
+	
+	free(probabilities);
+	free(votes);
+	[matrix release];
+	[classifier release];
+}
+
+- (void)testRandomForestPredictionPerformance {
+	LNKMatrix *matrix = _continuousMatrix(20000, 10);
+	LNKRandomForestClassifier *classifier = _trainedForest(matrix, 10, 100);
+	
+	[self measureBlock:^{
+		for (LNKSize row = 0; row < matrix.rowCount; row++)
+			[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:row], matrix.columnCount)];
+	}];
+	
+	[matrix release];
+	[classifier release];
+}
+
+- (void)testRandomForestBatchPredictionPerformance {
+	LNKMatrix *matrix = _continuousMatrix(20000, 10);
+	LNKRandomForestClassifier *classifier = _trainedForest(matrix, 10, 100);
+	LNKFloat *votes = LNKFloatAlloc(matrix.rowCount * 2);
+	
+	[self measureBlock:^{
+		[classifier predictVoteCountsForMatrix:matrix outputBuffer:votes];
+	}];
+	
+	free(votes);
+	[matrix release];
 	[classifier release];
 }
 
@@ -0,0 +1,146 @@
+//
+//  ExecutorTests.m
+//  LearnKit Tests
+//
+//  Copyright © 2016 Matt Rajca. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+
+#import "LNKExecutor.h"
+
+@interface ExecutorTests : XCTestCase
+
+@end
+
+@implementation ExecutorTests
+
+#define EXAMPLE_COUNT 100003
+
+- (void)_verifyExecutor:(LNKExecutorRef)executor grainSize:(LNKSize)grainSize {
+	const LNKSize threadCount = LNKExecutorGetThreadCount(executor);
+	const LNKRange range = LNKRangeMake(7, EXAMPLE_COUNT);
+	uint8_t *visits = calloc(range.location + range.length, sizeof(uint8_t));
+	int32_t *busyThreads = calloc(threadCount, sizeof(int32_t));
+	__block BOOL sharedThreadIndex = NO;
+	__block BOOL outOfBoundsThreadIndex = NO;
+
+	LNKExecutorApply(executor, range, grainSize, ^(LNKRange innerRange, LNKSize threadIndex) {
+		if (threadIndex >= threadCount) {
+			outOfBoundsThreadIndex = YES;
+			return;
+		}
+
+		if (__atomic_fetch_add(&busyThreads[threadIndex], 1, __ATOMIC_SEQ_CST))
+			sharedThreadIndex = YES;
+
+		// Uneven work so threads run out at different times and have to steal.
+		for (LNKSize index = innerRange.location; index < innerRange.location + innerRange.length; index++) {
+			if (index % 1009 == 0)
+				usleep(50);
+
+			visits[index]++;
+		}
+
+		__atomic_fetch_sub(&busyThreads[threadIndex], 1, __ATOMIC_SEQ_CST);
+	});
+
+	XCTAssertFalse(outOfBoundsThreadIndex);
+	XCTAssertFalse(sharedThreadIndex, @"Two chunks ran concurrently with the same thread index");
+
+	for (LNKSize index = 0; index < range.location + range.length; index++) {
+		if (visits[index] != (index >= range.location)) {
+			XCTFail(@"Example %llu was visited %d times", index, visits[index]);
+			break;
+		}
+	}
+
+	free(busyThreads);
+	free(visits);
+}
+
+- (void)testApplyVisitsEveryExampleOnce {
+	LNKExecutorRef executor = LNKExecutorCreate(4);
+
+	[self _verifyExecutor:executor grainSize:0];
+	[self _verifyExecutor:executor grainSize:1];
+	[self _verifyExecutor:executor grainSize:333];
+	[self _verifyExecutor:executor grainSize:EXAMPLE_COUNT * 2];
+
+	LNKExecutorFree(executor);
+}
+
+- (void)testChangingThreadCount {
+	LNKExecutorRef executor = LNKExecutorCreate(1);
+	[self _verifyExecutor:executor grainSize:0];
+
+	LNKExecutorSetThreadCount(executor, 8);
+	XCTAssertEqual(LNKExecutorGetThreadCount(executor), 8ULL);
+	[self _verifyExecutor:executor grainSize:0];
+
+	LNKExecutorSetThreadCount(executor, 2);
+	[self _verifyExecutor:executor grainSize:0];
+
+	LNKExecutorFree(executor);
+}
+
+- (void)testSum {
+	LNKExecutorRef executor = LNKExecutorCreate(0);
+	LNKFloat result[2];
+
+	LNKExecutorSum(executor, LNKRangeMake(1, EXAMPLE_COUNT), 100, result, 2, ^(LNKRange range, LNKFloat *accumulator) {
+		for (LNKSize index = range.location; index < range.location + range.length; index++) {
+			accumulator[0] += index;
+			accumulator[1] += 1;
+		}
+	});
+
+	XCTAssertEqual(result[0], (LNKFloat)EXAMPLE_COUNT * (EXAMPLE_COUNT + 1) / 2);
+	XCTAssertEqual(result[1], (LNKFloat)EXAMPLE_COUNT);
+
+	LNKExecutorFree(executor);
+}
+
+- (void)testCount {
+	LNKExecutorRef executor = LNKExecutorCreate(0);
+	LNKSize counts[3];
+
+	LNKExecutorCount(executor, LNKRangeMake(0, EXAMPLE_COUNT), 100, counts, 3, ^(LNKRange range, LNKSize *counters) {
+		for (LNKSize index = range.location; index < range.location + range.length; index++)
+			counters[index % 3]++;
+	});
+
+	XCTAssertEqual(counts[0] + counts[1] + counts[2], (LNKSize)EXAMPLE_COUNT);
+	XCTAssertEqual(counts[0], (LNKSize)(EXAMPLE_COUNT + 2) / 3);
+
+	LNKExecutorFree(executor);
+}
+
+- (void)testConcurrentCallers {
+	LNKExecutorRef executor = LNKExecutorCreate(4);
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+	// Several models sharing one executor.
+	dispatch_apply(8, queue, ^(size_t iteration) {
+#pragma unused(iteration)
+		[self _verifyExecutor:executor grainSize:0];
+	});
+
+	LNKExecutorFree(executor);
+}
+
+- (void)testApplyPerformance {
+	LNKExecutorRef executor = LNKExecutorGetShared();
+
+	// Dominated by the cost of handing out small chunks.
+	[self measureBlock:^{
+		for (int iteration = 0; iteration < 100; iteration++) {
+			LNKFloat result;
+			LNKExecutorSum(executor, LNKRangeMake(0, 10000), 100, &result, 1, ^(LNKRange range, LNKFloat *accumulator) {
+				*accumulator += range.length;
+			});
+		}
+	}];
+}
+
+@end
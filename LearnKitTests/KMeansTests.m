@@ -147,4 +147,231 @@
 	[classifier release];
 }
 
+/// Blobs of examples around `clusterCount` centers spread far apart along the diagonal.
+static LNKMatrix *_blobMatrix(LNKSize rowCount, LNKSize columnCount, LNKSize clusterCount) {
+	return [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+#pragma unused(outputVector)
+		for (LNKSize row = 0; row < rowCount; row++) {
+			const LNKSize blob = row % clusterCount;
+			
+			for (LNKSize column = 0; column < columnCount; column++)
+				matrix[row * columnCount + column] = blob * 100 + (LNKFloat)arc4random() / UINT32_MAX;
+		}
+		
+		return YES;
+	}];
+}
+
+- (void)testPlusPlusSeedingFindsSeparatedClusters {
+	const LNKSize clusterCount = 10;
+	LNKMatrix *matrix = _blobMatrix(5000, 2, clusterCount);
+	LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:clusterCount]];
+	classifier.iterationCount = LNKSizeMax;
+	[matrix release];
+	
+	[classifier train];
+	[self _verifyBlobCentroidsOfClassifier:classifier];
+	
+	[classifier release];
+}
+
+- (void)_verifyBlobCentroidsOfClassifier:(LNKKMeansClassifier *)classifier {
+	const LNKSize clusterCount = classifier.classes.count;
+	
+	// Every blob should end up with a centroid at its center.
+	BOOL foundBlobs[clusterCount];
+	memset(foundBlobs, 0, sizeof(foundBlobs));
+	
+	for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+		const LNKVector centroid = [classifier centroidForClusterAtIndex:cluster];
+		const LNKSize blob = (LNKSize)round(centroid.data[0] / 100);
+		
+		XCTAssertLessThan(blob, clusterCount);
+		XCTAssertEqualWithAccuracy(centroid.data[0], blob * 100 + 0.5, 0.1);
+		
+		if (blob < clusterCount)
+			foundBlobs[blob] = YES;
+		
+		LNKVectorRelease(centroid);
+	}
+	
+	for (LNKSize blob = 0; blob < clusterCount; blob++)
+		XCTAssertTrue(foundBlobs[blob], @"No centroid was placed in blob %llu", blob);
+}
+
+- (void)testMiniBatchTrainingFindsSeparatedClusters {
+	LNKMatrix *matrix = _blobMatrix(20000, 2, 10);
+	LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:10]];
+	classifier.iterationCount = LNKSizeMax;
+	classifier.miniBatchSize = 256;
+	[matrix release];
+	
+	[classifier train];
+	[self _verifyBlobCentroidsOfClassifier:classifier];
+	XCTAssertEqual(classifier.skippedDistanceCounts.count, 0UL);
+	
+	[classifier release];
+}
+
+- (void)testBatchSourceUpdatesCentroidsIncrementally {
+	const LNKSize clusterCount = 10;
+	
+	// The classifier only needs a sample of the stream; the initial centroids come from its first batch.
+	LNKMatrix *sample = _blobMatrix(100, 2, clusterCount);
+	LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:sample implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:clusterCount]];
+	[sample release];
+	
+	LNKMatrix *stream = _blobMatrix(50000, 2, clusterCount);
+	[classifier updateWithBatchSource:[LNKKMeansClassifier batchSourceWithMatrix:stream batchSize:500]];
+	[stream release];
+	
+	[self _verifyBlobCentroidsOfClassifier:classifier];
+	
+	// With a minimum learning rate, the centroid of a blob that moves keeps up with it.
+	classifier.minimumLearningRate = 0.1;
+	
+	LNKMatrix *movedBlob = [[LNKMatrix alloc] initWithRowCount:200 columnCount:2 prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+#pragma unused(outputVector)
+		for (LNKSize index = 0; index < 200 * 2; index++)
+			matrix[index] = 20 + (LNKFloat)arc4random() / UINT32_MAX;
+		
+		return YES;
+	}];
+	
+	[classifier updateWithBatchMatrix:movedBlob];
+	
+	const LNKSize cluster = [[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([movedBlob rowAtIndex:0], 2)] LNKSizeValue];
+	const LNKVector centroid = [classifier centroidForClusterAtIndex:cluster];
+	XCTAssertEqualWithAccuracy(centroid.data[0], 20.5, 0.2);
+	XCTAssertEqualWithAccuracy(centroid.data[1], 20.5, 0.2);
+	LNKVectorRelease(centroid);
+	
+	[movedBlob release];
+	[classifier release];
+}
+
+- (void)_verifyConvergedClassifier:(LNKKMeansClassifier *)classifier matrix:(LNKMatrix *)matrix {
+	const LNKSize clusterCount = classifier.classes.count;
+	const LNKSize columnCount = matrix.columnCount;
+	LNKFloat *sums = calloc(clusterCount * columnCount, sizeof(LNKFloat));
+	LNKSize *counts = calloc(clusterCount, sizeof(LNKSize));
+	
+	for (LNKSize row = 0; row < matrix.rowCount; row++) {
+		const LNKFloat *example = [matrix rowAtIndex:row];
+		const LNKSize cluster = [[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(example, columnCount)] LNKSizeValue];
+		
+		for (LNKSize column = 0; column < columnCount; column++)
+			sums[cluster * columnCount + column] += example[column];
+		
+		counts[cluster]++;
+	}
+	
+	// Once converged, every centroid is the mean of the examples closest to it. Skipping a distance computation
+	// the bounds didn't allow would leave examples with the wrong clusters.
+	for (LNKSize cluster = 0; cluster < clusterCount; cluster++) {
+		if (!counts[cluster])
+			continue;
+		
+		const LNKVector centroid = [classifier centroidForClusterAtIndex:cluster];
+		
+		for (LNKSize column = 0; column < columnCount; column++)
+			XCTAssertEqualWithAccuracy(centroid.data[column], sums[cluster * columnCount + column] / counts[cluster], 1e-9);
+		
+		LNKVectorRelease(centroid);
+	}
+	
+	NSArray<NSNumber *> *skippedDistanceCounts = classifier.skippedDistanceCounts;
+	XCTAssertGreaterThan(skippedDistanceCounts.count, 1UL);
+	XCTAssertEqual(skippedDistanceCounts.firstObject.LNKSizeValue, 0ULL, @"The first iteration has no bounds to go by");
+	XCTAssertGreaterThan(skippedDistanceCounts.lastObject.LNKSizeValue, matrix.rowCount * clusterCount / 2);
+	
+	free(counts);
+	free(sums);
+}
+
+- (void)testBoundsSkipDistanceComputations {
+	// Few clusters use Hamerly's bounds, many clusters use Elkan's bounds.
+	const LNKSize clusterCounts[] = { 8, 64 };
+	
+	for (size_t index = 0; index < sizeof(clusterCounts) / sizeof(clusterCounts[0]); index++) {
+		LNKMatrix *matrix = _blobMatrix(20000, 4, 25);
+		LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:clusterCounts[index]]];
+		classifier.iterationCount = LNKSizeMax;
+		
+		[classifier train];
+		[self _verifyConvergedClassifier:classifier matrix:matrix];
+		
+		[matrix release];
+		[classifier release];
+	}
+}
+
+- (void)testBatchPredictionsMatchSinglePredictions {
+	LNKMatrix *matrix = _blobMatrix(5000, 12, 40);
+	LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:40]];
+	classifier.iterationCount = 10;
+	
+	[classifier train];
+	
+	LNKFloat *outputBuffer = LNKFloatAlloc(matrix.rowCount);
+	[classifier predictValuesForMatrix:matrix outputBuffer:outputBuffer];
+	
+	for (LNKSize row = 0; row < matrix.rowCount; row++) {
+		const LNKSize cluster = [[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:row], matrix.columnCount)] LNKSizeValue];
+		XCTAssertEqual((LNKSize)outputBuffer[row], cluster);
+	}
+	
+	free(outputBuffer);
+	[matrix release];
+	[classifier release];
+}
+
+- (void)testBatchPredictionPerformance {
+	LNKMatrix *matrix = _blobMatrix(100000, 32, 300);
+	LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:256]];
+	classifier.iterationCount = 5;
+	
+	[classifier train];
+	
+	LNKFloat *outputBuffer = LNKFloatAlloc(matrix.rowCount);
+	
+	[self measureBlock:^{
+		[classifier predictValuesForMatrix:matrix outputBuffer:outputBuffer];
+	}];
+	
+	free(outputBuffer);
+	[matrix release];
+	[classifier release];
+}
+
+- (void)testTrainingPerformance {
+	LNKMatrix *matrix = _blobMatrix(100000, 16, 300);
+	LNKKMeansClassifier *classifier = [[LNKKMeansClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:256]];
+	classifier.iterationCount = 20;
+	[matrix release];
+	
+	[self measureBlock:^{
+		[classifier train];
+	}];
+	
+	// As the centroids settle, their bounds tighten and more distance computations are skipped.
+	NSArray<NSNumber *> *skippedDistanceCounts = classifier.skippedDistanceCounts;
+	const NSUInteger iterationCount = skippedDistanceCounts.count;
+	XCTAssertGreaterThan(iterationCount, 3UL);
+	XCTAssertEqual(skippedDistanceCounts.firstObject.LNKSizeValue, 0ULL, @"The first iteration has no bounds to go by");
+	
+	LNKSize earlySkippedCount = 0;
+	LNKSize lateSkippedCount = 0;
+	
+	for (NSUInteger iteration = 0; iteration < iterationCount / 2; iteration++) {
+		earlySkippedCount += skippedDistanceCounts[iteration].LNKSizeValue;
+		lateSkippedCount += skippedDistanceCounts[iterationCount - 1 - iteration].LNKSizeValue;
+	}
+	
+	XCTAssertGreaterThan(lateSkippedCount, earlySkippedCount);
+	XCTAssertGreaterThan(skippedDistanceCounts.lastObject.LNKSizeValue, skippedDistanceCounts[1].LNKSizeValue);
+	
+	[classifier release];
+}
+
 @end
@@ -37,4 +37,297 @@
 	[classifier release];
 }
 
+static LNKMatrix *_randomMatrix(LNKSize rowCount, LNKSize columnCount, LNKSize classCount) {
+	return [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		for (LNKSize index = 0; index < rowCount * columnCount; index++)
+			matrix[index] = (LNKFloat)arc4random() / UINT32_MAX;
+		
+		for (LNKSize row = 0; row < rowCount; row++)
+			outputVector[row] = arc4random_uniform((uint32_t)classCount);
+		
+		return YES;
+	}];
+}
+
+- (void)testKDTreeMatchesBruteForce {
+	for (LNKSize columnCount = 1; columnCount <= 5; columnCount += 2) {
+		LNKMatrix *matrix = _randomMatrix(3000, columnCount, 100);
+		LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:100]];
+		classifier.outputFunction = LNKKNNOutputFunctionAverage;
+		[matrix release];
+		
+		for (LNKSize k = 1; k <= 25; k += 8) {
+			classifier.k = k;
+			
+			for (int query = 0; query < 50; query++) {
+				LNKFloat featureVector[columnCount];
+				for (LNKSize column = 0; column < columnCount; column++)
+					featureVector[column] = (LNKFloat)arc4random() / UINT32_MAX;
+				
+				classifier.searchAlgorithm = LNKKNNSearchAlgorithmKDTree;
+				NSNumber *treeValue = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(featureVector, columnCount)];
+				classifier.searchAlgorithm = LNKKNNSearchAlgorithmBruteForce;
+				NSNumber *bruteForceValue = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe(featureVector, columnCount)];
+				
+				// Ties in distance may be broken differently, which is rare with random data.
+				XCTAssertEqualWithAccuracy(treeValue.LNKFloatValue, bruteForceValue.LNKFloatValue, 1e-9, @"The k-d tree found different neighbors");
+			}
+		}
+		
+		[classifier release];
+	}
+}
+
+- (void)_verifyBatchPredictionsForClassifier:(LNKKNNClassifier *)classifier columnCount:(LNKSize)columnCount {
+	LNKMatrix *queries = _randomMatrix(300, columnCount, 1);
+	LNKFloat *outputBuffer = LNKFloatAlloc(queries.rowCount);
+	
+	for (LNKSize k = 1; k <= 25; k += 8) {
+		classifier.k = k;
+		[classifier predictValuesForMatrix:queries outputBuffer:outputBuffer];
+		
+		for (LNKSize row = 0; row < queries.rowCount; row++) {
+			id value = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], columnCount)];
+			const LNKFloat expectedOutput = classifier.outputFunction == LNKKNNOutputFunctionAverage ? [value LNKFloatValue] : [value unsignedIntegerValue];
+			
+			XCTAssertEqualWithAccuracy(outputBuffer[row], expectedOutput, 1e-9, @"The batched prediction differs from the single prediction");
+		}
+	}
+	
+	free(outputBuffer);
+	[queries release];
+}
+
+- (void)testBatchPredictionsMatchSinglePredictions {
+	// The k-d tree, matrix multiplication, and custom distance function paths.
+	const LNKSize columnCounts[] = { 3, 20, 5 };
+	
+	for (size_t columnIndex = 0; columnIndex < sizeof(columnCounts) / sizeof(columnCounts[0]); columnIndex++) {
+		const LNKSize columnCount = columnCounts[columnIndex];
+		LNKMatrix *matrix = _randomMatrix(3000, columnCount, 10);
+		LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:10]];
+		[matrix release];
+		
+		if (columnIndex == 2) {
+			classifier.distanceFunction = ^LNKFloat(LNKVector example1, LNKVector example2) {
+				LNKFloat distance = 0;
+				for (LNKSize column = 0; column < example1.length; column++)
+					distance += fabs(example1.data[column] - example2.data[column]);
+				
+				return distance;
+			};
+		}
+		
+		[self _verifyBatchPredictionsForClassifier:classifier columnCount:columnCount];
+		
+		classifier.outputFunction = LNKKNNOutputFunctionAverage;
+		[self _verifyBatchPredictionsForClassifier:classifier columnCount:columnCount];
+		
+		[classifier release];
+	}
+}
+
+/// A classifier big enough for batched predictions to pay off, and queries for it.
+static LNKKNNClassifier *_predictionPerformanceClassifier(LNKSize columnCount, LNKMatrix **outQueries) {
+	LNKMatrix *matrix = _randomMatrix(100000, columnCount, 10);
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:10]];
+	classifier.k = 5;
+	[matrix release];
+	
+	*outQueries = _randomMatrix(1000, columnCount, 1);
+	
+	return classifier;
+}
+
+- (void)testSinglePredictionPerformance {
+	const LNKSize columnCount = 32;
+	LNKMatrix *queries = nil;
+	LNKKNNClassifier *classifier = _predictionPerformanceClassifier(columnCount, &queries);
+	
+	[self measureBlock:^{
+		for (LNKSize row = 0; row < queries.rowCount; row++)
+			[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], columnCount)];
+	}];
+	
+	[queries release];
+	[classifier release];
+}
+
+- (void)testBatchPredictionPerformance {
+	const LNKSize columnCount = 32;
+	LNKMatrix *queries = nil;
+	LNKKNNClassifier *classifier = _predictionPerformanceClassifier(columnCount, &queries);
+	LNKFloat *outputBuffer = LNKFloatAlloc(queries.rowCount);
+	
+	[classifier predictValuesForMatrix:queries outputBuffer:outputBuffer];
+	
+	for (LNKSize row = 0; row < queries.rowCount; row++) {
+		id value = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], columnCount)];
+		XCTAssertEqual(outputBuffer[row], [value unsignedIntegerValue], @"The batched prediction differs from the single prediction");
+	}
+	
+	[self measureBlock:^{
+		[classifier predictValuesForMatrix:queries outputBuffer:outputBuffer];
+	}];
+	
+	free(outputBuffer);
+	[queries release];
+	[classifier release];
+}
+
+- (void)testAddedExamplesAreFound {
+	const LNKSize columnCount = 8;
+	LNKMatrix *matrix = _randomMatrix(1000, columnCount, 1);
+	LNKMatrix *addedMatrix = [[LNKMatrix alloc] initWithRowCount:500 columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *buffer, LNKFloat *outputVector) {
+		for (LNKSize index = 0; index < 500 * columnCount; index++)
+			buffer[index] = (LNKFloat)arc4random() / UINT32_MAX;
+		
+		for (LNKSize row = 0; row < 500; row++)
+			outputVector[row] = 1 + row;
+		
+		return YES;
+	}];
+	
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	classifier.outputFunction = LNKKNNOutputFunctionAverage;
+	[matrix release];
+	
+	const LNKKNNSearchAlgorithm algorithms[] = { LNKKNNSearchAlgorithmBruteForce, LNKKNNSearchAlgorithmKDTree, LNKKNNSearchAlgorithmApproximate };
+	
+	// Indexes built before examples are added have to pick them up too.
+	classifier.searchAlgorithm = LNKKNNSearchAlgorithmApproximate;
+	[classifier addExamplesFromMatrix:[addedMatrix submatrixWithRowRange:NSMakeRange(0, 250)]];
+	[classifier addExamplesFromMatrix:[addedMatrix submatrixWithRowRange:NSMakeRange(250, 250)]];
+	
+	for (size_t algorithmIndex = 0; algorithmIndex < sizeof(algorithms) / sizeof(algorithms[0]); algorithmIndex++) {
+		classifier.searchAlgorithm = algorithms[algorithmIndex];
+		
+		for (LNKSize row = 0; row < addedMatrix.rowCount; row++) {
+			NSNumber *value = [classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([addedMatrix rowAtIndex:row], columnCount)];
+			XCTAssertEqual(value.LNKFloatValue, addedMatrix.outputVector[row], @"An added example was not found");
+		}
+	}
+	
+	[addedMatrix release];
+	[classifier release];
+}
+
+- (void)testKCountsAddedExamples {
+	LNKMatrix *matrix = _randomMatrix(10, 2, 2);
+	LNKMatrix *addedMatrix = _randomMatrix(5, 2, 2);
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:2]];
+	[matrix release];
+	
+	XCTAssertThrows(classifier.k = 12, @"k should be less than the number of examples");
+	
+	[classifier addExamplesFromMatrix:addedMatrix];
+	XCTAssertNoThrow(classifier.k = 12, @"Added examples should count toward the number of examples");
+	XCTAssertEqual(classifier.k, 12ULL);
+	XCTAssertThrows(classifier.k = 15, @"k should be less than the number of examples");
+	
+	[addedMatrix release];
+	[classifier release];
+}
+
+- (void)testApproximateSearchRecall {
+	LNKMatrix *matrix = _randomMatrix(10000, 32, 10);
+	LNKMatrix *heldOutMatrix = _randomMatrix(200, 32, 10);
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:10]];
+	classifier.k = 10;
+	classifier.searchAlgorithm = LNKKNNSearchAlgorithmApproximate;
+	[matrix release];
+	
+	const LNKFloat recall = [classifier computeApproximateRecallOnMatrix:heldOutMatrix];
+	XCTAssertGreaterThan(recall, 0.9, @"The approximate search missed too many neighbors");
+	
+	classifier.approximateSearchBreadth = 256;
+	XCTAssertGreaterThanOrEqual([classifier computeApproximateRecallOnMatrix:heldOutMatrix], recall - 0.01, @"A broader search should not find fewer neighbors");
+	
+	[heldOutMatrix release];
+	[classifier release];
+}
+
+- (void)testApproximateSearchPerformance {
+	const LNKSize columnCount = 256;
+	const int queryCount = 1000;
+	
+	LNKMatrix *matrix = _randomMatrix(50000, columnCount, 10);
+	LNKMatrix *heldOutMatrix = _randomMatrix(queryCount, columnCount, 10);
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:10]];
+	classifier.k = 10;
+	classifier.searchAlgorithm = LNKKNNSearchAlgorithmApproximate;
+	[matrix release];
+	
+	// Uniformly random points in many dimensions are about the hardest case for graph search, so the bar is lower than
+	// in testApproximateSearchRecall. The default search breadth still has to find most neighbors.
+	XCTAssertGreaterThan([classifier computeApproximateRecallOnMatrix:heldOutMatrix], 0.5, @"The default search breadth missed too many neighbors");
+	
+	[self measureBlock:^{
+		for (LNKSize row = 0; row < queryCount; row++)
+			[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([heldOutMatrix rowAtIndex:row], columnCount)];
+	}];
+	
+	[heldOutMatrix release];
+	[classifier release];
+}
+
+/// Measures single predictions with `searchAlgorithm` after checking it finds the same nearest neighbors as brute force.
+- (void)_measureSearchAlgorithm:(LNKKNNSearchAlgorithm)searchAlgorithm rowCount:(LNKSize)rowCount columnCount:(LNKSize)columnCount {
+	// Each example's output is its index, so with k = 1 the averaged output identifies the nearest neighbor.
+	LNKMatrix *matrix = [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrixBuffer, LNKFloat *outputVector) {
+		for (LNKSize index = 0; index < rowCount * columnCount; index++)
+			matrixBuffer[index] = (LNKFloat)arc4random() / UINT32_MAX;
+		
+		for (LNKSize row = 0; row < rowCount; row++)
+			outputVector[row] = row;
+		
+		return YES;
+	}];
+	LNKKNNClassifier *classifier = [[LNKKNNClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:nil classes:[LNKClasses withCount:rowCount]];
+	classifier.outputFunction = LNKKNNOutputFunctionAverage;
+	[matrix release];
+	
+	LNKMatrix *queries = _randomMatrix(200, columnCount, 1);
+	
+	for (LNKSize row = 0; row < queries.rowCount; row++) {
+		const LNKVector featureVector = LNKVectorCreateUnsafe([queries rowAtIndex:row], columnCount);
+		
+		classifier.searchAlgorithm = LNKKNNSearchAlgorithmBruteForce;
+		NSNumber *bruteForceNeighbor = [classifier predictValueForFeatureVector:featureVector];
+		classifier.searchAlgorithm = searchAlgorithm;
+		NSNumber *neighbor = [classifier predictValueForFeatureVector:featureVector];
+		
+		XCTAssertEqual(neighbor.LNKFloatValue, bruteForceNeighbor.LNKFloatValue, @"Different nearest neighbors were found");
+	}
+	
+	[self measureBlock:^{
+		for (LNKSize row = 0; row < queries.rowCount; row++)
+			[classifier predictValueForFeatureVector:LNKVectorCreateUnsafe([queries rowAtIndex:row], columnCount)];
+	}];
+	
+	[queries release];
+	[classifier release];
+}
+
+/// measureBlock can only be used once per test, so every size gets a test of its own. The k-d tree should beat brute
+/// force in few dimensions and fall behind it as dimensions grow.
+#define MEASURE_SEARCH_ALGORITHM(name, algorithm, rows, columns) \
+	- (void)test##name##SearchPerformance##rows##Rows##columns##Columns { \
+		[self _measureSearchAlgorithm:algorithm rowCount:rows columnCount:columns]; \
+	}
+
+MEASURE_SEARCH_ALGORITHM(BruteForce, LNKKNNSearchAlgorithmBruteForce, 10000, 2)
+MEASURE_SEARCH_ALGORITHM(BruteForce, LNKKNNSearchAlgorithmBruteForce, 10000, 8)
+MEASURE_SEARCH_ALGORITHM(BruteForce, LNKKNNSearchAlgorithmBruteForce, 10000, 32)
+MEASURE_SEARCH_ALGORITHM(BruteForce, LNKKNNSearchAlgorithmBruteForce, 100000, 2)
+MEASURE_SEARCH_ALGORITHM(BruteForce, LNKKNNSearchAlgorithmBruteForce, 100000, 8)
+MEASURE_SEARCH_ALGORITHM(BruteForce, LNKKNNSearchAlgorithmBruteForce, 100000, 32)
+
+MEASURE_SEARCH_ALGORITHM(KDTree, LNKKNNSearchAlgorithmKDTree, 10000, 2)
+MEASURE_SEARCH_ALGORITHM(KDTree, LNKKNNSearchAlgorithmKDTree, 10000, 8)
+MEASURE_SEARCH_ALGORITHM(KDTree, LNKKNNSearchAlgorithmKDTree, 10000, 32)
+MEASURE_SEARCH_ALGORITHM(KDTree, LNKKNNSearchAlgorithmKDTree, 100000, 2)
+MEASURE_SEARCH_ALGORITHM(KDTree, LNKKNNSearchAlgorithmKDTree, 100000, 8)
+MEASURE_SEARCH_ALGORITHM(KDTree, LNKKNNSearchAlgorithmKDTree, 100000, 32)
+
 @end
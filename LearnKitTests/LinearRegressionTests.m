@@ -20,6 +20,7 @@
 #import "LNKOptimizationAlgorithm.h"
 #import "LNKPredictorPrivate.h"
 #import "LNKRegularizationConfiguration.h"
+#import "LNKSparseMatrix.h"
 
 @interface LinearRegressionTests : XCTestCase
 
@@ -29,7 +30,7 @@
 
 #define DACCURACY 1.0
 
-extern void _LNKComputeBatchGradient(const LNKFloat *matrixBuffer, const LNKFloat *transposeMatrix, const LNKFloat *thetaVector, const LNKFloat *outputVector, LNKFloat *workgroupEC, LNKFloat *workgroupCC, LNKFloat *workgroupCC2, LNKSize rowCount, LNKSize columnCount, BOOL enableRegularization, LNKFloat lambda, LNKHFunction hFunction);
+extern void _LNKComputeBatchGradient(LNKMatrix *matrix, const LNKFloat *thetaVector, LNKFloat *workgroupEC, LNKFloat *workgroupCC, LNKFloat *workgroupCC2, BOOL enableRegularization, LNKFloat lambda, LNKHFunction hFunction);
 
 - (LNKLinearRegressionPredictor *)_ex1PredictorGD {
 	NSURL *url = [[NSBundle bundleForClass:[self class]] URLForResource:@"ex1data1" withExtension:@"txt"];
@@ -78,6 +79,27 @@ extern void _LNKComputeBatchGradient(const LNKFloat *matrixBuffer, const LNKFloa
 	XCTAssertEqualWithAccuracy(thetaVector[1],  1.166362, DACCURACY, @"The Theta vector is incorrect");
 }
 
+- (void)test3StochasticGradientDescent {
+	NSURL *url = [[NSBundle bundleForClass:[self class]] URLForResource:@"ex1data1" withExtension:@"txt"];
+	LNKMatrix *matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:url];
+	LNKOptimizationAlgorithmStochasticGradientDescent *algorithm = [LNKOptimizationAlgorithmStochasticGradientDescent algorithmWithAlpha:[LNKFixedAlpha withValue:0.001]
+																													  iterationCount:1500];
+	algorithm.stepCount = matrix.rowCount;
+	
+	LNKLinearRegressionPredictor *predictor = [[LNKLinearRegressionPredictor alloc] initWithMatrix:matrix
+															implementationType:LNKImplementationTypeAccelerate
+														 optimizationAlgorithm:algorithm];
+	[matrix release];
+	[predictor train];
+	
+	// Each step must pair a shuffled row with its own output; pairing it with the output of the unshuffled row at the
+	// same index fits a flat line around the mean.
+	LNKFloat *thetaVector = [predictor _thetaVector];
+	XCTAssertEqualWithAccuracy(thetaVector[0], -3.895781, DACCURACY, @"The Theta vector is incorrect");
+	XCTAssertEqualWithAccuracy(thetaVector[1],  1.193034, DACCURACY, @"The Theta vector is incorrect");
+	[predictor release];
+}
+
 - (void)test4Prediction {
 	LNKLinearRegressionPredictor *predictor = [self _ex1PredictorGD];
 	[predictor train];
@@ -192,24 +214,25 @@ extern void _LNKComputeBatchGradient(const LNKFloat *matrixBuffer, const LNKFloa
 	const LNKSize rowCount = workingMatrix.rowCount;
 	const LNKSize columnCount = workingMatrix.columnCount;
 	
-	const LNKFloat *matrixBuffer = workingMatrix.matrixBuffer;
-	const LNKFloat *outputVector = workingMatrix.outputVector;
-	
 	LNKFloat *workgroupEC = LNKFloatAlloc(rowCount);
 	LNKFloat *workgroupCC = LNKFloatAlloc(columnCount);
 	LNKFloat *workgroupCC2 = LNKFloatAlloc(columnCount);
 	
-	LNKFloat *transposeMatrix = LNKFloatAlloc(rowCount * columnCount);
-	LNK_mtrans(matrixBuffer, transposeMatrix, columnCount, rowCount);
-	
-	_LNKComputeBatchGradient(matrixBuffer, transposeMatrix, thetaVector, outputVector, workgroupEC, workgroupCC, workgroupCC2, rowCount, columnCount, regularizationEnabled, lambda, NULL);
+	_LNKComputeBatchGradient(workingMatrix, thetaVector, workgroupEC, workgroupCC, workgroupCC2, regularizationEnabled, lambda, NULL);
 	XCTAssertEqualWithAccuracy(workgroupCC[0], -15.3030, DACCURACY, @"Incorrect gradient");
 	XCTAssertEqualWithAccuracy(workgroupCC[1], 598.2507, DACCURACY, @"Incorrect gradient");
 	
+	// Sparse matrices are multiplied over their non-zero values and arrive at the same gradient.
+	LNKSparseMatrix *const sparseMatrix = [[LNKSparseMatrix alloc] initWithMatrix:workingMatrix];
+	const LNKFloat denseGradient[2] = { workgroupCC[0], workgroupCC[1] };
+	_LNKComputeBatchGradient(sparseMatrix, thetaVector, workgroupEC, workgroupCC, workgroupCC2, regularizationEnabled, lambda, NULL);
+	XCTAssertEqualWithAccuracy(workgroupCC[0], denseGradient[0], 1e-9);
+	XCTAssertEqualWithAccuracy(workgroupCC[1], denseGradient[1], 1e-9);
+	[sparseMatrix release];
+	
 	free(workgroupEC);
 	free(workgroupCC);
 	free(workgroupCC2);
-	free(transposeMatrix);
 	
 	[predictor train];
 
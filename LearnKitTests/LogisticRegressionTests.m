@@ -113,4 +113,31 @@
 	}];
 }
 
+- (void)test4BatchPrediction {
+	NSURL *url = [[NSBundle bundleForClass:[self class]] URLForResource:@"ex2data1" withExtension:@"csv"];
+	LNKMatrix *matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:url];
+	LNKOptimizationAlgorithmLBFGS *algorithm = [[LNKOptimizationAlgorithmLBFGS alloc] init];
+	LNKLogisticRegressionClassifier *classifier = [[LNKLogisticRegressionClassifier alloc] initWithMatrix:matrix implementationType:LNKImplementationTypeAccelerate optimizationAlgorithm:algorithm];
+	[algorithm release];
+	[classifier train];
+	
+	const LNKSize rowCount = matrix.rowCount;
+	LNKFloat *values = LNKFloatAlloc(rowCount);
+	LNKFloat *probabilities = LNKFloatAlloc(rowCount * 2);
+	[classifier predictValuesForMatrix:matrix outputBuffer:values];
+	[classifier predictProbabilitiesForMatrix:matrix outputBuffer:probabilities];
+	
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKVector featureVector = LNKVectorCreateUnsafe([matrix rowAtIndex:row], matrix.columnCount);
+		XCTAssertEqualWithAccuracy(values[row], [[classifier predictValueForFeatureVector:featureVector] LNKFloatValue], 1e-9);
+		XCTAssertEqualWithAccuracy(probabilities[row * 2], 1 - values[row], 1e-9);
+		XCTAssertEqualWithAccuracy(probabilities[row * 2 + 1], values[row], 1e-9);
+	}
+	
+	free(probabilities);
+	free(values);
+	[classifier release];
+	[matrix release];
+}
+
 @end
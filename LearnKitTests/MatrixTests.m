@@ -8,9 +8,12 @@
 #import <Cocoa/Cocoa.h>
 #import <XCTest/XCTest.h>
 
+#import "LNKAccelerate.h"
 #import "LNKCSVColumnRule.h"
 #import "LNKMatrixCSV.h"
+#import "LNKMatrixExporting.h"
 #import "LNKMatrixPrivate.h"
+#import "LNKSparseMatrix.h"
 
 @interface MatrixTests : XCTestCase
 
@@ -49,6 +52,74 @@
 	XCTAssertEqual([submatrix rowAtIndex:1][2], 2);
 }
 
+- (void)testRowViews {
+	const LNKSize rowCount = 100;
+	const LNKSize columnCount = 3;
+
+	// Every value identifies its row, so views can be checked against the rows they claim to hold.
+	LNKMatrix *matrix = [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		for (LNKSize row = 0; row < rowCount; row++) {
+			for (LNKSize column = 0; column < columnCount; column++)
+				matrix[row * columnCount + column] = row * 10 + column;
+
+			outputVector[row] = row;
+		}
+
+		return YES;
+	}];
+
+	void (^verifyRows)(LNKMatrix *) = ^(LNKMatrix *view) {
+		for (LNKSize row = 0; row < view.rowCount; row++) {
+			const LNKFloat sourceRow = view.outputVector[row];
+			XCTAssertEqual([view rowAtIndex:row][2], sourceRow * 10 + 2);
+			XCTAssertEqual([view valueAtRow:row column:1], sourceRow * 10 + 1);
+		}
+	};
+
+	LNKMatrix *trainingMatrix = nil, *testMatrix = nil;
+	[matrix splitIntoTrainingMatrix:&trainingMatrix testMatrix:&testMatrix trainingBias:0.7];
+	XCTAssertEqual(trainingMatrix.rowCount, (LNKSize)70);
+	XCTAssertEqual(testMatrix.rowCount, (LNKSize)30);
+	verifyRows(trainingMatrix);
+	verifyRows(testMatrix);
+
+	// The two halves hold every row exactly once.
+	NSMutableIndexSet *rows = [NSMutableIndexSet indexSet];
+	for (LNKSize row = 0; row < 70; row++)
+		[rows addIndex:(NSUInteger)trainingMatrix.outputVector[row]];
+	for (LNKSize row = 0; row < 30; row++)
+		[rows addIndex:(NSUInteger)testMatrix.outputVector[row]];
+	XCTAssertEqual(rows.count, (NSUInteger)rowCount);
+
+	LNKMatrix *rangeMatrix = [matrix submatrixWithRowRange:NSMakeRange(40, 20)];
+	XCTAssertEqual(rangeMatrix.matrixBuffer, [matrix rowAtIndex:40], @"Row ranges should not copy rows");
+	verifyRows(rangeMatrix);
+
+	// Views of views, which must outlive the matrices they were made from.
+	LNKMatrix *shuffledRangeMatrix = [rangeMatrix copyShuffledMatrix];
+	LNKMatrix *testRangeMatrix = [[testMatrix submatrixWithRowRange:NSMakeRange(5, 10)] retain];
+	[matrix release];
+
+	verifyRows(shuffledRangeMatrix);
+	verifyRows(testRangeMatrix);
+	XCTAssertEqual(testRangeMatrix.outputVector[0], testMatrix.outputVector[5]);
+
+	// Contiguous data is gathered on demand and matches the rows.
+	const LNKFloat *buffer = testRangeMatrix.matrixBuffer;
+	for (LNKSize row = 0; row < testRangeMatrix.rowCount; row++)
+		XCTAssertEqual(memcmp(buffer + row * columnCount, [testRangeMatrix rowAtIndex:row], columnCount * sizeof(LNKFloat)), 0);
+
+	// Output vectors are not shared.
+	[testRangeMatrix modifyOutputVector:^(LNKFloat *outputVector, LNKSize m) {
+#pragma unused(m)
+		outputVector[0] = -1;
+	}];
+	XCTAssertNotEqual(testMatrix.outputVector[5], -1);
+
+	[shuffledRangeMatrix release];
+	[testRangeMatrix release];
+}
+
 - (void)testShufflingIndices {
 	NSURL *const url = [[NSBundle bundleForClass:self.class] URLForResource:@"Pima" withExtension:@"csv"];
 	LNKMatrix *const matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:url];
@@ -119,4 +190,256 @@
 	[matrix release];
 }
 
+/// Writes a CSV file of `rowCount` rows with a header, a quoted label column and Windows line endings.
+static NSURL *_writeSyntheticCSV(LNKSize rowCount) {
+	NSURL *const url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+	FILE *const file = fopen(url.fileSystemRepresentation, "w");
+	fputs("id,label,half,class\r\n", file);
+
+	for (LNKSize row = 0; row < rowCount; row++)
+		fprintf(file, "%llu,\"row, %llu\",%g,%llu\r\n", row, row, row * 0.5, row % 2);
+
+	fclose(file);
+	return url;
+}
+
+- (void)testLoadingCSVAcrossChunks {
+	// Large enough to be split into several chunks.
+	const LNKSize rowCount = 200000;
+	NSURL *const url = _writeSyntheticCSV(rowCount);
+
+	LNKMatrix *const matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:url delimiter:',' ignoringHeader:YES columnPreprocessingRules:@{
+		@1: [LNKCSVColumnRule conversionRuleWithBlock:^LNKFloat(NSString *string) {
+			return [string hasPrefix:@"\"row"] ? 1 : 0;
+		}],
+		@3: [LNKCSVColumnRule deleteRule],
+		@2: [LNKCSVColumnRule outputRule]
+	}];
+	[[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+
+	XCTAssertEqual(matrix.rowCount, rowCount);
+	XCTAssertEqual(matrix.columnCount, (LNKSize)2);
+
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKFloat *values = [matrix rowAtIndex:row];
+
+		if (values[0] != row || values[1] != 1 || matrix.outputVector[row] != row * 0.5) {
+			XCTFail(@"Row %llu was not parsed correctly", row);
+			break;
+		}
+	}
+
+	[matrix release];
+}
+
+- (void)testCSVLoadingThroughput {
+	NSBundle *const bundle = [NSBundle bundleForClass:self.class];
+	NSMutableArray<NSURL *> *const urls = [NSMutableArray arrayWithObjects:[bundle URLForResource:@"CASP" withExtension:@"csv"], [bundle URLForResource:@"Pima" withExtension:@"csv"], nil];
+
+	// Larger files, such as the multi-gigabyte ones we train on, can be measured by setting the number of rows.
+	const char *const syntheticRowCount = getenv("LNK_SYNTHETIC_CSV_ROWS");
+	NSURL *const syntheticURL = syntheticRowCount ? _writeSyntheticCSV(strtoull(syntheticRowCount, NULL, 10)) : nil;
+
+	if (syntheticURL)
+		[urls addObject:syntheticURL];
+
+	[self measureBlock:^{
+		for (NSURL *url in urls) {
+			LNKMatrix *const matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:url delimiter:',' ignoringHeader:url == syntheticURL columnPreprocessingRules:@{}];
+			XCTAssertNotNil(matrix);
+			[matrix release];
+		}
+	}];
+
+	if (syntheticURL)
+		[[NSFileManager defaultManager] removeItemAtURL:syntheticURL error:NULL];
+}
+
+- (void)testNativeFormatRoundTrip {
+	const LNKSize rowCount = 50;
+	const LNKSize columnCount = 7;
+
+	LNKMatrix *const rawMatrix = [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *matrix, LNKFloat *outputVector) {
+		for (LNKSize index = 0; index < rowCount * columnCount; index++)
+			matrix[index] = sin((LNKFloat)index) * index;
+
+		for (LNKSize row = 0; row < rowCount; row++)
+			outputVector[row] = row % 3;
+
+		return YES;
+	}];
+
+	LNKMatrix *const matrix = [rawMatrix.normalizedMatrix matrixByAddingBiasColumn];
+	NSURL *const url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+
+	NSError *error = nil;
+	XCTAssertTrue([matrix writeNativeDataToURL:url error:&error], @"%@", error);
+
+	LNKMatrix *const loadedMatrix = [[LNKMatrix alloc] initWithNativeMatrixAtURL:url];
+	XCTAssertNotNil(loadedMatrix);
+	XCTAssertEqual(loadedMatrix.rowCount, rowCount);
+	XCTAssertEqual(loadedMatrix.columnCount, columnCount + 1);
+	XCTAssertTrue(loadedMatrix.hasBiasColumn);
+	XCTAssertTrue(loadedMatrix.normalized);
+	XCTAssertEqual(memcmp(loadedMatrix.matrixBuffer, matrix.matrixBuffer, rowCount * (columnCount + 1) * sizeof(LNKFloat)), 0);
+	XCTAssertEqual(memcmp(loadedMatrix.outputVector, matrix.outputVector, rowCount * sizeof(LNKFloat)), 0);
+	XCTAssertEqual(memcmp(loadedMatrix.normalizationMeanVector, matrix.normalizationMeanVector, (columnCount + 1) * sizeof(LNKFloat)), 0);
+	XCTAssertEqual(memcmp(loadedMatrix.normalizationStandardDeviationVector, matrix.normalizationStandardDeviationVector, (columnCount + 1) * sizeof(LNKFloat)), 0);
+
+	// Changes to a loaded matrix must not reach the file.
+	[loadedMatrix modifyOutputVector:^(LNKFloat *outputVector, LNKSize m) {
+		LNKFloat zero = 0;
+		LNK_vfill(&zero, outputVector, UNIT_STRIDE, m);
+	}];
+	[loadedMatrix release];
+
+	LNKMatrix *const reloadedMatrix = [[LNKMatrix alloc] initWithNativeMatrixAtURL:url];
+	XCTAssertEqual(memcmp(reloadedMatrix.outputVector, matrix.outputVector, rowCount * sizeof(LNKFloat)), 0);
+	[reloadedMatrix release];
+
+	// Matrices that were never normalized load as such.
+	XCTAssertTrue([rawMatrix writeNativeDataToURL:url error:&error], @"%@", error);
+	LNKMatrix *const loadedRawMatrix = [[LNKMatrix alloc] initWithNativeMatrixAtURL:url];
+	XCTAssertFalse(loadedRawMatrix.normalized);
+	XCTAssertFalse(loadedRawMatrix.hasBiasColumn);
+	XCTAssertEqualObjects(loadedRawMatrix, rawMatrix);
+	[loadedRawMatrix release];
+	[rawMatrix release];
+
+	// Truncated files are rejected.
+	NSFileHandle *const fileHandle = [NSFileHandle fileHandleForWritingToURL:url error:&error];
+	[fileHandle truncateFileAtOffset:100];
+	[fileHandle closeFile];
+	XCTAssertNil([[LNKMatrix alloc] initWithNativeMatrixAtURL:url]);
+
+	[[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
+- (void)testSparseMatrix {
+	const LNKSize rowCount = 60;
+	const LNKSize columnCount = 9;
+
+	// Roughly one value in five is non-zero. The last row is left empty and one entry is given twice.
+	LNKSparseTriplet *const triplets = malloc(rowCount * columnCount * sizeof(LNKSparseTriplet));
+	LNKSize tripletCount = 0;
+
+	for (LNKSize row = 0; row < rowCount - 1; row++) {
+		for (LNKSize column = 0; column < columnCount; column++) {
+			if ((row * 7 + column * 3) % 5 == 0)
+				triplets[tripletCount++] = (LNKSparseTriplet) { row, column, row + column * 0.5 + 1 };
+		}
+	}
+
+	triplets[tripletCount++] = (LNKSparseTriplet) { 0, 0, 2 };
+
+	// Triplets can come in any order.
+	for (LNKSize index = 0; index < tripletCount / 2; index++) {
+		const LNKSparseTriplet temp = triplets[index];
+		triplets[index] = triplets[tripletCount - 1 - index];
+		triplets[tripletCount - 1 - index] = temp;
+	}
+
+	LNKFloat *const outputVector = LNKFloatAlloc(rowCount);
+	for (LNKSize row = 0; row < rowCount; row++)
+		outputVector[row] = row;
+
+	LNKSparseMatrix *const matrix = [[LNKSparseMatrix alloc] initWithRowCount:rowCount columnCount:columnCount triplets:triplets tripletCount:tripletCount outputVector:outputVector];
+	free(triplets);
+	XCTAssertTrue(matrix.sparse);
+	XCTAssertEqual(matrix.nonzeroCount, tripletCount - 1);
+	XCTAssertEqual([matrix valueAtRow:0 column:0], 3);
+	XCTAssertEqual([matrix valueAtRow:rowCount - 1 column:4], 0);
+
+	LNKMatrix *const denseMatrix = [[LNKMatrix alloc] initWithRowCount:rowCount columnCount:columnCount prepareBuffers:^BOOL(LNKFloat *buffer, LNKFloat *denseOutputVector) {
+		for (LNKSize row = 0; row < rowCount; row++) {
+			for (LNKSize column = 0; column < columnCount; column++)
+				buffer[row * columnCount + column] = [matrix valueAtRow:row column:column];
+		}
+
+		LNKFloatCopy(denseOutputVector, outputVector, rowCount);
+		return YES;
+	}];
+	free(outputVector);
+
+	XCTAssertEqualObjects(matrix, denseMatrix);
+
+	LNKSparseMatrix *const convertedMatrix = [[LNKSparseMatrix alloc] initWithMatrix:denseMatrix];
+	XCTAssertEqual(convertedMatrix.nonzeroCount, matrix.nonzeroCount);
+	XCTAssertEqual(memcmp(convertedMatrix.columnIndices, matrix.columnIndices, matrix.nonzeroCount * sizeof(LNKSize)), 0);
+	[convertedMatrix release];
+
+	// Products match those of the dense matrix.
+	const LNKSize productColumnCount = 3;
+	LNKFloat *const buffer = LNKFloatAlloc(MAX(rowCount, columnCount) * productColumnCount);
+	LNKFloat *const sparseResult = LNKFloatAlloc(MAX(rowCount, columnCount) * productColumnCount);
+	LNKFloat *const denseResult = LNKFloatAlloc(MAX(rowCount, columnCount) * productColumnCount);
+
+	for (LNKSize index = 0; index < MAX(rowCount, columnCount) * productColumnCount; index++)
+		buffer[index] = cos((LNKFloat)index);
+
+	const LNKSize widths[] = { 1, productColumnCount };
+
+	for (LNKSize widthIndex = 0; widthIndex < 2; widthIndex++) {
+		const LNKSize width = widths[widthIndex];
+		[matrix multiplyByBuffer:buffer columnCount:width outputBuffer:sparseResult];
+		[denseMatrix multiplyByBuffer:buffer columnCount:width outputBuffer:denseResult];
+
+		for (LNKSize index = 0; index < rowCount * width; index++)
+			XCTAssertEqualWithAccuracy(sparseResult[index], denseResult[index], 1e-9);
+
+		[matrix multiplyTransposeByBuffer:buffer columnCount:width outputBuffer:sparseResult];
+		[denseMatrix multiplyTransposeByBuffer:buffer columnCount:width outputBuffer:denseResult];
+
+		for (LNKSize index = 0; index < columnCount * width; index++)
+			XCTAssertEqualWithAccuracy(sparseResult[index], denseResult[index], 1e-9);
+	}
+
+	free(buffer);
+	free(sparseResult);
+	free(denseResult);
+
+	// Bias columns, row ranges and splits stay sparse.
+	LNKMatrix *const biasMatrix = [matrix matrixByAddingBiasColumn];
+	XCTAssertTrue(biasMatrix.sparse);
+	XCTAssertTrue(biasMatrix.hasBiasColumn);
+	XCTAssertEqualObjects(biasMatrix, [denseMatrix matrixByAddingBiasColumn]);
+
+	LNKMatrix *const rangeMatrix = [matrix submatrixWithRowRange:NSMakeRange(10, 20)];
+	XCTAssertTrue(rangeMatrix.sparse);
+	XCTAssertEqualObjects(rangeMatrix, [denseMatrix submatrixWithRowRange:NSMakeRange(10, 20)]);
+
+	LNKMatrix *trainingMatrix = nil, *testMatrix = nil;
+	[matrix splitIntoTrainingMatrix:&trainingMatrix testMatrix:&testMatrix trainingBias:0.5];
+	XCTAssertTrue(testMatrix.sparse);
+
+	for (LNKSize row = 0; row < testMatrix.rowCount; row++) {
+		const LNKSize sourceRow = (LNKSize)testMatrix.outputVector[row];
+
+		for (LNKSize column = 0; column < columnCount; column++)
+			XCTAssertEqual([testMatrix valueAtRow:row column:column], [denseMatrix valueAtRow:sourceRow column:column]);
+	}
+
+	[denseMatrix release];
+	[matrix release];
+}
+
+- (void)testLoadingTripletFiles {
+	NSURL *const url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]];
+	NSString *const contents = @"%%MatrixMarket matrix coordinate real general\n% A comment\n3 4 3\n1 1 2.5\n3 4 -1\n2 2 7\n";
+	XCTAssertTrue([contents writeToURL:url atomically:YES encoding:NSUTF8StringEncoding error:NULL]);
+
+	LNKSparseMatrix *const matrix = [[LNKSparseMatrix alloc] initWithTripletFileAtURL:url rowCount:3 columnCount:4];
+	XCTAssertNotNil(matrix);
+	XCTAssertEqual(matrix.nonzeroCount, (LNKSize)3);
+	XCTAssertEqual([matrix valueAtRow:0 column:0], 2.5);
+	XCTAssertEqual([matrix valueAtRow:1 column:1], 7);
+	XCTAssertEqual([matrix valueAtRow:2 column:3], -1);
+	[matrix release];
+
+	// Indices beyond the given dimensions are rejected.
+	XCTAssertNil([[LNKSparseMatrix alloc] initWithTripletFileAtURL:url rowCount:2 columnCount:4]);
+
+	[[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
 @end
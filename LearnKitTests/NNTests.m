@@ -7,9 +7,12 @@
 
 #import <Foundation/Foundation.h>
 #import <XCTest/XCTest.h>
+#import <sched.h>
 
 #import "LNKConfusionMatrix.h"
+#import "LNKExecutor.h"
 #import "LNKMatrix.h"
+#import "LNKMemoryBufferManager.h"
 #import "LNKNeuralNetClassifier.h"
 #import "LNKNeuralNetClassifierPrivate.h"
 #import "LNKOptimizationAlgorithm.h"
@@ -25,6 +28,9 @@
 
 #define DACCURACY 0.01
 
+/// The number of examples the neural network classifier computes gradients for at a time.
+#define MINI_BATCH_SIZE 256
+
 - (LNKNeuralNetClassifier *)_preLearnedClassifierWithRegularization:(BOOL)regularize matrix:(LNKMatrix **)outMatrix {
 	NSBundle *bundle = [NSBundle bundleForClass:[self class]];
 	NSURL *matrixURL = [bundle URLForResource:@"ex3data1_X" withExtension:@"dat"];
@@ -136,6 +142,166 @@
 	LNKClass *const eight = [LNKClass classWithUnsignedInteger:8];
 	const LNKSize examples = matrix.rowCount / 10;
 	XCTAssertGreaterThanOrEqual([confusionMatrix frequencyForTrueClass:eight predictedClass:eight], 0.8 * examples);
+	XCTAssertEqual(confusionMatrix.exampleCount, matrix.rowCount);
+	
+	// Every example gets a class, so pooling the counts of all classes gives the accuracy.
+	const LNKFloat accuracy = [classifier computeClassificationAccuracyOnMatrix:matrix];
+	XCTAssertEqualWithAccuracy(confusionMatrix.microPrecision, accuracy, 1e-12);
+	XCTAssertEqualWithAccuracy(confusionMatrix.microRecall, accuracy, 1e-12);
+	XCTAssertEqualWithAccuracy(confusionMatrix.microF1Score, accuracy, 1e-12);
+	
+	const LNKSize eightIndex = [classifier.classes indexForClass:eight];
+	const LNKFloat precision = [confusionMatrix precisionForClassAtIndex:eightIndex];
+	const LNKFloat recall = [confusionMatrix recallForClassAtIndex:eightIndex];
+	XCTAssertEqualWithAccuracy(recall, [confusionMatrix frequencyForTrueClassAtIndex:eightIndex predictedClassAtIndex:eightIndex] / (LNKFloat)examples, 1e-12);
+	XCTAssertEqualWithAccuracy([confusionMatrix f1ScoreForClassAtIndex:eightIndex], 2 * precision * recall / (precision + recall), 1e-12);
+	XCTAssertGreaterThan(confusionMatrix.macroF1Score, 0.9);
+}
+
+- (void)test6PooledAllocationsPerEpoch {
+	LNKMatrix *matrix = nil;
+	LNKNeuralNetClassifier *classifier = [self _preLearnedClassifierWithRegularization:YES matrix:&matrix];
+	id<LNKOptimizationAlgorithmDelegate> delegate = (id<LNKOptimizationAlgorithmDelegate>)classifier;
+	LNKFloat *gradient = LNKFloatAlloc([classifier _totalUnitCount]);
+	const LNKRange epoch = LNKRangeMake(0, matrix.rowCount);
+	
+	// Epochs only warm up the pools of the threads that run them, and work stealing may leave a thread idle for a whole
+	// epoch, so every thread of the executor first computes the gradient of one full mini-batch. Nested gradient
+	// computations of a single mini-batch run on the thread that starts them, and the threads wait for each other so
+	// none of them can take a second chunk.
+	LNKExecutorRef executor = LNKExecutorGetShared();
+	const LNKSize threadCount = LNKExecutorGetThreadCount(executor);
+	const LNKSize totalUnitCount = [classifier _totalUnitCount];
+	__block LNKSize startedThreadCount = 0;
+	
+	LNKExecutorApply(executor, LNKRangeMake(0, threadCount), 1, ^(LNKRange range, LNKSize threadIndex) {
+#pragma unused(range)
+#pragma unused(threadIndex)
+		__atomic_add_fetch(&startedThreadCount, 1, __ATOMIC_ACQ_REL);
+		
+		while (__atomic_load_n(&startedThreadCount, __ATOMIC_ACQUIRE) < threadCount)
+			sched_yield();
+		
+		LNKFloat *threadGradient = LNKFloatAlloc(totalUnitCount);
+		[delegate computeGradientForOptimizationAlgorithm:threadGradient inRange:LNKRangeMake(0, MINI_BATCH_SIZE)];
+		free(threadGradient);
+	});
+	
+	// Whichever chunks the threads take, a full epoch now runs out of warm pools.
+	LNKMemoryBufferResetGlobalStatistics();
+	[delegate computeGradientForOptimizationAlgorithm:gradient inRange:epoch];
+	XCTAssertEqual(LNKMemoryBufferGetGlobalStatistics().missCount, 0ULL, @"Warming up every thread should leave nothing to allocate from the system");
+	
+	LNKMemoryBufferResetGlobalStatistics();
+	const int64_t bytesInUse = LNKMemoryBufferGetGlobalStatistics().bytesInUse;
+	
+	__block NSUInteger epochCount = 0;
+	[self measureBlock:^{
+		[delegate computeGradientForOptimizationAlgorithm:gradient inRange:epoch];
+		epochCount++;
+	}];
+	
+	const LNKMemoryBufferStatistics statistics = LNKMemoryBufferGetGlobalStatistics();
+	XCTAssertGreaterThanOrEqual(statistics.hitCount, epochCount, @"Epochs should allocate from the pools");
+	XCTAssertGreaterThan(statistics.highWaterBytes, bytesInUse, @"Epochs should allocate from the pools");
+	XCTAssertEqual(statistics.bytesInUse, bytesInUse, @"Every pooled allocation should be returned by the end of an epoch");
+	
+	// Once warm, mini-batches reuse the same scratch and pooled blocks every epoch.
+	XCTAssertEqual(statistics.missCount, 0ULL, @"Allocations fell through to the system after warming up");
+	
+	free(gradient);
+}
+
+- (void)_assertGradientOfClassifier:(LNKNeuralNetClassifier *)classifier matchesFiniteDifferencesOnMatrix:(LNKMatrix *)matrix {
+	id<LNKOptimizationAlgorithmDelegate> delegate = (id<LNKOptimizationAlgorithmDelegate>)classifier;
+	LNKFloat *gradient = LNKFloatAlloc([classifier _totalUnitCount]);
+	
+	// The range is not a multiple of the batch size so the final partial batch is covered too.
+	[delegate computeGradientForOptimizationAlgorithm:gradient inRange:LNKRangeMake(0, matrix.rowCount)];
+	
+	// (layer, row, column) of weights in both theta vectors, including ones applied to bias units.
+	const LNKSize weights[][3] = { { 0, 0, 0 }, { 0, 3, 200 }, { 0, 24, 400 }, { 1, 0, 0 }, { 1, 4, 13 }, { 1, 9, 25 } };
+	const LNKFloat epsilon = 1e-4;
+	
+	for (size_t i = 0; i < sizeof(weights) / sizeof(weights[0]); i++) {
+		LNKSize rows, columns;
+		LNKFloat *thetaVector = [classifier _thetaVectorForLayerAtIndex:weights[i][0] rows:&rows columns:&columns];
+		const LNKSize index = weights[i][1] * columns + weights[i][2];
+		const LNKSize gradientOffset = weights[i][0] == 0 ? 0 : [classifier _unitsInThetaVectorAtIndex:0];
+		
+		const LNKFloat weight = thetaVector[index];
+		thetaVector[index] = weight + epsilon;
+		const LNKFloat costAbove = [classifier _evaluateCostFunction];
+		thetaVector[index] = weight - epsilon;
+		const LNKFloat costBelow = [classifier _evaluateCostFunction];
+		thetaVector[index] = weight;
+		
+		XCTAssertEqualWithAccuracy(gradient[gradientOffset + index], (costAbove - costBelow) / (2 * epsilon), 1e-7, @"Incorrect gradient");
+	}
+	
+	free(gradient);
+}
+
+- (void)test7BatchedGradientMatchesFiniteDifferences {
+	LNKMatrix *matrix = nil;
+	LNKNeuralNetClassifier *classifier = [self _preLearnedClassifierWithRegularization:NO matrix:&matrix];
+	[self _assertGradientOfClassifier:classifier matchesFiniteDifferencesOnMatrix:matrix];
+}
+
+- (void)test8BatchPrediction {
+	LNKMatrix *matrix = nil;
+	LNKNeuralNetClassifier *classifier = [self _preLearnedClassifierWithRegularization:NO matrix:&matrix];
+	const LNKSize rowCount = matrix.rowCount;
+	const LNKSize columnCount = matrix.columnCount;
+	const LNKSize classCount = classifier.classes.count;
+	
+	LNKFloat *probabilities = LNKFloatAlloc(rowCount * classCount);
+	LNKFloat *values = LNKFloatAlloc(rowCount);
+	[classifier predictProbabilitiesForMatrix:matrix outputBuffer:probabilities];
+	[classifier predictValuesForMatrix:matrix outputBuffer:values];
+	
+	LNKFloat rowProbabilities[classCount];
+	
+	// Batches are fed forward with matrix-matrix products, so they only match single feature vectors up to rounding.
+	for (LNKSize row = 0; row < rowCount; row++) {
+		const LNKSize classIndex = [classifier predictClassIndexForFeatureVector:LNKVectorCreateUnsafe([matrix rowAtIndex:row], columnCount) probabilities:rowProbabilities];
+		
+		for (LNKSize classOffset = 0; classOffset < classCount; classOffset++)
+			XCTAssertEqualWithAccuracy(probabilities[row * classCount + classOffset], rowProbabilities[classOffset], 1e-9);
+		
+		XCTAssertEqual((LNKSize)values[row], [classifier.classes classAtIndex:classIndex].unsignedIntegerValue);
+	}
+	
+	free(values);
+	free(probabilities);
+}
+
+- (void)test9TanhGradientMatchesFiniteDifferences {
+	LNKMatrix *matrix = nil;
+	LNKNeuralNetClassifier *sigmoidClassifier = [self _preLearnedClassifierWithRegularization:NO matrix:&matrix];
+	LNKOptimizationAlgorithmCG *algorithm = [[LNKOptimizationAlgorithmCG alloc] init];
+	
+	// The tanh gradient squares every activation with `LNK_vpows`, which runs the portable kernel without Accelerate.
+	NSArray<LNKNeuralNetLayer *> *hiddenLayers = @[ [[[LNKNeuralNetTanhLayer alloc] initWithUnitCount:25] autorelease] ];
+	LNKNeuralNetLayer *outputLayer = [[LNKNeuralNetSigmoidLayer alloc] initWithClasses:[LNKClasses withRange:NSMakeRange(1, 10)]];
+	
+	LNKNeuralNetClassifier *classifier = [[LNKNeuralNetClassifier alloc] initWithMatrix:matrix
+																	 implementationType:LNKImplementationTypeAccelerate
+																  optimizationAlgorithm:algorithm
+																		   hiddenLayers:hiddenLayers
+																			outputLayer:outputLayer];
+	[algorithm release];
+	[outputLayer release];
+	
+	// Start from the learned weights so the hidden units are not all near zero, where tanh is almost linear.
+	for (LNKSize index = 0; index < [classifier _thetaVectorCount]; index++) {
+		LNKSize rows, columns;
+		const LNKFloat *thetaVector = [sigmoidClassifier _thetaVectorForLayerAtIndex:index rows:&rows columns:&columns];
+		[classifier _setThetaVector:thetaVector transpose:NO forLayerAtIndex:index rows:rows columns:columns];
+	}
+	
+	[self _assertGradientOfClassifier:classifier matchesFiniteDifferencesOnMatrix:matrix];
+	[classifier release];
 }
 
 @end
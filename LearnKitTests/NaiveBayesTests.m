@@ -81,6 +81,7 @@
 
 	XCTAssertEqual(probability, 0, @"There were no prior example of flus without chills");
 	XCTAssertNil(outputClass, @"No information");
+	XCTAssertEqual([classifier predictClassIndexForFeatureVector:LNKVectorCreateUnsafe(inputVector, 4) probabilities:NULL], LNKSizeMax);
 }
 
 - (void)testNaiveBayesWithLaplacianSmoothing {
@@ -101,6 +102,25 @@
 	XCTAssertEqual(outputClass.unsignedIntegerValue, 0ULL);
 }
 
+- (void)testNaiveBayesClassIndexPrediction {
+	LNKNaiveBayesClassifier *const classifier = [self _classifierForFluChills];
+
+	LNKDiscreteProbabilityDistribution *const probabilityDistribution = classifier.probabilityDistribution;
+	probabilityDistribution.performsLaplacianSmoothing = YES;
+
+	[self _registerValuesForDistribution:probabilityDistribution];
+	[classifier train];
+
+	const LNKFloat inputVector[] = {0,0,1,0};
+	LNKFloat probabilities[2];
+	const LNKSize classIndex = [classifier predictClassIndexForFeatureVector:LNKVectorCreateUnsafe(inputVector, 4) probabilities:probabilities];
+
+	XCTAssertEqual(classIndex, 0ULL);
+	XCTAssertGreaterThan(probabilities[0], probabilities[1]);
+	XCTAssertEqualWithAccuracy(probabilities[0] + probabilities[1], 1, 0.0001);
+	XCTAssertEqual([classifier predictClassIndexForFeatureVector:LNKVectorCreateUnsafe(inputVector, 4) probabilities:NULL], classIndex);
+}
+
 - (void)testGaussianNaiveBayes {
 	NSURL *const url = [[NSBundle bundleForClass:self.class] URLForResource:@"Pima" withExtension:@"csv"];
 	LNKMatrix *const matrix = [[LNKMatrix alloc] initWithCSVFileAtURL:url];
@@ -9,8 +9,12 @@
 #import <XCTest/XCTest.h>
 
 #import "LNKMatrix.h"
+#import "LNKSparseMatrix.h"
 #import "LNKTopicModeller.h"
 
+static const LNKSize documentCount = 1500;
+static const LNKSize wordCount = 12419;
+
 @interface TopicModellerTests : XCTestCase <LNKTopicModellerDelegate>
 @end
 
@@ -23,18 +27,41 @@
 	[super dealloc];
 }
 
-- (void)testNIPS {
-	const LNKSize documentCount = 1500;
-	const LNKSize wordCount = 12419;
-
+- (NSURL *)_documentURL {
 	NSURL *const docURL = [[NSBundle bundleForClass:self.class] URLForResource:@"nips-docword" withExtension:@"txt"];
-	NSURL *const vocabURL = [[NSBundle bundleForClass:self.class] URLForResource:@"nips-vocab" withExtension:@"txt"];
-
 	XCTAssertNotNil(docURL);
+	return docURL;
+}
+
+- (void)_findTopicsInDocumentMatrix:(LNKMatrix *)matrix {
+	NSURL *const vocabURL = [[NSBundle bundleForClass:self.class] URLForResource:@"nips-vocab" withExtension:@"txt"];
 	XCTAssertNotNil(vocabURL);
 
+	NSError *error2 = nil;
+	NSString *const vocabFile = [[NSString alloc] initWithContentsOfURL:vocabURL encoding:NSUTF8StringEncoding error:&error2];
+
+	NSMutableArray<NSString *> *const vocabulary = [[NSMutableArray alloc] init];
+	[vocabFile enumerateLinesUsingBlock:^(NSString *line, BOOL *stop) {
+#pragma unused(stop)
+		[vocabulary addObject:line];
+	}];
+	[vocabFile release];
+
+	NSOperationQueue *const queue = [[NSOperationQueue alloc] init];
+	LNKTopicModeller *const modeller = [[LNKTopicModeller alloc] initWithDocumentMatrix:matrix vocabulary:vocabulary topicCount:30 delegate:self];
+	[vocabulary release];
+
+	_expectation = [[self expectationWithDescription:@"Expectation"] retain];
+	[queue addOperation:modeller];
+	[modeller release];
+
+	[self waitForExpectationsWithTimeout:600 handler:nil];
+	[queue release];
+}
+
+- (void)testNIPS {
 	NSError *error = nil;
-	NSString *const document = [[NSString alloc] initWithContentsOfURL:docURL encoding:NSUTF8StringEncoding error:&error];
+	NSString *const document = [[NSString alloc] initWithContentsOfURL:[self _documentURL] encoding:NSUTF8StringEncoding error:&error];
 
 	LNKMatrix *const matrix = [[LNKMatrix alloc] initWithRowCount:documentCount columnCount:wordCount prepareBuffers:^BOOL(LNKFloat *matrixBuffer, LNKFloat *outputVector) {
 #pragma unused(outputVector)
@@ -53,27 +80,17 @@
 
 	[document release];
 
-	NSError *error2 = nil;
-	NSString *const vocabFile = [[NSString alloc] initWithContentsOfURL:vocabURL encoding:NSUTF8StringEncoding error:&error2];
-
-	NSMutableArray<NSString *> *const vocabulary = [[NSMutableArray alloc] init];
-	[vocabFile enumerateLinesUsingBlock:^(NSString *line, BOOL *stop) {
-#pragma unused(stop)
-		[vocabulary addObject:line];
-	}];
-	[vocabFile release];
-
-	NSOperationQueue *const queue = [[NSOperationQueue alloc] init];
-	LNKTopicModeller *const modeller = [[LNKTopicModeller alloc] initWithDocumentMatrix:matrix vocabulary:vocabulary topicCount:30 delegate:self];
-	[vocabulary release];
+	[self _findTopicsInDocumentMatrix:matrix];
 	[matrix release];
+}
 
-	_expectation = [[self expectationWithDescription:@"Expectation"] retain];
-	[queue addOperation:modeller];
-	[modeller release];
+- (void)testNIPSSparse {
+	// The bag-of-words file holds "document word count" triplets, which are mostly absent.
+	LNKSparseMatrix *const matrix = [[LNKSparseMatrix alloc] initWithTripletFileAtURL:[self _documentURL] rowCount:documentCount columnCount:wordCount];
+	XCTAssertNotNil(matrix);
 
-	[self waitForExpectationsWithTimeout:600 handler:nil];
-	[queue release];
+	[self _findTopicsInDocumentMatrix:matrix];
+	[matrix release];
 }
 
 - (void)topicModeller:(LNKTopicModeller *)modeller didFindTopics:(LNKTopicSet *)topics {
@@ -17,6 +17,7 @@ Copyright (C) 2001 and 2002 by Carl Edward Rasmussen. Date 2002-02-13
 
 [ Sagar G V, 2013, sagar.writeme@gmail.com ] Changes Made:
 - Ported to C
+- Cost functions receive a context pointer, and work vectors are allocated on the heap, so minimizations can run concurrently
 
 */
 
@@ -35,9 +36,12 @@ Copyright (C) 2001 and 2002 by Carl Edward Rasmussen. Date 2002-02-13
 #define MAXV 20
 #define RATIO 100.0f
 
+typedef void (*fmincg_cost_func)(void *context, LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gradVector);
+
 // 1. pass in the cost function which takes in an array and gives out cost and gradient at the given input. 
-// 2. xVector should contain the initial point which is will be modified to reflect the optimum point
-// 3. nDim is the dimension of xVector
-// 4. maxCostCalls is the maximum number of times the cost function may be called
+// 2. context is passed to every call of the cost function
+// 3. xVector should contain the initial point which is will be modified to reflect the optimum point
+// 4. nDim is the dimension of xVector
+// 5. maxCostCalls is the maximum number of times the cost function may be called
 // return value:  1 -> Num of Cost function calls exceeded max specified in the argument. 2-> line search failed
-int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gradVector), LNKFloat *xVector, int nDim, int maxCostFuncCalls);
+int fmincg(fmincg_cost_func costFunc, void *context, LNKFloat *xVector, int nDim, int maxCostFuncCalls);
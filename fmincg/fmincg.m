@@ -17,15 +17,17 @@ Copyright (C) 2001 and 2002 by Carl Edward Rasmussen. Date 2002-02-13
 
 [ Sagar GV, 2013, sagar.writeme@gmail.com ] Changes Made:
 - Ported to C
+- Cost functions receive a context pointer, and work vectors are allocated on the heap, so minimizations can run concurrently
 
 */
 #include "fmincg.h"
 
-int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gradVector), LNKFloat *xVector, int nDim, int maxCostCalls)
+// workVectors holds 7 * nDim elements. They're not kept on the stack since large problems would overflow the stacks of secondary threads.
+static int _fmincg(fmincg_cost_func costFunc, void *context, LNKFloat *xVector, int nDim, int maxCostCalls, LNKFloat *workVectors)
 {
 	int success = 0,costFuncCount=0,lineSearchFuncCount=0;
 	LNKFloat ls_failed,f1,d1,z1,f0,f2,d2,f3,d3,z3,limit,z2,A,B,C;
-	LNKFloat df1[nDim],s[nDim],x0[nDim],df0[nDim],df2[nDim],df2neg[nDim],tmp[nDim];
+	LNKFloat *df1 = workVectors, *s = df1 + nDim, *x0 = s + nDim, *df0 = x0 + nDim, *df2 = df0 + nDim, *df2neg = df2 + nDim, *tmp = df2neg + nDim;
 	LNKFloat *x = xVector;
 
 	ls_failed = 0;
@@ -36,7 +38,7 @@ int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gra
 		costFuncCount++;
 	}
 
-	(*costFunc)(xVector,&f1,df1);
+	(*costFunc)(context,xVector,&f1,df1);
 
 	LNK_vneg(df1, UNIT_STRIDE, s, UNIT_STRIDE, nDim);
 
@@ -59,7 +61,7 @@ int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gra
 			costFuncCount++;
 		}
 
-		(*costFunc)(x,&f2,df2);
+		(*costFunc)(context,x,&f2,df2);
 
 		LNK_dotpr(df2, UNIT_STRIDE, s, UNIT_STRIDE, &d2, nDim);
 
@@ -103,7 +105,7 @@ int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gra
 				}
 
 				lineSearchFuncCount++;
-				(*costFunc)(x,&f2,df2);
+				(*costFunc)(context,x,&f2,df2);
 
 				LNK_dotpr(df2, UNIT_STRIDE, s, UNIT_STRIDE, &d2, nDim);
 
@@ -156,7 +158,7 @@ int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gra
 			}
 
 			lineSearchFuncCount++;
-			(*costFunc)(x,&f2,df2);
+			(*costFunc)(context,x,&f2,df2);
 
 			LNK_dotpr(df2, UNIT_STRIDE, s, UNIT_STRIDE, &d2, nDim);
 		}
@@ -217,3 +219,12 @@ int fmincg(void (*costFunc)(LNKFloat *inputVector, LNKFloat *cost, LNKFloat *gra
 
 	return 2;
 }
+
+int fmincg(fmincg_cost_func costFunc, void *context, LNKFloat *xVector, int nDim, int maxCostCalls)
+{
+	LNKFloat *workVectors = LNKFloatAlloc(7 * (LNKSize)nDim);
+	const int result = _fmincg(costFunc, context, xVector, nDim, maxCostCalls, workVectors);
+	free(workVectors);
+
+	return result;
+}